@@ -0,0 +1,866 @@
+#include "archivewriter.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <memory>
+
+#include <zstd.h>
+
+#define ARCHIVE_TAR_BLOCK 512
+
+#define ARCHIVE_TAR_RECORD ( 20 * ARCHIVE_TAR_BLOCK )
+
+static uint64_t Func_Hash( const uint8_t * pData, size_t nBytes )
+{
+
+    ////// FNV-1a, enough to catch what a flaky stick does to a frame
+
+    uint64_t nHash = 14695981039346656037ULL;
+
+    for( size_t i = 0; i < nBytes; i++ ) nHash = ( nHash ^ pData[ i ] ) * 1099511628211ULL;
+
+    return nHash;
+
+}
+
+static BOOL Func_Fd_Write( int nFd, const uint8_t * pData, size_t nBytes )
+{
+
+    while( nBytes > 0 ) {
+
+        ssize_t nWritten = write( nFd, pData, nBytes );
+
+        if( nWritten < 0 && errno == EINTR ) continue;
+
+        if( nWritten <= 0 ) return FALSE;
+
+        pData += nWritten;
+
+        nBytes -= ( size_t )nWritten;
+
+    }
+
+    return TRUE;
+
+}
+
+static BOOL Func_Fd_Read( int nFd, uint8_t * pData, size_t nBytes, uint64_t nOffset )
+{
+
+    while( nBytes > 0 ) {
+
+        ssize_t nRead = pread( nFd, pData, nBytes, ( off_t )nOffset );
+
+        if( nRead < 0 && errno == EINTR ) continue;
+
+        if( nRead == 0 ) errno = ENODATA;               // shrank under us
+
+        if( nRead <= 0 ) return FALSE;
+
+        pData += nRead;
+
+        nBytes -= ( size_t )nRead;
+
+        nOffset += ( uint64_t )nRead;
+
+    }
+
+    return TRUE;
+
+}
+
+ArchiveWriter::ArchiveWriter( const std::string &strDir, const std::string &strName, IoScheduler * pIoScheduler, int nThreads, uint64_t nSplitBytes, int nLevel )
+    : m_strDir( strDir ), m_strName( strName ), m_pIoScheduler( pIoScheduler ), m_nSplitBytes( nSplitBytes ), m_nLevel( nLevel )
+    , m_nBlockBytes( ( uint64_t )ARCHIVE_BLOCK_MB << 20 ), m_oPool( nThreads )
+{
+
+    if( Func_Name_Reserve() == FALSE ) m_bFailed = TRUE;
+
+    m_thWriter = std::thread( &ArchiveWriter::Func_Writer_Loop, this );
+
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_bExit = TRUE;
+    }
+
+    m_cvWrite.notify_all();
+
+    if( m_thWriter.joinable() == TRUE ) m_thWriter.join();
+
+    if( m_bFinished == FALSE ) Remove();
+
+}
+
+std::string ArchiveWriter::Func_Part_Path( ULONG nPart ) const
+{
+
+    char szSuffix[ 16 ];
+
+    snprintf( szSuffix, sizeof( szSuffix ), ".%03lu", nPart );
+
+    return m_strDir + "/" + m_strName + ARCHIVE_EXTENSION + szSuffix;
+
+}
+
+BOOL ArchiveWriter::Func_Name_Reserve()
+{
+
+    ////// Names only go down to the time of the export; an archive already on the stick has
+    ////// had its sources deleted, so it must never be truncated by a later one
+
+    std::string strBase = m_strName;
+
+    for( int nTry = 0; nTry < ARCHIVE_NAME_TRIES; nTry++ ) {
+
+        if( nTry > 0 ) m_strName = strBase + "_" + std::to_string( nTry );
+
+        if( access( ( m_strDir + "/" + m_strName + ARCHIVE_MANIFEST_EXTENSION ).c_str(), F_OK ) == 0 ) continue;
+
+        m_nFd = open( Func_Part_Path( 0 ).c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644 );
+
+        if( m_nFd >= 0 ) {
+
+            m_nPartsOpened = 1;
+
+            return TRUE;
+
+        }
+
+        if( errno != EEXIST ) {
+
+            printf( "[QCAP DEBUG] %s(%d): open( %s ) failed, errno=%d\n", __FUNCTION__, __LINE__, Func_Part_Path( 0 ).c_str(), errno );
+
+            return FALSE;
+
+        }
+
+    }
+
+    printf( "[QCAP DEBUG] %s(%d): %s/%s is taken %d times over\n", __FUNCTION__, __LINE__, m_strDir.c_str(), strBase.c_str(), ARCHIVE_NAME_TRIES );
+
+    return FALSE;
+
+}
+
+ArchiveWriter::Block * ArchiveWriter::Func_Block_Current()
+{
+
+    if( m_oBatch_S.empty() == FALSE && m_oBatch_S[ m_nBlock ].vRaw.size() == m_nBlockBytes ) {
+
+        if( m_nBlock + 1 == m_oBatch_S.size() ) {
+
+            Func_Batch_Submit( m_oBatch_S.size() );
+
+        } else {
+
+            m_nBlock++;
+
+            m_oBatch_S[ m_nBlock ].vRaw.clear();
+
+            m_oBatch_S[ m_nBlock ].nRawOffset = m_nRawOffset;
+
+        }
+
+    }
+
+    if( m_oBatch_S.empty() == TRUE ) {
+
+        {
+            std::lock_guard< std::mutex > lock( m_mtx );
+
+            if( m_queFree.empty() == FALSE ) {
+
+                m_oBatch_S = std::move( m_queFree.front() );
+
+                m_queFree.pop_front();
+
+            }
+        }
+
+        m_oBatch_S.resize( ( size_t )m_oPool.GetThreadCount() );
+
+        for( Block &block : m_oBatch_S ) block.vRaw.reserve( m_nBlockBytes );
+
+        m_nBlock = 0;
+
+        m_oBatch_S[ 0 ].vRaw.clear();
+
+        m_oBatch_S[ 0 ].nRawOffset = m_nRawOffset;
+
+    }
+
+    return &m_oBatch_S[ m_nBlock ];
+
+}
+
+void ArchiveWriter::Func_Batch_Submit( size_t nBlocks )
+{
+
+    m_oBatch_S.resize( nBlocks );
+
+    m_oPool.Run( ( int )nBlocks, [ this ]( int i ) {
+
+        static thread_local std::unique_ptr< ZSTD_CCtx, size_t( * )( ZSTD_CCtx * ) > pCCtx( ZSTD_createCCtx(), ZSTD_freeCCtx );
+
+        Block &block = m_oBatch_S[ i ];
+
+        block.vCoded.resize( ZSTD_compressBound( block.vRaw.size() ) );
+
+        size_t nCoded = ZSTD_compressCCtx( pCCtx.get(), block.vCoded.data(), block.vCoded.size(), block.vRaw.data(), block.vRaw.size(), m_nLevel );
+
+        if( ZSTD_isError( nCoded ) ) {
+
+            printf( "[QCAP DEBUG] %s(%d): ZSTD_compressCCtx() failed: %s\n", __FUNCTION__, __LINE__, ZSTD_getErrorName( nCoded ) );
+
+            std::lock_guard< std::mutex > lock( m_mtx );
+
+            m_bFailed = TRUE;
+
+            nCoded = 0;
+
+        }
+
+        block.vCoded.resize( nCoded );
+
+    } );
+
+    ////// One batch waits for the writer while the next one fills, no more
+
+    std::unique_lock< std::mutex > lock( m_mtx );
+
+    m_cvFree.wait( lock, [ this ]() { return m_queWrite.empty() == TRUE || m_bFailed == TRUE; } );
+
+    m_queWrite.push_back( std::move( m_oBatch_S ) );
+
+    m_oBatch_S.clear();
+
+    m_nBlock = 0;
+
+    lock.unlock();
+
+    m_cvWrite.notify_one();
+
+}
+
+BOOL ArchiveWriter::Func_Stream_Append( const void * pData, size_t nBytes )
+{
+
+    const uint8_t * pSrc = ( const uint8_t * )pData;
+
+    while( nBytes > 0 ) {
+
+        Block * pBlock = Func_Block_Current();
+
+        size_t nTake = std::min< size_t >( nBytes, m_nBlockBytes - pBlock->vRaw.size() );
+
+        pBlock->vRaw.insert( pBlock->vRaw.end(), pSrc, pSrc + nTake );
+
+        pSrc += nTake;
+
+        nBytes -= nTake;
+
+        m_nRawOffset += nTake;
+
+    }
+
+    return TRUE;
+
+}
+
+BOOL ArchiveWriter::Func_Stream_Read( int nFd, uint64_t nBytes, uint64_t * pnRead, int * pnErrno )
+{
+
+    ////// Straight into the block, the file data is not copied again. Past a read error the
+    ////// rest of the member is zero filled, the header already promised its size.
+
+    uint64_t nOffset = 0;
+
+    BOOL bRead = TRUE;
+
+    *pnRead = 0;
+
+    while( nBytes > 0 ) {
+
+        if( m_pfnCancel != nullptr && m_pfnCancel() == TRUE ) {
+
+            m_bCancelled = TRUE;
+
+            return FALSE;
+
+        }
+
+        Block * pBlock = Func_Block_Current();
+
+        size_t nUsed = pBlock->vRaw.size();
+
+        size_t nTake = ( size_t )std::min< uint64_t >( nBytes, m_nBlockBytes - nUsed );
+
+        pBlock->vRaw.resize( nUsed + nTake );
+
+        if( bRead == TRUE && Func_Fd_Read( nFd, pBlock->vRaw.data() + nUsed, nTake, nOffset ) == FALSE ) {
+
+            *pnErrno = errno;
+
+            bRead = FALSE;
+
+        }
+
+        if( bRead == FALSE ) memset( pBlock->vRaw.data() + nUsed, 0, nTake );
+
+        else *pnRead += nTake;
+
+        nOffset += nTake;
+
+        nBytes -= nTake;
+
+        m_nRawOffset += nTake;
+
+    }
+
+    return bRead;
+
+}
+
+BOOL ArchiveWriter::Func_Header_Append( const std::string &strMember, uint64_t nSize, int64_t nMtime, char cType )
+{
+
+    char header[ ARCHIVE_TAR_BLOCK ] = {};
+
+    std::string strName = strMember, strPrefix;
+
+    if( strName.size() > 100 ) {
+
+        ////// ustar splits long paths at a '/', anything longer goes first as a GNU long name
+
+        size_t nSlash = strMember.find( '/', strMember.size() > 101 ? strMember.size() - 101 : 0 );
+
+        if( nSlash != std::string::npos && nSlash <= 155 && strMember.size() - nSlash - 1 <= 100 && nSlash > 0 ) {
+
+            strPrefix = strMember.substr( 0, nSlash );
+
+            strName = strMember.substr( nSlash + 1 );
+
+        } else {
+
+            if( Func_Header_Append( "././@LongLink", strMember.size() + 1, 0, 'L' ) == FALSE ) return FALSE;
+
+            Func_Stream_Append( strMember.c_str(), strMember.size() + 1 );
+
+            static const char zero[ ARCHIVE_TAR_BLOCK ] = {};
+
+            Func_Stream_Append( zero, ( ARCHIVE_TAR_BLOCK - ( strMember.size() + 1 ) % ARCHIVE_TAR_BLOCK ) % ARCHIVE_TAR_BLOCK );
+
+            strName = strMember.substr( 0, 100 );
+
+        }
+
+    }
+
+    memcpy( header, strName.data(), std::min< size_t >( strName.size(), 100 ) );
+
+    snprintf( header + 100, 8, "%07o", 0644 );
+
+    snprintf( header + 108, 8, "%07o", 0 );
+
+    snprintf( header + 116, 8, "%07o", 0 );
+
+    snprintf( header + 124, 12, "%011llo", ( unsigned long long )nSize );
+
+    snprintf( header + 136, 12, "%011llo", ( unsigned long long )std::min< int64_t >( std::max< int64_t >( nMtime, 0 ), 077777777777LL ) );
+
+    header[ 156 ] = cType;
+
+    memcpy( header + 257, "ustar", 6 );
+
+    memcpy( header + 263, "00", 2 );
+
+    memcpy( header + 345, strPrefix.data(), std::min< size_t >( strPrefix.size(), 155 ) );
+
+    ////// Checksum over the header with its own field as spaces
+
+    memset( header + 148, ' ', 8 );
+
+    unsigned int nSum = 0;
+
+    for( int i = 0; i < ARCHIVE_TAR_BLOCK; i++ ) nSum += ( uint8_t )header[ i ];
+
+    snprintf( header + 148, 8, "%06o", nSum );
+
+    header[ 155 ] = ' ';
+
+    return Func_Stream_Append( header, sizeof( header ) );
+
+}
+
+BOOL ArchiveWriter::Add( const std::string &strPath, const std::string &strMember )
+{
+
+    if( IsFailed() == TRUE ) return FALSE;
+
+    ////// Gone or unreadable before anything went into the stream: only listed as skipped
+
+    int nFd = open( strPath.c_str(), O_RDONLY | O_CLOEXEC );
+
+    if( nFd < 0 ) {
+
+        m_oSkip_S.push_back( { strMember, errno, 0 } );
+
+        return FALSE;
+
+    }
+
+    struct stat st = {};
+
+    if( fstat( nFd, &st ) != 0 || S_ISREG( st.st_mode ) == 0 ) {
+
+        m_oSkip_S.push_back( { strMember, ( S_ISREG( st.st_mode ) == 0 ) ? EINVAL : errno, 0 } );
+
+        close( nFd );
+
+        return FALSE;
+
+    }
+
+    uint64_t nSize = ( uint64_t )st.st_size;
+
+    Func_Header_Append( strMember, nSize, ( int64_t )st.st_mtime, '0' );
+
+    MemberEntry member = { strMember, m_nRawOffset, nSize, ( int64_t )st.st_mtime };
+
+    uint64_t nRead = 0;
+
+    int nErrno = 0;
+
+    BOOL bRead = Func_Stream_Read( nFd, nSize, &nRead, &nErrno );
+
+    close( nFd );
+
+    if( m_bCancelled == TRUE ) {
+
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_bFailed = TRUE;
+
+        return FALSE;
+
+    }
+
+    static const char zero[ ARCHIVE_TAR_BLOCK ] = {};
+
+    Func_Stream_Append( zero, ( ARCHIVE_TAR_BLOCK - nSize % ARCHIVE_TAR_BLOCK ) % ARCHIVE_TAR_BLOCK );
+
+    ////// Read failed part way ( shrank, I/O error ): the tar keeps a zero filled member so the
+    ////// stream stays aligned, the manifest lists it as skipped instead of as a member
+
+    if( bRead == FALSE ) m_oSkip_S.push_back( { strMember, nErrno, nRead } );
+
+    else m_oMember_S.push_back( member );
+
+    return ( bRead == TRUE && IsFailed() == FALSE ) ? TRUE : FALSE;
+
+}
+
+BOOL ArchiveWriter::IsFailed() const
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    return m_bFailed;
+
+}
+
+BOOL ArchiveWriter::Finish()
+{
+
+    ////// Two zero blocks end the archive, padded to a full record like tar does
+
+    std::vector< char > vEnd( 2 * ARCHIVE_TAR_BLOCK, 0 );
+
+    vEnd.resize( vEnd.size() + ( ARCHIVE_TAR_RECORD - ( m_nRawOffset + vEnd.size() ) % ARCHIVE_TAR_RECORD ) % ARCHIVE_TAR_RECORD, 0 );
+
+    Func_Stream_Append( vEnd.data(), vEnd.size() );
+
+    size_t nBlocks = ( m_oBatch_S.empty() == TRUE ) ? 0 : m_nBlock + ( ( m_oBatch_S[ m_nBlock ].vRaw.empty() == TRUE ) ? 0 : 1 );
+
+    if( nBlocks > 0 ) Func_Batch_Submit( nBlocks );
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_bExit = TRUE;
+    }
+
+    m_cvWrite.notify_all();
+
+    m_thWriter.join();
+
+    if( m_bFailed == TRUE ) return FALSE;
+
+    ////// Manifest last, so it only exists for a complete archive
+
+    std::string strManifest = m_strDir + "/" + m_strName + ARCHIVE_MANIFEST_EXTENSION;
+
+    FILE * pFp = fopen( ( strManifest + ".tmp" ).c_str(), "w" );
+
+    if( pFp == nullptr ) return FALSE;
+
+    fprintf( pFp, "bsci-archive 1 %lu %lu %s\n", ( ULONG )( m_nPart + 1 ), ( ULONG )m_nBlockBytes, m_strName.c_str() );
+
+    for( const BlockEntry &block : m_oBlock_S ) {
+
+        fprintf( pFp, "B %lu %llu %llu %llu %llu %016llx\n", block.nPart, ( unsigned long long )block.nOffset, ( unsigned long long )block.nBytes
+                 , ( unsigned long long )block.nRawOffset, ( unsigned long long )block.nRawBytes, ( unsigned long long )block.nHash );
+
+    }
+
+    for( const MemberEntry &member : m_oMember_S ) {
+
+        fprintf( pFp, "F %llu %llu %lld %s\n", ( unsigned long long )member.nOffset, ( unsigned long long )member.nSize, ( long long )member.nMtime, member.strName.c_str() );
+
+    }
+
+    for( const SkipEntry &skip : m_oSkip_S ) fprintf( pFp, "S %d %llu %s\n", skip.nErrno, ( unsigned long long )skip.nRead, skip.strName.c_str() );
+
+    BOOL bWritten = ( fflush( pFp ) == 0 ) ? TRUE : FALSE;
+
+    fclose( pFp );
+
+    if( bWritten == FALSE || rename( ( strManifest + ".tmp" ).c_str(), strManifest.c_str() ) != 0 ) return FALSE;
+
+    m_bFinished = TRUE;
+
+    printf( "[QCAP DEBUG] Archive %s: %lu files ( %lu skipped ), %lu MB -> %lu MB in %lu parts\n", m_strName.c_str(), ( ULONG )m_oMember_S.size(), ( ULONG )m_oSkip_S.size()
+            , ( ULONG )( m_nRawOffset >> 20 ), ( ULONG )( m_nBytesOut >> 20 ), ( ULONG )( m_nPart + 1 ) );
+
+    return TRUE;
+
+}
+
+void ArchiveWriter::Func_Writer_Loop()
+{
+
+    while( TRUE ) {
+
+        std::vector< Block > oBatch_S;
+
+        BOOL bOk;
+
+        {
+            std::unique_lock< std::mutex > lock( m_mtx );
+
+            m_cvWrite.wait( lock, [ this ]() { return m_bExit == TRUE || m_queWrite.empty() == FALSE; } );
+
+            if( m_queWrite.empty() == TRUE ) break;
+
+            oBatch_S = std::move( m_queWrite.front() );
+
+            m_queWrite.pop_front();
+
+            bOk = ( m_bFailed == FALSE ) ? TRUE : FALSE;
+        }
+
+        for( Block &block : oBatch_S ) if( bOk == TRUE ) bOk = Func_Block_Write( block );
+
+        {
+            std::lock_guard< std::mutex > lock( m_mtx );
+
+            if( bOk == FALSE ) m_bFailed = TRUE;
+
+            m_queFree.push_back( std::move( oBatch_S ) );
+        }
+
+        m_cvFree.notify_all();
+
+    }
+
+    if( m_nFd >= 0 ) close( m_nFd );
+
+    m_nFd = -1;
+
+}
+
+BOOL ArchiveWriter::Func_Block_Write( Block &block )
+{
+
+    if( block.vCoded.empty() == TRUE ) return FALSE;
+
+    ////// Whole frames per part, so every part boundary is also a frame boundary
+
+    if( m_nFd >= 0 && m_nPartBytes + block.vCoded.size() > m_nSplitBytes ) {
+
+        close( m_nFd );
+
+        m_nFd = -1;
+
+        m_nPart++;
+
+        m_nPartBytes = 0;
+
+    }
+
+    if( m_nFd < 0 ) {
+
+        m_nFd = open( Func_Part_Path( m_nPart ).c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644 );
+
+        if( m_nFd < 0 ) {
+
+            printf( "[QCAP DEBUG] %s(%d): open( %s ) failed, errno=%d\n", __FUNCTION__, __LINE__, Func_Part_Path( m_nPart ).c_str(), errno );
+
+            return FALSE;
+
+        }
+
+        m_nPartsOpened = m_nPart + 1;
+
+    }
+
+    if( m_pIoScheduler != nullptr ) m_pIoScheduler->Acquire( IO_CLASS_EXPORT, block.vCoded.size() );
+
+    BOOL bWritten = Func_Fd_Write( m_nFd, block.vCoded.data(), block.vCoded.size() );
+
+    if( m_pIoScheduler != nullptr ) m_pIoScheduler->Complete( IO_CLASS_EXPORT, ( bWritten == TRUE ) ? block.vCoded.size() : 0 );
+
+    if( bWritten == FALSE ) {
+
+        printf( "[QCAP DEBUG] %s(%d): write to %s failed, errno=%d\n", __FUNCTION__, __LINE__, Func_Part_Path( m_nPart ).c_str(), errno );
+
+        return FALSE;
+
+    }
+
+    BlockEntry entry = { m_nPart, m_nPartBytes, block.vCoded.size(), block.nRawOffset, block.vRaw.size(), Func_Hash( block.vCoded.data(), block.vCoded.size() ) };
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    m_oBlock_S.push_back( entry );
+
+    m_nPartBytes += block.vCoded.size();
+
+    m_nBytesOut += block.vCoded.size();
+
+    return TRUE;
+
+}
+
+BOOL ArchiveWriter::Verify()
+{
+
+    if( m_bFinished == FALSE ) return FALSE;
+
+    std::vector< uint8_t > vCoded;
+
+    int nFd = -1;
+
+    ULONG nPart = ( ULONG )-1;
+
+    BOOL bOk = TRUE;
+
+    for( const BlockEntry &block : m_oBlock_S ) {
+
+        if( block.nPart != nPart ) {
+
+            if( nFd >= 0 ) close( nFd );
+
+            nPart = block.nPart;
+
+            nFd = open( Func_Part_Path( nPart ).c_str(), O_RDONLY | O_CLOEXEC );
+
+            if( nFd < 0 ) { bOk = FALSE; break; }
+
+            posix_fadvise( nFd, 0, 0, POSIX_FADV_DONTNEED );
+
+        }
+
+        vCoded.resize( block.nBytes );
+
+        if( Func_Fd_Read( nFd, vCoded.data(), vCoded.size(), block.nOffset ) == FALSE || Func_Hash( vCoded.data(), vCoded.size() ) != block.nHash ) {
+
+            printf( "[QCAP DEBUG] %s(%d): part %lu differs at %llu\n", __FUNCTION__, __LINE__, nPart, ( unsigned long long )block.nOffset );
+
+            bOk = FALSE;
+
+            break;
+
+        }
+
+    }
+
+    if( nFd >= 0 ) close( nFd );
+
+    return bOk;
+
+}
+
+void ArchiveWriter::Remove()
+{
+
+    ////// The name was never reserved: whatever carries it belongs to another archive
+
+    if( m_nPartsOpened == 0 ) return;
+
+    for( ULONG nPart = 0; nPart < m_nPartsOpened; nPart++ ) unlink( Func_Part_Path( nPart ).c_str() );
+
+    std::string strManifest = m_strDir + "/" + m_strName + ARCHIVE_MANIFEST_EXTENSION;
+
+    unlink( strManifest.c_str() );
+
+    unlink( ( strManifest + ".tmp" ).c_str() );
+
+    m_bFinished = FALSE;
+
+}
+
+ArchiveStats ArchiveWriter::GetStats() const
+{
+
+    ArchiveStats stats;
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    stats.st_nFiles = ( ULONG )m_oMember_S.size();
+
+    stats.st_nParts = ( m_oBlock_S.empty() == TRUE ) ? 0 : m_nPart + 1;
+
+    stats.st_nBlocks = ( ULONG )m_oBlock_S.size();
+
+    stats.st_nBytesIn = m_nRawOffset;
+
+    stats.st_nBytesOut = m_nBytesOut;
+
+    return stats;
+
+}
+
+std::vector< std::string > ArchiveWriter::GetFiles() const
+{
+
+    std::vector< std::string > strFile_S;
+
+    for( ULONG nPart = 0; nPart <= m_nPart; nPart++ ) strFile_S.push_back( Func_Part_Path( nPart ) );
+
+    strFile_S.push_back( m_strDir + "/" + m_strName + ARCHIVE_MANIFEST_EXTENSION );
+
+    return strFile_S;
+
+}
+
+BOOL ArchiveWriter_Member_Extract( const char * pszManifest, const char * pszMember, const char * pszOutput )
+{
+
+    FILE * pFp = fopen( pszManifest, "r" );
+
+    if( pFp == nullptr ) return FALSE;
+
+    std::string strDir = pszManifest;
+
+    strDir = ( strDir.rfind( '/' ) == std::string::npos ) ? std::string( "." ) : strDir.substr( 0, strDir.rfind( '/' ) );
+
+    struct Frame { ULONG nPart; unsigned long long nOffset, nBytes, nRawOffset, nRawBytes; };
+
+    std::vector< Frame > oFrame_S;
+
+    char szLine[ 4096 ], szName[ 4096 ] = {};
+
+    unsigned long long nOffset = 0, nSize = 0;
+
+    BOOL bFound = FALSE;
+
+    if( fgets( szLine, sizeof( szLine ), pFp ) == nullptr || sscanf( szLine, "bsci-archive 1 %*u %*u %4095s", szName ) != 1 ) { fclose( pFp ); return FALSE; }
+
+    std::string strName = szName;
+
+    while( fgets( szLine, sizeof( szLine ), pFp ) != nullptr ) {
+
+        szLine[ strcspn( szLine, "\n" ) ] = 0;
+
+        Frame frame = {};
+
+        int nName = 0;
+
+        if( szLine[ 0 ] == 'B' && sscanf( szLine, "B %lu %llu %llu %llu %llu", &frame.nPart, &frame.nOffset, &frame.nBytes, &frame.nRawOffset, &frame.nRawBytes ) == 5 ) {
+
+            oFrame_S.push_back( frame );
+
+        } else if( bFound == FALSE && szLine[ 0 ] == 'F' && sscanf( szLine, "F %llu %llu %*d %n", &nOffset, &nSize, &nName ) >= 2 && nName > 0 && strcmp( szLine + nName, pszMember ) == 0 ) {
+
+            bFound = TRUE;
+
+        }
+
+    }
+
+    fclose( pFp );
+
+    if( bFound == FALSE ) {
+
+        printf( "[QCAP DEBUG] %s not in %s\n", pszMember, pszManifest );
+
+        return FALSE;
+
+    }
+
+    FILE * pFpOut = fopen( pszOutput, "wb" );
+
+    if( pFpOut == nullptr ) return FALSE;
+
+    ////// Only the frames the member overlaps are read and decoded
+
+    std::vector< uint8_t > vCoded, vRaw;
+
+    BOOL bOk = TRUE;
+
+    unsigned long long nEnd = nOffset + nSize;
+
+    for( const Frame &frame : oFrame_S ) {
+
+        if( frame.nRawOffset + frame.nRawBytes <= nOffset || frame.nRawOffset >= nEnd ) continue;
+
+        char szSuffix[ 16 ];
+
+        snprintf( szSuffix, sizeof( szSuffix ), ".%03lu", frame.nPart );
+
+        int nFd = open( ( strDir + "/" + strName + ARCHIVE_EXTENSION + szSuffix ).c_str(), O_RDONLY | O_CLOEXEC );
+
+        vCoded.resize( frame.nBytes );
+
+        vRaw.resize( frame.nRawBytes );
+
+        bOk = ( nFd >= 0 && Func_Fd_Read( nFd, vCoded.data(), vCoded.size(), frame.nOffset ) == TRUE ) ? TRUE : FALSE;
+
+        if( nFd >= 0 ) close( nFd );
+
+        if( bOk == TRUE ) {
+
+            size_t nRaw = ZSTD_decompress( vRaw.data(), vRaw.size(), vCoded.data(), vCoded.size() );
+
+            if( ZSTD_isError( nRaw ) || nRaw != vRaw.size() ) bOk = FALSE;
+
+        }
+
+        if( bOk == FALSE ) break;
+
+        unsigned long long nFrom = std::max( nOffset, frame.nRawOffset ), nTo = std::min( nEnd, frame.nRawOffset + frame.nRawBytes );
+
+        fwrite( vRaw.data() + ( nFrom - frame.nRawOffset ), 1, ( size_t )( nTo - nFrom ), pFpOut );
+
+    }
+
+    fclose( pFpOut );
+
+    printf( "[QCAP DEBUG] %s: %llu bytes -> %s%s\n", pszMember, nSize, pszOutput, ( bOk == TRUE ) ? "" : " ( failed )" );
+
+    return bOk;
+
+}
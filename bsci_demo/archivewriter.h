@@ -0,0 +1,259 @@
+#ifndef ARCHIVEWRITER_H
+#define ARCHIVEWRITER_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include <qcap.windef.h>
+
+#include "workerpool.h"
+#include "ioscheduler.h"
+
+////// Uncompressed tar bytes per zstd frame; a member is pulled out by decoding only the
+////// frames it overlaps
+
+#define ARCHIVE_BLOCK_MB 4
+
+////// Parts stay below the 4 GiB file limit of FAT32
+
+#define ARCHIVE_SPLIT_MB 4000
+
+#define ARCHIVE_ZSTD_LEVEL 3
+
+#define ARCHIVE_THREADS 3
+
+////// <name>.tar.zst.000, .001, ... and <name>.manifest. A name already on the stick is
+////// never overwritten, <name>_1, <name>_2, ... are tried instead.
+
+#define ARCHIVE_EXTENSION ".tar.zst"
+
+#define ARCHIVE_MANIFEST_EXTENSION ".manifest"
+
+#define ARCHIVE_NAME_TRIES 100
+
+struct ArchiveStats {
+
+    ULONG       st_nFiles               = 0;
+
+    ULONG       st_nParts               = 0;
+
+    ULONG       st_nBlocks              = 0;
+
+    uint64_t    st_nBytesIn             = 0;            // tar stream
+
+    uint64_t    st_nBytesOut            = 0;            // compressed, on the stick
+
+};
+
+////// Streams files into one tar archive compressed with zstd, written sequentially into
+////// parts of at most nSplitBytes. The tar stream is cut into ARCHIVE_BLOCK_MB blocks that
+////// are compressed as independent zstd frames on a worker pool while the writer thread
+////// puts the previous batch on the stick; concatenated frames are a regular .zst, so
+//////
+//////     cat <name>.tar.zst.* | zstd -d | tar -x
+//////
+////// unpacks everything. The manifest lists every frame ( part, offset, size, hash ) and
+////// every member ( offset in the tar stream ), which is what ArchiveWriter_Member_Extract
+////// uses to pull out one file, and every file that was skipped ( errno, bytes read ).
+
+class ArchiveWriter
+{
+
+public:
+
+    ////// Every frame written is export class I/O on pIoScheduler, when there is one
+
+    ArchiveWriter( const std::string &strDir, const std::string &strName, IoScheduler * pIoScheduler = nullptr, int nThreads = ARCHIVE_THREADS
+                   , uint64_t nSplitBytes = ( uint64_t )ARCHIVE_SPLIT_MB << 20, int nLevel = ARCHIVE_ZSTD_LEVEL );
+
+    ////// strName is reserved here by creating the first part; when that fails nothing can be
+    ////// added, see IsFailed(). Without Finish() the parts written so far are removed
+
+    ~ArchiveWriter();
+
+    typedef std::function< BOOL () > cancel_func_t;
+
+    ////// Polled between blocks while a member is read, TRUE abandons the archive
+
+    void SetCancelCheck( const cancel_func_t &pfnCancel ) { m_pfnCancel = pfnCancel; }
+
+    ////// FALSE when the file is not in the archive. A file that can not be opened or read is
+    ////// skipped and listed as such in the manifest, the archive carries on; see IsFailed()
+
+    BOOL Add( const std::string &strPath, const std::string &strMember );
+
+    ////// Cancelled or a write failed, nothing more can be added
+
+    BOOL IsFailed() const;
+
+    ////// Ends the tar stream, waits for the writer and writes the manifest
+
+    BOOL Finish();
+
+    ////// Reads every part back ( page cache dropped, so from the stick ) against the frame
+    ////// hashes; call after the data is synced
+
+    BOOL Verify();
+
+    ////// Only what this writer created
+
+    void Remove();
+
+    ////// strName, or the suffixed name it was written under
+
+    const std::string &GetName() const { return m_strName; }
+
+    ArchiveStats GetStats() const;
+
+    std::vector< std::string > GetFiles() const;
+
+private:
+
+    struct Block {
+
+        std::vector< uint8_t >  vRaw;
+
+        std::vector< uint8_t >  vCoded;
+
+        uint64_t                nRawOffset      = 0;
+
+    };
+
+    struct BlockEntry {
+
+        ULONG                   nPart;
+
+        uint64_t                nOffset;
+
+        uint64_t                nBytes;
+
+        uint64_t                nRawOffset;
+
+        uint64_t                nRawBytes;
+
+        uint64_t                nHash;
+
+    };
+
+    struct MemberEntry {
+
+        std::string             strName;
+
+        uint64_t                nOffset;
+
+        uint64_t                nSize;
+
+        int64_t                 nMtime;
+
+    };
+
+    struct SkipEntry {
+
+        std::string             strName;
+
+        int                     nErrno;
+
+        uint64_t                nRead;
+
+    };
+
+    BOOL Func_Stream_Append( const void * pData, size_t nBytes );
+
+    BOOL Func_Stream_Read( int nFd, uint64_t nBytes, uint64_t * pnRead, int * pnErrno );
+
+    BOOL Func_Header_Append( const std::string &strMember, uint64_t nSize, int64_t nMtime, char cType );
+
+    ////// Current block of the batch with room left, compressing and handing off full batches
+
+    Block * Func_Block_Current();
+
+    void Func_Batch_Submit( size_t nBlocks );
+
+    void Func_Writer_Loop();
+
+    BOOL Func_Block_Write( Block &block );
+
+    std::string Func_Part_Path( ULONG nPart ) const;
+
+    BOOL Func_Name_Reserve();
+
+private:
+
+    std::string                                 m_strDir;
+
+    std::string                                 m_strName;
+
+    IoScheduler *                               m_pIoScheduler;
+
+    uint64_t                                    m_nSplitBytes;
+
+    int                                         m_nLevel;
+
+    uint64_t                                    m_nBlockBytes;
+
+    WorkerPool                                  m_oPool;
+
+    ////// Filled by the caller's thread
+
+    std::vector< Block >                        m_oBatch_S;
+
+    size_t                                      m_nBlock            = 0;
+
+    uint64_t                                    m_nRawOffset        = 0;
+
+    std::vector< MemberEntry >                  m_oMember_S;
+
+    std::vector< SkipEntry >                    m_oSkip_S;
+
+    cancel_func_t                               m_pfnCancel;
+
+    BOOL                                        m_bCancelled        = FALSE;
+
+    BOOL                                        m_bFinished         = FALSE;
+
+    ////// Handed to the writer thread, and the batches it gives back for reuse
+
+    std::thread                                 m_thWriter;
+
+    mutable std::mutex                          m_mtx;
+
+    std::condition_variable                     m_cvWrite;
+
+    std::condition_variable                     m_cvFree;
+
+    std::deque< std::vector< Block > >          m_queWrite;
+
+    std::deque< std::vector< Block > >          m_queFree;
+
+    BOOL                                        m_bExit             = FALSE;
+
+    BOOL                                        m_bFailed           = FALSE;
+
+    ////// Writer thread side
+
+    int                                         m_nFd               = -1;
+
+    ULONG                                       m_nPart             = 0;
+
+    ULONG                                       m_nPartsOpened      = 0;            // created by this writer, O_EXCL
+
+    uint64_t                                    m_nPartBytes        = 0;
+
+    std::vector< BlockEntry >                   m_oBlock_S;
+
+    uint64_t                                    m_nBytesOut         = 0;
+
+};
+
+////// Offline tooling: one member of an archive by its manifest
+
+BOOL ArchiveWriter_Member_Extract( const char * pszManifest, const char * pszMember, const char * pszOutput );
+
+#endif // ARCHIVEWRITER_H
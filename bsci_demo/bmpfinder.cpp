@@ -1,14 +1,35 @@
 #include "bmpfinder.h"
 
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+
 BmpFinder::BmpFinder( const QString &path, int intervalMs, QObject * parent )
     : QObject( parent ), m_dirPath( path )
 {
 
+    m_nInotifyFd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+
+    if( m_nInotifyFd >= 0 ) {
+
+        m_pNotifier = new QSocketNotifier( m_nInotifyFd, QSocketNotifier::Read, this );
+
+        connect( m_pNotifier, &QSocketNotifier::activated, this, &BmpFinder::Slot_Inotify_Read );
+
+        Func_Watch_Add();
+
+    } else {
+
+        printf( "[QCAP DEBUG] %s(%d): inotify_init1() failed, errno=%d, polling every %d ms\n", __FUNCTION__, __LINE__, errno, intervalMs );
+
+    }
+
     m_ScanTimer = new QTimer( this );
 
     connect( m_ScanTimer, &QTimer::timeout, this, &BmpFinder::Slot_Scan_Update );
 
-    m_ScanTimer->start( intervalMs );
+    m_ScanTimer->start( ( m_nInotifyFd >= 0 ) ? BMP_FINDER_RECONCILE_INTERVAL : intervalMs );
 
     printf( "[QCAP DEBUG] Scan bmp file folder: %s\n", m_dirPath.toUtf8().data() );
 
@@ -16,6 +37,42 @@ BmpFinder::BmpFinder( const QString &path, int intervalMs, QObject * parent )
 
 }
 
+BmpFinder::~BmpFinder()
+{
+
+    if( m_nInotifyFd >= 0 ) close( m_nInotifyFd );
+
+}
+
+BOOL BmpFinder::Func_Name_IsBmp( const QString &fileName )
+{
+
+    return fileName.endsWith( ".bmp", Qt::CaseInsensitive );
+
+}
+
+BOOL BmpFinder::Func_Watch_Add()
+{
+
+    if( m_nInotifyFd < 0 || m_nWatch >= 0 ) return TRUE;
+
+    ////// Files count once they are complete: closed after writing or moved in
+
+    m_nWatch = inotify_add_watch( m_nInotifyFd, m_dirPath.toUtf8().data()
+                                  , IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF | IN_MOVE_SELF );
+
+    if( m_nWatch < 0 ) {
+
+        printf( "[QCAP DEBUG] %s(%d): inotify_add_watch( %s ) failed, errno=%d\n", __FUNCTION__, __LINE__, m_dirPath.toUtf8().data(), errno );
+
+        return FALSE;
+
+    }
+
+    return TRUE;
+
+}
+
 void BmpFinder::Func_Scan_InitFullScan()
 {
 
@@ -45,67 +102,153 @@ void BmpFinder::Func_Scan_InitFullScan()
 
 }
 
-void BmpFinder::Slot_Scan_Update()
+void BmpFinder::Slot_Inotify_Read()
 {
 
-    QtConcurrent::run( [ this ]() {
+    alignas( struct inotify_event ) char buffer[ 16 * ( sizeof( struct inotify_event ) + NAME_MAX + 1 ) ];
 
-        QDir dir( m_dirPath, "*.bmp", QDir::Name, QDir::Files );
+    QString lastNewFile;
 
-        if( dir.exists() == FALSE ) return;
+    BOOL bRescan = FALSE;
 
-        QStringList currentFiles = dir.entryList();
+    while( TRUE ) {
 
-        if( currentFiles.isEmpty() == TRUE ) {
+        ssize_t nRead = read( m_nInotifyFd, buffer, sizeof( buffer ) );
 
-            QMetaObject::invokeMethod( this, [ this ]() {
+        if( nRead <= 0 ) break;
 
-                m_knownFileSet.clear();
+        for( char * p = buffer; p < buffer + nRead; ) {
 
-            }, Qt::QueuedConnection );
+            const struct inotify_event * pEvent = ( const struct inotify_event * )p;
 
-            return;
+            p += sizeof( struct inotify_event ) + pEvent->len;
 
-        }
+            ////// Lost events or the folder itself went away: the next listing sorts it out
 
-        QSet< QString > currentSet( currentFiles.begin(), currentFiles.end() );
+            if( pEvent->mask & ( IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED ) ) {
 
-        QStringList newFiles;
+                if( pEvent->mask & ( IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED ) ) {
 
-        QStringList deletedFiles;
+                    inotify_rm_watch( m_nInotifyFd, m_nWatch );
 
-        ////// Find new files
+                    m_nWatch = -1;
 
-        for( const QString &file : currentFiles ) {
+                }
 
-            if( m_knownFileSet.contains( file ) == FALSE ) newFiles.append( file );
+                bRescan = TRUE;
 
-        }
+                continue;
+
+            }
+
+            if( pEvent->len == 0 ) continue;
+
+            QString file = QString::fromUtf8( pEvent->name );
+
+            if( Func_Name_IsBmp( file ) == FALSE ) continue;
+
+            if( m_bScanRunning == TRUE ) m_touchedFileSet.insert( file );
+
+            if( pEvent->mask & ( IN_CLOSE_WRITE | IN_MOVED_TO ) ) {
+
+                if( m_knownFileSet.contains( file ) == TRUE ) continue;
+
+                m_knownFileSet.insert( file );
 
+                ////// Same pick as a listing: the last new name in name order
 
-        ////// Find deleted files
+                if( lastNewFile.isEmpty() == TRUE || lastNewFile < file ) lastNewFile = file;
 
-        for( const QString &oldFile : m_knownFileSet ) {
+            } else if( m_knownFileSet.remove( file ) == TRUE ) {
 
-            if( currentSet.contains( oldFile ) == FALSE ) deletedFiles.append( oldFile );
+                emit Signal_Bmp_Removed( file );
+
+            }
 
         }
 
-        QString lastNewFile;
+    }
+
+    if( lastNewFile.isEmpty() == FALSE ) emit Signal_Bmp_LatestFound( QDir( m_dirPath ).absoluteFilePath( lastNewFile ) );
+
+    if( bRescan == TRUE ) Slot_Scan_Update();
+
+}
+
+void BmpFinder::Slot_Scan_Update()
+{
+
+    if( m_bScanRunning == TRUE ) return;
+
+    ////// A recreated folder is watched again before it is listed, so nothing falls between
 
-        if( newFiles.isEmpty() == FALSE ) lastNewFile = dir.absoluteFilePath( newFiles.last() );
+    if( m_nInotifyFd >= 0 && m_nWatch < 0 && QDir( m_dirPath ).exists() == TRUE ) Func_Watch_Add();
 
-        QMetaObject::invokeMethod( this, [ this, currentSet, lastNewFile, deletedFiles ]() {
+    m_bScanRunning = TRUE;
 
-            m_knownFileSet = currentSet;
+    m_touchedFileSet.clear();
 
-//            for( const QString &f : deletedFiles )
-//                emit Signal_Bmp_Removed( f );
+    QString dirPath = m_dirPath;
 
-            if( lastNewFile.isEmpty() == FALSE ) emit Signal_Bmp_LatestFound( lastNewFile );
+    QtConcurrent::run( [ this, dirPath ]() {
+
+        QDir dir( dirPath, "*.bmp", QDir::Name, QDir::Files );
+
+        QStringList currentFiles;
+
+        if( dir.exists() == TRUE ) currentFiles = dir.entryList();
+
+        QMetaObject::invokeMethod( this, [ this, currentFiles ]() {
+
+            Func_Scan_Apply( currentFiles );
 
         }, Qt::QueuedConnection );
 
     } );
 
 }
+
+void BmpFinder::Func_Scan_Apply( const QStringList &currentFiles )
+{
+
+    m_bScanRunning = FALSE;
+
+    QSet< QString > currentSet( currentFiles.begin(), currentFiles.end() );
+
+    QString lastNewFile;
+
+    ////// Find new files, names the watcher saw change meanwhile are already up to date
+
+    for( const QString &file : currentFiles ) {
+
+        if( m_knownFileSet.contains( file ) == TRUE || m_touchedFileSet.contains( file ) == TRUE ) continue;
+
+        m_knownFileSet.insert( file );
+
+        lastNewFile = file;
+
+    }
+
+    ////// Find deleted files
+
+    QStringList deletedFiles;
+
+    for( const QString &oldFile : m_knownFileSet ) {
+
+        if( currentSet.contains( oldFile ) == FALSE && m_touchedFileSet.contains( oldFile ) == FALSE ) deletedFiles.append( oldFile );
+
+    }
+
+    m_touchedFileSet.clear();
+
+    for( const QString &f : deletedFiles ) {
+
+        m_knownFileSet.remove( f );
+
+        emit Signal_Bmp_Removed( f );
+
+    }
+
+    if( lastNewFile.isEmpty() == FALSE ) emit Signal_Bmp_LatestFound( QDir( m_dirPath ).absoluteFilePath( lastNewFile ) );
+
+}
@@ -8,9 +8,18 @@
 #include <QSet>
 #include <QStringList>
 #include <QMetaObject>
+#include <QSocketNotifier>
 
 #include <qcap.windef.h>
 
+////// Full listing that catches whatever inotify missed ( queue overflow, folder recreated )
+
+#define BMP_FINDER_RECONCILE_INTERVAL 30000 //ms
+
+////// Follows the *.bmp files of one folder through inotify, so the cost is per change and not
+////// per file. The known set is only touched on the owner's thread. Without inotify it
+////// falls back to a full listing every intervalMs.
+
 class BmpFinder : public QObject
 {
 
@@ -20,6 +29,8 @@ public:
 
     explicit BmpFinder( const QString &path, int intervalMs = 1000, QObject *parent = nullptr );
 
+    ~BmpFinder();
+
 signals:
 
     void Signal_Bmp_LatestFound( const QString &fullPath );
@@ -30,17 +41,37 @@ private slots:
 
     void Slot_Scan_Update();
 
+    void Slot_Inotify_Read();
+
 private:
 
     void Func_Scan_InitFullScan();
 
+    BOOL Func_Watch_Add();
+
+    void Func_Scan_Apply( const QStringList &currentFiles );
+
+    static BOOL Func_Name_IsBmp( const QString &fileName );
+
 private:
 
-    QString         m_dirPath;
+    QString             m_dirPath;
+
+    QTimer *            m_ScanTimer = nullptr;
+
+    QSet<QString>       m_knownFileSet;
+
+    int                 m_nInotifyFd = -1;
+
+    int                 m_nWatch = -1;
+
+    QSocketNotifier *   m_pNotifier = nullptr;
+
+    ////// Names changed by events while a reconcile listing runs, the listing may predate them
 
-    QTimer *        m_ScanTimer = nullptr;
+    BOOL                m_bScanRunning = FALSE;
 
-    QSet<QString>   m_knownFileSet;
+    QSet<QString>       m_touchedFileSet;
 
 };
 #endif // BMPFINDER_H
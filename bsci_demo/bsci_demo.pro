@@ -33,29 +33,82 @@ LIBS += \
         -L"../lib/" -lqcap \
         -L/usr/lib/aarch64-linux-gnu/tegra \
         -lnvbufsurface -lnvbufsurftransform \
-        -L/usr/local/cuda/lib64 -lcuda -lcudart
+        -L/usr/local/cuda/lib64 -lcuda -lcudart \
+        -lzstd
 
 
 SOURCES += \
+    archivewriter.cpp \
     bmpfinder.cpp \
+    cpuconvert.cpp \
+    cropring.cpp \
+    cropwriter.cpp \
+    diskaccountant.cpp \
+    framebus.cpp \
+    framecodec.cpp \
+    framefence.cpp \
+    framepool.cpp \
+    fusedconverter.cpp \
+    ioscheduler.cpp \
+    latencystats.cpp \
         main.cpp \
         mainwindow.cpp \
     processinference.cpp \
+    retentionindex.cpp \
     screenwatcher.cpp \
+    segmentstore.cpp \
     setpassworddialog.cpp \
+    snapshotservice.cpp \
+    softcapture.cpp \
+    tensorbatcher.cpp \
+    thumbnailloader.cpp \
+    usbexporter.cpp \
+    usbmonitor.cpp \
+    workerpool.cpp \
     logindialog.cpp \
     aspectratioframe.cpp
 
 HEADERS += \
+    archivewriter.h \
     bmpfinder.h \
+    colorconvert.h \
+    cpuconvert.h \
+    cropring.h \
+    cropwriter.h \
+    diskaccountant.h \
+    framebus.h \
+    framecodec.h \
+    framefence.h \
+    framepool.h \
+    fusedconverter.h \
+    ioscheduler.h \
+    latencystats.h \
         mainwindow.h \
     processinference.h \
+    retentionindex.h \
     screenwatcher.h \
+    segmentstore.h \
     setpassworddialog.h \
+    snapshotservice.h \
+    softcapture.h \
+    tensorbatcher.h \
+    thumbnailloader.h \
+    usbexporter.h \
+    usbmonitor.h \
+    workerpool.h \
     logindialog.h \
     aspectratioframe.h \
     testkit.h
 
+CUDA_SOURCES += \
+    fusedconvert.cu
+
+cuda.input = CUDA_SOURCES
+cuda.output = ${QMAKE_FILE_BASE}_cuda.o
+cuda.commands = /usr/local/cuda/bin/nvcc -c -O3 -std=c++14 -Xcompiler -fPIC $$join(INCLUDEPATH,' -I','-I') ${QMAKE_FILE_NAME} -o ${QMAKE_FILE_OUT}
+cuda.dependency_type = TYPE_C
+QMAKE_EXTRA_COMPILERS += cuda
+
 FORMS += \
         mainwindow.ui \
     setpassworddialog.ui \
@@ -0,0 +1,104 @@
+#ifndef COLORCONVERT_H
+#define COLORCONVERT_H
+
+#include <stdint.h>
+
+#ifdef __CUDACC__
+#define COLORCONVERT_FUNC __host__ __device__ __forceinline__
+#else
+#define COLORCONVERT_FUNC static inline
+#endif
+
+////// BT.709 limited range YCbCr -> RGB, Q13 fixed point. Shared by the CUDA and CPU
+////// paths so both produce the same bytes.
+
+#define COLORCONVERT_SHIFT 13
+
+#define COLORCONVERT_Y  9535        // 1.164
+
+#define COLORCONVERT_RV 14688       // 1.793
+
+#define COLORCONVERT_GU 1745        // 0.213
+
+#define COLORCONVERT_GV 4366        // 0.533
+
+#define COLORCONVERT_BU 17302       // 2.112
+
+COLORCONVERT_FUNC uint8_t ColorConvert_Clamp( int32_t v )
+{
+
+    return ( uint8_t )( v < 0 ? 0 : ( v > 255 ? 255 : v ) );
+
+}
+
+COLORCONVERT_FUNC void ColorConvert_YUV_To_RGB( int32_t y, int32_t u, int32_t v, uint8_t * r, uint8_t * g, uint8_t * b )
+{
+
+    const int32_t nRound = 1 << ( COLORCONVERT_SHIFT - 1 );
+
+    int32_t c = ( y - 16 ) * COLORCONVERT_Y + nRound;
+
+    int32_t d = u - 128;
+
+    int32_t e = v - 128;
+
+    *r = ColorConvert_Clamp( ( c + COLORCONVERT_RV * e ) >> COLORCONVERT_SHIFT );
+
+    *g = ColorConvert_Clamp( ( c - COLORCONVERT_GU * d - COLORCONVERT_GV * e ) >> COLORCONVERT_SHIFT );
+
+    *b = ColorConvert_Clamp( ( c + COLORCONVERT_BU * d ) >> COLORCONVERT_SHIFT );
+
+}
+
+////// RGB -> BT.709 limited range YCbCr, same Q13 scale. Chroma is taken from the 2x2
+////// averaged RGB.
+
+#define COLORCONVERT_YR 1496        // 0.183
+
+#define COLORCONVERT_YG 5032        // 0.614
+
+#define COLORCONVERT_YB 508         // 0.062
+
+#define COLORCONVERT_UR 824         // 0.101
+
+#define COLORCONVERT_UG 2774        // 0.339
+
+#define COLORCONVERT_UB 3598        // 0.439
+
+#define COLORCONVERT_VR 3598        // 0.439
+
+#define COLORCONVERT_VG 3268        // 0.399
+
+#define COLORCONVERT_VB 330         // 0.040
+
+COLORCONVERT_FUNC uint8_t ColorConvert_RGB_To_Y( int32_t r, int32_t g, int32_t b )
+{
+
+    const int32_t nRound = 1 << ( COLORCONVERT_SHIFT - 1 );
+
+    return ColorConvert_Clamp( ( ( COLORCONVERT_YR * r + COLORCONVERT_YG * g + COLORCONVERT_YB * b + nRound ) >> COLORCONVERT_SHIFT ) + 16 );
+
+}
+
+COLORCONVERT_FUNC void ColorConvert_RGB_To_UV( int32_t r, int32_t g, int32_t b, uint8_t * u, uint8_t * v )
+{
+
+    const int32_t nRound = 1 << ( COLORCONVERT_SHIFT - 1 );
+
+    *u = ColorConvert_Clamp( ( ( COLORCONVERT_UB * b - COLORCONVERT_UR * r - COLORCONVERT_UG * g + nRound ) >> COLORCONVERT_SHIFT ) + 128 );
+
+    *v = ColorConvert_Clamp( ( ( COLORCONVERT_VR * r - COLORCONVERT_VG * g - COLORCONVERT_VB * b + nRound ) >> COLORCONVERT_SHIFT ) + 128 );
+
+}
+
+////// Plane layout of one frame, index 0..2 as returned by qcap2_av_frame_get_buffer1
+
+struct ColorPlanes {
+
+    uint8_t *   pData[ 3 ];
+
+    int         nStride[ 3 ];
+
+};
+
+#endif // COLORCONVERT_H
@@ -0,0 +1,1396 @@
+#include "cpuconvert.h"
+#include "workerpool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define CPU_CONVERT_X86 1
+#include <immintrin.h>
+#define CPU_CONVERT_TARGET_SSE41 __attribute__(( target( "sse4.1" ) ))
+#define CPU_CONVERT_TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+#endif
+
+#if defined( __aarch64__ ) || defined( __ARM_NEON )
+#define CPU_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+////// Row-band threads, the calling thread included. Leaves cores for capture, the file
+////// writer and inference.
+
+#define CPU_CONVERT_THREAD_NUM 4
+
+////// Below this many rows a frame is not worth splitting
+
+#define CPU_CONVERT_BAND_MIN_ROWS 64
+
+////// One row of each conversion. Chroma inputs are the row's subsampled chroma line,
+////// nWidth is always in luma pixels.
+
+struct CpuConvertRowFuncs {
+
+    void ( *pfnUV_Split )( const uint8_t * pUV, uint8_t * pU, uint8_t * pV, int nPairs );
+
+    void ( *pfnI420_To_GBRP )( const uint8_t * pY, const uint8_t * pU, const uint8_t * pV, uint8_t * pG, uint8_t * pB, uint8_t * pR, int nWidth );
+
+    void ( *pfnNV12_To_GBRP )( const uint8_t * pY, const uint8_t * pUV, uint8_t * pG, uint8_t * pB, uint8_t * pR, int nWidth );
+
+    void ( *pfnGBRP_To_Y )( const uint8_t * pG, const uint8_t * pB, const uint8_t * pR, uint8_t * pY, int nWidth );
+
+    void ( *pfnGBRP_To_UV )( const uint8_t * pG0, const uint8_t * pB0, const uint8_t * pR0,
+                             const uint8_t * pG1, const uint8_t * pB1, const uint8_t * pR1, uint8_t * pU, uint8_t * pV, int nWidth );
+
+};
+
+////// Scalar reference, also finishes the tail of every vector row
+
+static void Row_UV_Split_C( const uint8_t * pUV, uint8_t * pU, uint8_t * pV, int nPairs )
+{
+
+    for( int i = 0; i < nPairs; i++ ) {
+
+        pU[ i ] = pUV[ i * 2 ];
+
+        pV[ i ] = pUV[ i * 2 + 1 ];
+
+    }
+
+}
+
+static void Row_I420_To_GBRP_C( const uint8_t * pY, const uint8_t * pU, const uint8_t * pV, uint8_t * pG, uint8_t * pB, uint8_t * pR, int nWidth )
+{
+
+    for( int x = 0; x < nWidth; x++ ) ColorConvert_YUV_To_RGB( pY[ x ], pU[ x >> 1 ], pV[ x >> 1 ], &pR[ x ], &pG[ x ], &pB[ x ] );
+
+}
+
+static void Row_NV12_To_GBRP_C( const uint8_t * pY, const uint8_t * pUV, uint8_t * pG, uint8_t * pB, uint8_t * pR, int nWidth )
+{
+
+    for( int x = 0; x < nWidth; x++ ) ColorConvert_YUV_To_RGB( pY[ x ], pUV[ ( x >> 1 ) * 2 ], pUV[ ( x >> 1 ) * 2 + 1 ], &pR[ x ], &pG[ x ], &pB[ x ] );
+
+}
+
+static void Row_GBRP_To_Y_C( const uint8_t * pG, const uint8_t * pB, const uint8_t * pR, uint8_t * pY, int nWidth )
+{
+
+    for( int x = 0; x < nWidth; x++ ) pY[ x ] = ColorConvert_RGB_To_Y( pR[ x ], pG[ x ], pB[ x ] );
+
+}
+
+static void Row_GBRP_To_UV_C( const uint8_t * pG0, const uint8_t * pB0, const uint8_t * pR0,
+                              const uint8_t * pG1, const uint8_t * pB1, const uint8_t * pR1, uint8_t * pU, uint8_t * pV, int nWidth )
+{
+
+    for( int x = 0, i = 0; x < nWidth; x += 2, i++ ) {
+
+        int x1 = ( x + 1 < nWidth ) ? x + 1 : x;
+
+        int r = ( pR0[ x ] + pR0[ x1 ] + pR1[ x ] + pR1[ x1 ] + 2 ) >> 2;
+
+        int g = ( pG0[ x ] + pG0[ x1 ] + pG1[ x ] + pG1[ x1 ] + 2 ) >> 2;
+
+        int b = ( pB0[ x ] + pB0[ x1 ] + pB1[ x ] + pB1[ x1 ] + 2 ) >> 2;
+
+        ColorConvert_RGB_To_UV( r, g, b, &pU[ i ], &pV[ i ] );
+
+    }
+
+}
+
+static const CpuConvertRowFuncs g_stRowFuncs_C = {
+
+    Row_UV_Split_C, Row_I420_To_GBRP_C, Row_NV12_To_GBRP_C, Row_GBRP_To_Y_C, Row_GBRP_To_UV_C
+
+};
+
+#if CPU_CONVERT_X86
+
+////// SSE4.1: 16 pixels per step. Products need 32 bits, so each step widens to four
+////// int32x4 groups; packs_epi32 + packus_epi16 saturate exactly like ColorConvert_Clamp.
+
+CPU_CONVERT_TARGET_SSE41 static inline void Sse41_Widen( __m128i s, __m128i * p )
+{
+
+    p[ 0 ] = _mm_cvtepu8_epi32( s );
+
+    p[ 1 ] = _mm_cvtepu8_epi32( _mm_srli_si128( s, 4 ) );
+
+    p[ 2 ] = _mm_cvtepu8_epi32( _mm_srli_si128( s, 8 ) );
+
+    p[ 3 ] = _mm_cvtepu8_epi32( _mm_srli_si128( s, 12 ) );
+
+}
+
+CPU_CONVERT_TARGET_SSE41 static inline __m128i Sse41_Pack( const __m128i * p )
+{
+
+    return _mm_packus_epi16( _mm_packs_epi32( p[ 0 ], p[ 1 ] ), _mm_packs_epi32( p[ 2 ], p[ 3 ] ) );
+
+}
+
+CPU_CONVERT_TARGET_SSE41 static inline void Sse41_YUV16_To_GBR( __m128i y, __m128i u, __m128i v, uint8_t * pG, uint8_t * pB, uint8_t * pR )
+{
+
+    const __m128i k16 = _mm_set1_epi32( 16 );
+
+    const __m128i k128 = _mm_set1_epi32( 128 );
+
+    const __m128i kRound = _mm_set1_epi32( 1 << ( COLORCONVERT_SHIFT - 1 ) );
+
+    __m128i yi[ 4 ], ui[ 4 ], vi[ 4 ], r[ 4 ], g[ 4 ], b[ 4 ];
+
+    Sse41_Widen( y, yi );
+
+    Sse41_Widen( u, ui );
+
+    Sse41_Widen( v, vi );
+
+    for( int i = 0; i < 4; i++ ) {
+
+        __m128i c = _mm_add_epi32( _mm_mullo_epi32( _mm_sub_epi32( yi[ i ], k16 ), _mm_set1_epi32( COLORCONVERT_Y ) ), kRound );
+
+        __m128i d = _mm_sub_epi32( ui[ i ], k128 );
+
+        __m128i e = _mm_sub_epi32( vi[ i ], k128 );
+
+        r[ i ] = _mm_srai_epi32( _mm_add_epi32( c, _mm_mullo_epi32( e, _mm_set1_epi32( COLORCONVERT_RV ) ) ), COLORCONVERT_SHIFT );
+
+        g[ i ] = _mm_srai_epi32( _mm_sub_epi32( _mm_sub_epi32( c, _mm_mullo_epi32( d, _mm_set1_epi32( COLORCONVERT_GU ) ) ),
+                                                _mm_mullo_epi32( e, _mm_set1_epi32( COLORCONVERT_GV ) ) ), COLORCONVERT_SHIFT );
+
+        b[ i ] = _mm_srai_epi32( _mm_add_epi32( c, _mm_mullo_epi32( d, _mm_set1_epi32( COLORCONVERT_BU ) ) ), COLORCONVERT_SHIFT );
+
+    }
+
+    _mm_storeu_si128( ( __m128i * )pG, Sse41_Pack( g ) );
+
+    _mm_storeu_si128( ( __m128i * )pB, Sse41_Pack( b ) );
+
+    _mm_storeu_si128( ( __m128i * )pR, Sse41_Pack( r ) );
+
+}
+
+CPU_CONVERT_TARGET_SSE41 static void Row_UV_Split_SSE41( const uint8_t * pUV, uint8_t * pU, uint8_t * pV, int nPairs )
+{
+
+    const __m128i kShuffle = _mm_setr_epi8( 0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15 );
+
+    int i = 0;
+
+    for( ; i + 16 <= nPairs; i += 16 ) {
+
+        __m128i a = _mm_shuffle_epi8( _mm_loadu_si128( ( const __m128i * )( pUV + i * 2 ) ), kShuffle );
+
+        __m128i b = _mm_shuffle_epi8( _mm_loadu_si128( ( const __m128i * )( pUV + i * 2 + 16 ) ), kShuffle );
+
+        _mm_storeu_si128( ( __m128i * )( pU + i ), _mm_unpacklo_epi64( a, b ) );
+
+        _mm_storeu_si128( ( __m128i * )( pV + i ), _mm_unpackhi_epi64( a, b ) );
+
+    }
+
+    Row_UV_Split_C( pUV + i * 2, pU + i, pV + i, nPairs - i );
+
+}
+
+CPU_CONVERT_TARGET_SSE41 static void Row_I420_To_GBRP_SSE41( const uint8_t * pY, const uint8_t * pU, const uint8_t * pV, uint8_t * pG, uint8_t * pB, uint8_t * pR, int nWidth )
+{
+
+    int x = 0;
+
+    for( ; x + 16 <= nWidth; x += 16 ) {
+
+        __m128i u = _mm_loadl_epi64( ( const __m128i * )( pU + x / 2 ) );
+
+        __m128i v = _mm_loadl_epi64( ( const __m128i * )( pV + x / 2 ) );
+
+        Sse41_YUV16_To_GBR( _mm_loadu_si128( ( const __m128i * )( pY + x ) ), _mm_unpacklo_epi8( u, u ), _mm_unpacklo_epi8( v, v ), pG + x, pB + x, pR + x );
+
+    }
+
+    Row_I420_To_GBRP_C( pY + x, pU + x / 2, pV + x / 2, pG + x, pB + x, pR + x, nWidth - x );
+
+}
+
+CPU_CONVERT_TARGET_SSE41 static void Row_NV12_To_GBRP_SSE41( const uint8_t * pY, const uint8_t * pUV, uint8_t * pG, uint8_t * pB, uint8_t * pR, int nWidth )
+{
+
+    const __m128i kShuffle = _mm_setr_epi8( 0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15 );
+
+    int x = 0;
+
+    for( ; x + 16 <= nWidth; x += 16 ) {
+
+        __m128i uv = _mm_shuffle_epi8( _mm_loadu_si128( ( const __m128i * )( pUV + x ) ), kShuffle );
+
+        Sse41_YUV16_To_GBR( _mm_loadu_si128( ( const __m128i * )( pY + x ) ), _mm_unpacklo_epi8( uv, uv ), _mm_unpackhi_epi8( uv, uv ), pG + x, pB + x, pR + x );
+
+    }
+
+    Row_NV12_To_GBRP_C( pY + x, pUV + x, pG + x, pB + x, pR + x, nWidth - x );
+
+}
+
+CPU_CONVERT_TARGET_SSE41 static void Row_GBRP_To_Y_SSE41( const uint8_t * pG, const uint8_t * pB, const uint8_t * pR, uint8_t * pY, int nWidth )
+{
+
+    const __m128i k16 = _mm_set1_epi32( 16 );
+
+    const __m128i kRound = _mm_set1_epi32( 1 << ( COLORCONVERT_SHIFT - 1 ) );
+
+    int x = 0;
+
+    for( ; x + 16 <= nWidth; x += 16 ) {
+
+        __m128i gi[ 4 ], bi[ 4 ], ri[ 4 ], y[ 4 ];
+
+        Sse41_Widen( _mm_loadu_si128( ( const __m128i * )( pG + x ) ), gi );
+
+        Sse41_Widen( _mm_loadu_si128( ( const __m128i * )( pB + x ) ), bi );
+
+        Sse41_Widen( _mm_loadu_si128( ( const __m128i * )( pR + x ) ), ri );
+
+        for( int i = 0; i < 4; i++ ) {
+
+            __m128i acc = _mm_add_epi32( _mm_add_epi32( _mm_mullo_epi32( ri[ i ], _mm_set1_epi32( COLORCONVERT_YR ) ),
+                                                        _mm_mullo_epi32( gi[ i ], _mm_set1_epi32( COLORCONVERT_YG ) ) ),
+                                         _mm_add_epi32( _mm_mullo_epi32( bi[ i ], _mm_set1_epi32( COLORCONVERT_YB ) ), kRound ) );
+
+            y[ i ] = _mm_add_epi32( _mm_srai_epi32( acc, COLORCONVERT_SHIFT ), k16 );
+
+        }
+
+        _mm_storeu_si128( ( __m128i * )( pY + x ), Sse41_Pack( y ) );
+
+    }
+
+    Row_GBRP_To_Y_C( pG + x, pB + x, pR + x, pY + x, nWidth - x );
+
+}
+
+////// 16 pixels of two rows -> 8 x int16 ( 2x2 sum + 2 ) >> 2
+
+CPU_CONVERT_TARGET_SSE41 static inline __m128i Sse41_Average2x2( const uint8_t * p0, const uint8_t * p1 )
+{
+
+    const __m128i kOne = _mm_set1_epi8( 1 );
+
+    __m128i s0 = _mm_maddubs_epi16( _mm_loadu_si128( ( const __m128i * )p0 ), kOne );
+
+    __m128i s1 = _mm_maddubs_epi16( _mm_loadu_si128( ( const __m128i * )p1 ), kOne );
+
+    return _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( s0, s1 ), _mm_set1_epi16( 2 ) ), 2 );
+
+}
+
+CPU_CONVERT_TARGET_SSE41 static void Row_GBRP_To_UV_SSE41( const uint8_t * pG0, const uint8_t * pB0, const uint8_t * pR0,
+                                                          const uint8_t * pG1, const uint8_t * pB1, const uint8_t * pR1, uint8_t * pU, uint8_t * pV, int nWidth )
+{
+
+    const __m128i k128 = _mm_set1_epi32( 128 );
+
+    const __m128i kRound = _mm_set1_epi32( 1 << ( COLORCONVERT_SHIFT - 1 ) );
+
+    int x = 0;
+
+    for( ; x + 16 <= nWidth; x += 16 ) {
+
+        __m128i g16 = Sse41_Average2x2( pG0 + x, pG1 + x );
+
+        __m128i b16 = Sse41_Average2x2( pB0 + x, pB1 + x );
+
+        __m128i r16 = Sse41_Average2x2( pR0 + x, pR1 + x );
+
+        __m128i u[ 2 ], v[ 2 ];
+
+        for( int i = 0; i < 2; i++ ) {
+
+            __m128i g = _mm_cvtepi16_epi32( g16 );
+
+            __m128i b = _mm_cvtepi16_epi32( b16 );
+
+            __m128i r = _mm_cvtepi16_epi32( r16 );
+
+            g16 = _mm_srli_si128( g16, 8 );
+
+            b16 = _mm_srli_si128( b16, 8 );
+
+            r16 = _mm_srli_si128( r16, 8 );
+
+            __m128i au = _mm_sub_epi32( _mm_mullo_epi32( b, _mm_set1_epi32( COLORCONVERT_UB ) ),
+                                        _mm_add_epi32( _mm_mullo_epi32( r, _mm_set1_epi32( COLORCONVERT_UR ) ), _mm_mullo_epi32( g, _mm_set1_epi32( COLORCONVERT_UG ) ) ) );
+
+            __m128i av = _mm_sub_epi32( _mm_mullo_epi32( r, _mm_set1_epi32( COLORCONVERT_VR ) ),
+                                        _mm_add_epi32( _mm_mullo_epi32( g, _mm_set1_epi32( COLORCONVERT_VG ) ), _mm_mullo_epi32( b, _mm_set1_epi32( COLORCONVERT_VB ) ) ) );
+
+            u[ i ] = _mm_add_epi32( _mm_srai_epi32( _mm_add_epi32( au, kRound ), COLORCONVERT_SHIFT ), k128 );
+
+            v[ i ] = _mm_add_epi32( _mm_srai_epi32( _mm_add_epi32( av, kRound ), COLORCONVERT_SHIFT ), k128 );
+
+        }
+
+        __m128i u8 = _mm_packs_epi32( u[ 0 ], u[ 1 ] );
+
+        __m128i v8 = _mm_packs_epi32( v[ 0 ], v[ 1 ] );
+
+        _mm_storel_epi64( ( __m128i * )( pU + x / 2 ), _mm_packus_epi16( u8, u8 ) );
+
+        _mm_storel_epi64( ( __m128i * )( pV + x / 2 ), _mm_packus_epi16( v8, v8 ) );
+
+    }
+
+    Row_GBRP_To_UV_C( pG0 + x, pB0 + x, pR0 + x, pG1 + x, pB1 + x, pR1 + x, pU + x / 2, pV + x / 2, nWidth - x );
+
+}
+
+static const CpuConvertRowFuncs g_stRowFuncs_SSE41 = {
+
+    Row_UV_Split_SSE41, Row_I420_To_GBRP_SSE41, Row_NV12_To_GBRP_SSE41, Row_GBRP_To_Y_SSE41, Row_GBRP_To_UV_SSE41
+
+};
+
+////// AVX2: 32 pixels per step. packs / packus work per 128-bit lane, the final permute
+////// restores pixel order.
+
+CPU_CONVERT_TARGET_AVX2 static inline void Avx2_Widen( __m128i lo, __m128i hi, __m256i * p )
+{
+
+    p[ 0 ] = _mm256_cvtepu8_epi32( lo );
+
+    p[ 1 ] = _mm256_cvtepu8_epi32( _mm_unpackhi_epi64( lo, lo ) );
+
+    p[ 2 ] = _mm256_cvtepu8_epi32( hi );
+
+    p[ 3 ] = _mm256_cvtepu8_epi32( _mm_unpackhi_epi64( hi, hi ) );
+
+}
+
+CPU_CONVERT_TARGET_AVX2 static inline __m256i Avx2_Pack( const __m256i * p )
+{
+
+    __m256i s = _mm256_packus_epi16( _mm256_packs_epi32( p[ 0 ], p[ 1 ] ), _mm256_packs_epi32( p[ 2 ], p[ 3 ] ) );
+
+    return _mm256_permutevar8x32_epi32( s, _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 ) );
+
+}
+
+CPU_CONVERT_TARGET_AVX2 static inline void Avx2_YUV32_To_GBR( const uint8_t * pY, __m128i uLo, __m128i uHi, __m128i vLo, __m128i vHi, uint8_t * pG, uint8_t * pB, uint8_t * pR )
+{
+
+    const __m256i k16 = _mm256_set1_epi32( 16 );
+
+    const __m256i k128 = _mm256_set1_epi32( 128 );
+
+    const __m256i kRound = _mm256_set1_epi32( 1 << ( COLORCONVERT_SHIFT - 1 ) );
+
+    __m256i yi[ 4 ], ui[ 4 ], vi[ 4 ], r[ 4 ], g[ 4 ], b[ 4 ];
+
+    Avx2_Widen( _mm_loadu_si128( ( const __m128i * )pY ), _mm_loadu_si128( ( const __m128i * )( pY + 16 ) ), yi );
+
+    Avx2_Widen( uLo, uHi, ui );
+
+    Avx2_Widen( vLo, vHi, vi );
+
+    for( int i = 0; i < 4; i++ ) {
+
+        __m256i c = _mm256_add_epi32( _mm256_mullo_epi32( _mm256_sub_epi32( yi[ i ], k16 ), _mm256_set1_epi32( COLORCONVERT_Y ) ), kRound );
+
+        __m256i d = _mm256_sub_epi32( ui[ i ], k128 );
+
+        __m256i e = _mm256_sub_epi32( vi[ i ], k128 );
+
+        r[ i ] = _mm256_srai_epi32( _mm256_add_epi32( c, _mm256_mullo_epi32( e, _mm256_set1_epi32( COLORCONVERT_RV ) ) ), COLORCONVERT_SHIFT );
+
+        g[ i ] = _mm256_srai_epi32( _mm256_sub_epi32( _mm256_sub_epi32( c, _mm256_mullo_epi32( d, _mm256_set1_epi32( COLORCONVERT_GU ) ) ),
+                                                      _mm256_mullo_epi32( e, _mm256_set1_epi32( COLORCONVERT_GV ) ) ), COLORCONVERT_SHIFT );
+
+        b[ i ] = _mm256_srai_epi32( _mm256_add_epi32( c, _mm256_mullo_epi32( d, _mm256_set1_epi32( COLORCONVERT_BU ) ) ), COLORCONVERT_SHIFT );
+
+    }
+
+    _mm256_storeu_si256( ( __m256i * )pG, Avx2_Pack( g ) );
+
+    _mm256_storeu_si256( ( __m256i * )pB, Avx2_Pack( b ) );
+
+    _mm256_storeu_si256( ( __m256i * )pR, Avx2_Pack( r ) );
+
+}
+
+CPU_CONVERT_TARGET_AVX2 static void Row_UV_Split_AVX2( const uint8_t * pUV, uint8_t * pU, uint8_t * pV, int nPairs )
+{
+
+    const __m256i kShuffle = _mm256_setr_epi8( 0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+                                               0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15 );
+
+    int i = 0;
+
+    for( ; i + 32 <= nPairs; i += 32 ) {
+
+        __m256i a = _mm256_shuffle_epi8( _mm256_loadu_si256( ( const __m256i * )( pUV + i * 2 ) ), kShuffle );
+
+        __m256i b = _mm256_shuffle_epi8( _mm256_loadu_si256( ( const __m256i * )( pUV + i * 2 + 32 ) ), kShuffle );
+
+        _mm256_storeu_si256( ( __m256i * )( pU + i ), _mm256_permute4x64_epi64( _mm256_unpacklo_epi64( a, b ), 0xD8 ) );
+
+        _mm256_storeu_si256( ( __m256i * )( pV + i ), _mm256_permute4x64_epi64( _mm256_unpackhi_epi64( a, b ), 0xD8 ) );
+
+    }
+
+    Row_UV_Split_SSE41( pUV + i * 2, pU + i, pV + i, nPairs - i );
+
+}
+
+CPU_CONVERT_TARGET_AVX2 static void Row_I420_To_GBRP_AVX2( const uint8_t * pY, const uint8_t * pU, const uint8_t * pV, uint8_t * pG, uint8_t * pB, uint8_t * pR, int nWidth )
+{
+
+    int x = 0;
+
+    for( ; x + 32 <= nWidth; x += 32 ) {
+
+        __m128i u = _mm_loadu_si128( ( const __m128i * )( pU + x / 2 ) );
+
+        __m128i v = _mm_loadu_si128( ( const __m128i * )( pV + x / 2 ) );
+
+        Avx2_YUV32_To_GBR( pY + x, _mm_unpacklo_epi8( u, u ), _mm_unpackhi_epi8( u, u ), _mm_unpacklo_epi8( v, v ), _mm_unpackhi_epi8( v, v ), pG + x, pB + x, pR + x );
+
+    }
+
+    Row_I420_To_GBRP_SSE41( pY + x, pU + x / 2, pV + x / 2, pG + x, pB + x, pR + x, nWidth - x );
+
+}
+
+CPU_CONVERT_TARGET_AVX2 static void Row_NV12_To_GBRP_AVX2( const uint8_t * pY, const uint8_t * pUV, uint8_t * pG, uint8_t * pB, uint8_t * pR, int nWidth )
+{
+
+    const __m128i kShuffle = _mm_setr_epi8( 0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15 );
+
+    int x = 0;
+
+    for( ; x + 32 <= nWidth; x += 32 ) {
+
+        __m128i uvLo = _mm_shuffle_epi8( _mm_loadu_si128( ( const __m128i * )( pUV + x ) ), kShuffle );
+
+        __m128i uvHi = _mm_shuffle_epi8( _mm_loadu_si128( ( const __m128i * )( pUV + x + 16 ) ), kShuffle );
+
+        Avx2_YUV32_To_GBR( pY + x, _mm_unpacklo_epi8( uvLo, uvLo ), _mm_unpacklo_epi8( uvHi, uvHi ), _mm_unpackhi_epi8( uvLo, uvLo ), _mm_unpackhi_epi8( uvHi, uvHi ), pG + x, pB + x, pR + x );
+
+    }
+
+    Row_NV12_To_GBRP_SSE41( pY + x, pUV + x, pG + x, pB + x, pR + x, nWidth - x );
+
+}
+
+CPU_CONVERT_TARGET_AVX2 static void Row_GBRP_To_Y_AVX2( const uint8_t * pG, const uint8_t * pB, const uint8_t * pR, uint8_t * pY, int nWidth )
+{
+
+    const __m256i k16 = _mm256_set1_epi32( 16 );
+
+    const __m256i kRound = _mm256_set1_epi32( 1 << ( COLORCONVERT_SHIFT - 1 ) );
+
+    int x = 0;
+
+    for( ; x + 32 <= nWidth; x += 32 ) {
+
+        __m256i gi[ 4 ], bi[ 4 ], ri[ 4 ], y[ 4 ];
+
+        Avx2_Widen( _mm_loadu_si128( ( const __m128i * )( pG + x ) ), _mm_loadu_si128( ( const __m128i * )( pG + x + 16 ) ), gi );
+
+        Avx2_Widen( _mm_loadu_si128( ( const __m128i * )( pB + x ) ), _mm_loadu_si128( ( const __m128i * )( pB + x + 16 ) ), bi );
+
+        Avx2_Widen( _mm_loadu_si128( ( const __m128i * )( pR + x ) ), _mm_loadu_si128( ( const __m128i * )( pR + x + 16 ) ), ri );
+
+        for( int i = 0; i < 4; i++ ) {
+
+            __m256i acc = _mm256_add_epi32( _mm256_add_epi32( _mm256_mullo_epi32( ri[ i ], _mm256_set1_epi32( COLORCONVERT_YR ) ),
+                                                              _mm256_mullo_epi32( gi[ i ], _mm256_set1_epi32( COLORCONVERT_YG ) ) ),
+                                            _mm256_add_epi32( _mm256_mullo_epi32( bi[ i ], _mm256_set1_epi32( COLORCONVERT_YB ) ), kRound ) );
+
+            y[ i ] = _mm256_add_epi32( _mm256_srai_epi32( acc, COLORCONVERT_SHIFT ), k16 );
+
+        }
+
+        _mm256_storeu_si256( ( __m256i * )( pY + x ), Avx2_Pack( y ) );
+
+    }
+
+    Row_GBRP_To_Y_SSE41( pG + x, pB + x, pR + x, pY + x, nWidth - x );
+
+}
+
+////// Chroma is a quarter of the GBRP -> I420 work, AVX2 reuses the SSE4.1 row
+
+static const CpuConvertRowFuncs g_stRowFuncs_AVX2 = {
+
+    Row_UV_Split_AVX2, Row_I420_To_GBRP_AVX2, Row_NV12_To_GBRP_AVX2, Row_GBRP_To_Y_AVX2, Row_GBRP_To_UV_SSE41
+
+};
+
+#endif // CPU_CONVERT_X86
+
+#if CPU_CONVERT_NEON
+
+////// NEON: 16 pixels per step, vqmovn_s32 + vqmovun_s16 saturate like ColorConvert_Clamp
+
+static inline void Neon_Widen( uint8x16_t s, int32x4_t * p )
+{
+
+    uint16x8_t lo = vmovl_u8( vget_low_u8( s ) );
+
+    uint16x8_t hi = vmovl_u8( vget_high_u8( s ) );
+
+    p[ 0 ] = vreinterpretq_s32_u32( vmovl_u16( vget_low_u16( lo ) ) );
+
+    p[ 1 ] = vreinterpretq_s32_u32( vmovl_u16( vget_high_u16( lo ) ) );
+
+    p[ 2 ] = vreinterpretq_s32_u32( vmovl_u16( vget_low_u16( hi ) ) );
+
+    p[ 3 ] = vreinterpretq_s32_u32( vmovl_u16( vget_high_u16( hi ) ) );
+
+}
+
+static inline uint8x16_t Neon_Pack( const int32x4_t * p )
+{
+
+    int16x8_t lo = vcombine_s16( vqmovn_s32( p[ 0 ] ), vqmovn_s32( p[ 1 ] ) );
+
+    int16x8_t hi = vcombine_s16( vqmovn_s32( p[ 2 ] ), vqmovn_s32( p[ 3 ] ) );
+
+    return vcombine_u8( vqmovun_s16( lo ), vqmovun_s16( hi ) );
+
+}
+
+static inline uint8x16_t Neon_Duplicate( uint8x8_t s )
+{
+
+    uint8x8x2_t z = vzip_u8( s, s );
+
+    return vcombine_u8( z.val[ 0 ], z.val[ 1 ] );
+
+}
+
+static inline void Neon_YUV16_To_GBR( uint8x16_t y, uint8x16_t u, uint8x16_t v, uint8_t * pG, uint8_t * pB, uint8_t * pR )
+{
+
+    const int32x4_t k16 = vdupq_n_s32( 16 );
+
+    const int32x4_t k128 = vdupq_n_s32( 128 );
+
+    const int32x4_t kRound = vdupq_n_s32( 1 << ( COLORCONVERT_SHIFT - 1 ) );
+
+    int32x4_t yi[ 4 ], ui[ 4 ], vi[ 4 ], r[ 4 ], g[ 4 ], b[ 4 ];
+
+    Neon_Widen( y, yi );
+
+    Neon_Widen( u, ui );
+
+    Neon_Widen( v, vi );
+
+    for( int i = 0; i < 4; i++ ) {
+
+        int32x4_t c = vmlaq_n_s32( kRound, vsubq_s32( yi[ i ], k16 ), COLORCONVERT_Y );
+
+        int32x4_t d = vsubq_s32( ui[ i ], k128 );
+
+        int32x4_t e = vsubq_s32( vi[ i ], k128 );
+
+        r[ i ] = vshrq_n_s32( vmlaq_n_s32( c, e, COLORCONVERT_RV ), COLORCONVERT_SHIFT );
+
+        g[ i ] = vshrq_n_s32( vmlsq_n_s32( vmlsq_n_s32( c, d, COLORCONVERT_GU ), e, COLORCONVERT_GV ), COLORCONVERT_SHIFT );
+
+        b[ i ] = vshrq_n_s32( vmlaq_n_s32( c, d, COLORCONVERT_BU ), COLORCONVERT_SHIFT );
+
+    }
+
+    vst1q_u8( pG, Neon_Pack( g ) );
+
+    vst1q_u8( pB, Neon_Pack( b ) );
+
+    vst1q_u8( pR, Neon_Pack( r ) );
+
+}
+
+static void Row_UV_Split_NEON( const uint8_t * pUV, uint8_t * pU, uint8_t * pV, int nPairs )
+{
+
+    int i = 0;
+
+    for( ; i + 16 <= nPairs; i += 16 ) {
+
+        uint8x16x2_t uv = vld2q_u8( pUV + i * 2 );
+
+        vst1q_u8( pU + i, uv.val[ 0 ] );
+
+        vst1q_u8( pV + i, uv.val[ 1 ] );
+
+    }
+
+    Row_UV_Split_C( pUV + i * 2, pU + i, pV + i, nPairs - i );
+
+}
+
+static void Row_I420_To_GBRP_NEON( const uint8_t * pY, const uint8_t * pU, const uint8_t * pV, uint8_t * pG, uint8_t * pB, uint8_t * pR, int nWidth )
+{
+
+    int x = 0;
+
+    for( ; x + 16 <= nWidth; x += 16 ) {
+
+        Neon_YUV16_To_GBR( vld1q_u8( pY + x ), Neon_Duplicate( vld1_u8( pU + x / 2 ) ), Neon_Duplicate( vld1_u8( pV + x / 2 ) ), pG + x, pB + x, pR + x );
+
+    }
+
+    Row_I420_To_GBRP_C( pY + x, pU + x / 2, pV + x / 2, pG + x, pB + x, pR + x, nWidth - x );
+
+}
+
+static void Row_NV12_To_GBRP_NEON( const uint8_t * pY, const uint8_t * pUV, uint8_t * pG, uint8_t * pB, uint8_t * pR, int nWidth )
+{
+
+    int x = 0;
+
+    for( ; x + 16 <= nWidth; x += 16 ) {
+
+        uint8x8x2_t uv = vld2_u8( pUV + x );
+
+        Neon_YUV16_To_GBR( vld1q_u8( pY + x ), Neon_Duplicate( uv.val[ 0 ] ), Neon_Duplicate( uv.val[ 1 ] ), pG + x, pB + x, pR + x );
+
+    }
+
+    Row_NV12_To_GBRP_C( pY + x, pUV + x, pG + x, pB + x, pR + x, nWidth - x );
+
+}
+
+static void Row_GBRP_To_Y_NEON( const uint8_t * pG, const uint8_t * pB, const uint8_t * pR, uint8_t * pY, int nWidth )
+{
+
+    const int32x4_t k16 = vdupq_n_s32( 16 );
+
+    const int32x4_t kRound = vdupq_n_s32( 1 << ( COLORCONVERT_SHIFT - 1 ) );
+
+    int x = 0;
+
+    for( ; x + 16 <= nWidth; x += 16 ) {
+
+        int32x4_t gi[ 4 ], bi[ 4 ], ri[ 4 ], y[ 4 ];
+
+        Neon_Widen( vld1q_u8( pG + x ), gi );
+
+        Neon_Widen( vld1q_u8( pB + x ), bi );
+
+        Neon_Widen( vld1q_u8( pR + x ), ri );
+
+        for( int i = 0; i < 4; i++ ) {
+
+            int32x4_t acc = vmlaq_n_s32( vmlaq_n_s32( vmlaq_n_s32( kRound, ri[ i ], COLORCONVERT_YR ), gi[ i ], COLORCONVERT_YG ), bi[ i ], COLORCONVERT_YB );
+
+            y[ i ] = vaddq_s32( vshrq_n_s32( acc, COLORCONVERT_SHIFT ), k16 );
+
+        }
+
+        vst1q_u8( pY + x, Neon_Pack( y ) );
+
+    }
+
+    Row_GBRP_To_Y_C( pG + x, pB + x, pR + x, pY + x, nWidth - x );
+
+}
+
+////// 16 pixels of two rows -> 8 x ( 2x2 sum + 2 ) >> 2
+
+static inline uint16x8_t Neon_Average2x2( const uint8_t * p0, const uint8_t * p1 )
+{
+
+    uint16x8_t s = vaddq_u16( vpaddlq_u8( vld1q_u8( p0 ) ), vpaddlq_u8( vld1q_u8( p1 ) ) );
+
+    return vshrq_n_u16( vaddq_u16( s, vdupq_n_u16( 2 ) ), 2 );
+
+}
+
+static void Row_GBRP_To_UV_NEON( const uint8_t * pG0, const uint8_t * pB0, const uint8_t * pR0,
+                                 const uint8_t * pG1, const uint8_t * pB1, const uint8_t * pR1, uint8_t * pU, uint8_t * pV, int nWidth )
+{
+
+    const int32x4_t k128 = vdupq_n_s32( 128 );
+
+    const int32x4_t kRound = vdupq_n_s32( 1 << ( COLORCONVERT_SHIFT - 1 ) );
+
+    int x = 0;
+
+    for( ; x + 16 <= nWidth; x += 16 ) {
+
+        uint16x8_t g16 = Neon_Average2x2( pG0 + x, pG1 + x );
+
+        uint16x8_t b16 = Neon_Average2x2( pB0 + x, pB1 + x );
+
+        uint16x8_t r16 = Neon_Average2x2( pR0 + x, pR1 + x );
+
+        int16x4_t u[ 2 ], v[ 2 ];
+
+        for( int i = 0; i < 2; i++ ) {
+
+            int32x4_t g = vreinterpretq_s32_u32( vmovl_u16( i == 0 ? vget_low_u16( g16 ) : vget_high_u16( g16 ) ) );
+
+            int32x4_t b = vreinterpretq_s32_u32( vmovl_u16( i == 0 ? vget_low_u16( b16 ) : vget_high_u16( b16 ) ) );
+
+            int32x4_t r = vreinterpretq_s32_u32( vmovl_u16( i == 0 ? vget_low_u16( r16 ) : vget_high_u16( r16 ) ) );
+
+            int32x4_t au = vmlsq_n_s32( vmlsq_n_s32( vmlaq_n_s32( kRound, b, COLORCONVERT_UB ), r, COLORCONVERT_UR ), g, COLORCONVERT_UG );
+
+            int32x4_t av = vmlsq_n_s32( vmlsq_n_s32( vmlaq_n_s32( kRound, r, COLORCONVERT_VR ), g, COLORCONVERT_VG ), b, COLORCONVERT_VB );
+
+            u[ i ] = vqmovn_s32( vaddq_s32( vshrq_n_s32( au, COLORCONVERT_SHIFT ), k128 ) );
+
+            v[ i ] = vqmovn_s32( vaddq_s32( vshrq_n_s32( av, COLORCONVERT_SHIFT ), k128 ) );
+
+        }
+
+        vst1_u8( pU + x / 2, vqmovun_s16( vcombine_s16( u[ 0 ], u[ 1 ] ) ) );
+
+        vst1_u8( pV + x / 2, vqmovun_s16( vcombine_s16( v[ 0 ], v[ 1 ] ) ) );
+
+    }
+
+    Row_GBRP_To_UV_C( pG0 + x, pB0 + x, pR0 + x, pG1 + x, pB1 + x, pR1 + x, pU + x / 2, pV + x / 2, nWidth - x );
+
+}
+
+static const CpuConvertRowFuncs g_stRowFuncs_NEON = {
+
+    Row_UV_Split_NEON, Row_I420_To_GBRP_NEON, Row_NV12_To_GBRP_NEON, Row_GBRP_To_Y_NEON, Row_GBRP_To_UV_NEON
+
+};
+
+#endif // CPU_CONVERT_NEON
+
+BOOL CpuConvert_Isa_Supported( CpuConvertIsa eIsa )
+{
+
+    switch( eIsa ) {
+
+    case CPU_CONVERT_ISA_SCALAR: return TRUE;
+
+#if CPU_CONVERT_X86
+
+    case CPU_CONVERT_ISA_SSE41: return __builtin_cpu_supports( "sse4.1" ) ? TRUE : FALSE;
+
+    case CPU_CONVERT_ISA_AVX2: return __builtin_cpu_supports( "avx2" ) ? TRUE : FALSE;
+
+#endif
+
+#if CPU_CONVERT_NEON
+
+    case CPU_CONVERT_ISA_NEON: return TRUE;
+
+#endif
+
+    default: return FALSE;
+
+    }
+
+}
+
+CpuConvertIsa CpuConvert_Isa_Best()
+{
+
+    static const CpuConvertIsa eBest = []() {
+
+        for( int i = CPU_CONVERT_ISA_COUNT - 1; i > CPU_CONVERT_ISA_SCALAR; i-- ) {
+
+            if( CpuConvert_Isa_Supported( ( CpuConvertIsa )i ) == TRUE ) return ( CpuConvertIsa )i;
+
+        }
+
+        return CPU_CONVERT_ISA_SCALAR;
+
+    }();
+
+    return eBest;
+
+}
+
+const char * CpuConvert_Isa_Name( CpuConvertIsa eIsa )
+{
+
+    switch( eIsa ) {
+
+    case CPU_CONVERT_ISA_SCALAR:    return "scalar";
+
+    case CPU_CONVERT_ISA_SSE41:     return "sse4.1";
+
+    case CPU_CONVERT_ISA_AVX2:      return "avx2";
+
+    case CPU_CONVERT_ISA_NEON:      return "neon";
+
+    default:                        return "?";
+
+    }
+
+}
+
+const char * CpuConvert_Kind_Name( CpuConvertKind eKind )
+{
+
+    switch( eKind ) {
+
+    case CPU_CONVERT_NV12_TO_I420:  return "NV12->I420";
+
+    case CPU_CONVERT_I420_TO_GBRP:  return "I420->GBRP";
+
+    case CPU_CONVERT_NV12_TO_GBRP:  return "NV12->GBRP";
+
+    case CPU_CONVERT_GBRP_TO_I420:  return "GBRP->I420";
+
+    default:                        return "?";
+
+    }
+
+}
+
+static const CpuConvertRowFuncs * Func_RowFuncs_Get( CpuConvertIsa eIsa )
+{
+
+    if( CpuConvert_Isa_Supported( eIsa ) == FALSE ) return &g_stRowFuncs_C;
+
+    switch( eIsa ) {
+
+#if CPU_CONVERT_X86
+
+    case CPU_CONVERT_ISA_SSE41: return &g_stRowFuncs_SSE41;
+
+    case CPU_CONVERT_ISA_AVX2: return &g_stRowFuncs_AVX2;
+
+#endif
+
+#if CPU_CONVERT_NEON
+
+    case CPU_CONVERT_ISA_NEON: return &g_stRowFuncs_NEON;
+
+#endif
+
+    default: return &g_stRowFuncs_C;
+
+    }
+
+}
+
+////// Rows [ y0, y1 ), y0 even so a band always owns whole chroma rows
+
+static void Func_Band_Convert( const CpuConvertRowFuncs * pFuncs, CpuConvertKind eKind, const ColorPlanes &src, const ColorPlanes &dst,
+                               int nWidth, int nHeight, int y0, int y1 )
+{
+
+    const uint8_t * const * s = src.pData;
+
+    uint8_t * const * d = dst.pData;
+
+    const int * ss = src.nStride;
+
+    const int * ds = dst.nStride;
+
+    switch( eKind ) {
+
+    case CPU_CONVERT_NV12_TO_I420:
+
+        for( int y = y0; y < y1; y++ ) memcpy( d[ 0 ] + y * ds[ 0 ], s[ 0 ] + y * ss[ 0 ], nWidth );
+
+        for( int cy = y0 / 2; cy < ( y1 + 1 ) / 2; cy++ ) {
+
+            pFuncs->pfnUV_Split( s[ 1 ] + cy * ss[ 1 ], d[ 1 ] + cy * ds[ 1 ], d[ 2 ] + cy * ds[ 2 ], ( nWidth + 1 ) / 2 );
+
+        }
+
+        break;
+
+    case CPU_CONVERT_I420_TO_GBRP:
+
+        for( int y = y0; y < y1; y++ ) {
+
+            pFuncs->pfnI420_To_GBRP( s[ 0 ] + y * ss[ 0 ], s[ 1 ] + ( y / 2 ) * ss[ 1 ], s[ 2 ] + ( y / 2 ) * ss[ 2 ],
+                                     d[ 0 ] + y * ds[ 0 ], d[ 1 ] + y * ds[ 1 ], d[ 2 ] + y * ds[ 2 ], nWidth );
+
+        }
+
+        break;
+
+    case CPU_CONVERT_NV12_TO_GBRP:
+
+        for( int y = y0; y < y1; y++ ) {
+
+            pFuncs->pfnNV12_To_GBRP( s[ 0 ] + y * ss[ 0 ], s[ 1 ] + ( y / 2 ) * ss[ 1 ],
+                                     d[ 0 ] + y * ds[ 0 ], d[ 1 ] + y * ds[ 1 ], d[ 2 ] + y * ds[ 2 ], nWidth );
+
+        }
+
+        break;
+
+    case CPU_CONVERT_GBRP_TO_I420:
+
+        for( int y = y0; y < y1; y++ ) {
+
+            pFuncs->pfnGBRP_To_Y( s[ 0 ] + y * ss[ 0 ], s[ 1 ] + y * ss[ 1 ], s[ 2 ] + y * ss[ 2 ], d[ 0 ] + y * ds[ 0 ], nWidth );
+
+        }
+
+        for( int y = y0; y < y1; y += 2 ) {
+
+            int yNext = ( y + 1 < nHeight ) ? y + 1 : y;
+
+            pFuncs->pfnGBRP_To_UV( s[ 0 ] + y * ss[ 0 ], s[ 1 ] + y * ss[ 1 ], s[ 2 ] + y * ss[ 2 ],
+                                   s[ 0 ] + yNext * ss[ 0 ], s[ 1 ] + yNext * ss[ 1 ], s[ 2 ] + yNext * ss[ 2 ],
+                                   d[ 1 ] + ( y / 2 ) * ds[ 1 ], d[ 2 ] + ( y / 2 ) * ds[ 2 ], nWidth );
+
+        }
+
+        break;
+
+    default:
+
+        break;
+
+    }
+
+}
+
+////// Shared row-band workers, CPU_CONVERT_THREAD_NUM threads at most
+
+static WorkerPool & Func_Pool_Get()
+{
+
+    static WorkerPool oPool( CPU_CONVERT_THREAD_NUM );
+
+    return oPool;
+
+}
+
+void CpuConvert_Run( CpuConvertKind eKind, const ColorPlanes &src, const ColorPlanes &dst,
+                     int nWidth, int nHeight, CpuConvertIsa eIsa, int nThreads )
+{
+
+    if( nWidth <= 0 || nHeight <= 0 ) return;
+
+    const CpuConvertRowFuncs * pFuncs = Func_RowFuncs_Get( eIsa );
+
+    if( nThreads == 0 ) nThreads = Func_Pool_Get().GetThreadCount();
+
+    int nBands = std::min( nThreads, std::max( 1, nHeight / CPU_CONVERT_BAND_MIN_ROWS ) );
+
+    if( nBands <= 1 ) {
+
+        Func_Band_Convert( pFuncs, eKind, src, dst, nWidth, nHeight, 0, nHeight );
+
+        return;
+
+    }
+
+    int nBandRows = ( ( nHeight + nBands - 1 ) / nBands + 1 ) & ~1;
+
+    Func_Pool_Get().Run( nBands, [ & ]( int i ) {
+
+        int y0 = i * nBandRows;
+
+        int y1 = std::min( nHeight, y0 + nBandRows );
+
+        if( y0 < y1 ) Func_Band_Convert( pFuncs, eKind, src, dst, nWidth, nHeight, y0, y1 );
+
+    });
+
+}
+
+////// Crop rows [ y0, y1 ) read straight from the NV12 frame. Chroma comes from row
+////// ( nY + y ) / 2 and the pair at an even column, as in Kernel_NV12_To_I420_GBRPCrop; an odd
+////// nX leaves one pixel before the first pair, which is converted on its own
+
+static void Func_Crop_Band_Convert( const CpuConvertRowFuncs * pFuncs, const ColorPlanes &src, const ColorPlanes &dst,
+                                    int nX, int nY, int nWidth, int y0, int y1 )
+{
+
+    int nLead = std::min( nWidth, nX & 1 );
+
+    for( int y = y0; y < y1; y++ ) {
+
+        const uint8_t * pY = src.pData[ 0 ] + ( nY + y ) * src.nStride[ 0 ] + nX;
+
+        const uint8_t * pUV = src.pData[ 1 ] + ( ( nY + y ) / 2 ) * src.nStride[ 1 ] + ( nX & ~1 );
+
+        uint8_t * pG = dst.pData[ 0 ] + y * dst.nStride[ 0 ];
+
+        uint8_t * pB = dst.pData[ 1 ] + y * dst.nStride[ 1 ];
+
+        uint8_t * pR = dst.pData[ 2 ] + y * dst.nStride[ 2 ];
+
+        if( nLead == 1 ) {
+
+            ColorConvert_YUV_To_RGB( pY[ 0 ], pUV[ 0 ], pUV[ 1 ], &pR[ 0 ], &pG[ 0 ], &pB[ 0 ] );
+
+            pUV += 2;
+
+        }
+
+        pFuncs->pfnNV12_To_GBRP( pY + nLead, pUV, pG + nLead, pB + nLead, pR + nLead, nWidth - nLead );
+
+    }
+
+}
+
+void CpuConvert_NV12_Crop_To_GBRP( const ColorPlanes &src, const ColorPlanes &dst, int nX, int nY, int nWidth, int nHeight,
+                                   CpuConvertIsa eIsa, int nThreads )
+{
+
+    if( nWidth <= 0 || nHeight <= 0 ) return;
+
+    const CpuConvertRowFuncs * pFuncs = Func_RowFuncs_Get( eIsa );
+
+    if( nThreads == 0 ) nThreads = Func_Pool_Get().GetThreadCount();
+
+    int nBands = std::min( nThreads, std::max( 1, nHeight / CPU_CONVERT_BAND_MIN_ROWS ) );
+
+    if( nBands <= 1 ) {
+
+        Func_Crop_Band_Convert( pFuncs, src, dst, nX, nY, nWidth, 0, nHeight );
+
+        return;
+
+    }
+
+    int nBandRows = ( nHeight + nBands - 1 ) / nBands;
+
+    Func_Pool_Get().Run( nBands, [ & ]( int i ) {
+
+        int y0 = i * nBandRows;
+
+        int y1 = std::min( nHeight, y0 + nBandRows );
+
+        if( y0 < y1 ) Func_Crop_Band_Convert( pFuncs, src, dst, nX, nY, nWidth, y0, y1 );
+
+    });
+
+}
+
+////// Self-test and benchmark
+
+enum CpuConvertLayout { CPU_CONVERT_LAYOUT_NV12, CPU_CONVERT_LAYOUT_I420, CPU_CONVERT_LAYOUT_GBRP };
+
+struct CpuConvertFrame {
+
+    std::vector< uint8_t >  vPlane[ 3 ];
+
+    ColorPlanes             planes;
+
+    int                     nPlaneWidth[ 3 ];
+
+    int                     nPlaneHeight[ 3 ];
+
+    int                     nPlanes;
+
+};
+
+static void Func_Frame_Alloc( CpuConvertFrame * pFrame, CpuConvertLayout eLayout, int nWidth, int nHeight, int nPadding )
+{
+
+    int cw = ( nWidth + 1 ) / 2;
+
+    int ch = ( nHeight + 1 ) / 2;
+
+    pFrame->planes = ColorPlanes();
+
+    switch( eLayout ) {
+
+    case CPU_CONVERT_LAYOUT_NV12:
+
+        pFrame->nPlanes = 2;
+
+        pFrame->nPlaneWidth[ 0 ] = nWidth; pFrame->nPlaneHeight[ 0 ] = nHeight;
+
+        pFrame->nPlaneWidth[ 1 ] = cw * 2; pFrame->nPlaneHeight[ 1 ] = ch;
+
+        break;
+
+    case CPU_CONVERT_LAYOUT_I420:
+
+        pFrame->nPlanes = 3;
+
+        pFrame->nPlaneWidth[ 0 ] = nWidth; pFrame->nPlaneHeight[ 0 ] = nHeight;
+
+        pFrame->nPlaneWidth[ 1 ] = cw; pFrame->nPlaneHeight[ 1 ] = ch;
+
+        pFrame->nPlaneWidth[ 2 ] = cw; pFrame->nPlaneHeight[ 2 ] = ch;
+
+        break;
+
+    case CPU_CONVERT_LAYOUT_GBRP:
+
+        pFrame->nPlanes = 3;
+
+        for( int i = 0; i < 3; i++ ) { pFrame->nPlaneWidth[ i ] = nWidth; pFrame->nPlaneHeight[ i ] = nHeight; }
+
+        break;
+
+    }
+
+    for( int i = 0; i < pFrame->nPlanes; i++ ) {
+
+        pFrame->planes.nStride[ i ] = pFrame->nPlaneWidth[ i ] + nPadding;
+
+        pFrame->vPlane[ i ].assign( ( size_t )pFrame->planes.nStride[ i ] * pFrame->nPlaneHeight[ i ], 0 );
+
+        pFrame->planes.pData[ i ] = pFrame->vPlane[ i ].data();
+
+    }
+
+}
+
+static size_t Func_Frame_Bytes( const CpuConvertFrame &frame )
+{
+
+    size_t nBytes = 0;
+
+    for( int i = 0; i < frame.nPlanes; i++ ) nBytes += ( size_t )frame.nPlaneWidth[ i ] * frame.nPlaneHeight[ i ];
+
+    return nBytes;
+
+}
+
+static void Func_Layouts_Get( CpuConvertKind eKind, CpuConvertLayout * pSrc, CpuConvertLayout * pDst )
+{
+
+    switch( eKind ) {
+
+    case CPU_CONVERT_NV12_TO_I420: *pSrc = CPU_CONVERT_LAYOUT_NV12; *pDst = CPU_CONVERT_LAYOUT_I420; break;
+
+    case CPU_CONVERT_I420_TO_GBRP: *pSrc = CPU_CONVERT_LAYOUT_I420; *pDst = CPU_CONVERT_LAYOUT_GBRP; break;
+
+    case CPU_CONVERT_NV12_TO_GBRP: *pSrc = CPU_CONVERT_LAYOUT_NV12; *pDst = CPU_CONVERT_LAYOUT_GBRP; break;
+
+    default:                       *pSrc = CPU_CONVERT_LAYOUT_GBRP; *pDst = CPU_CONVERT_LAYOUT_I420; break;
+
+    }
+
+}
+
+BOOL CpuConvert_SelfTest()
+{
+
+    static const int nSize_S[][ 2 ] = { { 1920, 1080 }, { 1918, 1078 }, { 1921, 17 }, { 37, 11 }, { 15, 3 }, { 1, 1 } };
+
+    BOOL bPass = TRUE;
+
+    srand( 1 );
+
+    for( const auto &size : nSize_S ) {
+
+        int nWidth = size[ 0 ];
+
+        int nHeight = size[ 1 ];
+
+        for( int k = 0; k < CPU_CONVERT_KIND_COUNT; k++ ) {
+
+            CpuConvertKind eKind = ( CpuConvertKind )k;
+
+            CpuConvertLayout eSrc, eDst;
+
+            Func_Layouts_Get( eKind, &eSrc, &eDst );
+
+            CpuConvertFrame src, ref;
+
+            Func_Frame_Alloc( &src, eSrc, nWidth, nHeight, 16 );
+
+            Func_Frame_Alloc( &ref, eDst, nWidth, nHeight, 16 );
+
+            for( int i = 0; i < src.nPlanes; i++ ) for( auto &c : src.vPlane[ i ] ) c = ( uint8_t )rand();
+
+            CpuConvert_Run( eKind, src.planes, ref.planes, nWidth, nHeight, CPU_CONVERT_ISA_SCALAR, 1 );
+
+            for( int n = CPU_CONVERT_ISA_SCALAR; n < CPU_CONVERT_ISA_COUNT; n++ ) {
+
+                CpuConvertIsa eIsa = ( CpuConvertIsa )n;
+
+                if( CpuConvert_Isa_Supported( eIsa ) == FALSE ) continue;
+
+                CpuConvertFrame dst;
+
+                Func_Frame_Alloc( &dst, eDst, nWidth, nHeight, 16 );
+
+                CpuConvert_Run( eKind, src.planes, dst.planes, nWidth, nHeight, eIsa, 0 );
+
+                for( int i = 0; i < dst.nPlanes; i++ ) {
+
+                    for( int y = 0; y < dst.nPlaneHeight[ i ]; y++ ) {
+
+                        const uint8_t * pRef = ref.planes.pData[ i ] + y * ref.planes.nStride[ i ];
+
+                        const uint8_t * pDst = dst.planes.pData[ i ] + y * dst.planes.nStride[ i ];
+
+                        if( memcmp( pRef, pDst, dst.nPlaneWidth[ i ] ) == 0 ) continue;
+
+                        printf( "[QCAP DEBUG] CpuConvert self-test: %s %s %dx%d plane %d row %d mismatch\n"
+                                , CpuConvert_Kind_Name( eKind ), CpuConvert_Isa_Name( eIsa ), nWidth, nHeight, i, y );
+
+                        bPass = FALSE;
+
+                        break;
+
+                    }
+
+                }
+
+            }
+
+        }
+
+    }
+
+    ////// Crops at odd and even origins against the per-pixel rule of the CUDA kernel
+
+    static const int nCrop_S[][ 4 ] = { { 0, 0, 64, 32 }, { 1, 0, 63, 31 }, { 0, 1, 64, 33 }, { 3, 5, 37, 11 }, { 1, 1, 1, 1 } };
+
+    CpuConvertFrame srcFrame;
+
+    Func_Frame_Alloc( &srcFrame, CPU_CONVERT_LAYOUT_NV12, 80, 48, 16 );
+
+    for( int i = 0; i < srcFrame.nPlanes; i++ ) for( auto &c : srcFrame.vPlane[ i ] ) c = ( uint8_t )rand();
+
+    const ColorPlanes &src = srcFrame.planes;
+
+    for( const auto &crop : nCrop_S ) {
+
+        int nX = crop[ 0 ], nY = crop[ 1 ], nWidth = crop[ 2 ], nHeight = crop[ 3 ];
+
+        CpuConvertFrame ref;
+
+        Func_Frame_Alloc( &ref, CPU_CONVERT_LAYOUT_GBRP, nWidth, nHeight, 16 );
+
+        for( int y = 0; y < nHeight; y++ ) {
+
+            for( int x = 0; x < nWidth; x++ ) {
+
+                int sx = nX + x, sy = nY + y;
+
+                const uint8_t * pUV = src.pData[ 1 ] + ( sy / 2 ) * src.nStride[ 1 ] + ( sx / 2 ) * 2;
+
+                ColorConvert_YUV_To_RGB( src.pData[ 0 ][ sy * src.nStride[ 0 ] + sx ], pUV[ 0 ], pUV[ 1 ]
+                                         , &ref.planes.pData[ 2 ][ y * ref.planes.nStride[ 2 ] + x ]
+                                         , &ref.planes.pData[ 0 ][ y * ref.planes.nStride[ 0 ] + x ]
+                                         , &ref.planes.pData[ 1 ][ y * ref.planes.nStride[ 1 ] + x ] );
+
+            }
+
+        }
+
+        for( int n = CPU_CONVERT_ISA_SCALAR; n < CPU_CONVERT_ISA_COUNT; n++ ) {
+
+            CpuConvertIsa eIsa = ( CpuConvertIsa )n;
+
+            if( CpuConvert_Isa_Supported( eIsa ) == FALSE ) continue;
+
+            CpuConvertFrame dst;
+
+            Func_Frame_Alloc( &dst, CPU_CONVERT_LAYOUT_GBRP, nWidth, nHeight, 16 );
+
+            CpuConvert_NV12_Crop_To_GBRP( src, dst.planes, nX, nY, nWidth, nHeight, eIsa, 0 );
+
+            for( int i = 0; i < 3; i++ ) {
+
+                for( int y = 0; y < nHeight; y++ ) {
+
+                    if( memcmp( ref.planes.pData[ i ] + y * ref.planes.nStride[ i ], dst.planes.pData[ i ] + y * dst.planes.nStride[ i ], nWidth ) == 0 ) continue;
+
+                    printf( "[QCAP DEBUG] CpuConvert self-test: NV12 crop at %d,%d %dx%d %s plane %d row %d mismatch\n"
+                            , nX, nY, nWidth, nHeight, CpuConvert_Isa_Name( eIsa ), i, y );
+
+                    bPass = FALSE;
+
+                    break;
+
+                }
+
+            }
+
+        }
+
+    }
+
+    printf( "[QCAP DEBUG] CpuConvert self-test %s\n", ( bPass == TRUE ) ? "passed" : "FAILED" );
+
+    return bPass;
+
+}
+
+static double Func_Throughput_Measure( CpuConvertKind eKind, const CpuConvertFrame &src, const CpuConvertFrame &dst,
+                                       int nWidth, int nHeight, CpuConvertIsa eIsa, int nThreads, double dSeconds )
+{
+
+    CpuConvert_Run( eKind, src.planes, dst.planes, nWidth, nHeight, eIsa, nThreads );
+
+    auto tStart = std::chrono::steady_clock::now();
+
+    double dElapsed = 0.0;
+
+    uint64_t nFrames = 0;
+
+    do {
+
+        CpuConvert_Run( eKind, src.planes, dst.planes, nWidth, nHeight, eIsa, nThreads );
+
+        nFrames++;
+
+        dElapsed = std::chrono::duration< double >( std::chrono::steady_clock::now() - tStart ).count();
+
+    } while( dElapsed < dSeconds );
+
+    return ( double )Func_Frame_Bytes( src ) * nFrames / dElapsed / 1e6;
+
+}
+
+void CpuConvert_Benchmark( int nWidth, int nHeight, double dSecondsPerCase )
+{
+
+    int nThreads = Func_Pool_Get().GetThreadCount();
+
+    char szBanded[ 16 ];
+
+    snprintf( szBanded, sizeof( szBanded ), "x%d", nThreads );
+
+    printf( "CpuConvert benchmark %dx%d, MB/s of source data ( x1 = calling thread, %s = row bands )\n", nWidth, nHeight, szBanded );
+
+    printf( "%-12s %-8s %10s %10s\n", "pair", "isa", "x1", szBanded );
+
+    for( int k = 0; k < CPU_CONVERT_KIND_COUNT; k++ ) {
+
+        CpuConvertKind eKind = ( CpuConvertKind )k;
+
+        CpuConvertLayout eSrc, eDst;
+
+        Func_Layouts_Get( eKind, &eSrc, &eDst );
+
+        CpuConvertFrame src, dst;
+
+        Func_Frame_Alloc( &src, eSrc, nWidth, nHeight, 0 );
+
+        Func_Frame_Alloc( &dst, eDst, nWidth, nHeight, 0 );
+
+        for( int i = 0; i < src.nPlanes; i++ ) for( auto &c : src.vPlane[ i ] ) c = ( uint8_t )rand();
+
+        for( int n = CPU_CONVERT_ISA_SCALAR; n < CPU_CONVERT_ISA_COUNT; n++ ) {
+
+            CpuConvertIsa eIsa = ( CpuConvertIsa )n;
+
+            if( CpuConvert_Isa_Supported( eIsa ) == FALSE ) continue;
+
+            double dSingle = Func_Throughput_Measure( eKind, src, dst, nWidth, nHeight, eIsa, 1, dSecondsPerCase );
+
+            double dBanded = Func_Throughput_Measure( eKind, src, dst, nWidth, nHeight, eIsa, 0, dSecondsPerCase );
+
+            printf( "%-12s %-8s %10.1f %10.1f\n", CpuConvert_Kind_Name( eKind ), CpuConvert_Isa_Name( eIsa ), dSingle, dBanded );
+
+        }
+
+    }
+
+}
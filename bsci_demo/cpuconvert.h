@@ -0,0 +1,75 @@
+#ifndef CPUCONVERT_H
+#define CPUCONVERT_H
+
+#include <qcap.windef.h>
+
+#include "colorconvert.h"
+
+////// CPU colour conversion backend. Used by FusedConverter when there is no usable CUDA
+////// device ( or BSCI_CONVERT_BACKEND=cpu ), and benchmarked with --convert-bench.
+////// Every vector path is bit-exact against CPU_CONVERT_ISA_SCALAR.
+
+enum CpuConvertKind {
+
+    CPU_CONVERT_NV12_TO_I420 = 0,
+
+    CPU_CONVERT_I420_TO_GBRP,
+
+    CPU_CONVERT_NV12_TO_GBRP,
+
+    CPU_CONVERT_GBRP_TO_I420,
+
+    CPU_CONVERT_KIND_COUNT
+
+};
+
+enum CpuConvertIsa {
+
+    CPU_CONVERT_ISA_SCALAR = 0,
+
+    CPU_CONVERT_ISA_SSE41,
+
+    CPU_CONVERT_ISA_AVX2,
+
+    CPU_CONVERT_ISA_NEON,
+
+    CPU_CONVERT_ISA_COUNT
+
+};
+
+////// Best instruction set this CPU supports
+
+CpuConvertIsa CpuConvert_Isa_Best();
+
+BOOL CpuConvert_Isa_Supported( CpuConvertIsa eIsa );
+
+const char * CpuConvert_Isa_Name( CpuConvertIsa eIsa );
+
+const char * CpuConvert_Kind_Name( CpuConvertKind eKind );
+
+////// Converts nWidth x nHeight pixels. Planes follow qcap2_av_frame_get_buffer1 order
+////// ( NV12: Y, UV / I420: Y, U, V / GBRP: G, B, R ). To convert a crop, offset src by an
+////// even x / y before the call. nThreads 0 splits the rows across the shared pool,
+////// 1 runs on the calling thread.
+
+void CpuConvert_Run( CpuConvertKind eKind, const ColorPlanes &src, const ColorPlanes &dst,
+                     int nWidth, int nHeight, CpuConvertIsa eIsa = CpuConvert_Isa_Best(), int nThreads = 0 );
+
+////// nWidth x nHeight GBRP crop at any nX, nY of a whole NV12 frame, same bytes as the fused
+////// CUDA kernel: each pixel takes the chroma of the 2x2 block it sits in
+
+void CpuConvert_NV12_Crop_To_GBRP( const ColorPlanes &src, const ColorPlanes &dst, int nX, int nY, int nWidth, int nHeight,
+                                   CpuConvertIsa eIsa = CpuConvert_Isa_Best(), int nThreads = 0 );
+
+////// Compares every supported instruction set against the scalar reference on random
+////// frames, odd sizes included, and NV12 crops at odd origins against the kernel's
+////// per-pixel rule. Returns FALSE if any output differs.
+
+BOOL CpuConvert_SelfTest();
+
+////// Prints MB/s ( source bytes ) per format pair and instruction set, single thread
+////// and row-band threaded
+
+void CpuConvert_Benchmark( int nWidth, int nHeight, double dSecondsPerCase );
+
+#endif // CPUCONVERT_H
@@ -0,0 +1,339 @@
+#include "cropring.h"
+#include "cpuconvert.h"
+#include "latencystats.h"
+#include "framepool.h"
+
+#include <QDateTime>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <cstdio>
+#include <cstring>
+
+CropRing::CropRing( const CropStoreParam &store, const CropRingParam &param )
+    : m_stStore( store ), m_stParam( param )
+{
+
+    ////// NV12 chroma covers 2x2 blocks, so the copy starts on an even row and column and
+    ////// takes one extra column / row when the crop origin is odd
+
+    m_nCopyX = m_stParam.st_nCropX & ~1UL;
+
+    m_nCopyY = m_stParam.st_nCropY & ~1UL;
+
+    m_nCopyW = ( m_stParam.st_nCropW + ( m_stParam.st_nCropX & 1 ) + 1 ) & ~1UL;
+
+    m_nCopyH = ( m_stParam.st_nCropH + ( m_stParam.st_nCropY & 1 ) + 1 ) & ~1UL;
+
+    size_t nSlots = ( size_t )std::ceil( m_stParam.st_nPreMs * m_stParam.st_dFps / 1000.0 ) + CROP_RING_SPARE_SLOTS;
+
+    std::vector< qcap2_rcbuffer_t * > pRCBuffer_S( nSlots );
+
+    if( FramePool::Instance().Acquire( QCAP_COLORSPACE_TYPE_NV12, m_nCopyW, m_nCopyH, FRAME_POOL_MEMORY_SYSTEM, ( int )nSlots, pRCBuffer_S.data() ) != QCAP_RS_SUCCESSFUL ) {
+
+        printf( "[QCAP DEBUG] %s(%d): no frames for the crop ring, every frame is dropped\n", __FUNCTION__, __LINE__ );
+
+        nSlots = 0;
+
+    }
+
+    m_oSlot_S.resize( nSlots );
+
+    for( size_t i = 0; i < nSlots; i++ ) {
+
+        Slot &slot = m_oSlot_S[ i ];
+
+        slot.pRCBuffer = pRCBuffer_S[ i ];
+
+        ////// Pool frames stay where they are, the planes are looked up once
+
+        uint8_t * pBuffer[ 4 ];
+
+        int nStride[ 4 ];
+
+        qcap2_av_frame_get_buffer1( ( qcap2_av_frame_t * )qcap2_rcbuffer_get_data( slot.pRCBuffer ), pBuffer, nStride );
+
+        slot.stPlanes = { { pBuffer[ 0 ], pBuffer[ 1 ], nullptr }, { nStride[ 0 ], nStride[ 1 ], 0 } };
+
+    }
+
+    m_vGBRP.resize( ( size_t )m_stParam.st_nCropW * m_stParam.st_nCropH * 3 );
+
+    printf( "[QCAP DEBUG] Crop ring: %lu slots at %.1f FPS, %lu MB, window -%lu / +%lu ms\n"
+            , ( ULONG )nSlots, m_stParam.st_dFps, ( ULONG )( nSlots * FramePool::Func_Frame_Bytes( QCAP_COLORSPACE_TYPE_NV12, m_nCopyW, m_nCopyH ) >> 20 )
+            , m_stParam.st_nPreMs, m_stParam.st_nPostMs );
+
+    m_thWriter = std::thread( &CropRing::Func_Writer_Loop, this );
+
+}
+
+CropRing::~CropRing()
+{
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_bExit = TRUE;
+    }
+
+    m_cvWrite.notify_all();
+
+    ////// The writer drains whatever is still queued before it exits
+
+    if( m_thWriter.joinable() == TRUE ) m_thWriter.join();
+
+    std::vector< qcap2_rcbuffer_t * > pRCBuffer_S;
+
+    for( const Slot &slot : m_oSlot_S ) pRCBuffer_S.push_back( slot.pRCBuffer );
+
+    if( pRCBuffer_S.empty() == FALSE ) FramePool::Instance().Release( pRCBuffer_S.data(), ( int )pRCBuffer_S.size() );
+
+}
+
+void CropRing::Func_Slot_Fill( Slot * pSlot, qcap2_rcbuffer_t * pRCBuffer )
+{
+
+    std::shared_ptr< qcap2_av_frame_t > pAVFrame(
+                ( qcap2_av_frame_t * )qcap2_rcbuffer_lock_data( pRCBuffer ),
+                [ pRCBuffer ]( qcap2_av_frame_t * ) {
+                    qcap2_rcbuffer_unlock_data( pRCBuffer );
+                });
+
+    uint8_t * pBuffer[ 4 ];
+
+    int nStride[ 4 ];
+
+    qcap2_av_frame_get_buffer1( pAVFrame.get(), pBuffer, nStride );
+
+    ////// Captured NV12 is one contiguous buffer, the chroma plane follows the luma rows
+
+    if( pBuffer[ 1 ] == nullptr ) {
+
+        pBuffer[ 1 ] = pBuffer[ 0 ] + nStride[ 0 ] * m_stParam.st_nSrcHeight;
+
+        nStride[ 1 ] = nStride[ 0 ];
+
+    }
+
+    const ColorPlanes &dst = pSlot->stPlanes;
+
+    const uint8_t * pSrcY = pBuffer[ 0 ] + m_nCopyY * nStride[ 0 ] + m_nCopyX;
+
+    const uint8_t * pSrcUV = pBuffer[ 1 ] + ( m_nCopyY / 2 ) * nStride[ 1 ] + m_nCopyX;
+
+    ////// A crop reaching the right or bottom edge of an odd sized source has no extra column / row
+
+    ULONG nRowBytes = std::min( m_nCopyW, m_stParam.st_nSrcWidth - m_nCopyX );
+
+    ULONG nRows = std::min( m_nCopyH, m_stParam.st_nSrcHeight - m_nCopyY );
+
+    for( ULONG y = 0; y < nRows; y++ ) memcpy( dst.pData[ 0 ] + y * dst.nStride[ 0 ], pSrcY + y * nStride[ 0 ], nRowBytes );
+
+    for( ULONG y = 0; y < ( nRows + 1 ) / 2; y++ ) memcpy( dst.pData[ 1 ] + y * dst.nStride[ 1 ], pSrcUV + y * nStride[ 1 ], ( nRowBytes + 1 ) & ~1UL );
+
+}
+
+void CropRing::Func_Slot_Queue( size_t nSlot )
+{
+
+    m_oSlot_S[ nSlot ].bPinned = TRUE;
+
+    m_queWrite.push_back( { nSlot, Func_Latency_Now() } );
+
+}
+
+void CropRing::Push( const FrameBusPacket &packet )
+{
+
+    Slot * pSlot = nullptr;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        for( size_t i = 0; i < m_oSlot_S.size(); i++ ) {
+
+            size_t nSlot = ( m_nHead + i ) % m_oSlot_S.size();
+
+            if( m_oSlot_S[ nSlot ].bPinned == TRUE ) continue;
+
+            pSlot = &m_oSlot_S[ nSlot ];
+
+            pSlot->bValid = FALSE;
+
+            m_nHead = nSlot + 1;
+
+            break;
+
+        }
+
+        if( pSlot == nullptr ) {
+
+            m_nFramesDropped++;
+
+            return;
+
+        }
+    }
+
+    ////// Slot is neither valid nor pinned, nothing else touches it during the copy
+
+    Func_Slot_Fill( pSlot, packet.pRCBuffer );
+
+    int64_t nNowNs = Func_Latency_Now();
+
+    BOOL bQueued = FALSE;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        pSlot->nOriginNs = packet.nOriginNs;
+
+        pSlot->nCaptureTimeMs = QDateTime::currentMSecsSinceEpoch() - ( nNowNs - packet.nOriginNs ) / 1000000;
+
+        pSlot->bValid = TRUE;
+
+        m_nFramesStored++;
+
+        ////// Open post windows take the new frame, closed ones are dropped
+
+        while( m_queWindow.empty() == FALSE && m_queWindow.front().nEndNs < packet.nOriginNs ) m_queWindow.pop_front();
+
+        for( const Window &window : m_queWindow ) {
+
+            if( packet.nOriginNs < window.nStartNs || packet.nOriginNs > window.nEndNs ) continue;
+
+            Func_Slot_Queue( pSlot - m_oSlot_S.data() );
+
+            bQueued = TRUE;
+
+            break;
+
+        }
+    }
+
+    if( bQueued == TRUE ) m_cvWrite.notify_all();
+
+}
+
+void CropRing::Trigger( int64_t nTriggerNs )
+{
+
+    Window window;
+
+    window.nStartNs = nTriggerNs - ( int64_t )m_stParam.st_nPreMs * 1000000;
+
+    window.nEndNs = nTriggerNs + ( int64_t )m_stParam.st_nPostMs * 1000000;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_nTriggers++;
+
+        ////// Frames already captured go out oldest first. A slot queued by an earlier,
+        ////// overlapping press is still pinned and is not written twice.
+
+        std::vector< size_t > nSlot_S;
+
+        for( size_t i = 0; i < m_oSlot_S.size(); i++ ) {
+
+            const Slot &slot = m_oSlot_S[ i ];
+
+            if( slot.bValid == FALSE || slot.bPinned == TRUE ) continue;
+
+            if( slot.nOriginNs < window.nStartNs || slot.nOriginNs > window.nEndNs ) continue;
+
+            nSlot_S.push_back( i );
+
+        }
+
+        std::sort( nSlot_S.begin(), nSlot_S.end(), [ this ]( size_t a, size_t b ) { return m_oSlot_S[ a ].nOriginNs < m_oSlot_S[ b ].nOriginNs; } );
+
+        for( size_t nSlot : nSlot_S ) Func_Slot_Queue( nSlot );
+
+        m_queWindow.push_back( window );
+
+        printf( "[QCAP DEBUG] Crop ring: trigger, %lu frames before the press queued\n", ( ULONG )nSlot_S.size() );
+    }
+
+    m_cvWrite.notify_all();
+
+}
+
+void CropRing::Func_Writer_Loop()
+{
+
+    while( TRUE ) {
+
+        WriteItem item;
+
+        {
+            std::unique_lock< std::mutex > lock( m_mtx );
+
+            m_cvWrite.wait( lock, [ this ]() { return m_bExit == TRUE || m_queWrite.empty() == FALSE; } );
+
+            if( m_queWrite.empty() == TRUE ) break;
+
+            item = m_queWrite.front();
+
+            m_queWrite.pop_front();
+        }
+
+        if( m_stStore.st_pIoScheduler != nullptr ) m_stStore.st_pIoScheduler->QueueWait( IO_CLASS_CAPTURE, Func_Latency_Now() - item.nQueuedNs );
+
+        ////// Pinned, so capture leaves the slot alone while it is converted and written
+
+        Slot &slot = m_oSlot_S[ item.nSlot ];
+
+        size_t nPlane = ( size_t )m_stParam.st_nCropW * m_stParam.st_nCropH;
+
+        ColorPlanes dst = {};
+
+        for( int i = 0; i < 3; i++ ) {
+
+            dst.pData[ i ] = m_vGBRP.data() + nPlane * i;
+
+            dst.nStride[ i ] = ( int )m_stParam.st_nCropW;
+
+        }
+
+        ////// The slot starts at the even row and column before the crop, the odd part of the
+        ////// origin is the offset inside it
+
+        CpuConvert_NV12_Crop_To_GBRP( slot.stPlanes, dst, ( int )( m_stParam.st_nCropX - m_nCopyX ), ( int )( m_stParam.st_nCropY - m_nCopyY )
+                                      , ( int )m_stParam.st_nCropW, ( int )m_stParam.st_nCropH );
+
+        BOOL bWritten = CropWriter::Func_Crop_Write( m_stStore, dst, m_stParam.st_nCropW, m_stParam.st_nCropH, slot.nCaptureTimeMs );
+
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        slot.bPinned = FALSE;
+
+        if( bWritten == TRUE ) m_nFramesWritten++;
+
+    }
+
+}
+
+CropRingStats CropRing::GetStats() const
+{
+
+    CropRingStats stats;
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    stats.st_nSlots = ( ULONG )m_oSlot_S.size();
+
+    for( const Slot &slot : m_oSlot_S ) if( slot.bPinned == TRUE ) stats.st_nPinned++;
+
+    stats.st_nFramesStored = m_nFramesStored;
+
+    stats.st_nFramesDropped = m_nFramesDropped;
+
+    stats.st_nFramesWritten = m_nFramesWritten;
+
+    stats.st_nTriggers = m_nTriggers;
+
+    return stats;
+
+}
@@ -0,0 +1,182 @@
+#ifndef CROPRING_H
+#define CROPRING_H
+
+#include <QString>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+#include <qcap.windef.h>
+#include <qcap2.h>
+
+#include "framebus.h"
+#include "cropwriter.h"
+
+////// Window saved around a "Store Crop" press, on the capture timestamps
+
+#define CROP_RING_PRE_MS 1000
+
+#define CROP_RING_POST_MS 500
+
+////// Crops a second the ring takes, the bus hands it frames at this rate. Together with
+////// CROP_RING_PRE_MS it sizes the ring; post window frames are queued as they arrive, so
+////// the few spare slots only cover frames still waiting for the writer.
+
+#define CROP_RING_FPS 30.0
+
+#define CROP_RING_SPARE_SLOTS 8
+
+struct CropRingParam {
+
+    ULONG       st_nSrcWidth    = 0;
+
+    ULONG       st_nSrcHeight   = 0;
+
+    ULONG       st_nCropX       = 0;
+
+    ULONG       st_nCropY       = 0;
+
+    ULONG       st_nCropW       = 0;
+
+    ULONG       st_nCropH       = 0;
+
+    ULONG       st_nPreMs       = CROP_RING_PRE_MS;
+
+    ULONG       st_nPostMs      = CROP_RING_POST_MS;
+
+    double      st_dFps         = CROP_RING_FPS;        // also the ring's frame bus rate
+
+};
+
+struct CropRingStats {
+
+    ULONG       st_nSlots               = 0;
+
+    ULONG       st_nPinned              = 0;
+
+    uint64_t    st_nFramesStored        = 0;
+
+    uint64_t    st_nFramesDropped       = 0;
+
+    uint64_t    st_nFramesWritten       = 0;
+
+    uint64_t    st_nTriggers            = 0;
+
+};
+
+////// Pre-trigger ring: keeps the last frames' crops as NV12 in frames taken from the
+////// FramePool once, so a press can save frames captured before the GUI event was handled.
+////// Capture frames can not be held that long ( the card has few ), so the crop is copied
+////// out; the copy starts on the even row and column at or before the crop origin, and the
+////// writer converts from the exact origin like the fused converter does. Selected slots
+////// are pinned until the background writer has converted them to GBRP and written them;
+////// capture skips pinned slots and never waits for the disk.
+
+class CropRing
+{
+
+public:
+
+    CropRing( const CropStoreParam &store, const CropRingParam &param );
+
+    ~CropRing();
+
+    ////// Frame bus consumer, copies the crop out of the captured NV12
+
+    void Push( const FrameBusPacket &packet );
+
+    ////// nTriggerNs on the Func_Latency_Now() clock. Frames already in the ring are queued
+    ////// at once, later ones as they arrive until the post window closes.
+
+    void Trigger( int64_t nTriggerNs );
+
+    CropRingStats GetStats() const;
+
+private:
+
+    struct Slot {
+
+        qcap2_rcbuffer_t *      pRCBuffer       = nullptr;      // pooled NV12, held for the ring's life
+
+        ColorPlanes             stPlanes        = {};
+
+        int64_t                 nOriginNs       = 0;
+
+        qint64                  nCaptureTimeMs  = 0;
+
+        BOOL                    bValid          = FALSE;
+
+        BOOL                    bPinned         = FALSE;
+
+    };
+
+    struct Window {
+
+        int64_t                 nStartNs;
+
+        int64_t                 nEndNs;
+
+    };
+
+    struct WriteItem {
+
+        size_t                  nSlot;
+
+        int64_t                 nQueuedNs;
+
+    };
+
+    void Func_Slot_Fill( Slot * pSlot, qcap2_rcbuffer_t * pRCBuffer );
+
+    void Func_Slot_Queue( size_t nSlot );
+
+    void Func_Writer_Loop();
+
+private:
+
+    CropStoreParam              m_stStore;
+
+    CropRingParam               m_stParam;
+
+    ////// Copied window: even origin, covers the crop
+
+    ULONG                       m_nCopyX            = 0;
+
+    ULONG                       m_nCopyY            = 0;
+
+    ULONG                       m_nCopyW            = 0;
+
+    ULONG                       m_nCopyH            = 0;
+
+    std::vector< Slot >         m_oSlot_S;
+
+    size_t                      m_nHead             = 0;
+
+    std::deque< Window >        m_queWindow;
+
+    std::vector< uint8_t >      m_vGBRP;
+
+    std::thread                 m_thWriter;
+
+    mutable std::mutex          m_mtx;
+
+    std::condition_variable     m_cvWrite;
+
+    std::deque< WriteItem >     m_queWrite;
+
+    BOOL                        m_bExit             = FALSE;
+
+    uint64_t                    m_nFramesStored     = 0;
+
+    uint64_t                    m_nFramesDropped    = 0;
+
+    uint64_t                    m_nFramesWritten    = 0;
+
+    uint64_t                    m_nTriggers         = 0;
+
+};
+
+#endif // CROPRING_H
@@ -0,0 +1,350 @@
+#include "cropwriter.h"
+#include "latencystats.h"
+#include "framecodec.h"
+
+#include <QDateTime>
+
+#include <memory>
+#include <cstdio>
+
+CropWriter::CropWriter( const CropStoreParam &store, ULONG nMaxDepth )
+    : m_stStore( store ), m_nMaxDepth( nMaxDepth )
+{
+
+    m_thWriter = std::thread( &CropWriter::Func_Writer_Loop, this );
+
+}
+
+CropWriter::~CropWriter()
+{
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtxQueue );
+
+        m_bExit = TRUE;
+    }
+
+    m_cvQueue.notify_all();
+
+    ////// The writer drains whatever is still queued before it exits
+
+    if( m_thWriter.joinable() == TRUE ) m_thWriter.join();
+
+}
+
+BOOL CropWriter::Push( qcap2_rcbuffer_t * pRCBuffer, qint64 nCaptureTimeMs, int64_t nOriginNs )
+{
+
+    if( pRCBuffer == nullptr ) return FALSE;
+
+    qcap2_av_frame_t * pAVFrame = ( qcap2_av_frame_t * )qcap2_rcbuffer_get_data( pRCBuffer );
+
+    ULONG nColorSpaceType = 0;
+
+    ULONG nBufferWidth = 0;
+
+    ULONG nBufferHeight = 0;
+
+    qcap2_av_frame_get_video_property( pAVFrame, &nColorSpaceType, &nBufferWidth, &nBufferHeight );
+
+    uint64_t nBytes = ( uint64_t )nBufferWidth * nBufferHeight * 3;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtxQueue );
+
+        if( m_bExit == TRUE || m_queWrite.size() >= m_nMaxDepth ) {
+
+            m_nFramesRejected++;
+
+            return FALSE;
+
+        }
+
+        qcap2_rcbuffer_add_ref( pRCBuffer );
+
+        m_queWrite.push_back( { pRCBuffer, nCaptureTimeMs, nOriginNs, Func_Latency_Now(), nBytes } );
+
+        m_nBytesInFlight += nBytes;
+    }
+
+    m_cvQueue.notify_one();
+
+    return TRUE;
+
+}
+
+CropWriterStats CropWriter::GetStats() const
+{
+
+    CropWriterStats stats;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtxQueue );
+
+        stats.st_nDepth = m_queWrite.size();
+    }
+
+    stats.st_nBytesInFlight = m_nBytesInFlight;
+
+    stats.st_nFramesWritten = m_nFramesWritten;
+
+    stats.st_nFramesRejected = m_nFramesRejected;
+
+    stats.st_nFramesFailed = m_nFramesFailed;
+
+    return stats;
+
+}
+
+BOOL CropWriter::Holds( qcap2_rcbuffer_t * pRCBuffer ) const
+{
+
+    std::lock_guard< std::mutex > lock( m_mtxQueue );
+
+    if( m_pWriting == pRCBuffer ) return TRUE;
+
+    for( const WriteItem &item : m_queWrite ) {
+
+        if( item.pRCBuffer == pRCBuffer ) return TRUE;
+
+    }
+
+    return FALSE;
+
+}
+
+void CropWriter::Func_Writer_Loop()
+{
+
+    while( TRUE ) {
+
+        WriteItem item;
+
+        {
+            std::unique_lock< std::mutex > lock( m_mtxQueue );
+
+            m_cvQueue.wait( lock, [ this ]() { return m_bExit == TRUE || m_queWrite.empty() == FALSE; } );
+
+            if( m_queWrite.empty() == TRUE ) break;
+
+            item = m_queWrite.front();
+
+            m_queWrite.pop_front();
+
+            m_pWriting = item.pRCBuffer;
+        }
+
+        if( m_stStore.st_pIoScheduler != nullptr ) m_stStore.st_pIoScheduler->QueueWait( IO_CLASS_CAPTURE, Func_Latency_Now() - item.nQueuedNs );
+
+        BOOL bWritten = Func_Frame_Write( item );
+
+        ////// A failed write is counted below, not timed as one that reached the disk
+
+        if( bWritten == TRUE ) LatencyStats::Instance().Record( LATENCY_STAGE_FILE_WRITE, item.nOriginNs );
+
+        {
+            std::lock_guard< std::mutex > lock( m_mtxQueue );
+
+            m_pWriting = nullptr;
+        }
+
+        qcap2_rcbuffer_release( item.pRCBuffer );
+
+        m_nBytesInFlight -= item.nBytes;
+
+        if( bWritten == TRUE ) m_nFramesWritten++;
+
+        else m_nFramesFailed++;
+
+    }
+
+}
+
+BOOL CropWriter::Func_Frame_Write( const WriteItem &item )
+{
+
+    std::shared_ptr< qcap2_av_frame_t > pAVFrame(
+                ( qcap2_av_frame_t * )qcap2_rcbuffer_lock_data( item.pRCBuffer ),
+                [ &item ]( qcap2_av_frame_t * ) {
+                    qcap2_rcbuffer_unlock_data( item.pRCBuffer );
+                });
+
+    uint8_t * pBuffer[ 4 ];
+
+    int nStride[ 4 ];
+
+    qcap2_av_frame_get_buffer1( pAVFrame.get(), pBuffer, nStride );
+
+    ULONG nColorSpaceType = 0;
+
+    ULONG nBufferWidth = 0;
+
+    ULONG nBufferHeight = 0;
+
+    qcap2_av_frame_get_video_property( pAVFrame.get(), &nColorSpaceType, &nBufferWidth, &nBufferHeight );
+
+    ColorPlanes planes;
+
+    for( int i = 0; i < 3; i++ ) {
+
+        planes.pData[ i ] = pBuffer[ i ];
+
+        planes.nStride[ i ] = nStride[ i ];
+
+    }
+
+    return Func_Crop_Write( m_stStore, planes, nBufferWidth, nBufferHeight, item.nCaptureTimeMs );
+
+}
+
+BOOL CropWriter::Func_Crop_Write( const CropStoreParam &store, const ColorPlanes &planes, ULONG nWidth, ULONG nHeight, qint64 nCaptureTimeMs )
+{
+
+    BOOL bCompress = store.st_bCompress;
+
+    IoScheduler * pIoScheduler = store.st_pIoScheduler;
+
+    ////// The segment store takes the capture I/O token around its own write, after coding
+
+    if( store.st_pStore != nullptr ) {
+
+        int64_t nFrame = store.st_pStore->Append( planes, 3, nWidth, nHeight, QCAP_COLORSPACE_TYPE_GBRP, nCaptureTimeMs, bCompress );
+
+        if( nFrame < 0 ) return FALSE;
+
+        printf( "[QCAP DEBUG] Try storage GBRP to: segment frame %lld\n", ( long long )nFrame );
+
+        return TRUE;
+
+    }
+
+    ////// RAW DATA //////
+
+    QString qszRecord_Path = store.st_qszOutputPath
+            + QDateTime::fromMSecsSinceEpoch( nCaptureTimeMs ).toString( Qt::ISODateWithMs )
+            + QString( "_GBRPScaler" )
+            + QString( "_W" ) + QString::number( nWidth )
+            + QString( "_H" ) + QString::number( nHeight )
+            + QString( ( bCompress == TRUE ) ? FRAME_CODEC_EXTENSION : ".raw" );
+
+    ////// Slices are coded on the codec pool, the coded buffer is reused per writer thread
+
+    static thread_local std::vector< uint8_t > vCoded;
+
+    uint64_t nBytes = ( uint64_t )nWidth * nHeight * 3;
+
+    if( bCompress == TRUE ) {
+
+        vCoded.clear();
+
+        FrameCodec_Encode( planes, 3, nWidth, nHeight, &vCoded );
+
+        nBytes = vCoded.size();
+
+    }
+
+    ////// The space is accounted for and allocated before the first byte goes out
+
+    DiskAccountant * pAccountant = store.st_pAccountant;
+
+    if( pAccountant != nullptr && pAccountant->Reserve( nBytes ) == FALSE ) {
+
+        printf( "[QCAP DEBUG] %s(%d): no disk space for %s\n", __FUNCTION__, __LINE__, qszRecord_Path.toUtf8().data() );
+
+        return FALSE;
+
+    }
+
+    if( pIoScheduler != nullptr ) pIoScheduler->Acquire( IO_CLASS_CAPTURE, nBytes );
+
+    FILE * pFp_Scaler = fopen( qszRecord_Path.toUtf8().data(), "wb" );
+
+    if( pFp_Scaler == NULL || DiskAccountant::Func_File_Preallocate( fileno( pFp_Scaler ), nBytes ) == FALSE ) {
+
+        printf( "[QCAP DEBUG] %s(%d): fopen( %s ) failed\n", __FUNCTION__, __LINE__, qszRecord_Path.toUtf8().data() );
+
+        if( pFp_Scaler != NULL ) {
+
+            fclose( pFp_Scaler );
+
+            remove( qszRecord_Path.toUtf8().data() );
+
+        }
+
+        if( pAccountant != nullptr ) pAccountant->Release( nBytes );
+
+        if( pIoScheduler != nullptr ) pIoScheduler->Complete( IO_CLASS_CAPTURE, 0 );
+
+        return FALSE;
+
+    }
+
+    BOOL bWritten = TRUE;
+
+    if( bCompress == TRUE ) {
+
+        bWritten = ( fwrite( vCoded.data(), 1, vCoded.size(), pFp_Scaler ) == vCoded.size() ) ? TRUE : FALSE;
+
+    } else {
+
+        for( UINT iPlane = 0; iPlane < 3 && bWritten == TRUE; iPlane++ ) {
+
+            ////// Packed planes go out in one call, padded planes row by row
+
+            if( ( ULONG )planes.nStride[ iPlane ] == nWidth ) {
+
+                size_t nPlaneBytes = ( size_t )nWidth * nHeight;
+
+                if( fwrite( planes.pData[ iPlane ], 1, nPlaneBytes, pFp_Scaler ) != nPlaneBytes ) bWritten = FALSE;
+
+            } else {
+
+                for( UINT iFrameHeight = 0 ; iFrameHeight < nHeight && bWritten == TRUE; iFrameHeight++ ) {
+
+                    if( fwrite( planes.pData[ iPlane ] + iFrameHeight * planes.nStride[ iPlane ], 1, nWidth, pFp_Scaler ) != nWidth ) bWritten = FALSE;
+
+                }
+
+            }
+
+        }
+
+    }
+
+    ////// fclose flushes the stdio buffer, a full disk often only shows up here
+
+    if( fclose( pFp_Scaler ) != 0 ) bWritten = FALSE;
+
+    if( bWritten == FALSE ) {
+
+        printf( "[QCAP DEBUG] %s(%d): short write to %s, file removed\n", __FUNCTION__, __LINE__, qszRecord_Path.toUtf8().data() );
+
+        remove( qszRecord_Path.toUtf8().data() );
+
+        if( pAccountant != nullptr ) pAccountant->Release( nBytes );
+
+        if( pIoScheduler != nullptr ) pIoScheduler->Complete( IO_CLASS_CAPTURE, 0 );
+
+        return FALSE;
+
+    }
+
+    if( pIoScheduler != nullptr ) pIoScheduler->Complete( IO_CLASS_CAPTURE, nBytes );
+
+    if( pAccountant != nullptr ) {
+
+        pAccountant->Release( nBytes );
+
+        pAccountant->Written( nBytes );
+
+    }
+
+    if( store.st_pRetention != nullptr ) store.st_pRetention->Add( qszRecord_Path, nCaptureTimeMs, nBytes );
+
+    printf( "[QCAP DEBUG] Try storage GBRP to: %s ( %lu bytes )\n", qszRecord_Path.toUtf8().data(), ( ULONG )nBytes );
+
+    ////// RAW DATA //////
+
+    return TRUE;
+
+}
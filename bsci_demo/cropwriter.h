@@ -0,0 +1,131 @@
+#ifndef CROPWRITER_H
+#define CROPWRITER_H
+
+#include <QString>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+
+#include <qcap.windef.h>
+#include <qcap2.h>
+
+#include "colorconvert.h"
+#include "segmentstore.h"
+#include "retentionindex.h"
+#include "diskaccountant.h"
+#include "ioscheduler.h"
+
+////// The crop scaler owns 4 output buffers, every queued frame pins one of them,
+////// so keep the queue shallow enough that the scaler never runs dry.
+
+#define CROP_WRITER_QUEUE_DEPTH 2
+
+////// Where stored crops go, shared by the crop writer and the pre-trigger ring
+
+struct CropStoreParam {
+
+    QString             st_qszOutputPath;
+
+    BOOL                st_bCompress        = FALSE;            // lossless .bscf ( framecodec.h ) instead of .raw
+
+    SegmentStore *      st_pStore           = nullptr;          // append to segments instead of one file per frame
+
+    RetentionIndex *    st_pRetention       = nullptr;          // told about every file written
+
+    DiskAccountant *    st_pAccountant      = nullptr;          // reserves space before every write
+
+    IoScheduler *       st_pIoScheduler     = nullptr;          // every write runs as capture I/O
+
+};
+
+struct CropWriterStats {
+
+    ULONG       st_nDepth               = 0;
+
+    uint64_t    st_nBytesInFlight       = 0;
+
+    uint64_t    st_nFramesWritten       = 0;
+
+    uint64_t    st_nFramesRejected      = 0;
+
+    uint64_t    st_nFramesFailed        = 0;            // open, write or close failed, nothing kept
+
+};
+
+class CropWriter
+{
+
+public:
+
+    explicit CropWriter( const CropStoreParam &store, ULONG nMaxDepth = CROP_WRITER_QUEUE_DEPTH );
+
+    ~CropWriter();
+
+    ////// Called from the crop completion handler, only takes a reference and returns.
+    ////// Returns FALSE ( and counts a rejected frame ) when the queue is full.
+
+    BOOL Push( qcap2_rcbuffer_t * pRCBuffer, qint64 nCaptureTimeMs, int64_t nOriginNs );
+
+    CropWriterStats GetStats() const;
+
+    ////// TRUE while pRCBuffer is queued or being written
+
+    BOOL Holds( qcap2_rcbuffer_t * pRCBuffer ) const;
+
+    ////// Writes G, B, R planes to <path><capture time>_GBRPScaler_W<w>_H<h>.raw ( or .bscf
+    ////// when compressed ), or appends them to the segment store
+
+    static BOOL Func_Crop_Write( const CropStoreParam &store, const ColorPlanes &planes, ULONG nWidth, ULONG nHeight, qint64 nCaptureTimeMs );
+
+private:
+
+    struct WriteItem {
+
+        qcap2_rcbuffer_t *  pRCBuffer;
+
+        qint64              nCaptureTimeMs;
+
+        int64_t             nOriginNs;
+
+        int64_t             nQueuedNs;
+
+        uint64_t            nBytes;
+
+    };
+
+    void Func_Writer_Loop();
+
+    BOOL Func_Frame_Write( const WriteItem &item );
+
+private:
+
+    CropStoreParam              m_stStore;
+
+    ULONG                       m_nMaxDepth;
+
+    std::thread                 m_thWriter;
+
+    mutable std::mutex          m_mtxQueue;
+
+    std::condition_variable     m_cvQueue;
+
+    std::deque< WriteItem >     m_queWrite;
+
+    qcap2_rcbuffer_t *          m_pWriting          = nullptr;
+
+    BOOL                        m_bExit             = FALSE;
+
+    std::atomic< uint64_t >     m_nBytesInFlight    { 0 };
+
+    std::atomic< uint64_t >     m_nFramesWritten    { 0 };
+
+    std::atomic< uint64_t >     m_nFramesRejected   { 0 };
+
+    std::atomic< uint64_t >     m_nFramesFailed     { 0 };
+
+};
+
+#endif // CROPWRITER_H
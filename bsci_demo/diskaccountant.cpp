@@ -0,0 +1,249 @@
+#include "diskaccountant.h"
+#include "latencystats.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/statvfs.h>
+
+#include <algorithm>
+
+DiskAccountant::DiskAccountant( const QString &qszPath )
+    : m_qszPath( qszPath )
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    Func_Sample( TRUE );
+
+    printf( "[QCAP DEBUG] Disk accountant: %s, %lu MB free of %lu MB\n"
+            , m_qszPath.toUtf8().data(), ( ULONG )( m_nBytesFree >> 20 ), ( ULONG )( m_nBytesTotal >> 20 ) );
+
+}
+
+void DiskAccountant::SetEvictHandler( const evict_func_t &pfnEvict )
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    m_pfnEvict = pfnEvict;
+
+}
+
+void DiskAccountant::Func_Sample( BOOL bForce )
+{
+
+    int64_t nNowNs = Func_Latency_Now();
+
+    if( bForce == FALSE && nNowNs - m_nSampleNs < ( int64_t )DISK_ACCOUNT_SAMPLE_MS * 1000000 ) return;
+
+    struct statvfs st = {};
+
+    if( statvfs( m_qszPath.toUtf8().data(), &st ) != 0 ) return;
+
+    m_nBytesTotal = ( uint64_t )st.f_blocks * st.f_frsize;
+
+    m_nBytesFree = ( uint64_t )st.f_bavail * st.f_frsize;
+
+    ////// Rate is smoothed over a few full sample periods so one burst does not flip overwrite
+    ////// mode; a forced early sample only refreshes the free space
+
+    int64_t nPeriodNs = nNowNs - m_nSampleNs;
+
+    if( m_nSampleNs == 0 || nPeriodNs >= ( int64_t )DISK_ACCOUNT_SAMPLE_MS * 1000000 ) {
+
+        if( m_nSampleNs > 0 ) m_dWriteRate = m_dWriteRate * 0.8 + m_nBytesWritten / ( nPeriodNs / 1e9 ) * 0.2;
+
+        m_nBytesWritten = 0;
+
+        m_nSampleNs = nNowNs;
+
+    }
+
+    ////// Overwrite on / off, and eviction for whatever is missing below the trigger
+
+    int64_t nAvail = Func_Headroom();
+
+    uint64_t nTrigger = Func_Trigger();
+
+    if( nAvail < ( int64_t )nTrigger ) {
+
+        if( m_bOverwrite == FALSE ) {
+
+            printf( "[QCAP DEBUG] Disk accountant: %lu MB free, %.0f MB/s, overwriting oldest data using FIFO mode\n"
+                    , ( ULONG )( std::max< int64_t >( nAvail, 0 ) >> 20 ), m_dWriteRate / 1e6 );
+
+        }
+
+        m_bOverwrite = TRUE;
+
+        uint64_t nDeficit = ( uint64_t )( ( int64_t )nTrigger - nAvail );
+
+        if( nDeficit > m_nDeficitRequested ) {
+
+            Func_Evict_Request( nDeficit - m_nDeficitRequested );
+
+            m_nDeficitRequested = nDeficit;
+
+        }
+
+    } else {
+
+        m_bOverwrite = FALSE;
+
+        m_nDeficitRequested = 0;
+
+    }
+
+}
+
+int64_t DiskAccountant::Func_Headroom() const
+{
+
+    return ( int64_t )m_nBytesFree - ( int64_t )m_nBytesReserved;
+
+}
+
+uint64_t DiskAccountant::Func_Trigger() const
+{
+
+    uint64_t nPercent = m_nBytesTotal / 100 * ( 100 - DISK_ACCOUNT_OVERWRITE_PERCENT );
+
+    uint64_t nLead = ( ( uint64_t )DISK_ACCOUNT_FLOOR_MB << 20 ) + ( uint64_t )( m_dWriteRate * DISK_ACCOUNT_LEAD_S );
+
+    return std::max( nPercent, nLead );
+
+}
+
+void DiskAccountant::Func_Evict_Request( uint64_t nBytes )
+{
+
+    if( !m_pfnEvict ) return;
+
+    m_pfnEvict( nBytes );
+
+    m_nEvictRequested += nBytes;
+
+}
+
+BOOL DiskAccountant::Reserve( uint64_t nBytes )
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    Func_Sample( FALSE );
+
+    int64_t nFloor = ( int64_t )DISK_ACCOUNT_FLOOR_MB << 20;
+
+    ////// A stale sample may not show what eviction has freed yet, look again before refusing
+
+    if( Func_Headroom() - ( int64_t )nBytes < nFloor ) Func_Sample( TRUE );
+
+    if( Func_Headroom() - ( int64_t )nBytes < nFloor ) {
+
+        m_nReserveRejected++;
+
+        Func_Evict_Request( nBytes );
+
+        return FALSE;
+
+    }
+
+    m_nBytesReserved += nBytes;
+
+    ////// FIFO: what goes in makes the oldest go out
+
+    if( m_bOverwrite == TRUE ) Func_Evict_Request( nBytes );
+
+    return TRUE;
+
+}
+
+void DiskAccountant::Release( uint64_t nBytes )
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    nBytes = std::min( nBytes, m_nBytesReserved );
+
+    m_nBytesReserved -= nBytes;
+
+    ////// The blocks are in use now, the sample will show it from the next statvfs() on
+
+    m_nBytesFree -= std::min( nBytes, m_nBytesFree );
+
+}
+
+void DiskAccountant::Written( uint64_t nBytes )
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    m_nBytesWritten += nBytes;
+
+}
+
+BOOL DiskAccountant::IsOverwrite()
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    Func_Sample( FALSE );
+
+    return m_bOverwrite;
+
+}
+
+DiskAccountStats DiskAccountant::GetStats()
+{
+
+    DiskAccountStats stats;
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    Func_Sample( FALSE );
+
+    int64_t nHeadroom = Func_Headroom() - ( ( int64_t )DISK_ACCOUNT_FLOOR_MB << 20 );
+
+    stats.st_nBytesTotal = m_nBytesTotal;
+
+    stats.st_nBytesFree = ( uint64_t )std::max< int64_t >( Func_Headroom(), 0 );
+
+    stats.st_nBytesReserved = m_nBytesReserved;
+
+    stats.st_dWriteRate = m_dWriteRate;
+
+    if( m_dWriteRate > 1.0 ) stats.st_dSecondsToFull = std::max< int64_t >( nHeadroom, 0 ) / m_dWriteRate;
+
+    stats.st_bOverwrite = m_bOverwrite;
+
+    stats.st_nReserveRejected = m_nReserveRejected;
+
+    stats.st_nBytesEvictRequested = m_nEvictRequested;
+
+    return stats;
+
+}
+
+BOOL DiskAccountant::Func_File_Preallocate( int nFd, uint64_t nBytes, BOOL * pbAllocated )
+{
+
+    if( pbAllocated != nullptr ) *pbAllocated = FALSE;
+
+    if( nBytes == 0 ) return TRUE;
+
+    if( fallocate( nFd, 0, 0, ( off_t )nBytes ) == 0 ) {
+
+        if( pbAllocated != nullptr ) *pbAllocated = TRUE;
+
+        return TRUE;
+
+    }
+
+    if( errno == ENOSPC || errno == EDQUOT ) return FALSE;
+
+    ////// EOPNOTSUPP and friends: the write allocates as it goes
+
+    return TRUE;
+
+}
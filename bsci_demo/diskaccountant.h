@@ -0,0 +1,132 @@
+#ifndef DISKACCOUNTANT_H
+#define DISKACCOUNTANT_H
+
+#include <QString>
+
+#include <stdint.h>
+
+#include <mutex>
+#include <functional>
+
+#include <qcap.windef.h>
+
+////// Overwrite starts below this much free space ( the old fixed 90% rule ) ...
+
+#define DISK_ACCOUNT_OVERWRITE_PERCENT 90
+
+////// ... or when the disk would be full within this many seconds at the measured write rate
+
+#define DISK_ACCOUNT_LEAD_S 30
+
+////// Never reserved, so metadata, logs and the OS keep room and no write meets ENOSPC
+
+#define DISK_ACCOUNT_FLOOR_MB 256
+
+////// statvfs() is sampled at most this often, reservations cover the writes in between
+
+#define DISK_ACCOUNT_SAMPLE_MS 250
+
+struct DiskAccountStats {
+
+    uint64_t    st_nBytesTotal          = 0;
+
+    uint64_t    st_nBytesFree           = 0;            // last sample, less reservations
+
+    uint64_t    st_nBytesReserved       = 0;
+
+    double      st_dWriteRate           = 0.0;          // bytes / s
+
+    double      st_dSecondsToFull       = -1.0;         // -1 while nothing is written
+
+    BOOL        st_bOverwrite           = FALSE;
+
+    uint64_t    st_nReserveRejected     = 0;
+
+    uint64_t    st_nBytesEvictRequested = 0;
+
+};
+
+////// Disk space seen by every writer in real time. A write reserves its size first, the
+////// reservation is dropped once the blocks are allocated ( fallocate ) or written, and the
+////// free space from the last statvfs() sample less open reservations is what the next
+////// writer can have. Writers also report the bytes they wrote, which gives the write rate
+////// and with it the time until the disk is full.
+//////
+////// Overwrite mode switches on early enough that eviction keeps up: below the fixed
+////// percentage or within DISK_ACCOUNT_LEAD_S of full. Then every reservation asks the
+////// evict handler for the same number of bytes, plus the shortfall below the trigger once.
+
+class DiskAccountant
+{
+
+public:
+
+    typedef std::function< void ( uint64_t nBytes ) > evict_func_t;
+
+    explicit DiskAccountant( const QString &qszPath );
+
+    void SetEvictHandler( const evict_func_t &pfnEvict );
+
+    ////// FALSE when the write would eat into the floor, the caller drops it instead of
+    ////// failing halfway with ENOSPC
+
+    BOOL Reserve( uint64_t nBytes );
+
+    void Release( uint64_t nBytes );
+
+    ////// Bytes that actually went to disk, for the write rate
+
+    void Written( uint64_t nBytes );
+
+    BOOL IsOverwrite();
+
+    DiskAccountStats GetStats();
+
+    ////// fallocate() the first nBytes of the file. FALSE only when the space is not there;
+    ////// file systems without fallocate() fall through with TRUE and *pbAllocated FALSE.
+
+    static BOOL Func_File_Preallocate( int nFd, uint64_t nBytes, BOOL * pbAllocated = nullptr );
+
+private:
+
+    ////// Caller holds m_mtx
+
+    void Func_Sample( BOOL bForce );
+
+    int64_t Func_Headroom() const;
+
+    uint64_t Func_Trigger() const;
+
+    void Func_Evict_Request( uint64_t nBytes );
+
+private:
+
+    QString                     m_qszPath;
+
+    std::mutex                  m_mtx;
+
+    evict_func_t                m_pfnEvict;
+
+    int64_t                     m_nSampleNs         = 0;
+
+    uint64_t                    m_nBytesTotal       = 0;
+
+    uint64_t                    m_nBytesFree        = 0;
+
+    uint64_t                    m_nBytesReserved    = 0;
+
+    uint64_t                    m_nBytesWritten     = 0;    // since the last sample
+
+    double                      m_dWriteRate        = 0.0;
+
+    BOOL                        m_bOverwrite        = FALSE;
+
+    uint64_t                    m_nDeficitRequested = 0;
+
+    uint64_t                    m_nReserveRejected  = 0;
+
+    uint64_t                    m_nEvictRequested   = 0;
+
+};
+
+#endif // DISKACCOUNTANT_H
@@ -0,0 +1,281 @@
+#include "framebus.h"
+
+#include <cstdio>
+
+FrameBus::FrameBus()
+{
+}
+
+FrameBus::~FrameBus()
+{
+
+    std::vector< std::shared_ptr< Subscriber > > pSubscriber_S;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtxSubscriber );
+
+        pSubscriber_S.swap( m_pSubscriber_S );
+    }
+
+    for( auto &pSub : pSubscriber_S ) Func_Subscriber_Stop( pSub.get() );
+
+}
+
+int FrameBus::Subscribe( const FrameBusParam &param, const consumer_func_t &pfnConsumer )
+{
+
+    std::shared_ptr< Subscriber > pSub = std::make_shared< Subscriber >();
+
+    pSub->stParam = param;
+
+    if( pSub->stParam.st_nQueueDepth == 0 ) pSub->stParam.st_nQueueDepth = 1;
+
+    pSub->pfnConsumer = pfnConsumer;
+
+    std::lock_guard< std::mutex > lock( m_mtxSubscriber );
+
+    pSub->nId = m_nNextId++;
+
+    pSub->thDeliver = std::thread( &FrameBus::Func_Deliver_Loop, this, pSub.get() );
+
+    m_pSubscriber_S.push_back( pSub );
+
+    printf( "[QCAP DEBUG] Frame bus: subscribe %s ( id %d, rate %2.3f, depth %lu, policy %d )\n"
+            , param.st_strName.c_str(), pSub->nId, param.st_dTargetRate, pSub->stParam.st_nQueueDepth, ( int )param.st_ePolicy );
+
+    return pSub->nId;
+
+}
+
+void FrameBus::Unsubscribe( int nId )
+{
+
+    std::shared_ptr< Subscriber > pSub;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtxSubscriber );
+
+        for( auto it = m_pSubscriber_S.begin(); it != m_pSubscriber_S.end(); ++it ) {
+
+            if( ( *it )->nId == nId ) {
+
+                pSub = *it;
+
+                m_pSubscriber_S.erase( it );
+
+                break;
+
+            }
+
+        }
+    }
+
+    if( pSub ) Func_Subscriber_Stop( pSub.get() );
+
+}
+
+void FrameBus::Func_Subscriber_Stop( Subscriber * pSub )
+{
+
+    {
+        std::lock_guard< std::mutex > lock( pSub->mtxQueue );
+
+        pSub->bExit = TRUE;
+    }
+
+    pSub->cvQueue.notify_all();
+
+    if( pSub->thDeliver.joinable() == TRUE ) pSub->thDeliver.join();
+
+    ////// A Publish that copied the subscriber list before it was removed may still be in
+    ////// Func_Enqueue, the queue is only touched under mtxQueue
+
+    std::deque< FrameBusPacket > queFrame;
+
+    {
+        std::lock_guard< std::mutex > lock( pSub->mtxQueue );
+
+        queFrame.swap( pSub->queFrame );
+    }
+
+    for( const FrameBusPacket &packet : queFrame ) qcap2_rcbuffer_release( packet.pRCBuffer );
+
+}
+
+BOOL FrameBus::Func_Rate_Accept( Subscriber * pSub, double dSampleTime )
+{
+
+    double dRate = pSub->stParam.st_dTargetRate;
+
+    if( dRate <= 0.0 ) return TRUE;
+
+    double dPeriod = 1.0 / dRate;
+
+    ////// Due times advance by whole periods, so 60 -> 25 fps decimation keeps the average
+    ////// rate exact. A gap longer than one period ( signal loss, stall ) re-anchors.
+
+    if( pSub->dNextDue < 0.0 || dSampleTime - pSub->dNextDue > dPeriod ) pSub->dNextDue = dSampleTime;
+
+    if( dSampleTime + dPeriod * 0.01 < pSub->dNextDue ) return FALSE;
+
+    pSub->dNextDue += dPeriod;
+
+    return TRUE;
+
+}
+
+void FrameBus::Func_Enqueue( Subscriber * pSub, const FrameBusPacket &packet )
+{
+
+    std::unique_lock< std::mutex > lock( pSub->mtxQueue );
+
+    ////// Stopping: nothing may be dropped or queued once Func_Subscriber_Stop took the queue
+
+    if( pSub->bExit == TRUE ) return;
+
+    if( pSub->queFrame.size() >= pSub->stParam.st_nQueueDepth ) {
+
+        switch( pSub->stParam.st_ePolicy ) {
+
+        case FRAME_DROP_NEWEST:
+
+            pSub->nDropped++;
+
+            return;
+
+        case FRAME_DROP_OLDEST:
+
+            qcap2_rcbuffer_release( pSub->queFrame.front().pRCBuffer );
+
+            pSub->queFrame.pop_front();
+
+            pSub->nDropped++;
+
+            break;
+
+        case FRAME_BLOCK:
+
+            pSub->cvQueue.wait( lock, [ pSub ]() { return pSub->bExit == TRUE || pSub->queFrame.size() < pSub->stParam.st_nQueueDepth; } );
+
+            if( pSub->bExit == TRUE ) return;
+
+            break;
+
+        }
+
+    }
+
+    if( pSub->bExit == TRUE ) return;
+
+    qcap2_rcbuffer_add_ref( packet.pRCBuffer );
+
+    pSub->queFrame.push_back( packet );
+
+    lock.unlock();
+
+    pSub->cvQueue.notify_all();
+
+}
+
+void FrameBus::Publish( qcap2_rcbuffer_t * pRCBuffer, double dSampleTime, int64_t nOriginNs )
+{
+
+    if( pRCBuffer == nullptr ) return;
+
+    std::vector< std::shared_ptr< Subscriber > > pSubscriber_S;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtxSubscriber );
+
+        pSubscriber_S = m_pSubscriber_S;
+    }
+
+    FrameBusPacket packet;
+
+    packet.pRCBuffer = pRCBuffer;
+
+    packet.dSampleTime = dSampleTime;
+
+    packet.nOriginNs = nOriginNs;
+
+    for( auto &pSub : pSubscriber_S ) {
+
+        if( Func_Rate_Accept( pSub.get(), dSampleTime ) == FALSE ) {
+
+            pSub->nSkipped++;
+
+            continue;
+
+        }
+
+        Func_Enqueue( pSub.get(), packet );
+
+    }
+
+}
+
+void FrameBus::Func_Deliver_Loop( Subscriber * pSub )
+{
+
+    while( TRUE ) {
+
+        FrameBusPacket packet;
+
+        {
+            std::unique_lock< std::mutex > lock( pSub->mtxQueue );
+
+            pSub->cvQueue.wait( lock, [ pSub ]() { return pSub->bExit == TRUE || pSub->queFrame.empty() == FALSE; } );
+
+            if( pSub->bExit == TRUE ) break;
+
+            packet = pSub->queFrame.front();
+
+            pSub->queFrame.pop_front();
+        }
+
+        ////// Wake a publisher blocked on a full FRAME_BLOCK queue
+
+        pSub->cvQueue.notify_all();
+
+        pSub->pfnConsumer( packet );
+
+        qcap2_rcbuffer_release( packet.pRCBuffer );
+
+        pSub->nDelivered++;
+
+    }
+
+}
+
+std::vector< FrameBusStats > FrameBus::GetStats() const
+{
+
+    std::vector< FrameBusStats > stats_S;
+
+    std::lock_guard< std::mutex > lock( m_mtxSubscriber );
+
+    for( const auto &pSub : m_pSubscriber_S ) {
+
+        FrameBusStats stats;
+
+        stats.st_strName = pSub->stParam.st_strName;
+
+        {
+            std::lock_guard< std::mutex > lockQueue( pSub->mtxQueue );
+
+            stats.st_nDepth = pSub->queFrame.size();
+        }
+
+        stats.st_nDelivered = pSub->nDelivered;
+
+        stats.st_nDropped = pSub->nDropped;
+
+        stats.st_nSkipped = pSub->nSkipped;
+
+        stats_S.push_back( stats );
+
+    }
+
+    return stats_S;
+
+}
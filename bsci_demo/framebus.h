@@ -0,0 +1,138 @@
+#ifndef FRAMEBUS_H
+#define FRAMEBUS_H
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+
+#include <qcap.windef.h>
+#include <qcap2.h>
+
+////// Distributes captured frames to independent consumers. Every consumer has its own
+////// queue, delivery thread, target rate and drop policy, so a slow consumer only ever
+////// drops its own frames. Frames are shared by reference count, never copied.
+
+enum FrameDropPolicy {
+
+    FRAME_DROP_OLDEST = 0,
+
+    FRAME_DROP_NEWEST,
+
+    FRAME_BLOCK
+
+};
+
+struct FrameBusParam {
+
+    std::string         st_strName;
+
+    double              st_dTargetRate      = 0.0;          // 0 = every frame
+
+    ULONG               st_nQueueDepth      = 2;
+
+    FrameDropPolicy     st_ePolicy          = FRAME_DROP_OLDEST;
+
+};
+
+struct FrameBusPacket {
+
+    qcap2_rcbuffer_t *  pRCBuffer           = nullptr;      // borrowed for the consumer call, add_ref to keep it
+
+    double              dSampleTime         = 0.0;
+
+    int64_t             nOriginNs           = 0;
+
+};
+
+struct FrameBusStats {
+
+    std::string         st_strName;
+
+    ULONG               st_nDepth           = 0;
+
+    uint64_t            st_nDelivered       = 0;
+
+    uint64_t            st_nDropped         = 0;
+
+    uint64_t            st_nSkipped         = 0;
+
+};
+
+class FrameBus
+{
+
+public:
+
+    typedef std::function< void ( const FrameBusPacket& ) > consumer_func_t;
+
+    FrameBus();
+
+    ~FrameBus();
+
+    ////// Returns the subscriber id, consumers run on their own thread.
+
+    int Subscribe( const FrameBusParam &param, const consumer_func_t &pfnConsumer );
+
+    void Unsubscribe( int nId );
+
+    ////// Called on the capture thread. Takes one reference per accepting consumer.
+
+    void Publish( qcap2_rcbuffer_t * pRCBuffer, double dSampleTime, int64_t nOriginNs );
+
+    std::vector< FrameBusStats > GetStats() const;
+
+private:
+
+    struct Subscriber {
+
+        int                             nId;
+
+        FrameBusParam                   stParam;
+
+        consumer_func_t                 pfnConsumer;
+
+        std::thread                     thDeliver;
+
+        std::mutex                      mtxQueue;
+
+        std::condition_variable         cvQueue;
+
+        std::deque< FrameBusPacket >    queFrame;
+
+        BOOL                            bExit           = FALSE;
+
+        double                          dNextDue        = -1.0;
+
+        std::atomic< uint64_t >         nDelivered      { 0 };
+
+        std::atomic< uint64_t >         nDropped        { 0 };
+
+        std::atomic< uint64_t >         nSkipped        { 0 };
+
+    };
+
+    void Func_Deliver_Loop( Subscriber * pSub );
+
+    void Func_Subscriber_Stop( Subscriber * pSub );
+
+    BOOL Func_Rate_Accept( Subscriber * pSub, double dSampleTime );
+
+    void Func_Enqueue( Subscriber * pSub, const FrameBusPacket &packet );
+
+private:
+
+    mutable std::mutex                              m_mtxSubscriber;
+
+    std::vector< std::shared_ptr< Subscriber > >    m_pSubscriber_S;
+
+    int                                             m_nNextId       = 1;
+
+};
+
+#endif // FRAMEBUS_H
@@ -0,0 +1,621 @@
+#include "framecodec.h"
+#include "workerpool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#define FRAME_CODEC_VERSION 1
+
+#define FRAME_CODEC_HEADER_BYTES 16
+
+////// Longest unary prefix before a residual is sent as 8 raw bits
+
+#define FRAME_CODEC_RICE_LIMIT 16
+
+////// Adaptive Rice state halves every this many samples, so k follows local texture
+
+#define FRAME_CODEC_RICE_RESET 64
+
+static WorkerPool & Func_Pool_Get()
+{
+
+    static WorkerPool oPool( FRAME_CODEC_THREAD_NUM );
+
+    return oPool;
+
+}
+
+static inline void Func_U16_Put( uint8_t * p, uint32_t v ) { p[ 0 ] = ( uint8_t )v; p[ 1 ] = ( uint8_t )( v >> 8 ); }
+
+static inline void Func_U32_Put( uint8_t * p, uint32_t v ) { for( int i = 0; i < 4; i++ ) p[ i ] = ( uint8_t )( v >> ( i * 8 ) ); }
+
+static inline uint32_t Func_U16_Get( const uint8_t * p ) { return p[ 0 ] | ( ( uint32_t )p[ 1 ] << 8 ); }
+
+static inline uint32_t Func_U32_Get( const uint8_t * p ) { return p[ 0 ] | ( ( uint32_t )p[ 1 ] << 8 ) | ( ( uint32_t )p[ 2 ] << 16 ) | ( ( uint32_t )p[ 3 ] << 24 ); }
+
+////// MSB first bit packing
+
+struct FrameCodecBitWriter {
+
+    std::vector< uint8_t > *    pOut;
+
+    uint64_t                    nAcc    = 0;
+
+    int                         nBits   = 0;
+
+    inline void Put( uint32_t v, int n )
+    {
+
+        nAcc = ( nAcc << n ) | v;
+
+        nBits += n;
+
+        while( nBits >= 8 ) {
+
+            nBits -= 8;
+
+            pOut->push_back( ( uint8_t )( nAcc >> nBits ) );
+
+        }
+
+    }
+
+    void Flush()
+    {
+
+        if( nBits > 0 ) pOut->push_back( ( uint8_t )( nAcc << ( 8 - nBits ) ) );
+
+        nBits = 0;
+
+    }
+
+};
+
+struct FrameCodecBitReader {
+
+    const uint8_t *             p;
+
+    const uint8_t *             pEnd;
+
+    uint64_t                    nAcc    = 0;
+
+    int                         nBits   = 0;
+
+    size_t                      nPad    = 0;
+
+    inline void Refill()
+    {
+
+        while( nBits <= 56 ) {
+
+            uint8_t c = 0;
+
+            if( p < pEnd ) c = *p++; else nPad++;
+
+            nAcc = ( nAcc << 8 ) | c;
+
+            nBits += 8;
+
+        }
+
+    }
+
+    inline uint32_t Get( int n )
+    {
+
+        Refill();
+
+        nBits -= n;
+
+        return ( uint32_t )( nAcc >> nBits ) & ( ( 1u << n ) - 1 );
+
+    }
+
+    ////// Number of leading zeros before the terminating one, FRAME_CODEC_RICE_LIMIT for an escape
+
+    inline int Unary()
+    {
+
+        Refill();
+
+        uint64_t nWindow = nAcc << ( 64 - nBits );
+
+        int nZeros = ( nWindow == 0 ) ? 64 : __builtin_clzll( nWindow );
+
+        if( nZeros >= FRAME_CODEC_RICE_LIMIT ) {
+
+            nBits -= FRAME_CODEC_RICE_LIMIT;
+
+            return FRAME_CODEC_RICE_LIMIT;
+
+        }
+
+        nBits -= nZeros + 1;
+
+        return nZeros;
+
+    }
+
+    ////// Read past the payload means the slice was truncated or corrupt
+
+    BOOL IsOverrun() const { return ( nPad * 8 > ( size_t )nBits ) ? TRUE : FALSE; }
+
+};
+
+struct FrameCodecRice {
+
+    uint32_t    nA  = 16;
+
+    uint32_t    nN  = 1;
+
+    inline int K() const
+    {
+
+        int k = 0;
+
+        while( ( nN << k ) < nA && k < 7 ) k++;
+
+        return k;
+
+    }
+
+    inline void Update( uint32_t u )
+    {
+
+        nA += u;
+
+        if( ++nN == FRAME_CODEC_RICE_RESET ) { nA >>= 1; nN >>= 1; }
+
+    }
+
+};
+
+////// LOCO-I median edge detector on left ( a ), above ( b ), above-left ( c ). Rows above
+////// the slice are not used, so each slice decodes on its own.
+
+static inline int Func_Predict( const uint8_t * pRow, const uint8_t * pAbove, int x )
+{
+
+    if( pAbove == nullptr ) return ( x == 0 ) ? 128 : pRow[ x - 1 ];
+
+    if( x == 0 ) return pAbove[ 0 ];
+
+    int a = pRow[ x - 1 ];
+
+    int b = pAbove[ x ];
+
+    int c = pAbove[ x - 1 ];
+
+    int nMax = a > b ? a : b;
+
+    int nMin = a > b ? b : a;
+
+    if( c >= nMax ) return nMin;
+
+    if( c <= nMin ) return nMax;
+
+    return a + b - c;
+
+}
+
+static void Func_Slice_Encode( const uint8_t * pPlane, int nStride, int nWidth, int y0, int y1, std::vector< uint8_t > * pOut )
+{
+
+    FrameCodecBitWriter writer;
+
+    writer.pOut = pOut;
+
+    pOut->reserve( ( size_t )nWidth * ( y1 - y0 ) );
+
+    FrameCodecRice rice;
+
+    for( int y = y0; y < y1; y++ ) {
+
+        const uint8_t * pRow = pPlane + ( size_t )y * nStride;
+
+        const uint8_t * pAbove = ( y > y0 ) ? pRow - nStride : nullptr;
+
+        for( int x = 0; x < nWidth; x++ ) {
+
+            int e = ( int8_t )( uint8_t )( pRow[ x ] - Func_Predict( pRow, pAbove, x ) );
+
+            uint32_t u = ( e >= 0 ) ? ( uint32_t )e * 2 : ( uint32_t )( -e ) * 2 - 1;
+
+            int k = rice.K();
+
+            uint32_t q = u >> k;
+
+            if( q < FRAME_CODEC_RICE_LIMIT ) {
+
+                writer.Put( 1, q + 1 );
+
+                if( k > 0 ) writer.Put( u & ( ( 1u << k ) - 1 ), k );
+
+            } else {
+
+                writer.Put( 0, FRAME_CODEC_RICE_LIMIT );
+
+                writer.Put( u, 8 );
+
+            }
+
+            rice.Update( u );
+
+        }
+
+    }
+
+    writer.Flush();
+
+}
+
+static BOOL Func_Slice_Decode( const uint8_t * pData, size_t nSize, uint8_t * pPlane, int nWidth, int y0, int y1 )
+{
+
+    FrameCodecBitReader reader;
+
+    reader.p = pData;
+
+    reader.pEnd = pData + nSize;
+
+    FrameCodecRice rice;
+
+    for( int y = y0; y < y1; y++ ) {
+
+        uint8_t * pRow = pPlane + ( size_t )y * nWidth;
+
+        const uint8_t * pAbove = ( y > y0 ) ? pRow - nWidth : nullptr;
+
+        for( int x = 0; x < nWidth; x++ ) {
+
+            int k = rice.K();
+
+            int q = reader.Unary();
+
+            uint32_t u = ( q < FRAME_CODEC_RICE_LIMIT ) ? ( ( ( uint32_t )q << k ) | ( k > 0 ? reader.Get( k ) : 0 ) ) : reader.Get( 8 );
+
+            if( u > 255 ) return FALSE;
+
+            int e = ( u & 1 ) ? -( int )( ( u + 1 ) >> 1 ) : ( int )( u >> 1 );
+
+            pRow[ x ] = ( uint8_t )( Func_Predict( pRow, pAbove, x ) + e );
+
+            rice.Update( u );
+
+        }
+
+        if( reader.IsOverrun() == TRUE ) return FALSE;
+
+    }
+
+    return TRUE;
+
+}
+
+void FrameCodec_Encode( const ColorPlanes &planes, int nPlanes, ULONG nWidth, ULONG nHeight, std::vector< uint8_t > * pOut )
+{
+
+    int nSlices = ( int )( ( nHeight + FRAME_CODEC_SLICE_ROWS - 1 ) / FRAME_CODEC_SLICE_ROWS );
+
+    int nTasks = nSlices * nPlanes;
+
+    ////// Slice buffers are kept per thread and reused, frames are the same size every time
+
+    static thread_local std::vector< std::vector< uint8_t > > vSlice_S;
+
+    if( ( int )vSlice_S.size() < nTasks ) vSlice_S.resize( nTasks );
+
+    std::vector< std::vector< uint8_t > > &vSlice = vSlice_S;
+
+    Func_Pool_Get().Run( nTasks, [ & ]( int i ) {
+
+        int nPlane = i / nSlices;
+
+        int y0 = ( i % nSlices ) * FRAME_CODEC_SLICE_ROWS;
+
+        int y1 = std::min( ( int )nHeight, y0 + FRAME_CODEC_SLICE_ROWS );
+
+        vSlice[ i ].clear();
+
+        Func_Slice_Encode( planes.pData[ nPlane ], planes.nStride[ nPlane ], ( int )nWidth, y0, y1, &vSlice[ i ] );
+
+    });
+
+    size_t nOffset = pOut->size();
+
+    size_t nTotal = FRAME_CODEC_HEADER_BYTES + ( size_t )nTasks * 4;
+
+    for( int i = 0; i < nTasks; i++ ) nTotal += vSlice[ i ].size();
+
+    pOut->resize( nOffset + nTotal );
+
+    uint8_t * p = pOut->data() + nOffset;
+
+    memcpy( p, "BSCF", 4 );
+
+    p[ 4 ] = FRAME_CODEC_VERSION;
+
+    p[ 5 ] = ( uint8_t )nPlanes;
+
+    Func_U16_Put( p + 6, FRAME_CODEC_SLICE_ROWS );
+
+    Func_U32_Put( p + 8, ( uint32_t )nWidth );
+
+    Func_U32_Put( p + 12, ( uint32_t )nHeight );
+
+    p += FRAME_CODEC_HEADER_BYTES;
+
+    for( int i = 0; i < nTasks; i++, p += 4 ) Func_U32_Put( p, ( uint32_t )vSlice[ i ].size() );
+
+    for( int i = 0; i < nTasks; i++ ) {
+
+        memcpy( p, vSlice[ i ].data(), vSlice[ i ].size() );
+
+        p += vSlice[ i ].size();
+
+    }
+
+}
+
+BOOL FrameCodec_Decode( const uint8_t * pData, size_t nSize, FrameCodecImage * pImage )
+{
+
+    if( nSize < FRAME_CODEC_HEADER_BYTES || memcmp( pData, "BSCF", 4 ) != 0 || pData[ 4 ] != FRAME_CODEC_VERSION ) return FALSE;
+
+    int nPlanes = pData[ 5 ];
+
+    uint32_t nSliceRows = Func_U16_Get( pData + 6 );
+
+    uint32_t nWidth = Func_U32_Get( pData + 8 );
+
+    uint32_t nHeight = Func_U32_Get( pData + 12 );
+
+    if( nPlanes < 1 || nPlanes > 3 || nSliceRows == 0 || nWidth == 0 || nHeight == 0 || nWidth > 16384 || nHeight > 16384 ) return FALSE;
+
+    int nSlices = ( int )( ( nHeight + nSliceRows - 1 ) / nSliceRows );
+
+    int nTasks = nSlices * nPlanes;
+
+    if( nSize < FRAME_CODEC_HEADER_BYTES + ( size_t )nTasks * 4 ) return FALSE;
+
+    std::vector< size_t > nOffset_S( nTasks );
+
+    size_t nOffset = FRAME_CODEC_HEADER_BYTES + ( size_t )nTasks * 4;
+
+    for( int i = 0; i < nTasks; i++ ) {
+
+        nOffset_S[ i ] = nOffset;
+
+        nOffset += Func_U32_Get( pData + FRAME_CODEC_HEADER_BYTES + i * 4 );
+
+    }
+
+    if( nOffset > nSize ) return FALSE;
+
+    pImage->nWidth = nWidth;
+
+    pImage->nHeight = nHeight;
+
+    pImage->nPlanes = nPlanes;
+
+    for( int i = 0; i < nPlanes; i++ ) pImage->vPlane[ i ].resize( ( size_t )nWidth * nHeight );
+
+    std::vector< uint8_t > bOk_S( nTasks, 0 );
+
+    Func_Pool_Get().Run( nTasks, [ & ]( int i ) {
+
+        int nPlane = i / nSlices;
+
+        int y0 = ( i % nSlices ) * ( int )nSliceRows;
+
+        int y1 = std::min( ( int )nHeight, y0 + ( int )nSliceRows );
+
+        size_t nSliceSize = Func_U32_Get( pData + FRAME_CODEC_HEADER_BYTES + i * 4 );
+
+        bOk_S[ i ] = Func_Slice_Decode( pData + nOffset_S[ i ], nSliceSize, pImage->vPlane[ nPlane ].data(), ( int )nWidth, y0, y1 ) == TRUE ? 1 : 0;
+
+    });
+
+    for( int i = 0; i < nTasks; i++ ) if( bOk_S[ i ] == 0 ) return FALSE;
+
+    return TRUE;
+
+}
+
+static BOOL Func_File_Read( const char * pszPath, std::vector< uint8_t > * pData )
+{
+
+    FILE * pFile = fopen( pszPath, "rb" );
+
+    if( pFile == NULL ) {
+
+        printf( "[QCAP DEBUG] %s(%d): fopen( %s ) failed\n", __FUNCTION__, __LINE__, pszPath );
+
+        return FALSE;
+
+    }
+
+    fseek( pFile, 0, SEEK_END );
+
+    long nSize = ftell( pFile );
+
+    fseek( pFile, 0, SEEK_SET );
+
+    pData->resize( nSize > 0 ? ( size_t )nSize : 0 );
+
+    size_t nRead = pData->empty() ? 0 : fread( pData->data(), 1, pData->size(), pFile );
+
+    fclose( pFile );
+
+    return ( nRead == pData->size() ) ? TRUE : FALSE;
+
+}
+
+BOOL FrameCodec_File_Decode( const char * pszInput, const char * pszOutput )
+{
+
+    std::vector< uint8_t > vData;
+
+    if( Func_File_Read( pszInput, &vData ) == FALSE ) return FALSE;
+
+    FrameCodecImage image;
+
+    if( FrameCodec_Decode( vData.data(), vData.size(), &image ) == FALSE ) {
+
+        printf( "[QCAP DEBUG] %s: not a valid %s stream\n", pszInput, FRAME_CODEC_EXTENSION );
+
+        return FALSE;
+
+    }
+
+    FILE * pFile = fopen( pszOutput, "wb" );
+
+    if( pFile == NULL ) {
+
+        printf( "[QCAP DEBUG] %s(%d): fopen( %s ) failed\n", __FUNCTION__, __LINE__, pszOutput );
+
+        return FALSE;
+
+    }
+
+    for( int i = 0; i < image.nPlanes; i++ ) fwrite( image.vPlane[ i ].data(), 1, image.vPlane[ i ].size(), pFile );
+
+    fclose( pFile );
+
+    printf( "[QCAP DEBUG] %s -> %s ( %lux%lu, %d planes )\n", pszInput, pszOutput, image.nWidth, image.nHeight, image.nPlanes );
+
+    return TRUE;
+
+}
+
+////// Smooth gradients, edges and sensor noise, roughly what an endoscope crop looks like
+
+static void Func_Synthetic_Fill( std::vector< uint8_t > * pPlane, ULONG nWidth, ULONG nHeight, int nSeed )
+{
+
+    srand( nSeed );
+
+    for( ULONG y = 0; y < nHeight; y++ ) {
+
+        for( ULONG x = 0; x < nWidth; x++ ) {
+
+            int v = ( int )( ( x * 3 + y * 2 ) / 16 + nSeed * 40 ) % 200;
+
+            if( ( ( x / 97 ) + ( y / 83 ) ) % 5 == 0 ) v += 40;
+
+            v += rand() % 5 - 2;
+
+            ( *pPlane )[ y * nWidth + x ] = ( uint8_t )( v < 0 ? 0 : ( v > 255 ? 255 : v ) );
+
+        }
+
+    }
+
+}
+
+BOOL FrameCodec_Benchmark( const char * pszRawFile, ULONG nWidth, ULONG nHeight, double dSeconds )
+{
+
+    FrameCodecImage source;
+
+    source.nWidth = nWidth;
+
+    source.nHeight = nHeight;
+
+    source.nPlanes = 3;
+
+    size_t nPlaneBytes = ( size_t )nWidth * nHeight;
+
+    if( pszRawFile != nullptr ) {
+
+        std::vector< uint8_t > vRaw;
+
+        if( Func_File_Read( pszRawFile, &vRaw ) == FALSE || vRaw.size() != nPlaneBytes * 3 ) {
+
+            printf( "[QCAP DEBUG] %s: expected %lu bytes of %lux%lu GBRP\n", pszRawFile, ( ULONG )( nPlaneBytes * 3 ), nWidth, nHeight );
+
+            return FALSE;
+
+        }
+
+        for( int i = 0; i < 3; i++ ) source.vPlane[ i ].assign( vRaw.begin() + nPlaneBytes * i, vRaw.begin() + nPlaneBytes * ( i + 1 ) );
+
+    } else {
+
+        for( int i = 0; i < 3; i++ ) {
+
+            source.vPlane[ i ].resize( nPlaneBytes );
+
+            Func_Synthetic_Fill( &source.vPlane[ i ], nWidth, nHeight, i + 1 );
+
+        }
+
+    }
+
+    ColorPlanes planes = {};
+
+    for( int i = 0; i < 3; i++ ) {
+
+        planes.pData[ i ] = source.vPlane[ i ].data();
+
+        planes.nStride[ i ] = ( int )nWidth;
+
+    }
+
+    std::vector< uint8_t > vCoded;
+
+    FrameCodecImage decoded;
+
+    uint64_t nEncoded = 0;
+
+    auto tStart = std::chrono::steady_clock::now();
+
+    double dEncode = 0.0;
+
+    do {
+
+        vCoded.clear();
+
+        FrameCodec_Encode( planes, 3, nWidth, nHeight, &vCoded );
+
+        nEncoded++;
+
+        dEncode = std::chrono::duration< double >( std::chrono::steady_clock::now() - tStart ).count();
+
+    } while( dEncode < dSeconds );
+
+    uint64_t nDecoded = 0;
+
+    BOOL bOk = TRUE;
+
+    tStart = std::chrono::steady_clock::now();
+
+    double dDecode = 0.0;
+
+    do {
+
+        bOk = FrameCodec_Decode( vCoded.data(), vCoded.size(), &decoded );
+
+        nDecoded++;
+
+        dDecode = std::chrono::duration< double >( std::chrono::steady_clock::now() - tStart ).count();
+
+    } while( bOk == TRUE && dDecode < dSeconds );
+
+    for( int i = 0; i < 3 && bOk == TRUE; i++ ) if( decoded.vPlane[ i ] != source.vPlane[ i ] ) bOk = FALSE;
+
+    double dRaw = ( double )nPlaneBytes * 3;
+
+    printf( "FrameCodec %lux%lu %s: %lu -> %lu bytes, ratio %.2f, encode %.1f MB/s, decode %.1f MB/s ( %d threads ), round trip %s\n"
+            , nWidth, nHeight, ( pszRawFile != nullptr ) ? pszRawFile : "synthetic"
+            , ( ULONG )dRaw, ( ULONG )vCoded.size(), dRaw / vCoded.size()
+            , dRaw * nEncoded / dEncode / 1e6, dRaw * nDecoded / dDecode / 1e6
+            , Func_Pool_Get().GetThreadCount(), ( bOk == TRUE ) ? "ok" : "FAILED" );
+
+    return bOk;
+
+}
@@ -0,0 +1,56 @@
+#ifndef FRAMECODEC_H
+#define FRAMECODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include <qcap.windef.h>
+
+#include "colorconvert.h"
+
+////// Lossless planar frame codec for stored crops ( .bscf ). Each plane is cut into
+////// FRAME_CODEC_SLICE_ROWS row slices that are coded independently, so encode and decode
+////// run across the codec worker pool and a damaged slice stays local.
+//////
+////// Slice coding: LOCO-I median predictor, zigzag residual, adaptive Rice code.
+////// Layout ( little endian ): "BSCF", u8 version, u8 planes, u16 slice rows, u32 width,
+////// u32 height, u32 size of every slice ( plane major ), slice payloads.
+
+#define FRAME_CODEC_SLICE_ROWS 64
+
+#define FRAME_CODEC_THREAD_NUM 4
+
+#define FRAME_CODEC_EXTENSION ".bscf"
+
+struct FrameCodecImage {
+
+    ULONG                   nWidth      = 0;
+
+    ULONG                   nHeight     = 0;
+
+    int                     nPlanes     = 0;
+
+    std::vector< uint8_t >  vPlane[ 3 ];        // packed, stride == nWidth
+
+};
+
+////// Appends the coded frame to *pOut
+
+void FrameCodec_Encode( const ColorPlanes &planes, int nPlanes, ULONG nWidth, ULONG nHeight, std::vector< uint8_t > * pOut );
+
+////// FALSE on a malformed or truncated stream
+
+BOOL FrameCodec_Decode( const uint8_t * pData, size_t nSize, FrameCodecImage * pImage );
+
+////// Offline tooling: .bscf -> .raw ( planes back to back, as CropWriter writes them )
+
+BOOL FrameCodec_File_Decode( const char * pszInput, const char * pszOutput );
+
+////// Compression ratio and encode / decode MB/s with a round-trip check. Uses the given
+////// GBRP .raw crop, or a synthetic frame of nWidth x nHeight when pszRawFile is nullptr.
+
+BOOL FrameCodec_Benchmark( const char * pszRawFile, ULONG nWidth, ULONG nHeight, double dSeconds );
+
+#endif // FRAMECODEC_H
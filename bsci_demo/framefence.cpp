@@ -0,0 +1,388 @@
+#include "framefence.h"
+#include "latencystats.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+////// Benchmark load: a live stream busy most of each 60 fps frame, inference at 30 fps
+
+#define FENCE_BENCH_LIVE_PERIOD_US 16667
+
+#define FENCE_BENCH_LIVE_WORK_US 11000
+
+#define FENCE_BENCH_INFER_PERIOD_US 33333
+
+#define FENCE_BENCH_INFER_WORK_US 4000
+
+CudaFence::CudaFence( cudaStream_t stream )
+    : m_stream( stream )
+{
+
+    ////// Blocking sync: the waiting handler thread sleeps instead of spinning
+
+    cudaError_t err = cudaEventCreateWithFlags( &m_event, cudaEventDisableTiming | cudaEventBlockingSync );
+
+    if( err != cudaSuccess ) {
+
+        printf( "[QCAP DEBUG] %s(%d): cudaEventCreateWithFlags() failed, err=%d\n", __FUNCTION__, __LINE__, err );
+
+        m_event = nullptr;
+
+    }
+
+}
+
+CudaFence::~CudaFence()
+{
+
+    if( m_event != nullptr ) cudaEventDestroy( m_event );
+
+}
+
+BOOL CudaFence::Record()
+{
+
+    if( m_event == nullptr ) return FALSE;
+
+    m_bRecorded = ( cudaEventRecord( m_event, m_stream ) == cudaSuccess ) ? TRUE : FALSE;
+
+    return m_bRecorded;
+
+}
+
+BOOL CudaFence::Query()
+{
+
+    if( m_bRecorded == FALSE ) return FALSE;
+
+    return ( cudaEventQuery( m_event ) == cudaSuccess ) ? TRUE : FALSE;
+
+}
+
+BOOL CudaFence::Wait( int64_t nTimeoutNs )
+{
+
+    if( m_bRecorded == FALSE ) return FALSE;
+
+    if( nTimeoutNs < 0 ) return ( cudaEventSynchronize( m_event ) == cudaSuccess ) ? TRUE : FALSE;
+
+    int64_t nDeadlineNs = Func_Latency_Now() + nTimeoutNs;
+
+    while( TRUE ) {
+
+        cudaError_t err = cudaEventQuery( m_event );
+
+        if( err == cudaSuccess ) return TRUE;
+
+        if( err != cudaErrorNotReady || Func_Latency_Now() >= nDeadlineNs ) return FALSE;
+
+        std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+
+    }
+
+}
+
+CpuFenceStream::CpuFenceStream()
+{
+
+    m_thRun = std::thread( &CpuFenceStream::Func_Run_Loop, this );
+
+}
+
+CpuFenceStream::~CpuFenceStream()
+{
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_bExit = TRUE;
+    }
+
+    m_cvWork.notify_all();
+
+    if( m_thRun.joinable() == TRUE ) m_thRun.join();
+
+}
+
+uint64_t CpuFenceStream::Submit( const std::function< void() > &pfnWork )
+{
+
+    uint64_t nSequence;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_queWork.push_back( pfnWork );
+
+        nSequence = ++m_nSubmitted;
+    }
+
+    m_cvWork.notify_one();
+
+    return nSequence;
+
+}
+
+uint64_t CpuFenceStream::GetSubmitted() const
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    return m_nSubmitted;
+
+}
+
+uint64_t CpuFenceStream::GetCompleted() const
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    return m_nCompleted;
+
+}
+
+BOOL CpuFenceStream::Wait( uint64_t nSequence, int64_t nTimeoutNs )
+{
+
+    std::unique_lock< std::mutex > lock( m_mtx );
+
+    auto pfnDone = [ this, nSequence ]() { return m_nCompleted >= nSequence; };
+
+    if( nTimeoutNs < 0 ) {
+
+        m_cvDone.wait( lock, pfnDone );
+
+        return TRUE;
+
+    }
+
+    return ( m_cvDone.wait_for( lock, std::chrono::nanoseconds( nTimeoutNs ), pfnDone ) == true ) ? TRUE : FALSE;
+
+}
+
+void CpuFenceStream::Func_Run_Loop()
+{
+
+    while( TRUE ) {
+
+        std::function< void() > pfnWork;
+
+        {
+            std::unique_lock< std::mutex > lock( m_mtx );
+
+            m_cvWork.wait( lock, [ this ]() { return m_bExit == TRUE || m_queWork.empty() == FALSE; } );
+
+            if( m_queWork.empty() == TRUE ) return;
+
+            pfnWork = m_queWork.front();
+
+            m_queWork.pop_front();
+        }
+
+        if( pfnWork ) pfnWork();
+
+        {
+            std::lock_guard< std::mutex > lock( m_mtx );
+
+            m_nCompleted++;
+        }
+
+        m_cvDone.notify_all();
+
+    }
+
+}
+
+BOOL CpuFence::Record()
+{
+
+    m_nSequence = m_pStream->GetSubmitted();
+
+    return TRUE;
+
+}
+
+BOOL CpuFence::Query()
+{
+
+    return ( m_pStream->GetCompleted() >= m_nSequence ) ? TRUE : FALSE;
+
+}
+
+BOOL CpuFence::Wait( int64_t nTimeoutNs )
+{
+
+    return m_pStream->Wait( m_nSequence, nTimeoutNs );
+
+}
+
+BOOL FrameFence_SelfTest()
+{
+
+    BOOL bPass = TRUE;
+
+    auto pfnCheck = [ &bPass ]( BOOL bOk, const char * pszWhat ) {
+
+        if( bOk == FALSE ) {
+
+            printf( "FrameFence self-test: %s\n", pszWhat );
+
+            bPass = FALSE;
+
+        }
+
+    };
+
+    CpuFenceStream streamA, streamB;
+
+    std::atomic< int > nStepA( 0 );
+
+    std::mutex mtxGate;
+
+    mtxGate.lock();
+
+    ////// B is held up by the gate; a fence on A must not care
+
+    streamB.Submit( [ &mtxGate ]() { mtxGate.lock(); mtxGate.unlock(); } );
+
+    streamA.Submit( [ &nStepA ]() { std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) ); nStepA = 1; } );
+
+    CpuFence fenceA( &streamA ), fenceB( &streamB );
+
+    fenceA.Record();
+
+    fenceB.Record();
+
+    ////// Work queued after the record is not covered
+
+    streamA.Submit( [ &nStepA ]() { std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) ); nStepA = 2; } );
+
+    pfnCheck( fenceA.Query() == FALSE, "fence signalled before its work ran" );
+
+    pfnCheck( fenceA.Wait( 2000000000LL ) == TRUE, "fence on a free stream timed out" );
+
+    pfnCheck( nStepA.load() == 1, "fence waited for too little or too much" );
+
+    pfnCheck( fenceB.Query() == FALSE && fenceB.Wait( 10000000LL ) == FALSE, "fence on a blocked stream signalled" );
+
+    mtxGate.unlock();
+
+    pfnCheck( fenceB.Wait( 2000000000LL ) == TRUE, "fence missed its work" );
+
+    ////// A fresh record covers everything queued so far, in order
+
+    CpuFence fenceA2( &streamA );
+
+    fenceA2.Record();
+
+    pfnCheck( fenceA2.Wait( 2000000000LL ) == TRUE && nStepA.load() == 2, "later fence out of order" );
+
+    ////// Recorded on an idle stream: already signalled
+
+    CpuFenceStream streamIdle;
+
+    CpuFence fenceIdle( &streamIdle );
+
+    fenceIdle.Record();
+
+    pfnCheck( fenceIdle.Query() == TRUE, "fence on an idle stream not signalled" );
+
+    printf( "FrameFence self-test %s\n", ( bPass == TRUE ) ? "passed" : "FAILED" );
+
+    return bPass;
+
+}
+
+static void Func_Bench_Run( BOOL bDeviceWait, double dSeconds, std::vector< double > * pLatency_S )
+{
+
+    CpuFenceStream streamLive, streamInfer;
+
+    std::atomic< BOOL > bStop( FALSE );
+
+    std::thread thLive( [ & ]() {
+
+        auto tNext = std::chrono::steady_clock::now();
+
+        while( bStop.load() == FALSE ) {
+
+            streamLive.Submit( []() { std::this_thread::sleep_for( std::chrono::microseconds( FENCE_BENCH_LIVE_WORK_US ) ); } );
+
+            tNext += std::chrono::microseconds( FENCE_BENCH_LIVE_PERIOD_US );
+
+            std::this_thread::sleep_until( tNext );
+
+        }
+
+    } );
+
+    ////// The inference handler: queue the scale, then wait before touching the frame
+
+    CpuFence fenceLive( &streamLive ), fenceInfer( &streamInfer );
+
+    auto tStart = std::chrono::steady_clock::now(), tNext = tStart;
+
+    while( std::chrono::duration< double >( std::chrono::steady_clock::now() - tStart ).count() < dSeconds ) {
+
+        int64_t nQueuedNs = Func_Latency_Now();
+
+        streamInfer.Submit( []() { std::this_thread::sleep_for( std::chrono::microseconds( FENCE_BENCH_INFER_WORK_US ) ); } );
+
+        fenceInfer.Record();
+
+        if( bDeviceWait == TRUE ) {
+
+            fenceLive.Record();
+
+            fenceLive.Wait();
+
+        }
+
+        fenceInfer.Wait();
+
+        pLatency_S->push_back( ( Func_Latency_Now() - nQueuedNs ) / 1e6 );
+
+        tNext += std::chrono::microseconds( FENCE_BENCH_INFER_PERIOD_US );
+
+        std::this_thread::sleep_until( tNext );
+
+    }
+
+    bStop = TRUE;
+
+    thLive.join();
+
+}
+
+void FrameFence_Benchmark( double dSecondsPerCase )
+{
+
+    printf( "FrameFence benchmark, CPU stand-in streams: live %d us every %d us, inference %d us every %d us\n"
+            , FENCE_BENCH_LIVE_WORK_US, FENCE_BENCH_LIVE_PERIOD_US, FENCE_BENCH_INFER_WORK_US, FENCE_BENCH_INFER_PERIOD_US );
+
+    printf( "%-8s %8s %10s %10s %10s\n", "wait", "frames", "avg ms", "p99 ms", "max ms" );
+
+    for( int n = 0; n < 2; n++ ) {
+
+        std::vector< double > dLatency_S;
+
+        Func_Bench_Run( ( n == 0 ) ? TRUE : FALSE, dSecondsPerCase, &dLatency_S );
+
+        if( dLatency_S.empty() == TRUE ) continue;
+
+        std::sort( dLatency_S.begin(), dLatency_S.end() );
+
+        double dSum = 0.0;
+
+        for( double d : dLatency_S ) dSum += d;
+
+        printf( "%-8s %8lu %10.2f %10.2f %10.2f\n", ( n == 0 ) ? "device" : "fence", ( ULONG )dLatency_S.size(), dSum / dLatency_S.size()
+                , dLatency_S[ std::min( dLatency_S.size() - 1, dLatency_S.size() * 99 / 100 ) ], dLatency_S.back() );
+
+    }
+
+}
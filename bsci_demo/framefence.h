@@ -0,0 +1,146 @@
+#ifndef FRAMEFENCE_H
+#define FRAMEFENCE_H
+
+#include <stdint.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+
+#include <qcap.windef.h>
+
+#include <cuda_runtime_api.h>
+
+////// Completion of the GPU work queued on one stream, instead of a device wide synchronize.
+////// Record() marks what has been queued on the fence's stream so far, Wait() returns
+////// once that has run; work queued later is not waited for. Other streams are left out
+////// only as far as the stream semantics allow: see CudaFence.
+
+class FrameFence
+{
+
+public:
+
+    virtual ~FrameFence() {}
+
+    virtual BOOL Record() = 0;
+
+    ////// TRUE once the recorded work has completed
+
+    virtual BOOL Query() = 0;
+
+    ////// nTimeoutNs < 0 waits as long as it takes; FALSE on timeout or error
+
+    virtual BOOL Wait( int64_t nTimeoutNs = -1 ) = 0;
+
+};
+
+////// CUDA event on a stream. nullptr is the legacy default stream, which synchronises with
+////// every blocking stream, so its fence also covers their work and only non-blocking
+////// streams are excluded.
+
+class CudaFence : public FrameFence
+{
+
+public:
+
+    explicit CudaFence( cudaStream_t stream = nullptr );
+
+    ~CudaFence();
+
+    BOOL Record() override;
+
+    BOOL Query() override;
+
+    BOOL Wait( int64_t nTimeoutNs = -1 ) override;
+
+private:
+
+    cudaStream_t        m_stream;
+
+    cudaEvent_t         m_event         = nullptr;
+
+    BOOL                m_bRecorded     = FALSE;
+
+};
+
+////// CPU stand-in for a GPU stream: submitted work runs in order on one thread. Lets the
+////// fence ordering be tested, and the latency benchmarked, without a GPU.
+
+class CpuFenceStream
+{
+
+public:
+
+    CpuFenceStream();
+
+    ~CpuFenceStream();
+
+    ////// Returns the sequence number of the work, counting from 1
+
+    uint64_t Submit( const std::function< void() > &pfnWork );
+
+    uint64_t GetSubmitted() const;
+
+    uint64_t GetCompleted() const;
+
+    BOOL Wait( uint64_t nSequence, int64_t nTimeoutNs );
+
+private:
+
+    void Func_Run_Loop();
+
+private:
+
+    std::thread                                 m_thRun;
+
+    mutable std::mutex                          m_mtx;
+
+    std::condition_variable                     m_cvWork;
+
+    std::condition_variable                     m_cvDone;
+
+    std::deque< std::function< void() > >       m_queWork;
+
+    uint64_t                                    m_nSubmitted    = 0;
+
+    uint64_t                                    m_nCompleted    = 0;
+
+    BOOL                                        m_bExit         = FALSE;
+
+};
+
+class CpuFence : public FrameFence
+{
+
+public:
+
+    explicit CpuFence( CpuFenceStream * pStream ) : m_pStream( pStream ) {}
+
+    BOOL Record() override;
+
+    BOOL Query() override;
+
+    BOOL Wait( int64_t nTimeoutNs = -1 ) override;
+
+private:
+
+    CpuFenceStream *    m_pStream;
+
+    uint64_t            m_nSequence     = 0;
+
+};
+
+////// Ordering checks on the CPU stand-in; FALSE if a fence signals early or waits on
+////// another stream
+
+BOOL FrameFence_SelfTest();
+
+////// Inference frame latency ( queued to observed done ) next to a busy live stream, with
+////// a device wide wait against a fence on the inference stream, CPU stand-in streams
+
+void FrameFence_Benchmark( double dSecondsPerCase );
+
+#endif // FRAMEFENCE_H
@@ -0,0 +1,519 @@
+#include "framepool.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <set>
+
+#include <cuda_runtime_api.h>
+
+bool FramePoolKey::operator<( const FramePoolKey &other ) const
+{
+
+    if( st_nColorSpaceType != other.st_nColorSpaceType ) return st_nColorSpaceType < other.st_nColorSpaceType;
+
+    if( st_nWidth != other.st_nWidth ) return st_nWidth < other.st_nWidth;
+
+    if( st_nHeight != other.st_nHeight ) return st_nHeight < other.st_nHeight;
+
+    return st_eMemory < other.st_eMemory;
+
+}
+
+FramePool& FramePool::Instance()
+{
+
+    static FramePool s_oPool( FRAME_POOL_PINNED_CAP, Func_Cuda_Device() );
+
+    return s_oPool;
+
+}
+
+BOOL FramePool::Func_Cuda_Device()
+{
+
+    int nDevices = 0;
+
+    return ( cudaGetDeviceCount( &nDevices ) == cudaSuccess && nDevices > 0 ) ? TRUE : FALSE;
+
+}
+
+FramePool::FramePool( uint64_t nPinnedCap, BOOL bCuda )
+    : m_bCuda( bCuda ), m_nPinnedCap( nPinnedCap )
+{
+}
+
+FramePool::~FramePool()
+{
+
+    Trim();
+
+    ULONG nInUse = 0;
+
+    for( const auto &item : m_mapClass ) nInUse += item.second.nInUse;
+
+    if( nInUse > 0 ) printf( "[QCAP DEBUG] %s(%d): %lu frames still in use\n", __FUNCTION__, __LINE__, nInUse );
+
+}
+
+uint64_t FramePool::Func_Frame_Bytes( ULONG nColorSpaceType, ULONG nWidth, ULONG nHeight )
+{
+
+    uint64_t nPixels = ( uint64_t )nWidth * nHeight;
+
+    switch( nColorSpaceType ) {
+
+    case QCAP_COLORSPACE_TYPE_I420:
+
+    case QCAP_COLORSPACE_TYPE_NV12: return nPixels * 3 / 2;
+
+    case QCAP_COLORSPACE_TYPE_GBRP: return nPixels * 3;
+
+    default: return nPixels * 4;
+
+    }
+
+}
+
+BOOL FramePool::Func_Pinned( const FramePoolKey &key ) const
+{
+
+    return ( key.st_eMemory == FRAME_POOL_MEMORY_CUDA_HOST ) ? TRUE : FALSE;
+
+}
+
+qcap2_rcbuffer_t * FramePool::Func_Buffer_Alloc( const FramePoolKey &key )
+{
+
+    qcap2_rcbuffer_t * pRCBuffer = qcap2_rcbuffer_new_av_frame();
+
+    if( pRCBuffer == nullptr ) return nullptr;
+
+    qcap2_av_frame_t * pAVFrame = ( qcap2_av_frame_t * )qcap2_rcbuffer_get_data( pRCBuffer );
+
+    qcap2_av_frame_set_video_property( pAVFrame, key.st_nColorSpaceType, key.st_nWidth, key.st_nHeight );
+
+    bool bAllocated;
+
+    if( Func_Pinned( key ) == TRUE && m_bCuda == TRUE ) bAllocated = qcap2_av_frame_alloc_cuda_host_buffer( pAVFrame, cudaHostAllocMapped, 32, 1 );
+
+    else bAllocated = qcap2_av_frame_alloc_buffer( pAVFrame, 32, 1 );
+
+    if( bAllocated == false ) {
+
+        printf( "[QCAP DEBUG] %s(%d): frame allocation failed, %lux%lu\n", __FUNCTION__, __LINE__, key.st_nWidth, key.st_nHeight );
+
+        qcap2_rcbuffer_delete( pRCBuffer );
+
+        return nullptr;
+
+    }
+
+    SizeClass &sizeClass = m_mapClass[ key ];
+
+    sizeClass.nAllocated++;
+
+    if( Func_Pinned( key ) == TRUE ) {
+
+        m_nPinnedBytes += sizeClass.nFrameBytes;
+
+        m_nPinnedHighWater = std::max( m_nPinnedHighWater, m_nPinnedBytes );
+
+    } else {
+
+        m_nSystemBytes += sizeClass.nFrameBytes;
+
+    }
+
+    m_mapOwner[ pRCBuffer ].stKey = key;
+
+    return pRCBuffer;
+
+}
+
+void FramePool::Func_Buffer_Free( qcap2_rcbuffer_t * pRCBuffer, const FramePoolKey &key )
+{
+
+    qcap2_av_frame_t * pAVFrame = ( qcap2_av_frame_t * )qcap2_rcbuffer_get_data( pRCBuffer );
+
+    if( Func_Pinned( key ) == TRUE && m_bCuda == TRUE ) qcap2_av_frame_free_cuda_host_buffer( pAVFrame );
+
+    else qcap2_av_frame_free_buffer( pAVFrame );
+
+    qcap2_rcbuffer_delete( pRCBuffer );
+
+    SizeClass &sizeClass = m_mapClass[ key ];
+
+    sizeClass.nAllocated--;
+
+    if( Func_Pinned( key ) == TRUE ) m_nPinnedBytes -= sizeClass.nFrameBytes;
+
+    else m_nSystemBytes -= sizeClass.nFrameBytes;
+
+    m_mapOwner.erase( pRCBuffer );
+
+}
+
+uint64_t FramePool::Func_Trim_Pinned( const FramePoolKey * pKeep, uint64_t nBytes )
+{
+
+    auto pfnSkip = [ this, pKeep ]( const FramePoolKey &key ) {
+
+        return Func_Pinned( key ) == FALSE || ( pKeep != nullptr && ( key < *pKeep || *pKeep < key ) == false );
+
+    };
+
+    uint64_t nIdleBytes = 0;
+
+    for( const auto &item : m_mapClass ) {
+
+        if( pfnSkip( item.first ) == false ) nIdleBytes += item.second.pIdle_S.size() * item.second.nFrameBytes;
+
+    }
+
+    if( nIdleBytes < nBytes ) return 0;
+
+    uint64_t nFreed = 0;
+
+    for( auto &item : m_mapClass ) {
+
+        if( pfnSkip( item.first ) ) continue;
+
+        while( nFreed < nBytes && item.second.pIdle_S.empty() == false ) {
+
+            qcap2_rcbuffer_t * pRCBuffer = item.second.pIdle_S.back();
+
+            item.second.pIdle_S.pop_back();
+
+            Func_Buffer_Free( pRCBuffer, item.first );
+
+            nFreed += item.second.nFrameBytes;
+
+        }
+
+        if( nFreed >= nBytes ) break;
+
+    }
+
+    m_nTrimmedBytes += nFreed;
+
+    return nFreed;
+
+}
+
+QRESULT FramePool::Acquire( ULONG nColorSpaceType, ULONG nWidth, ULONG nHeight, FramePoolMemory eMemory, int nCount, qcap2_rcbuffer_t ** ppRCBuffers )
+{
+
+    if( nCount <= 0 || ppRCBuffers == nullptr ) return QCAP_RS_ERROR_GENERAL;
+
+    FramePoolKey key = { nColorSpaceType, nWidth, nHeight, eMemory };
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    SizeClass &sizeClass = m_mapClass[ key ];
+
+    sizeClass.nFrameBytes = Func_Frame_Bytes( nColorSpaceType, nWidth, nHeight );
+
+    int nRecycle = std::min( nCount, ( int )sizeClass.pIdle_S.size() );
+
+    uint64_t nNewBytes = ( uint64_t )( nCount - nRecycle ) * sizeClass.nFrameBytes;
+
+    ////// Idle frames of other shapes make room first, a set that still does not fit is refused
+
+    if( Func_Pinned( key ) == TRUE && m_nPinnedBytes + nNewBytes > m_nPinnedCap ) {
+
+        Func_Trim_Pinned( &key, m_nPinnedBytes + nNewBytes - m_nPinnedCap );
+
+        if( m_nPinnedBytes + nNewBytes > m_nPinnedCap ) {
+
+            m_nRefused++;
+
+            printf( "[QCAP DEBUG] %s(%d): %d frames of %lux%lu over the pinned cap, %lu of %lu bytes held\n", __FUNCTION__, __LINE__
+                    , nCount, nWidth, nHeight, ( ULONG )m_nPinnedBytes, ( ULONG )m_nPinnedCap );
+
+            return QCAP_RS_ERROR_OUT_OF_MEMORY;
+
+        }
+
+    }
+
+    for( int i = 0; i < nRecycle; i++ ) {
+
+        ppRCBuffers[ i ] = sizeClass.pIdle_S.back();
+
+        sizeClass.pIdle_S.pop_back();
+
+    }
+
+    for( int i = nRecycle; i < nCount; i++ ) {
+
+        ppRCBuffers[ i ] = Func_Buffer_Alloc( key );
+
+        if( ppRCBuffers[ i ] == nullptr ) {
+
+            ////// All or none: what was taken goes back idle
+
+            sizeClass.pIdle_S.insert( sizeClass.pIdle_S.end(), ppRCBuffers, ppRCBuffers + i );
+
+            return QCAP_RS_ERROR_OUT_OF_MEMORY;
+
+        }
+
+    }
+
+    for( int i = 0; i < nCount; i++ ) m_mapOwner[ ppRCBuffers[ i ] ].bInUse = TRUE;
+
+    sizeClass.nInUse += nCount;
+
+    sizeClass.nHighWater = std::max( sizeClass.nHighWater, sizeClass.nInUse );
+
+    sizeClass.nAcquired += nCount;
+
+    sizeClass.nRecycled += nRecycle;
+
+    return QCAP_RS_SUCCESSFUL;
+
+}
+
+void FramePool::Release( qcap2_rcbuffer_t * const * ppRCBuffers, int nCount )
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    for( int i = 0; i < nCount; i++ ) {
+
+        auto it = m_mapOwner.find( ppRCBuffers[ i ] );
+
+        if( it == m_mapOwner.end() ) {
+
+            printf( "[QCAP DEBUG] %s(%d): frame %p is not from the pool\n", __FUNCTION__, __LINE__, ( void * )ppRCBuffers[ i ] );
+
+            m_nBadReleases++;
+
+            continue;
+
+        }
+
+        ////// Already idle: queuing it again would hand one buffer to two consumers
+
+        if( it->second.bInUse == FALSE ) {
+
+            printf( "[QCAP DEBUG] %s(%d): frame %p released twice\n", __FUNCTION__, __LINE__, ( void * )ppRCBuffers[ i ] );
+
+            m_nBadReleases++;
+
+            continue;
+
+        }
+
+        it->second.bInUse = FALSE;
+
+        SizeClass &sizeClass = m_mapClass[ it->second.stKey ];
+
+        sizeClass.pIdle_S.push_back( ppRCBuffers[ i ] );
+
+        sizeClass.nInUse--;
+
+    }
+
+}
+
+uint64_t FramePool::Trim()
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    uint64_t nFreed = 0;
+
+    for( auto &item : m_mapClass ) {
+
+        for( qcap2_rcbuffer_t * pRCBuffer : item.second.pIdle_S ) {
+
+            Func_Buffer_Free( pRCBuffer, item.first );
+
+            nFreed += item.second.nFrameBytes;
+
+        }
+
+        item.second.pIdle_S.clear();
+
+    }
+
+    return nFreed;
+
+}
+
+void FramePool::SetPinnedCap( uint64_t nPinnedCap )
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    m_nPinnedCap = nPinnedCap;
+
+}
+
+FramePoolStats FramePool::GetStats() const
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    FramePoolStats stats;
+
+    stats.st_nPinnedBytes = m_nPinnedBytes;
+
+    stats.st_nPinnedHighWater = m_nPinnedHighWater;
+
+    stats.st_nPinnedCap = m_nPinnedCap;
+
+    stats.st_nSystemBytes = m_nSystemBytes;
+
+    stats.st_nTrimmedBytes = m_nTrimmedBytes;
+
+    stats.st_nRefused = m_nRefused;
+
+    stats.st_nBadReleases = m_nBadReleases;
+
+    for( const auto &item : m_mapClass ) {
+
+        FramePoolClassStats stClass;
+
+        stClass.st_stKey = item.first;
+
+        stClass.st_nFrameBytes = item.second.nFrameBytes;
+
+        stClass.st_nAllocated = item.second.nAllocated;
+
+        stClass.st_nInUse = item.second.nInUse;
+
+        stClass.st_nHighWater = item.second.nHighWater;
+
+        stClass.st_nAcquired = item.second.nAcquired;
+
+        stClass.st_nRecycled = item.second.nRecycled;
+
+        stats.st_stClass_S.push_back( stClass );
+
+    }
+
+    return stats;
+
+}
+
+BOOL FramePool_SelfTest()
+{
+
+    BOOL bPass = TRUE;
+
+    auto pfnCheck = [ &bPass ]( BOOL bOk, const char * pszWhat ) {
+
+        if( bOk == FALSE ) {
+
+            printf( "FramePool self-test: %s\n", pszWhat );
+
+            bPass = FALSE;
+
+        }
+
+    };
+
+    ////// 64x32 I420 and 32x32 GBRP are both 3072 bytes, the cap holds 10 of them
+
+    const uint64_t nFrameBytes = FramePool::Func_Frame_Bytes( QCAP_COLORSPACE_TYPE_I420, 64, 32 );
+
+    FramePool pool( nFrameBytes * 10, FALSE );
+
+    auto pfnClass = [ &pool ]( ULONG nColorSpaceType ) {
+
+        for( const FramePoolClassStats &stClass : pool.GetStats().st_stClass_S ) {
+
+            if( stClass.st_stKey.st_nColorSpaceType == nColorSpaceType && stClass.st_stKey.st_eMemory == FRAME_POOL_MEMORY_CUDA_HOST ) return stClass;
+
+        }
+
+        return FramePoolClassStats();
+
+    };
+
+    qcap2_rcbuffer_t * pA_S[ 8 ], * pB_S[ 12 ], * pC, * pSys_S[ 20 ];
+
+    pfnCheck( pool.Acquire( QCAP_COLORSPACE_TYPE_I420, 64, 32, FRAME_POOL_MEMORY_CUDA_HOST, 4, pA_S ) == QCAP_RS_SUCCESSFUL, "first set refused" );
+
+    std::set< qcap2_rcbuffer_t * > pFirst_S( pA_S, pA_S + 4 );
+
+    pool.Release( pA_S, 4 );
+
+    ////// Same class again: the same frames, nothing allocated
+
+    pfnCheck( pool.Acquire( QCAP_COLORSPACE_TYPE_I420, 64, 32, FRAME_POOL_MEMORY_CUDA_HOST, 4, pA_S ) == QCAP_RS_SUCCESSFUL
+              && std::set< qcap2_rcbuffer_t * >( pA_S, pA_S + 4 ) == pFirst_S, "released set not recycled" );
+
+    pfnCheck( pfnClass( QCAP_COLORSPACE_TYPE_I420 ).st_nAllocated == 4 && pfnClass( QCAP_COLORSPACE_TYPE_I420 ).st_nRecycled == 4, "recycling allocated" );
+
+    pfnCheck( pool.Acquire( QCAP_COLORSPACE_TYPE_I420, 64, 32, FRAME_POOL_MEMORY_CUDA_HOST, 4, pA_S + 4 ) == QCAP_RS_SUCCESSFUL, "second set refused" );
+
+    pfnCheck( pfnClass( QCAP_COLORSPACE_TYPE_I420 ).st_nHighWater == 8, "high water" );
+
+    pool.Release( pA_S, 8 );
+
+    ////// 8 idle I420 + 6 GBRP is over the cap: 4 idle I420 frames are freed for them
+
+    pfnCheck( pool.Acquire( QCAP_COLORSPACE_TYPE_GBRP, 32, 32, FRAME_POOL_MEMORY_CUDA_HOST, 6, pB_S ) == QCAP_RS_SUCCESSFUL, "trim did not make room" );
+
+    FramePoolStats stats = pool.GetStats();
+
+    pfnCheck( stats.st_nPinnedBytes == nFrameBytes * 10 && stats.st_nTrimmedBytes == nFrameBytes * 4, "trim accounting" );
+
+    pfnCheck( stats.st_nPinnedHighWater == nFrameBytes * 10, "pinned high water" );
+
+    ////// 4 idle I420 left: 5 more GBRP do not fit even after trimming, nothing may change
+
+    pfnCheck( pool.Acquire( QCAP_COLORSPACE_TYPE_GBRP, 32, 32, FRAME_POOL_MEMORY_CUDA_HOST, 5, pB_S + 6 ) == QCAP_RS_ERROR_OUT_OF_MEMORY, "over the cap accepted" );
+
+    stats = pool.GetStats();
+
+    pfnCheck( stats.st_nRefused == 1 && pfnClass( QCAP_COLORSPACE_TYPE_GBRP ).st_nInUse == 6, "refused set changed the pool" );
+
+    pfnCheck( pool.Acquire( QCAP_COLORSPACE_TYPE_I420, 64, 32, FRAME_POOL_MEMORY_CUDA_HOST, 1, &pC ) == QCAP_RS_SUCCESSFUL
+              && pfnClass( QCAP_COLORSPACE_TYPE_I420 ).st_nRecycled == 5, "idle frame not reused under the cap" );
+
+    ////// System memory is not capped
+
+    pfnCheck( pool.Acquire( QCAP_COLORSPACE_TYPE_I420, 64, 32, FRAME_POOL_MEMORY_SYSTEM, 20, pSys_S ) == QCAP_RS_SUCCESSFUL
+              && pool.GetStats().st_nSystemBytes == nFrameBytes * 20, "system frames" );
+
+    pool.Release( pB_S, 6 );
+
+    pool.Release( &pC, 1 );
+
+    pool.Release( pSys_S, 20 );
+
+    ////// Released twice, also within one call: one idle frame, handed out once
+
+    pool.Release( &pC, 1 );
+
+    pfnCheck( pool.Acquire( QCAP_COLORSPACE_TYPE_I420, 64, 32, FRAME_POOL_MEMORY_CUDA_HOST, 1, &pC ) == QCAP_RS_SUCCESSFUL, "frame refused after a double release" );
+
+    qcap2_rcbuffer_t * pTwice_S[ 2 ] = { pC, pC };
+
+    pool.Release( pTwice_S, 2 );
+
+    qcap2_rcbuffer_t * pD_S[ 5 ];
+
+    pfnCheck( pool.Acquire( QCAP_COLORSPACE_TYPE_I420, 64, 32, FRAME_POOL_MEMORY_CUDA_HOST, 5, pD_S ) == QCAP_RS_SUCCESSFUL
+              && std::set< qcap2_rcbuffer_t * >( pD_S, pD_S + 5 ).size() == 5, "double release handed a frame out twice" );
+
+    pfnCheck( pool.GetStats().st_nBadReleases == 2 && pfnClass( QCAP_COLORSPACE_TYPE_I420 ).st_nInUse == 5, "double release accounting" );
+
+    pool.Release( pD_S, 5 );
+
+    pool.Trim();
+
+    stats = pool.GetStats();
+
+    pfnCheck( stats.st_nPinnedBytes == 0 && stats.st_nSystemBytes == 0, "trim left frames" );
+
+    printf( "FramePool self-test %s\n", ( bPass == TRUE ) ? "passed" : "FAILED" );
+
+    return bPass;
+
+}
@@ -0,0 +1,199 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <qcap.windef.h>
+#include <qcap2.h>
+
+////// Pinned ( cudaHost ) memory the pool may hold, in use and idle together; page locked
+////// memory is taken from the kernel, too much of it starves the rest of the system
+
+#define FRAME_POOL_PINNED_CAP ( 512ULL * 1024 * 1024 )
+
+enum FramePoolMemory {
+
+    FRAME_POOL_MEMORY_SYSTEM = 0,
+
+    FRAME_POOL_MEMORY_CUDA_HOST         // mapped cudaHost, what the NPP scalers write
+
+};
+
+////// A size class: frames of one shape in one kind of memory are interchangeable
+
+struct FramePoolKey {
+
+    ULONG               st_nColorSpaceType;
+
+    ULONG               st_nWidth;
+
+    ULONG               st_nHeight;
+
+    FramePoolMemory     st_eMemory;
+
+    bool operator<( const FramePoolKey &other ) const;
+
+};
+
+struct FramePoolClassStats {
+
+    FramePoolKey    st_stKey;
+
+    uint64_t        st_nFrameBytes          = 0;
+
+    ULONG           st_nAllocated           = 0;
+
+    ULONG           st_nInUse               = 0;
+
+    ULONG           st_nHighWater           = 0;            // most in use at once
+
+    uint64_t        st_nAcquired            = 0;
+
+    uint64_t        st_nRecycled            = 0;            // acquired without an allocation
+
+};
+
+struct FramePoolStats {
+
+    uint64_t        st_nPinnedBytes         = 0;
+
+    uint64_t        st_nPinnedHighWater     = 0;
+
+    uint64_t        st_nPinnedCap           = 0;
+
+    uint64_t        st_nSystemBytes         = 0;
+
+    uint64_t        st_nTrimmedBytes        = 0;            // idle frames freed to make room
+
+    uint64_t        st_nRefused             = 0;            // Acquire() over the pinned cap
+
+    uint64_t        st_nBadReleases         = 0;            // Release() of an idle or foreign frame, ignored
+
+    std::vector< FramePoolClassStats >      st_stClass_S;
+
+};
+
+////// One allocator for the frame buffers of every scaler and converter. Buffers are handed
+////// out in sets and come back with Release(); a returned buffer is idle and goes to the next
+////// consumer of the same size class instead of being freed, so restarting a scaler or
+////// adding a consumer costs no new pinned memory when a matching set is idle. A request
+////// that would go over the pinned cap first frees idle frames of other classes, and is
+////// refused if that is not enough.
+////// Without a CUDA device cudaHost requests are served
+////// from system memory, still counted against the cap, so the pool runs and can be
+////// tested anywhere.
+
+class FramePool
+{
+
+public:
+
+    static FramePool& Instance();
+
+    FramePool( uint64_t nPinnedCap, BOOL bCuda );
+
+    ////// Frees idle frames; frames still in use are left to their holders
+
+    ~FramePool();
+
+    ////// All nCount or none; QCAP_RS_ERROR_OUT_OF_MEMORY when over the cap or an allocation fails
+
+    QRESULT Acquire( ULONG nColorSpaceType, ULONG nWidth, ULONG nHeight, FramePoolMemory eMemory, int nCount, qcap2_rcbuffer_t ** ppRCBuffers );
+
+    ////// A frame that is already idle ( released twice ) or not from the pool is reported and
+    ////// ignored, so it can never be handed to two consumers
+
+    void Release( qcap2_rcbuffer_t * const * ppRCBuffers, int nCount );
+
+    ////// Frees every idle frame, returns the bytes freed
+
+    uint64_t Trim();
+
+    void SetPinnedCap( uint64_t nPinnedCap );
+
+    FramePoolStats GetStats() const;
+
+    ////// Bytes of one frame, as the pool accounts it
+
+    static uint64_t Func_Frame_Bytes( ULONG nColorSpaceType, ULONG nWidth, ULONG nHeight );
+
+private:
+
+    struct SizeClass {
+
+        std::vector< qcap2_rcbuffer_t * >   pIdle_S;
+
+        uint64_t    nFrameBytes     = 0;
+
+        ULONG       nAllocated      = 0;
+
+        ULONG       nInUse          = 0;
+
+        ULONG       nHighWater      = 0;
+
+        uint64_t    nAcquired       = 0;
+
+        uint64_t    nRecycled       = 0;
+
+    };
+
+    struct Owner {
+
+        FramePoolKey    stKey;
+
+        BOOL            bInUse      = FALSE;
+
+    };
+
+    ////// Only the device decides: the NPP scalers want cudaHost frames whatever the converter backend
+
+    static BOOL Func_Cuda_Device();
+
+    BOOL Func_Pinned( const FramePoolKey &key ) const;
+
+    qcap2_rcbuffer_t * Func_Buffer_Alloc( const FramePoolKey &key );
+
+    void Func_Buffer_Free( qcap2_rcbuffer_t * pRCBuffer, const FramePoolKey &key );
+
+    ////// Frees idle pinned frames of classes other than pKeep until nBytes are free, under m_mtx;
+    ////// frees nothing when the idle frames cannot cover nBytes
+
+    uint64_t Func_Trim_Pinned( const FramePoolKey * pKeep, uint64_t nBytes );
+
+private:
+
+    BOOL                                                m_bCuda;
+
+    mutable std::mutex                                  m_mtx;
+
+    std::map< FramePoolKey, SizeClass >                 m_mapClass;
+
+    std::map< qcap2_rcbuffer_t *, Owner >               m_mapOwner;
+
+    uint64_t                                            m_nPinnedCap;
+
+    uint64_t                                            m_nPinnedBytes          = 0;
+
+    uint64_t                                            m_nPinnedHighWater      = 0;
+
+    uint64_t                                            m_nSystemBytes          = 0;
+
+    uint64_t                                            m_nTrimmedBytes         = 0;
+
+    uint64_t                                            m_nRefused              = 0;
+
+    uint64_t                                            m_nBadReleases          = 0;
+
+};
+
+////// Recycling, the cap, trimming, the high-water marks and double releases on a private pool
+////// in system memory;
+////// FALSE on any mismatch
+
+BOOL FramePool_SelfTest();
+
+#endif // FRAMEPOOL_H
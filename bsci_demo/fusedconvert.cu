@@ -0,0 +1,91 @@
+#include "colorconvert.h"
+
+#include <cuda_runtime_api.h>
+
+////// One thread per 2x2 luma block: the block and its NV12 chroma pair are read once, the
+////// full-frame I420 output and ( when requested ) the GBRP crop are written in the same pass.
+
+__global__ static void Kernel_NV12_To_I420_GBRPCrop( ColorPlanes src, ColorPlanes dstLive, ColorPlanes dstCrop,
+                                                     int nWidth, int nHeight,
+                                                     int nCropX, int nCropY, int nCropW, int nCropH, int bCrop )
+{
+
+    int bx = blockIdx.x * blockDim.x + threadIdx.x;
+
+    int by = blockIdx.y * blockDim.y + threadIdx.y;
+
+    int x0 = bx * 2;
+
+    int y0 = by * 2;
+
+    if( x0 >= nWidth || y0 >= nHeight ) return;
+
+    const uint8_t * pUV = src.pData[ 1 ] + by * src.nStride[ 1 ] + x0;
+
+    int u = pUV[ 0 ];
+
+    int v = pUV[ 1 ];
+
+    dstLive.pData[ 1 ][ by * dstLive.nStride[ 1 ] + bx ] = ( uint8_t )u;
+
+    dstLive.pData[ 2 ][ by * dstLive.nStride[ 2 ] + bx ] = ( uint8_t )v;
+
+    for( int dy = 0; dy < 2; dy++ ) {
+
+        int y = y0 + dy;
+
+        if( y >= nHeight ) break;
+
+        const uint8_t * pSrcY = src.pData[ 0 ] + y * src.nStride[ 0 ];
+
+        uint8_t * pDstY = dstLive.pData[ 0 ] + y * dstLive.nStride[ 0 ];
+
+        for( int dx = 0; dx < 2; dx++ ) {
+
+            int x = x0 + dx;
+
+            if( x >= nWidth ) break;
+
+            uint8_t Y = pSrcY[ x ];
+
+            pDstY[ x ] = Y;
+
+            if( bCrop == 0 ) continue;
+
+            int cx = x - nCropX;
+
+            int cy = y - nCropY;
+
+            if( cx < 0 || cy < 0 || cx >= nCropW || cy >= nCropH ) continue;
+
+            uint8_t r, g, b;
+
+            ColorConvert_YUV_To_RGB( Y, u, v, &r, &g, &b );
+
+            dstCrop.pData[ 0 ][ cy * dstCrop.nStride[ 0 ] + cx ] = g;
+
+            dstCrop.pData[ 1 ][ cy * dstCrop.nStride[ 1 ] + cx ] = b;
+
+            dstCrop.pData[ 2 ][ cy * dstCrop.nStride[ 2 ] + cx ] = r;
+
+        }
+
+    }
+
+}
+
+cudaError_t FusedConvert_Launch( const ColorPlanes &src, const ColorPlanes &dstLive, const ColorPlanes &dstCrop,
+                                 int nWidth, int nHeight, int nCropX, int nCropY, int nCropW, int nCropH,
+                                 bool bCrop, cudaStream_t stream )
+{
+
+    dim3 block( 32, 8 );
+
+    dim3 grid( ( ( nWidth + 1 ) / 2 + block.x - 1 ) / block.x, ( ( nHeight + 1 ) / 2 + block.y - 1 ) / block.y );
+
+    Kernel_NV12_To_I420_GBRPCrop<<< grid, block, 0, stream >>>( src, dstLive, dstCrop, nWidth, nHeight,
+                                                                nCropX, nCropY, nCropW, nCropH, bCrop ? 1 : 0 );
+
+    return cudaGetLastError();
+
+}
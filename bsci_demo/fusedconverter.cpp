@@ -0,0 +1,261 @@
+#include "fusedconverter.h"
+
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+FusedConverter::FusedConverter( ULONG nSrcWidth, ULONG nSrcHeight, ULONG nCropX, ULONG nCropY, ULONG nCropW, ULONG nCropH )
+    : m_nSrcWidth( nSrcWidth ), m_nSrcHeight( nSrcHeight ),
+      m_nCropX( nCropX ), m_nCropY( nCropY ), m_nCropW( nCropW ), m_nCropH( nCropH )
+{
+
+    m_bCpuBackend = ( Func_Cuda_Available() == TRUE ) ? FALSE : TRUE;
+
+}
+
+FusedConverter::~FusedConverter()
+{
+
+    Stop();
+
+}
+
+BOOL FusedConverter::Func_Cuda_Available()
+{
+
+    const char * pszBackend = getenv( "BSCI_CONVERT_BACKEND" );
+
+    if( pszBackend != nullptr && strcmp( pszBackend, "cpu" ) == 0 ) return FALSE;
+
+    int nDevices = 0;
+
+    if( cudaGetDeviceCount( &nDevices ) != cudaSuccess || nDevices <= 0 ) return FALSE;
+
+    return TRUE;
+
+}
+
+QRESULT FusedConverter::Start( qcap2_rcbuffer_t ** pLiveBuffers, qcap2_rcbuffer_t ** pCropBuffers, int nBuffers )
+{
+
+    if( nBuffers <= 0 ) return QCAP_RS_ERROR_GENERAL;
+
+    m_pLiveBuffer_S.assign( pLiveBuffers, pLiveBuffers + nBuffers );
+
+    m_pCropBuffer_S.assign( pCropBuffers, pCropBuffers + nBuffers );
+
+    if( m_bCpuBackend == TRUE ) {
+
+        printf( "[QCAP DEBUG] FusedConverter: CPU backend ( %s )\n", CpuConvert_Isa_Name( CpuConvert_Isa_Best() ) );
+
+        return QCAP_RS_SUCCESSFUL;
+
+    }
+
+    ////// Own stream, so waiting for a frame never waits on the NPP scalers or inference
+
+    cudaError_t err = cudaStreamCreateWithFlags( &m_stream, cudaStreamNonBlocking );
+
+    if( err != cudaSuccess ) {
+
+        printf( "[QCAP DEBUG] %s(%d): cudaStreamCreateWithFlags() failed, err=%d\n", __FUNCTION__, __LINE__, err );
+
+        m_pLiveBuffer_S.clear();
+
+        m_pCropBuffer_S.clear();
+
+        return QCAP_RS_ERROR_GENERAL;
+
+    }
+
+    return QCAP_RS_SUCCESSFUL;
+
+}
+
+void FusedConverter::Stop()
+{
+
+    if( m_stream != nullptr ) {
+
+        cudaStreamSynchronize( m_stream );
+
+        cudaStreamDestroy( m_stream );
+
+        m_stream = nullptr;
+
+    }
+
+    m_pLiveBuffer_S.clear();
+
+    m_pCropBuffer_S.clear();
+
+}
+
+void FusedConverter::SetCropBusyCheck( const busy_func_t &pfnBusy )
+{
+
+    m_pfnCropBusy = pfnBusy;
+
+}
+
+void FusedConverter::Func_Planes_Get( qcap2_av_frame_t * pAVFrame, ColorPlanes * pPlanes )
+{
+
+    uint8_t * pBuffer[ 4 ];
+
+    int nStride[ 4 ];
+
+    qcap2_av_frame_get_buffer1( pAVFrame, pBuffer, nStride );
+
+    for( int i = 0; i < 3; i++ ) {
+
+        pPlanes->pData[ i ] = pBuffer[ i ];
+
+        pPlanes->nStride[ i ] = nStride[ i ];
+
+    }
+
+}
+
+QRESULT FusedConverter::Convert( qcap2_rcbuffer_t * pSrcRCBuffer, BOOL bCrop, qcap2_rcbuffer_t ** ppLive, qcap2_rcbuffer_t ** ppCrop )
+{
+
+    *ppLive = nullptr;
+
+    *ppCrop = nullptr;
+
+    if( m_pLiveBuffer_S.empty() == TRUE || pSrcRCBuffer == nullptr ) return QCAP_RS_ERROR_GENERAL;
+
+    qcap2_rcbuffer_t * pLiveRCBuffer = m_pLiveBuffer_S[ m_nLiveIndex ];
+
+    qcap2_rcbuffer_t * pCropRCBuffer = nullptr;
+
+    ////// The next free crop slot in round robin order; a slow writer may still hold some
+
+    for( size_t i = 0; bCrop == TRUE && i < m_pCropBuffer_S.size(); i++ ) {
+
+        size_t nIndex = ( m_nCropIndex + i ) % m_pCropBuffer_S.size();
+
+        if( m_pfnCropBusy && m_pfnCropBusy( m_pCropBuffer_S[ nIndex ] ) == TRUE ) continue;
+
+        m_nCropIndex = nIndex;
+
+        pCropRCBuffer = m_pCropBuffer_S[ nIndex ];
+
+        break;
+
+    }
+
+    if( bCrop == TRUE && pCropRCBuffer == nullptr ) m_nCropBusyDrops++;
+
+    ColorPlanes src = {};
+
+    ColorPlanes dstLive = {};
+
+    ColorPlanes dstCrop = {};
+
+    {
+        std::shared_ptr< qcap2_av_frame_t > pSrcFrame(
+                    ( qcap2_av_frame_t * )qcap2_rcbuffer_lock_data( pSrcRCBuffer ),
+                    [ pSrcRCBuffer ]( qcap2_av_frame_t * ) {
+                        qcap2_rcbuffer_unlock_data( pSrcRCBuffer );
+                    });
+
+        std::shared_ptr< qcap2_av_frame_t > pLiveFrame(
+                    ( qcap2_av_frame_t * )qcap2_rcbuffer_lock_data( pLiveRCBuffer ),
+                    [ pLiveRCBuffer ]( qcap2_av_frame_t * ) {
+                        qcap2_rcbuffer_unlock_data( pLiveRCBuffer );
+                    });
+
+        std::shared_ptr< qcap2_av_frame_t > pCropFrame;
+
+        if( pCropRCBuffer != nullptr ) {
+
+            pCropFrame.reset( ( qcap2_av_frame_t * )qcap2_rcbuffer_lock_data( pCropRCBuffer ),
+                              [ pCropRCBuffer ]( qcap2_av_frame_t * ) {
+                                  qcap2_rcbuffer_unlock_data( pCropRCBuffer );
+                              });
+
+            Func_Planes_Get( pCropFrame.get(), &dstCrop );
+
+        }
+
+        Func_Planes_Get( pSrcFrame.get(), &src );
+
+        Func_Planes_Get( pLiveFrame.get(), &dstLive );
+
+        ////// Captured NV12 is one contiguous buffer, the chroma plane follows the luma rows
+
+        if( src.pData[ 1 ] == nullptr ) {
+
+            src.pData[ 1 ] = src.pData[ 0 ] + src.nStride[ 0 ] * m_nSrcHeight;
+
+            src.nStride[ 1 ] = src.nStride[ 0 ];
+
+        }
+
+        BOOL bCropSlot = ( pCropRCBuffer != nullptr ) ? TRUE : FALSE;
+
+        QRESULT qres = ( m_bCpuBackend == TRUE ) ? Func_Cpu_Convert( src, dstLive, dstCrop, bCropSlot )
+                                                 : Func_Cuda_Convert( src, dstLive, dstCrop, bCropSlot );
+
+        if( qres != QCAP_RS_SUCCESSFUL ) return qres;
+    }
+
+    m_nLiveIndex = ( m_nLiveIndex + 1 ) % m_pLiveBuffer_S.size();
+
+    qcap2_rcbuffer_add_ref( pLiveRCBuffer );
+
+    *ppLive = pLiveRCBuffer;
+
+    if( pCropRCBuffer != nullptr ) {
+
+        m_nCropIndex = ( m_nCropIndex + 1 ) % m_pCropBuffer_S.size();
+
+        qcap2_rcbuffer_add_ref( pCropRCBuffer );
+
+        *ppCrop = pCropRCBuffer;
+
+    }
+
+    return QCAP_RS_SUCCESSFUL;
+
+}
+
+QRESULT FusedConverter::Func_Cuda_Convert( const ColorPlanes &src, const ColorPlanes &dstLive, const ColorPlanes &dstCrop, BOOL bCrop )
+{
+
+    cudaError_t err = FusedConvert_Launch( src, dstLive, dstCrop,
+                                           m_nSrcWidth, m_nSrcHeight,
+                                           m_nCropX, m_nCropY, m_nCropW, m_nCropH,
+                                           bCrop == TRUE, m_stream );
+
+    if( err == cudaSuccess ) err = cudaStreamSynchronize( m_stream );
+
+    if( err != cudaSuccess ) {
+
+        printf( "[QCAP DEBUG] %s(%d): fused conversion failed, err=%d\n", __FUNCTION__, __LINE__, err );
+
+        return QCAP_RS_ERROR_GENERAL;
+
+    }
+
+    return QCAP_RS_SUCCESSFUL;
+
+}
+
+QRESULT FusedConverter::Func_Cpu_Convert( const ColorPlanes &src, const ColorPlanes &dstLive, const ColorPlanes &dstCrop, BOOL bCrop )
+{
+
+    CpuConvert_Run( CPU_CONVERT_NV12_TO_I420, src, dstLive, m_nSrcWidth, m_nSrcHeight );
+
+    if( bCrop == FALSE ) return QCAP_RS_SUCCESSFUL;
+
+    ////// The crop is read straight from the NV12 source at the exact origin, as the kernel does
+
+    CpuConvert_NV12_Crop_To_GBRP( src, dstCrop, m_nCropX, m_nCropY, m_nCropW, m_nCropH );
+
+    return QCAP_RS_SUCCESSFUL;
+
+}
@@ -0,0 +1,104 @@
+#ifndef FUSEDCONVERTER_H
+#define FUSEDCONVERTER_H
+
+#include <vector>
+#include <atomic>
+#include <functional>
+
+#include <qcap.windef.h>
+#include <qcap2.h>
+
+#include <cuda_runtime_api.h>
+
+#include "colorconvert.h"
+#include "cpuconvert.h"
+
+////// fusedconvert.cu
+
+cudaError_t FusedConvert_Launch( const ColorPlanes &src, const ColorPlanes &dstLive, const ColorPlanes &dstCrop,
+                                 int nWidth, int nHeight, int nCropX, int nCropY, int nCropW, int nCropH,
+                                 bool bCrop, cudaStream_t stream );
+
+////// Single-pass conversion stage: reads each captured NV12 frame once and produces the
+////// full-frame I420 for Frame_Live and, on request, the centred GBRP crop. Replaces the
+////// separate live and crop NPP scalers when FUSED_CONVERT_ENABLE is set. Without a CUDA
+////// device ( or with BSCI_CONVERT_BACKEND=cpu ) the same outputs come from CpuConvert.
+
+class FusedConverter
+{
+
+public:
+
+    FusedConverter( ULONG nSrcWidth, ULONG nSrcHeight, ULONG nCropX, ULONG nCropY, ULONG nCropW, ULONG nCropH );
+
+    ~FusedConverter();
+
+    ////// FALSE selects the CPU backend, output buffers can then be plain system memory
+
+    static BOOL Func_Cuda_Available();
+
+    BOOL IsCpuBackend() const { return m_bCpuBackend; }
+
+    ////// TRUE while a consumer still reads the buffer
+
+    typedef std::function< BOOL ( qcap2_rcbuffer_t * pRCBuffer ) > busy_func_t;
+
+    ////// Output buffers are owned by the caller and recycled round robin, like scaler buffers
+
+    QRESULT Start( qcap2_rcbuffer_t ** pLiveBuffers, qcap2_rcbuffer_t ** pCropBuffers, int nBuffers );
+
+    void Stop();
+
+    ////// A crop slot the check reports busy is skipped; with every slot busy the crop is
+    ////// dropped for this frame and counted in GetCropBusyDrops()
+
+    void SetCropBusyCheck( const busy_func_t &pfnBusy );
+
+    uint64_t GetCropBusyDrops() const { return m_nCropBusyDrops; }
+
+    ////// Returned buffers carry a reference, release them with qcap2_rcbuffer_release.
+    ////// *ppCrop is left nullptr when bCrop is FALSE or the crop was dropped.
+
+    QRESULT Convert( qcap2_rcbuffer_t * pSrcRCBuffer, BOOL bCrop, qcap2_rcbuffer_t ** ppLive, qcap2_rcbuffer_t ** ppCrop );
+
+private:
+
+    static void Func_Planes_Get( qcap2_av_frame_t * pAVFrame, ColorPlanes * pPlanes );
+
+    QRESULT Func_Cuda_Convert( const ColorPlanes &src, const ColorPlanes &dstLive, const ColorPlanes &dstCrop, BOOL bCrop );
+
+    QRESULT Func_Cpu_Convert( const ColorPlanes &src, const ColorPlanes &dstLive, const ColorPlanes &dstCrop, BOOL bCrop );
+
+private:
+
+    ULONG                               m_nSrcWidth;
+
+    ULONG                               m_nSrcHeight;
+
+    ULONG                               m_nCropX;
+
+    ULONG                               m_nCropY;
+
+    ULONG                               m_nCropW;
+
+    ULONG                               m_nCropH;
+
+    std::vector< qcap2_rcbuffer_t * >   m_pLiveBuffer_S;
+
+    std::vector< qcap2_rcbuffer_t * >   m_pCropBuffer_S;
+
+    size_t                              m_nLiveIndex    = 0;
+
+    size_t                              m_nCropIndex    = 0;
+
+    busy_func_t                         m_pfnCropBusy;
+
+    std::atomic< uint64_t >             m_nCropBusyDrops    { 0 };
+
+    cudaStream_t                        m_stream        = nullptr;
+
+    BOOL                                m_bCpuBackend   = FALSE;
+
+};
+
+#endif // FUSEDCONVERTER_H
@@ -0,0 +1,198 @@
+#include "ioscheduler.h"
+#include "latencystats.h"
+
+#include <algorithm>
+#include <chrono>
+
+#define IO_SCHED_MB ( 1024.0 * 1024.0 )
+
+IoScheduler::IoScheduler()
+    : m_dExportLimit( IO_SCHED_EXPORT_MAX_MBPS * IO_SCHED_MB ), m_dTokens( IO_SCHED_BURST_MB * IO_SCHED_MB )
+{
+
+    m_nRefillNs = m_nPeriodNs = Func_Latency_Now();
+
+}
+
+IoScheduler::~IoScheduler()
+{
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_bExit = TRUE;
+    }
+
+    m_cvExport.notify_all();
+
+}
+
+void IoScheduler::Func_Period_Update( int64_t nNowNs )
+{
+
+    ////// Tokens first, at the rate that was in force since the last refill
+
+    double dBurst = IO_SCHED_BURST_MB * IO_SCHED_MB;
+
+    m_dTokens = std::min( dBurst, m_dTokens + m_dExportLimit * ( nNowNs - m_nRefillNs ) / 1e9 );
+
+    m_nRefillNs = nNowNs;
+
+    int64_t nPeriodNs = nNowNs - m_nPeriodNs;
+
+    if( nPeriodNs < ( int64_t )IO_SCHED_PERIOD_MS * 1000000 ) return;
+
+    for( ClassState &state : m_stClass ) {
+
+        state.stLast.st_dRate = state.nPeriodBytes / ( nPeriodNs / 1e9 );
+
+        state.stLast.st_dWaitAvgMs = ( state.nPeriodWaits > 0 ) ? state.nPeriodWaitNs / 1e6 / state.nPeriodWaits : 0.0;
+
+        state.stLast.st_dWaitMaxMs = state.nPeriodWaitMaxNs / 1e6;
+
+    }
+
+    ////// AIMD on the export limit, driven by how long capture frames queued
+
+    if( m_stClass[ IO_CLASS_CAPTURE ].nPeriodWaitMaxNs > ( int64_t )IO_SCHED_CAPTURE_WAIT_MS * 1000000 ) {
+
+        m_dExportLimit = std::max( m_dExportLimit / 2, IO_SCHED_EXPORT_MIN_MBPS * IO_SCHED_MB );
+
+        m_dTokens = std::min( m_dTokens, 0.0 );
+
+        m_nBackoffs++;
+
+    } else {
+
+        m_dExportLimit = std::min( m_dExportLimit + IO_SCHED_EXPORT_STEP_MBPS * IO_SCHED_MB, IO_SCHED_EXPORT_MAX_MBPS * IO_SCHED_MB );
+
+    }
+
+    for( ClassState &state : m_stClass ) {
+
+        state.nPeriodBytes = 0;
+
+        state.nPeriodWaits = 0;
+
+        state.nPeriodWaitNs = 0;
+
+        state.nPeriodWaitMaxNs = 0;
+
+    }
+
+    m_nPeriodNs = nNowNs;
+
+}
+
+void IoScheduler::Func_Wait_Record( IoClass eClass, int64_t nWaitNs )
+{
+
+    ClassState &state = m_stClass[ eClass ];
+
+    state.nPeriodWaits++;
+
+    state.nPeriodWaitNs += nWaitNs;
+
+    state.nPeriodWaitMaxNs = std::max( state.nPeriodWaitMaxNs, nWaitNs );
+
+}
+
+void IoScheduler::Acquire( IoClass eClass, uint64_t nBytes )
+{
+
+    std::unique_lock< std::mutex > lock( m_mtx );
+
+    if( eClass == IO_CLASS_CAPTURE ) {
+
+        m_nCaptureActive++;
+
+        return;
+
+    }
+
+    ////// A chunk bigger than the bucket only needs a full bucket and leaves it in debt
+
+    double dNeed = std::min( ( double )nBytes, IO_SCHED_BURST_MB * IO_SCHED_MB );
+
+    int64_t nStartNs = Func_Latency_Now();
+
+    while( m_bExit == FALSE ) {
+
+        Func_Period_Update( Func_Latency_Now() );
+
+        if( m_nCaptureActive == 0 && m_dTokens >= dNeed ) break;
+
+        ////// Short sleeps, so a changed limit or a finished capture write is seen quickly
+
+        double dWaitMs = ( m_nCaptureActive > 0 ) ? 10.0 : std::min( 10.0, ( dNeed - m_dTokens ) / m_dExportLimit * 1e3 );
+
+        m_cvExport.wait_for( lock, std::chrono::microseconds( std::max< int64_t >( ( int64_t )( dWaitMs * 1e3 ), 100 ) ) );
+
+    }
+
+    m_dTokens -= ( double )nBytes;
+
+    Func_Wait_Record( eClass, Func_Latency_Now() - nStartNs );
+
+}
+
+void IoScheduler::Complete( IoClass eClass, uint64_t nBytes )
+{
+
+    BOOL bNotify = FALSE;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        ClassState &state = m_stClass[ eClass ];
+
+        state.nBytes += nBytes;
+
+        state.nOps++;
+
+        state.nPeriodBytes += nBytes;
+
+        if( eClass == IO_CLASS_CAPTURE && --m_nCaptureActive == 0 ) bNotify = TRUE;
+
+        Func_Period_Update( Func_Latency_Now() );
+    }
+
+    if( bNotify == TRUE ) m_cvExport.notify_all();
+
+}
+
+void IoScheduler::QueueWait( IoClass eClass, int64_t nWaitNs )
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    Func_Wait_Record( eClass, nWaitNs );
+
+}
+
+IoSchedStats IoScheduler::GetStats()
+{
+
+    IoSchedStats stats;
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    Func_Period_Update( Func_Latency_Now() );
+
+    for( int i = 0; i < IO_CLASS_COUNT; i++ ) {
+
+        stats.st_stClass[ i ] = m_stClass[ i ].stLast;
+
+        stats.st_stClass[ i ].st_nBytes = m_stClass[ i ].nBytes;
+
+        stats.st_stClass[ i ].st_nOps = m_stClass[ i ].nOps;
+
+    }
+
+    stats.st_dExportLimit = m_dExportLimit;
+
+    stats.st_nBackoffs = m_nBackoffs;
+
+    return stats;
+
+}
@@ -0,0 +1,141 @@
+#ifndef IOSCHEDULER_H
+#define IOSCHEDULER_H
+
+#include <stdint.h>
+
+#include <mutex>
+#include <condition_variable>
+
+#include <qcap.windef.h>
+
+////// Export bandwidth limits ( MB/s ), the limit moves between them with capture pressure
+
+#define IO_SCHED_EXPORT_MAX_MBPS 160
+
+#define IO_SCHED_EXPORT_MIN_MBPS 4
+
+////// Raised by this much per calm period, halved in a period where a capture frame waited
+////// longer than IO_SCHED_CAPTURE_WAIT_MS in its writer queue
+
+#define IO_SCHED_EXPORT_STEP_MBPS 8
+
+#define IO_SCHED_CAPTURE_WAIT_MS 40
+
+#define IO_SCHED_BURST_MB 8
+
+#define IO_SCHED_PERIOD_MS 250
+
+enum IoClass {
+
+    IO_CLASS_CAPTURE = 0,       // crops, segments, snapshots
+
+    IO_CLASS_EXPORT,            // bulk copies to USB
+
+    IO_CLASS_COUNT
+
+};
+
+struct IoClassStats {
+
+    uint64_t    st_nBytes               = 0;
+
+    uint64_t    st_nOps                 = 0;
+
+    ////// Over the last full period
+
+    double      st_dRate                = 0.0;          // bytes / s
+
+    double      st_dWaitAvgMs           = 0.0;
+
+    double      st_dWaitMaxMs           = 0.0;
+
+};
+
+struct IoSchedStats {
+
+    IoClassStats    st_stClass[ IO_CLASS_COUNT ];
+
+    double          st_dExportLimit     = 0.0;          // bytes / s
+
+    uint64_t        st_nBackoffs        = 0;
+
+};
+
+////// One arbiter for the disk shared by capture writers and the USB export. Capture
+////// writes never wait and hold export off while they run; export goes through a token
+////// bucket whose rate backs off ( AIMD ) whenever capture frames queue up behind the disk.
+////// Waits are what a class spent before its I/O could start: writer queue time for
+////// capture, throttling for export.
+
+class IoScheduler
+{
+
+public:
+
+    IoScheduler();
+
+    ~IoScheduler();
+
+    ////// Around every write; Acquire() blocks export only
+
+    void Acquire( IoClass eClass, uint64_t nBytes );
+
+    void Complete( IoClass eClass, uint64_t nBytes );
+
+    ////// Time an item spent in a writer queue before its write started
+
+    void QueueWait( IoClass eClass, int64_t nWaitNs );
+
+    IoSchedStats GetStats();
+
+private:
+
+    struct ClassState {
+
+        uint64_t    nBytes              = 0;
+
+        uint64_t    nOps                = 0;
+
+        uint64_t    nPeriodBytes        = 0;
+
+        uint64_t    nPeriodWaits        = 0;
+
+        int64_t     nPeriodWaitNs       = 0;
+
+        int64_t     nPeriodWaitMaxNs    = 0;
+
+        IoClassStats stLast;
+
+    };
+
+    ////// Caller holds m_mtx
+
+    void Func_Period_Update( int64_t nNowNs );
+
+    void Func_Wait_Record( IoClass eClass, int64_t nWaitNs );
+
+private:
+
+    std::mutex                  m_mtx;
+
+    std::condition_variable     m_cvExport;
+
+    ClassState                  m_stClass[ IO_CLASS_COUNT ];
+
+    int                         m_nCaptureActive    = 0;
+
+    double                      m_dExportLimit;
+
+    double                      m_dTokens;
+
+    int64_t                     m_nRefillNs;
+
+    int64_t                     m_nPeriodNs;
+
+    uint64_t                    m_nBackoffs         = 0;
+
+    BOOL                        m_bExit             = FALSE;
+
+};
+
+#endif // IOSCHEDULER_H
@@ -0,0 +1,273 @@
+#include "latencystats.h"
+
+#include <QStringList>
+
+#include <cstdio>
+
+LatencyHistogram::LatencyHistogram()
+{
+
+    Reset();
+
+}
+
+int LatencyHistogram::Func_Bucket_Index( uint64_t nValue )
+{
+
+    const uint64_t nSubCount = 1ULL << LATENCY_SUB_BITS;
+
+    const uint64_t nHalfCount = nSubCount >> 1;
+
+    if( nValue >= ( 1ULL << LATENCY_MAX_BITS ) ) nValue = ( 1ULL << LATENCY_MAX_BITS ) - 1;
+
+    if( nValue < nSubCount ) return ( int )nValue;
+
+    ////// e = how far the top LATENCY_SUB_BITS bits sit above bit 0, m = those bits
+
+    int nMsb = 63 - __builtin_clzll( nValue );
+
+    int e = nMsb - LATENCY_SUB_BITS + 1;
+
+    uint64_t m = nValue >> e;
+
+    return ( int )( e * nHalfCount + m );
+
+}
+
+uint64_t LatencyHistogram::Func_Bucket_Value( int nIndex )
+{
+
+    const int nSubCount = 1 << LATENCY_SUB_BITS;
+
+    const int nHalfCount = nSubCount >> 1;
+
+    if( nIndex < nSubCount ) return ( uint64_t )nIndex;
+
+    int e = nIndex / nHalfCount - 1;
+
+    uint64_t m = ( uint64_t )( nIndex - e * nHalfCount );
+
+    ////// Highest value that lands in the bucket, so percentiles never under-report
+
+    return ( m << e ) + ( ( 1ULL << e ) - 1 );
+
+}
+
+void LatencyHistogram::Record( int64_t nValueNs )
+{
+
+    if( nValueNs < 0 ) nValueNs = 0;
+
+    m_nCount_S[ Func_Bucket_Index( ( uint64_t )nValueNs ) ].fetch_add( 1, std::memory_order_relaxed );
+
+    m_nTotal.fetch_add( 1, std::memory_order_relaxed );
+
+    int64_t nMax = m_nMax.load( std::memory_order_relaxed );
+
+    while( nValueNs > nMax && m_nMax.compare_exchange_weak( nMax, nValueNs, std::memory_order_relaxed ) == FALSE );
+
+}
+
+void LatencyHistogram::Reset()
+{
+
+    for( int i = 0; i < LATENCY_BUCKET_NUM; i++ ) m_nCount_S[ i ].store( 0, std::memory_order_relaxed );
+
+    m_nTotal.store( 0, std::memory_order_relaxed );
+
+    m_nMax.store( 0, std::memory_order_relaxed );
+
+}
+
+LatencySummary LatencyHistogram::GetSummary() const
+{
+
+    LatencySummary summary;
+
+    uint64_t nCount_S[ LATENCY_BUCKET_NUM ];
+
+    uint64_t nTotal = 0;
+
+    ////// Snapshot the buckets first, the total is recounted so it matches the snapshot
+
+    for( int i = 0; i < LATENCY_BUCKET_NUM; i++ ) {
+
+        nCount_S[ i ] = m_nCount_S[ i ].load( std::memory_order_relaxed );
+
+        nTotal += nCount_S[ i ];
+
+    }
+
+    summary.st_nCount = nTotal;
+
+    summary.st_nMax = m_nMax.load( std::memory_order_relaxed );
+
+    if( nTotal == 0 ) return summary;
+
+    const double dQuantile_S[ 3 ] = { 0.50, 0.99, 0.999 };
+
+    int64_t * pResult_S[ 3 ] = { &summary.st_nP50, &summary.st_nP99, &summary.st_nP999 };
+
+    uint64_t nSeen = 0;
+
+    int iQuantile = 0;
+
+    for( int i = 0; i < LATENCY_BUCKET_NUM && iQuantile < 3; i++ ) {
+
+        nSeen += nCount_S[ i ];
+
+        while( iQuantile < 3 && nSeen >= ( uint64_t )( dQuantile_S[ iQuantile ] * nTotal + 0.5 ) && nSeen > 0 ) {
+
+            int64_t nValue = ( int64_t )Func_Bucket_Value( i );
+
+            *pResult_S[ iQuantile ] = ( nValue < summary.st_nMax ) ? nValue : summary.st_nMax;
+
+            iQuantile++;
+
+        }
+
+    }
+
+    return summary;
+
+}
+
+BOOL LatencyStampQueue::Push( int64_t nStampNs )
+{
+
+    uint32_t nTail = m_nTail.load( std::memory_order_relaxed );
+
+    if( nTail - m_nHead.load( std::memory_order_acquire ) >= LATENCY_STAMP_QUEUE_SIZE ) return FALSE;
+
+    m_nStamp_S[ nTail % LATENCY_STAMP_QUEUE_SIZE ] = nStampNs;
+
+    m_nTail.store( nTail + 1, std::memory_order_release );
+
+    return TRUE;
+
+}
+
+int64_t LatencyStampQueue::Pop()
+{
+
+    uint32_t nHead = m_nHead.load( std::memory_order_relaxed );
+
+    if( nHead == m_nTail.load( std::memory_order_acquire ) ) return 0;
+
+    int64_t nStampNs = m_nStamp_S[ nHead % LATENCY_STAMP_QUEUE_SIZE ];
+
+    m_nHead.store( nHead + 1, std::memory_order_release );
+
+    return nStampNs;
+
+}
+
+LatencyStats& LatencyStats::Instance()
+{
+
+    static LatencyStats s_oStats;
+
+    return s_oStats;
+
+}
+
+int64_t LatencyStats::Func_Capture_Origin( double dSampleTime, int64_t nCallbackNs )
+{
+
+    int64_t nSampleNs = ( int64_t )( dSampleTime * 1000000000.0 );
+
+    int64_t nOffset = nCallbackNs - nSampleNs;
+
+    int64_t nMinOffset = m_nSampleOffsetNs.load( std::memory_order_relaxed );
+
+    while( nOffset < nMinOffset && m_nSampleOffsetNs.compare_exchange_weak( nMinOffset, nOffset, std::memory_order_relaxed ) == FALSE );
+
+    if( nOffset < nMinOffset ) nMinOffset = nOffset;
+
+    int64_t nOriginNs = nSampleNs + nMinOffset;
+
+    m_oHistogram_S[ LATENCY_STAGE_CALLBACK ].Record( nCallbackNs - nOriginNs );
+
+    return nOriginNs;
+
+}
+
+void LatencyStats::Record( LatencyStage eStage, int64_t nOriginNs )
+{
+
+    if( nOriginNs <= 0 ) return;
+
+    m_oHistogram_S[ eStage ].Record( Func_Latency_Now() - nOriginNs );
+
+}
+
+void LatencyStats::Reset()
+{
+
+    for( int i = 0; i < LATENCY_STAGE_COUNT; i++ ) m_oHistogram_S[ i ].Reset();
+
+    m_nSampleOffsetNs = INT64_MAX;
+
+}
+
+const char * LatencyStats::Func_Stage_Name( LatencyStage eStage )
+{
+
+    static const char * pszStageName_S[ LATENCY_STAGE_COUNT ] = {
+
+        "callback",
+
+        "live scale",
+
+        "sink push",
+
+        "crop scale",
+
+        "file write",
+
+        "infer scale",
+
+        "infer tensor",
+
+        "snapshot"
+
+    };
+
+    return pszStageName_S[ eStage ];
+
+}
+
+QString LatencyStats::Func_Summary_Text() const
+{
+
+    QStringList qszLines;
+
+    qszLines << QString( "%1 %2 %3 %4 %5 %6" )
+                .arg( "stage", -12 ).arg( "count", 8 ).arg( "p50", 8 ).arg( "p99", 8 ).arg( "p99.9", 8 ).arg( "max", 8 );
+
+    for( int i = 0; i < LATENCY_STAGE_COUNT; i++ ) {
+
+        LatencySummary summary = m_oHistogram_S[ i ].GetSummary();
+
+        ////// ms with two decimals
+
+        qszLines << QString( "%1 %2 %3 %4 %5 %6" )
+                    .arg( Func_Stage_Name( ( LatencyStage )i ), -12 )
+                    .arg( summary.st_nCount, 8 )
+                    .arg( summary.st_nP50 / 1000000.0, 8, 'f', 2 )
+                    .arg( summary.st_nP99 / 1000000.0, 8, 'f', 2 )
+                    .arg( summary.st_nP999 / 1000000.0, 8, 'f', 2 )
+                    .arg( summary.st_nMax / 1000000.0, 8, 'f', 2 );
+
+    }
+
+    return qszLines.join( "\n" );
+
+}
+
+void LatencyStats::Dump() const
+{
+
+    printf( "[QCAP DEBUG] Pipeline latency ( ms from capture ):\n%s\n", Func_Summary_Text().toUtf8().data() );
+
+}
@@ -0,0 +1,158 @@
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <QString>
+
+#include <atomic>
+#include <stdint.h>
+#include <time.h>
+
+#include <qcap.windef.h>
+
+////// Per-stage latency of the capture pipeline, measured on CLOCK_MONOTONIC from the
+////// estimated capture instant of each frame ( dSampleTime mapped onto the host clock ).
+
+enum LatencyStage {
+
+    LATENCY_STAGE_CALLBACK = 0,
+
+    LATENCY_STAGE_LIVE_SCALE,
+
+    LATENCY_STAGE_SINK_PUSH,
+
+    LATENCY_STAGE_CROP_SCALE,
+
+    LATENCY_STAGE_FILE_WRITE,
+
+    LATENCY_STAGE_INFER_SCALE,
+
+    LATENCY_STAGE_INFER_TENSOR,
+
+    LATENCY_STAGE_SNAPSHOT,
+
+    LATENCY_STAGE_COUNT
+
+};
+
+static inline int64_t Func_Latency_Now()
+{
+
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ( int64_t )ts.tv_sec * 1000000000LL + ts.tv_nsec;
+
+}
+
+////// HDR-style log-linear histogram: 2^( LATENCY_SUB_BITS - 1 ) linear buckets per power of two
+////// ( ~3% relative error ), values in ns up to 2^LATENCY_MAX_BITS. Record() is lock-free.
+
+#define LATENCY_SUB_BITS 6
+
+#define LATENCY_MAX_BITS 37
+
+#define LATENCY_BUCKET_NUM ( ( LATENCY_MAX_BITS - LATENCY_SUB_BITS + 2 ) << ( LATENCY_SUB_BITS - 1 ) )
+
+struct LatencySummary {
+
+    uint64_t    st_nCount   = 0;
+
+    int64_t     st_nP50     = 0;
+
+    int64_t     st_nP99     = 0;
+
+    int64_t     st_nP999    = 0;
+
+    int64_t     st_nMax     = 0;
+
+};
+
+class LatencyHistogram
+{
+
+public:
+
+    LatencyHistogram();
+
+    void Record( int64_t nValueNs );
+
+    void Reset();
+
+    LatencySummary GetSummary() const;
+
+private:
+
+    static int Func_Bucket_Index( uint64_t nValue );
+
+    static uint64_t Func_Bucket_Value( int nIndex );
+
+private:
+
+    std::atomic< uint64_t >     m_nCount_S[ LATENCY_BUCKET_NUM ];
+
+    std::atomic< uint64_t >     m_nTotal;
+
+    std::atomic< int64_t >      m_nMax;
+
+};
+
+////// Single producer / single consumer FIFO of frame timestamps, follows frames through a
+////// scaler: the pushing side stores the frame origin, the completion handler takes it back.
+
+#define LATENCY_STAMP_QUEUE_SIZE 16
+
+class LatencyStampQueue
+{
+
+public:
+
+    BOOL Push( int64_t nStampNs );
+
+    int64_t Pop();
+
+private:
+
+    int64_t                     m_nStamp_S[ LATENCY_STAMP_QUEUE_SIZE ] = { 0 };
+
+    std::atomic< uint32_t >     m_nHead { 0 };
+
+    std::atomic< uint32_t >     m_nTail { 0 };
+
+};
+
+class LatencyStats
+{
+
+public:
+
+    static LatencyStats& Instance();
+
+    ////// Maps a capture sample time ( seconds, device clock ) onto CLOCK_MONOTONIC, using the
+    ////// smallest observed delivery delay as the offset, and records the callback stage.
+
+    int64_t Func_Capture_Origin( double dSampleTime, int64_t nCallbackNs );
+
+    void Record( LatencyStage eStage, int64_t nOriginNs );
+
+    void Reset();
+
+    QString Func_Summary_Text() const;
+
+    void Dump() const;
+
+    static const char * Func_Stage_Name( LatencyStage eStage );
+
+private:
+
+    LatencyStats() {}
+
+private:
+
+    LatencyHistogram            m_oHistogram_S[ LATENCY_STAGE_COUNT ];
+
+    std::atomic< int64_t >      m_nSampleOffsetNs   { INT64_MAX };
+
+};
+
+#endif // LATENCYSTATS_H
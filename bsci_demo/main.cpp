@@ -4,6 +4,16 @@
 #include "logindialog.h"
 #include "setpassworddialog.h"
 #include "screenwatcher.h"
+#include "cpuconvert.h"
+#include "framecodec.h"
+#include "segmentstore.h"
+#include "archivewriter.h"
+#include "tensorbatcher.h"
+#include "framefence.h"
+#include "framepool.h"
+#include "testkit.h"
+#include <cstring>
+#include <cstdlib>
 
 bool hasConfig() {
     QFile file("config.json");
@@ -12,6 +22,58 @@ bool hasConfig() {
 
 int main(int argc, char *argv[])
 {
+    // CPU colour conversion self-test and throughput, no UI or capture device needed
+    if (argc > 1 && strcmp(argv[1], "--convert-bench") == 0) {
+        BOOL bPass = CpuConvert_SelfTest();
+        CpuConvert_Benchmark(SOURCE_WIDTH, SOURCE_HEIGHT, 1.0);
+        return (bPass == TRUE) ? 0 : 1;
+    }
+
+    // Inference tensors: self-test and frames/s for batch sizes 1 to 16
+    if (argc > 1 && strcmp(argv[1], "--tensor-bench") == 0) {
+        BOOL bPass = TensorBatcher_SelfTest();
+        TensorBatcher_Benchmark(INFER_FRAME_WIDTH, INFER_FRAME_HEIGHT, 1.0);
+        return (bPass == TRUE) ? 0 : 1;
+    }
+
+    // Inference frame fences: ordering self-test and latency next to a busy live stream
+    if (argc > 1 && strcmp(argv[1], "--fence-bench") == 0) {
+        BOOL bPass = FrameFence_SelfTest();
+        FrameFence_Benchmark(5.0);
+        return (bPass == TRUE) ? 0 : 1;
+    }
+
+    // Shared frame-buffer pool: recycling, pinned cap and trimming in system memory
+    if (argc > 1 && strcmp(argv[1], "--framepool-test") == 0) {
+        return (FramePool_SelfTest() == TRUE) ? 0 : 1;
+    }
+
+    // Event handler threads: --handler-bench [ max threads ] [ pin ], dispatch rate and latency
+    if (argc > 1 && strcmp(argv[1], "--handler-bench") == 0) {
+        __testkit__::PoolTestCase_Benchmark(argc > 2 ? atoi(argv[2]) : 4, argc > 3 && strcmp(argv[3], "pin") == 0, 3.0);
+        return 0;
+    }
+
+    // Stored crop codec: --codec-bench [ file.raw ] ( GBRP crop ), --decode in.bscf out.raw
+    if (argc > 1 && strcmp(argv[1], "--codec-bench") == 0) {
+        BOOL bPass = FrameCodec_Benchmark(argc > 2 ? argv[2] : nullptr, LIVE_FRAME_WIDTH, LIVE_FRAME_HEIGHT, 1.0);
+        return (bPass == TRUE) ? 0 : 1;
+    }
+
+    if (argc > 3 && strcmp(argv[1], "--decode") == 0) {
+        return (FrameCodec_File_Decode(argv[2], argv[3]) == TRUE) ? 0 : 1;
+    }
+
+    // Segment store: --segment-extract <folder> <frame number> out.raw
+    if (argc > 4 && strcmp(argv[1], "--segment-extract") == 0) {
+        return (SegmentStore_Frame_Extract(argv[2], strtoull(argv[3], nullptr, 10), argv[4]) == TRUE) ? 0 : 1;
+    }
+
+    // USB archive: --archive-extract <name>.manifest <member> out
+    if (argc > 4 && strcmp(argv[1], "--archive-extract") == 0) {
+        return (ArchiveWriter_Member_Extract(argv[2], argv[3], argv[4]) == TRUE) ? 0 : 1;
+    }
+
     QApplication a(argc, argv);
 
     screenwatcher watcher;
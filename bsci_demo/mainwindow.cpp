@@ -7,6 +7,8 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QMessageBox>
+#include <QShortcut>
+#include <QFontDatabase>
 
 MainWindow * g_pMain = nullptr;
 
@@ -104,48 +106,6 @@ void Func_OutputFolder_Check( const QString &qszPath )
 }
 
 
-void Func_OldestBmp_Delete( const QString &folderPath )
-{
-
-    QDirIterator DirIt( folderPath, {"*.bmp", "*.BMP"}, QDir::Files );
-
-    QFileInfo FileOldest;
-
-    BOOL bHasOldest = FALSE;
-
-    while( DirIt.hasNext() == TRUE ) {
-
-        DirIt.next();
-
-        QFileInfo FileTemp = DirIt.fileInfo();
-
-        if( bHasOldest == FALSE ) {
-
-            FileOldest = FileTemp;
-
-            bHasOldest = TRUE;
-
-        } else {
-
-            if( FileTemp.birthTime() < FileOldest.birthTime() ) {
-
-                FileOldest = FileTemp;
-
-            }
-
-        }
-
-    }
-
-    if( bHasOldest == TRUE ) {
-
-        QFile::remove( FileOldest.absoluteFilePath() );
-
-    }
-
-}
-
-
 QRETURN on_process_signal_removed(PVOID pDevice, ULONG nVideoInput, ULONG nAudioInput, PVOID pUserData )
 {
 
@@ -266,113 +226,234 @@ QRETURN on_process_video_preview( PVOID pDevice, double dSampleTime, BYTE* pFram
 
     Q_UNUSED( pDevice );
 
-    Q_UNUSED( dSampleTime );
-
     ULONG nDeviceIndex = ( uintptr_t ) pUserData ;
 
     Q_UNUSED( nDeviceIndex );
 
+    int64_t nOriginNs = LatencyStats::Instance().Func_Capture_Origin( dSampleTime, Func_Latency_Now() );
+
 
-    if( g_pMain->m_stFunc_Device.st_bSinkState == TRUE
-            && g_pMain->m_stFunc_Device.st_pSink_Live != nullptr ) {
+    ////// Fan out to the consumers, each one takes its own reference; ~MainWindow stops the
+    ////// capture before it deletes the bus
 
-        QRESULT QR = QCAP_RS_SUCCESSFUL;
+    FrameBus * pFrameBus = g_pMain->m_pFrameBus;
 
-        qcap2_rcbuffer_t * pSrcRCBuffer = qcap2_rcbuffer_cast( pFrameBuffer, nFrameBufferLen );
+    if( pFrameBus != nullptr ) {
 
-        std::shared_ptr< qcap2_rcbuffer_t > pDstLiveRCBuffer = nullptr;
+        ////// The cast wraps the bound preview buffer and the wrapper is ours: it is released
+        ////// here, once, whatever the consumers did. Nothing else casts the preview buffer,
+        ////// consumers only ever see the bus packet and add their own reference to keep it.
 
+        qcap2_rcbuffer_t * pCastRCBuffer = qcap2_rcbuffer_cast( pFrameBuffer, nFrameBufferLen );
 
-        ////// Capture to Live
+        if( pCastRCBuffer == nullptr ) {
 
-        if( g_pMain->m_stFunc_Device.st_bSinkState == TRUE
-                && g_pMain->m_stFunc_Device.st_pScaler_Live != nullptr ) {
+            printf( "[QCAP DEBUG] %s(%d): qcap2_rcbuffer_cast Failed!!! \n", __FUNCTION__, __LINE__ );
 
-            qcap2_video_scaler_push( g_pMain->m_stFunc_Device.st_pScaler_Live, pSrcRCBuffer );
+            return QCAP_RT_OK;
 
-            qcap2_rcbuffer_t * pLiveTempBuffer = nullptr;
+        }
 
-            qcap2_video_scaler_pop( g_pMain->m_stFunc_Device.st_pScaler_Live, &pLiveTempBuffer );
+        std::shared_ptr< qcap2_rcbuffer_t > pSrcRCBuffer( pCastRCBuffer, qcap2_rcbuffer_release );
 
-            pDstLiveRCBuffer.reset( pLiveTempBuffer, qcap2_rcbuffer_release );
+        pFrameBus->Publish( pSrcRCBuffer.get(), dSampleTime, nOriginNs );
 
-        } else {
+    }
 
-            pDstLiveRCBuffer.reset( pSrcRCBuffer, qcap2_rcbuffer_release );
+    return QCAP_RT_OK;
 
-        }
+}
+
+
+void on_consume_live( const FrameBusPacket &packet )
+{
+
+    if( g_pMain->m_stFunc_Device.st_bSinkState == FALSE
+            || g_pMain->m_stFunc_Device.st_pSink_Live == nullptr ) return;
+
+    QRESULT QR = QCAP_RS_SUCCESSFUL;
+
+
+    ////// Capture to Live ( completion handled by on_process_live_scaled )
 
-        QR = qcap2_video_sink_push( g_pMain->m_stFunc_Device.st_pSink_Live, pDstLiveRCBuffer.get() );
+    if( g_pMain->m_stFunc_Device.st_pScaler_Live != nullptr ) {
+
+        QR = qcap2_video_scaler_push( g_pMain->m_stFunc_Device.st_pScaler_Live, packet.pRCBuffer );
+
+        if( QR != QCAP_RS_SUCCESSFUL ) printf("[QCAP DEBUG] %s(%d): qcap2_video_scaler_push ( Live ) Failed ( %d )!!! \n", __FUNCTION__, __LINE__, QR );
+
+        else g_pMain->m_stFunc_Device.st_oStamp_Live.Push( packet.nOriginNs );
+
+    } else {
+
+        QR = qcap2_video_sink_push( g_pMain->m_stFunc_Device.st_pSink_Live, packet.pRCBuffer );
 
         if( QR != QCAP_RS_SUCCESSFUL ) printf("[QCAP DEBUG] %s(%d): qcap2_video_sink_push ( Video Preview callback ) Failed ( %d )!!! \n", __FUNCTION__, __LINE__, QR );
 
+        LatencyStats::Instance().Record( LATENCY_STAGE_SINK_PUSH, packet.nOriginNs );
+
+    }
 
-        ////// Live Crop to Output Data
+}
 
-        if( g_pMain->m_stFunc_Device.st_bSinkState == TRUE
-                && g_pMain->m_stFunc_Device.st_bStorageCropRaw == TRUE
-                && g_pMain->m_stFunc_Device.st_pScaler_Crop != nullptr ) {
 
-            //////
+void on_consume_crop( const FrameBusPacket &packet )
+{
 
-            if( g_pMain->m_stFunc_Device.st_bDiskOverwrite == TRUE ) Func_OldestBmp_Delete( g_pMain->m_qszOutputPath );
+    ////// Capture to Crop ( completion handled by on_process_crop_scaled ), the crop
+    ////// window is cut straight out of the captured frame
 
-            qcap2_video_scaler_push( g_pMain->m_stFunc_Device.st_pScaler_Crop, pDstLiveRCBuffer.get() );
+    if( g_pMain->m_stFunc_Device.st_bSinkState == FALSE
+            || g_pMain->m_stFunc_Device.st_pScaler_Crop == nullptr ) return;
 
-            qcap2_rcbuffer_t * pCropTempBuffer = nullptr;
+    ////// Taken in one step, a press that lands meanwhile is kept for the next frame
 
-            qcap2_video_scaler_pop( g_pMain->m_stFunc_Device.st_pScaler_Crop, &pCropTempBuffer );
+    if( g_pMain->m_stFunc_Device.st_bStorageCropRaw.exchange( FALSE ) == FALSE ) return;
 
-            std::shared_ptr< qcap2_rcbuffer_t > pRCBuffer1 ( pCropTempBuffer, qcap2_rcbuffer_release );
+    g_pMain->m_stFunc_Device.st_nCropCaptureTimeMs = QDateTime::currentMSecsSinceEpoch();
 
-            std::shared_ptr<qcap2_av_frame_t> pAVFrame1(
-             (qcap2_av_frame_t*)qcap2_rcbuffer_lock_data( pCropTempBuffer ),
-             [ pCropTempBuffer ]( qcap2_av_frame_t * ) {
-              qcap2_rcbuffer_unlock_data( pCropTempBuffer );
-             });
+    QRESULT QR = qcap2_video_scaler_push( g_pMain->m_stFunc_Device.st_pScaler_Crop, packet.pRCBuffer );
 
-            uint8_t* pBuffer[4];
+    if( QR != QCAP_RS_SUCCESSFUL ) printf("[QCAP DEBUG] %s(%d): qcap2_video_scaler_push ( Crop ) Failed ( %d )!!! \n", __FUNCTION__, __LINE__, QR );
 
-            int nStride[4];
+    else g_pMain->m_stFunc_Device.st_oStamp_Crop.Push( packet.nOriginNs );
 
-            qcap2_av_frame_get_buffer1( pAVFrame1.get(), pBuffer, nStride );
+}
 
-            ULONG mColorSpaceType = 0;
 
-            ULONG nBufferWidth = 0;
+void on_consume_fused( const FrameBusPacket &packet )
+{
 
-            ULONG nBufferHeight = 0;
+    FusedConverter * pConverter = g_pMain->m_stFunc_Device.st_pFusedConverter;
 
-            qcap2_av_frame_get_video_property( pAVFrame1.get(), &mColorSpaceType, &nBufferWidth, &nBufferHeight);
+    if( g_pMain->m_stFunc_Device.st_bSinkState == FALSE
+            || g_pMain->m_stFunc_Device.st_pSink_Live == nullptr
+            || pConverter == nullptr ) return;
 
-            ////// RAW DATA //////
+    ////// Read once: HwUninitialize removes this handler before ~MainWindow deletes the writer
 
-            FILE * pFp_Scaler = NULL;
+    CropWriter * pCropWriter = g_pMain->m_pCropWriter;
 
-            QString qszRecord_Path = g_pMain->m_qszOutputPath
-                    + QDateTime::currentDateTime().toString( Qt::ISODateWithMs )
-                    + QString( "_GBRPScaler" )
-                    + QString( "_W" ) + QString::number( LIVE_FRAME_WIDTH )
-                    + QString( "_H" ) + QString::number( LIVE_FRAME_HEIGHT )
-                    + QString( ".raw" );
+    BOOL bCrop = ( pCropWriter != nullptr && g_pMain->m_stFunc_Device.st_bStorageCropRaw.exchange( FALSE ) == TRUE ) ? TRUE : FALSE;
 
-            pFp_Scaler = fopen( qszRecord_Path.toUtf8().data(), "wb" );
+    if( bCrop == TRUE ) g_pMain->m_stFunc_Device.st_nCropCaptureTimeMs = QDateTime::currentMSecsSinceEpoch();
 
-            for( UINT iFrameHeight = 0 ; iFrameHeight < nBufferHeight; iFrameHeight++ ) fwrite( pBuffer[ 0 ] + iFrameHeight * nStride[ 0 ], 1, nBufferWidth, pFp_Scaler );
+    qcap2_rcbuffer_t * pLiveTempBuffer = nullptr;
 
-            for( UINT iFrameHeight = 0 ; iFrameHeight < nBufferHeight; iFrameHeight++ ) fwrite( pBuffer[ 1 ] + iFrameHeight * nStride[ 1 ], 1, nBufferWidth, pFp_Scaler );
+    qcap2_rcbuffer_t * pCropTempBuffer = nullptr;
 
-            for( UINT iFrameHeight = 0 ; iFrameHeight < nBufferHeight; iFrameHeight++ ) fwrite( pBuffer[ 2 ] + iFrameHeight * nStride[ 2 ], 1, nBufferWidth, pFp_Scaler );
+    QRESULT QR = pConverter->Convert( packet.pRCBuffer, bCrop, &pLiveTempBuffer, &pCropTempBuffer );
 
-            fclose( pFp_Scaler );
+    if( QR != QCAP_RS_SUCCESSFUL ) {
 
-            printf("[QCAP DEBUG] Try storage GBRP to: %s\n", qszRecord_Path.toUtf8().data() );
+        printf("[QCAP DEBUG] %s(%d): FusedConverter::Convert Failed ( %d )!!! \n", __FUNCTION__, __LINE__, QR );
 
-            ////// RAW DATA //////
+        ////// The press was taken but nothing came of it, the next frame tries again
 
-            g_pMain->m_stFunc_Device.st_bStorageCropRaw = FALSE;
+        if( bCrop == TRUE ) g_pMain->m_stFunc_Device.st_bStorageCropRaw = TRUE;
 
-        }
+        return;
+
+    }
+
+    std::shared_ptr< qcap2_rcbuffer_t > pDstLiveRCBuffer( pLiveTempBuffer, qcap2_rcbuffer_release );
+
+    LatencyStats::Instance().Record( LATENCY_STAGE_LIVE_SCALE, packet.nOriginNs );
+
+    QR = qcap2_video_sink_push( g_pMain->m_stFunc_Device.st_pSink_Live, pDstLiveRCBuffer.get() );
+
+    if( QR != QCAP_RS_SUCCESSFUL ) printf("[QCAP DEBUG] %s(%d): qcap2_video_sink_push ( Video Preview callback ) Failed ( %d )!!! \n", __FUNCTION__, __LINE__, QR );
+
+    LatencyStats::Instance().Record( LATENCY_STAGE_SINK_PUSH, packet.nOriginNs );
+
+    if( pCropTempBuffer != nullptr ) {
+
+        std::shared_ptr< qcap2_rcbuffer_t > pRCBuffer1 ( pCropTempBuffer, qcap2_rcbuffer_release );
+
+        LatencyStats::Instance().Record( LATENCY_STAGE_CROP_SCALE, packet.nOriginNs );
+
+        BOOL bQueued = pCropWriter->Push( pCropTempBuffer, g_pMain->m_stFunc_Device.st_nCropCaptureTimeMs, packet.nOriginNs );
+
+        if( bQueued == FALSE ) printf( "[QCAP DEBUG] %s(%d): crop writer queue full, frame rejected\n", __FUNCTION__, __LINE__ );
+
+    } else if( bCrop == TRUE ) {
+
+        g_pMain->m_stFunc_Device.st_bStorageCropRaw = TRUE;
+
+    }
+
+}
+
+
+QRETURN on_process_live_scaled( qcap2_video_scaler_t * pVsca )
+{
+
+    QRESULT QR = QCAP_RS_SUCCESSFUL;
+
+    qcap2_rcbuffer_t * pLiveTempBuffer = nullptr;
+
+    QR = qcap2_video_scaler_pop( pVsca, &pLiveTempBuffer );
+
+    if( QR != QCAP_RS_SUCCESSFUL || pLiveTempBuffer == nullptr ) {
+
+        printf("[QCAP DEBUG] %s(%d): qcap2_video_scaler_pop ( Live ) Failed ( %d )!!! \n", __FUNCTION__, __LINE__, QR );
+
+        return QCAP_RT_FAIL;
+
+    }
+
+    std::shared_ptr< qcap2_rcbuffer_t > pDstLiveRCBuffer( pLiveTempBuffer, qcap2_rcbuffer_release );
+
+    int64_t nOriginNs = g_pMain->m_stFunc_Device.st_oStamp_Live.Pop();
+
+    LatencyStats::Instance().Record( LATENCY_STAGE_LIVE_SCALE, nOriginNs );
+
+    if( g_pMain->m_stFunc_Device.st_bSinkState == FALSE ) return QCAP_RT_OK;
+
+    QR = qcap2_video_sink_push( g_pMain->m_stFunc_Device.st_pSink_Live, pDstLiveRCBuffer.get() );
+
+    if( QR != QCAP_RS_SUCCESSFUL ) printf("[QCAP DEBUG] %s(%d): qcap2_video_sink_push ( Video Preview callback ) Failed ( %d )!!! \n", __FUNCTION__, __LINE__, QR );
+
+    LatencyStats::Instance().Record( LATENCY_STAGE_SINK_PUSH, nOriginNs );
+
+    return QCAP_RT_OK;
+
+}
+
+
+QRETURN on_process_crop_scaled( qcap2_video_scaler_t * pVsca )
+{
+
+    QRESULT QR = QCAP_RS_SUCCESSFUL;
+
+    qcap2_rcbuffer_t * pCropTempBuffer = nullptr;
+
+    QR = qcap2_video_scaler_pop( pVsca, &pCropTempBuffer );
+
+    if( QR != QCAP_RS_SUCCESSFUL || pCropTempBuffer == nullptr ) {
+
+        printf("[QCAP DEBUG] %s(%d): qcap2_video_scaler_pop ( Crop ) Failed ( %d )!!! \n", __FUNCTION__, __LINE__, QR );
+
+        return QCAP_RT_FAIL;
+
+    }
+
+    std::shared_ptr< qcap2_rcbuffer_t > pRCBuffer1 ( pCropTempBuffer, qcap2_rcbuffer_release );
+
+    int64_t nOriginNs = g_pMain->m_stFunc_Device.st_oStamp_Crop.Pop();
+
+    LatencyStats::Instance().Record( LATENCY_STAGE_CROP_SCALE, nOriginNs );
+
+    ////// Hand off to the writer stage, eviction and file I/O happen on its thread; read once,
+    ////// HwUninitialize removes this handler before ~MainWindow deletes the writer
+
+    CropWriter * pCropWriter = g_pMain->m_pCropWriter;
+
+    if( pCropWriter != nullptr ) {
+
+        BOOL bQueued = pCropWriter->Push( pCropTempBuffer, g_pMain->m_stFunc_Device.st_nCropCaptureTimeMs, nOriginNs );
+
+        if( bQueued == FALSE ) printf( "[QCAP DEBUG] %s(%d): crop writer queue full, frame rejected\n", __FUNCTION__, __LINE__ );
 
     }
 
@@ -401,29 +482,97 @@ QRETURN on_process_audio_preview( PVOID pDevice, double dSampleTime, BYTE* pFram
 }
 
 
-QRESULT new_video_cudahostbuf( free_stack_t& _FreeStack_, ULONG nColorSpaceType, ULONG nWidth, ULONG nHeight, unsigned int nFlags, qcap2_rcbuffer_t** ppRCBuffer ) {
+QRESULT new_event( free_stack_t& _FreeStack_, qcap2_event_t** ppEvent ) {
 
     QRESULT qres = QCAP_RS_SUCCESSFUL;
 
     switch(1) { case 1:
-        qcap2_rcbuffer_t* pRCBuffer = qcap2_rcbuffer_new_av_frame();
-        _FreeStack_ += [pRCBuffer]() {
-            qcap2_rcbuffer_delete(pRCBuffer);
+        qcap2_event_t* pEvent = qcap2_event_new();
+        _FreeStack_ += [pEvent]() {
+            qcap2_event_delete(pEvent);
+        };
+
+        qres = qcap2_event_start(pEvent);
+        if(qres != QCAP_RS_SUCCESSFUL) {
+            printf("[QCAP DEBUG] %s(%d): qcap2_event_start() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+            break;
+        }
+        _FreeStack_ += [pEvent]() {
+            QRESULT qres;
+            qres = qcap2_event_stop(pEvent);
+            if(qres != QCAP_RS_SUCCESSFUL) {
+                printf("[QCAP DEBUG] %s(%d): qcap2_event_stop() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+            }
+        };
+
+        *ppEvent = pEvent;
+    }
+
+    return qres;
+
+}
+
+
+QRESULT new_event_handlers( free_stack_t& _FreeStack_, qcap2_event_handlers_t** ppEventHandlers ) {
+
+    QRESULT qres = QCAP_RS_SUCCESSFUL;
+
+    switch(1) { case 1:
+        qcap2_event_handlers_t* pEventHandlers = qcap2_event_handlers_new();
+        _FreeStack_ += [pEventHandlers]() {
+            qcap2_event_handlers_delete(pEventHandlers);
+        };
+
+        qres = qcap2_event_handlers_start(pEventHandlers);
+        if(qres != QCAP_RS_SUCCESSFUL) {
+            printf("[QCAP DEBUG] %s(%d): qcap2_event_handlers_start() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+            break;
+        }
+        _FreeStack_ += [pEventHandlers]() {
+            QRESULT qres;
+            qres = qcap2_event_handlers_stop(pEventHandlers);
+            if(qres != QCAP_RS_SUCCESSFUL) {
+                printf("[QCAP DEBUG] %s(%d): qcap2_event_handlers_stop() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+            }
         };
 
-        qcap2_av_frame_t* pAVFrame = (qcap2_av_frame_t*)qcap2_rcbuffer_get_data(pRCBuffer);
-        qcap2_av_frame_set_video_property(pAVFrame, nColorSpaceType, nWidth, nHeight);
+        *ppEventHandlers = pEventHandlers;
+    }
+
+    return qres;
+
+}
+
 
-        if(! qcap2_av_frame_alloc_cuda_host_buffer(pAVFrame, nFlags, 32, 1)) {
-            qres = QCAP_RS_ERROR_OUT_OF_MEMORY;
-            printf("[QCAP DEBUG] %s(%d): qcap2_av_frame_alloc_cuda_host_buffer() failed", __FUNCTION__, __LINE__);
+QRESULT add_event_handler( free_stack_t& _FreeStack_, qcap2_event_handlers_t* pEventHandlers, qcap2_event_t* pEvent, const callback_t::cb_func_t& func ) {
+
+    QRESULT qres = QCAP_RS_SUCCESSFUL;
+
+    switch(1) { case 1:
+        uintptr_t nHandle;
+        qres = qcap2_event_get_native_handle(pEvent, &nHandle);
+        if(qres != QCAP_RS_SUCCESSFUL) {
+            printf("[QCAP DEBUG] %s(%d): qcap2_event_get_native_handle() failed, qres=%d", __FUNCTION__, __LINE__, qres);
             break;
         }
-        _FreeStack_ += [pAVFrame]() {
-            qcap2_av_frame_free_cuda_host_buffer(pAVFrame);
+
+        callback_t* pCallback = new callback_t(func);
+        _FreeStack_ += [pCallback]() {
+            delete pCallback;
         };
 
-        *ppRCBuffer = pRCBuffer;
+        qres = qcap2_event_handlers_add_handler(pEventHandlers, nHandle, callback_t::_func, pCallback);
+        if(qres != QCAP_RS_SUCCESSFUL) {
+            printf("[QCAP DEBUG] %s(%d): qcap2_event_handlers_add_handler() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+            break;
+        }
+        _FreeStack_ += [pEventHandlers, nHandle]() {
+            QRESULT qres;
+            qres = qcap2_event_handlers_remove_handler(pEventHandlers, nHandle);
+            if(qres != QCAP_RS_SUCCESSFUL) {
+                printf("[QCAP DEBUG] %s(%d): qcap2_event_handlers_remove_handler() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+            }
+        };
     }
 
     return qres;
@@ -448,12 +597,43 @@ MainWindow::MainWindow(QWidget *parent) :
 
     Func_OutputFolder_Check( m_qszOutputPath );
 
-    m_infer = new processinference(ui->Frame_Infer, m_qszOutputPath, INFER_FRAME_WIDTH, INFER_FRAME_HEIGHT);
+    ////// Retention index first, it has to see the segments the store opens. The accountant
+    ////// reserves space for every write and asks the index to evict when the disk runs low.
+
+    m_pRetention = new RetentionIndex( m_qszOutputPath );
+
+    ////// Capture writes and the USB export share the disk through the I/O scheduler
+
+    m_pIoScheduler = new IoScheduler();
+
+    m_pDiskAccountant = new DiskAccountant( m_qszOutputPath );
+
+    m_pDiskAccountant->SetEvictHandler( [ this ]( uint64_t nBytes ) { m_pRetention->Request( nBytes ); } );
+
+#if SEGMENT_STORE_ENABLE
+
+    m_pSegmentStore = new SegmentStore( m_qszOutputPath, m_pRetention, m_pDiskAccountant, m_pIoScheduler );
+
+#endif
 
+    m_stCropStore.st_qszOutputPath = m_qszOutputPath;
 
-    ////// Auto Detect Disk Usage ( Per 2 Sec Check )
+    m_stCropStore.st_bCompress = CROP_COMPRESS_ENABLE;
 
-    m_qtStorage = QStorageInfo( QDir( QCoreApplication::applicationFilePath() ) );
+    m_stCropStore.st_pStore = m_pSegmentStore;
+
+    m_stCropStore.st_pRetention = m_pRetention;
+
+    m_stCropStore.st_pAccountant = m_pDiskAccountant;
+
+    m_stCropStore.st_pIoScheduler = m_pIoScheduler;
+
+    m_pCropWriter = new CropWriter( m_stCropStore, CROP_WRITER_QUEUE_DEPTH );
+
+    m_pFrameBus = new FrameBus();
+
+
+    ////// Disk Usage Display ( Per 2 Sec ), overwrite itself follows the accountant
 
     m_stFunc_Device.st_pDiskUsageTimer = new QTimer( this );
 
@@ -473,7 +653,43 @@ MainWindow::MainWindow(QWidget *parent) :
 
     ui->Frame_Infer->setAspectRatio( INFER_FRAME_WIDTH * 1.0 / INFER_FRAME_HEIGHT );
 
-    ////// Output Folder Bmp File
+    ////// Pipeline Latency Overlay ( F11 dumps latency, frame bus and writer stats to stdout )
+
+    m_pLabel_Latency = new QLabel( this );
+
+    m_pLabel_Latency->setFont( QFontDatabase::systemFont( QFontDatabase::FixedFont ) );
+
+    ui->verticalLayout->addWidget( m_pLabel_Latency );
+
+    m_pLatencyTimer = new QTimer( this );
+
+    connect( m_pLatencyTimer, &QTimer::timeout, this, &MainWindow::Func_Latency_Update );
+
+    m_pLatencyTimer->start( LATENCY_OVERLAY_INTERVAL );
+
+    QShortcut * pShortcut_Latency = new QShortcut( QKeySequence( Qt::Key_F11 ), this );
+
+    connect( pShortcut_Latency, &QShortcut::activated, this, &MainWindow::Func_PipelineStats_Dump );
+
+    ////// F10 stores the next inference frame as a snapshot
+
+    QShortcut * pShortcut_Snapshot = new QShortcut( QKeySequence( Qt::Key_F10 ), this );
+
+    connect( pShortcut_Snapshot, &QShortcut::activated, this, [ this ]() { if( m_infer != nullptr ) m_infer->TriggerSnapshot(); } );
+
+    ////// Output Folder Bmp File, the newest one is decoded off the GUI thread and previewed
+
+    m_pLabel_Thumbnail = new QLabel( this );
+
+    m_pLabel_Thumbnail->setFixedSize( THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT );
+
+    m_pLabel_Thumbnail->setAlignment( Qt::AlignCenter );
+
+    ui->verticalLayout->addWidget( m_pLabel_Thumbnail );
+
+    m_pThumbnailLoader = new ThumbnailLoader( QSize( THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT ), THUMBNAIL_DECODE_THREADS, this );
+
+    connect( m_pThumbnailLoader, &ThumbnailLoader::Signal_Thumbnail_Ready, this, &MainWindow::Func_Thumbnail_Show );
 
     BmpFinder * loader = new BmpFinder( m_qszOutputPath, BMP_SCAN_INTERVAL, this );
 
@@ -489,9 +705,22 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->progressBar->setValue(0);
     ui->labelStatus->setText("Waiting for USB Plugin...");
 
+    m_pUsbExporter = new UsbExporter( m_pIoScheduler, this );
+
+    connect( m_pUsbExporter, &UsbExporter::Signal_Export_Progress, this, &MainWindow::Func_Export_Progress );
+
+    connect( m_pUsbExporter, &UsbExporter::Signal_Export_Finished, this, &MainWindow::Func_Export_Finished );
+
+    ////// Mount events drive USB detection, the timer only repeats the move while a stick is in
+
+    m_pUsbMonitor = new UsbMonitor( this );
+
+    connect( m_pUsbMonitor, &UsbMonitor::Signal_Usb_Mounted, this, &MainWindow::checkUsb );
+
+    connect( m_pUsbMonitor, &UsbMonitor::Signal_Usb_Removed, this, &MainWindow::checkUsb );
+
     timer = new QTimer(this);
     connect(timer, &QTimer::timeout, this, &MainWindow::checkUsb);
-    timer->start(2000);
 
     // Check if the USB is already plugged in when the app starts
     QString usbPath = detectUsbPath();
@@ -500,15 +729,12 @@ MainWindow::MainWindow(QWidget *parent) :
         ui->labelStatus->setText("USB already plugged in: " + usbPath);
         printf("Detected USB at startup: %s\n", usbPath.toStdString().c_str());
         lastUsbPath = usbPath;  // Set it as the last detected USB
+        timer->start(USB_MOVE_INTERVAL);
         copyRecursively(sourceDir, usbPath); // Start copying files immediately
     }
 
     HwInitialize();
 
-    Func_Live_Scaler_Init( m_stFunc_Device.st_oFreeStack, 0, 0, SOURCE_WIDTH, SOURCE_HEIGHT, &m_stFunc_Device.st_pScaler_Live );
-
-    Func_Live_Sink_Init( m_stFunc_Device.st_oFreeStack, QCAP_COLORSPACE_TYPE_I420, SOURCE_WIDTH, SOURCE_HEIGHT, ui->Frame_Live, &m_stFunc_Device.st_pSink_Live );
-
     ULONG nCropX = 0;
 
     if( ( SOURCE_WIDTH - LIVE_FRAME_WIDTH ) / 2 > 0 ) nCropX = ( SOURCE_WIDTH - LIVE_FRAME_WIDTH ) / 2;
@@ -517,174 +743,494 @@ MainWindow::MainWindow(QWidget *parent) :
 
     if( ( SOURCE_HEIGHT - LIVE_FRAME_HEIGHT ) / 2 > 0 ) nCropY = ( SOURCE_HEIGHT - LIVE_FRAME_HEIGHT ) / 2;
 
-    Func_Crop_Scaler_Init( m_stFunc_Device.st_oFreeStack, nCropX, nCropY, LIVE_FRAME_WIDTH, LIVE_FRAME_HEIGHT, &m_stFunc_Device.st_pScaler_Crop );
+#if FUSED_CONVERT_ENABLE
+
+    ////// One pass over the captured NV12 produces both the live I420 and the GBRP crop
+
+    Func_Fused_Converter_Init( m_stFunc_Device.st_oFreeStack, nCropX, nCropY, LIVE_FRAME_WIDTH, LIVE_FRAME_HEIGHT, &m_stFunc_Device.st_pFusedConverter );
+
+    Func_Live_Sink_Init( m_stFunc_Device.st_oFreeStack, QCAP_COLORSPACE_TYPE_I420, SOURCE_WIDTH, SOURCE_HEIGHT, ui->Frame_Live, &m_stFunc_Device.st_pSink_Live );
+
+    FrameBusParam stFusedParam;
+
+    stFusedParam.st_strName = "fused";
+
+    stFusedParam.st_nQueueDepth = 2;
+
+    stFusedParam.st_ePolicy = FRAME_DROP_OLDEST;
+
+    m_pFrameBus->Subscribe( stFusedParam, &on_consume_fused );
+
+#else
+
+    ////// Live and crop completions run on their own event handler threads, so the
+    ////// capture callback only pushes and the two conversions overlap
+
+    new_event_handlers( m_stFunc_Device.st_oFreeStack, &m_stFunc_Device.st_pEventHandlers_Live );
+
+    new_event_handlers( m_stFunc_Device.st_oFreeStack, &m_stFunc_Device.st_pEventHandlers_Crop );
+
+    new_event( m_stFunc_Device.st_oFreeStack, &m_stFunc_Device.st_pEvent_Live );
+
+    new_event( m_stFunc_Device.st_oFreeStack, &m_stFunc_Device.st_pEvent_Crop );
+
+    Func_Live_Scaler_Init( m_stFunc_Device.st_oFreeStack, 0, 0, SOURCE_WIDTH, SOURCE_HEIGHT, m_stFunc_Device.st_pEvent_Live, &m_stFunc_Device.st_pScaler_Live );
+
+    Func_Live_Sink_Init( m_stFunc_Device.st_oFreeStack, QCAP_COLORSPACE_TYPE_I420, SOURCE_WIDTH, SOURCE_HEIGHT, ui->Frame_Live, &m_stFunc_Device.st_pSink_Live );
+
+    Func_Crop_Scaler_Init( m_stFunc_Device.st_oFreeStack, nCropX, nCropY, LIVE_FRAME_WIDTH, LIVE_FRAME_HEIGHT, m_stFunc_Device.st_pEvent_Crop, &m_stFunc_Device.st_pScaler_Crop );
+
+    if( m_stFunc_Device.st_pScaler_Live != nullptr ) {
+
+        add_event_handler( m_stFunc_Device.st_oFreeStack, m_stFunc_Device.st_pEventHandlers_Live, m_stFunc_Device.st_pEvent_Live,
+                           std::bind( &on_process_live_scaled, m_stFunc_Device.st_pScaler_Live ) );
+
+    }
+
+    if( m_stFunc_Device.st_pScaler_Crop != nullptr ) {
+
+        add_event_handler( m_stFunc_Device.st_oFreeStack, m_stFunc_Device.st_pEventHandlers_Crop, m_stFunc_Device.st_pEvent_Crop,
+                           std::bind( &on_process_crop_scaled, m_stFunc_Device.st_pScaler_Crop ) );
+
+    }
+
+    ////// Frame Bus Consumers ( queued frames pin capture buffers, keep the total depth
+    ////// well below MAX_CUDA_BUFFER_NUM )
+
+    FrameBusParam stLiveParam;
+
+    stLiveParam.st_strName = "live";
+
+    stLiveParam.st_nQueueDepth = 2;
+
+    stLiveParam.st_ePolicy = FRAME_DROP_OLDEST;
+
+    m_pFrameBus->Subscribe( stLiveParam, &on_consume_live );
+
+    FrameBusParam stCropParam;
+
+    stCropParam.st_strName = "crop";
+
+    stCropParam.st_nQueueDepth = 1;
+
+    stCropParam.st_ePolicy = FRAME_DROP_OLDEST;
+
+    m_pFrameBus->Subscribe( stCropParam, &on_consume_crop );
+
+#endif
+
+#if CROP_RING_ENABLE
+
+    ////// Pre-trigger ring on its own bus thread, fed at the rate it was sized for
+
+    CropRingParam stRingParam;
+
+    stRingParam.st_nSrcWidth = SOURCE_WIDTH;
+
+    stRingParam.st_nSrcHeight = SOURCE_HEIGHT;
+
+    stRingParam.st_nCropX = nCropX;
+
+    stRingParam.st_nCropY = nCropY;
+
+    stRingParam.st_nCropW = LIVE_FRAME_WIDTH;
+
+    stRingParam.st_nCropH = LIVE_FRAME_HEIGHT;
+
+    m_pCropRing = new CropRing( m_stCropStore, stRingParam );
+
+    FrameBusParam stRingBusParam;
+
+    stRingBusParam.st_strName = "ring";
+
+    stRingBusParam.st_dTargetRate = stRingParam.st_dFps;
+
+    stRingBusParam.st_nQueueDepth = 2;
+
+    stRingBusParam.st_ePolicy = FRAME_DROP_OLDEST;
+
+    m_pFrameBus->Subscribe( stRingBusParam, [ this ]( const FrameBusPacket &packet ) { m_pCropRing->Push( packet ); } );
+
+#endif
+
+    ////// Inference sees the live crop window, scaled from the captured frame itself. One
+    ////// queued frame that newer ones replace, at the inference rate
+
+    m_infer = new processinference(ui->Frame_Infer, m_qszOutputPath, INFER_FRAME_WIDTH, INFER_FRAME_HEIGHT, nCropX, nCropY, LIVE_FRAME_WIDTH, LIVE_FRAME_HEIGHT, m_pIoScheduler);
+
+#if INFER_TEST_PATTERN_ENABLE == 0
+
+    FrameBusParam stInferParam;
+
+    stInferParam.st_strName = "infer";
+
+    stInferParam.st_dTargetRate = INFER_FRAME_RATE;
+
+    stInferParam.st_nQueueDepth = 1;
+
+    stInferParam.st_ePolicy = FRAME_DROP_OLDEST;
+
+    m_nInferBusId = m_pFrameBus->Subscribe( stInferParam, [ this ]( const FrameBusPacket &packet ) { m_infer->Push( packet ); } );
+
+#endif
+
+}
+
+
+void MainWindow::HwInitialize()
+{
+
+    //CREATE SOFTWARE CAPTURE SOURCE ( BENCHMARK / REGRESSION, NO CARD REQUIRED )
+
+    SoftCaptureParam stSoftParam;
+
+    if( SoftCapture::Func_Param_FromEnv( SOURCE_WIDTH, SOURCE_HEIGHT, &stSoftParam ) == TRUE ) {
+
+        m_pSoftCapture = new SoftCapture( stSoftParam );
+
+        m_pSoftCapture->RegisterFormatChangedCallback( on_process_format_changed, ( PVOID ) ( ULONG ) 0 );
+
+        m_pSoftCapture->RegisterVideoPreviewCallback( on_process_video_preview, ( PVOID ) ( ULONG ) 0 );
+
+        if( m_pSoftCapture->Run() != QCAP_RS_SUCCESSFUL ) {
+
+            printf( "[QCAP DEBUG] Soft capture source %s failed to start\n", stSoftParam.st_qszSource.toUtf8().data() );
+
+            delete m_pSoftCapture;
+
+            m_pSoftCapture = nullptr;
+
+        }
+
+        return;
+
+    }
+
+    //CREATE CAPTURE DEVICE
+
+    char CapDevName[ ] = "SC0710 PCI";
+
+    QCAP_CREATE( CapDevName, 0, NULL, &m_hDevice, TRUE, FALSE );
+
+    if( m_hDevice != nullptr ) {
+
+        ULONG nVcheck = QCAP_INPUT_TYPE_HDMI;
+
+        ULONG nVcurrent = 0;
+
+        QCAP_GET_VIDEO_INPUT( m_hDevice, &( nVcurrent ) );
+
+        if( nVcurrent != nVcheck ) QCAP_SET_VIDEO_INPUT( m_hDevice, nVcheck );
+
+        ULONG nAcheck = QCAP_INPUT_TYPE_EMBEDDED_AUDIO;
+
+        ULONG nAcurrent = 0;
+
+        QCAP_GET_AUDIO_INPUT( m_hDevice, &( nAcurrent ) );
+
+        if( nAcurrent != nAcheck ) QCAP_SET_AUDIO_INPUT( m_hDevice, nAcheck );
+
+        QCAP_REGISTER_NO_SIGNAL_DETECTED_CALLBACK( m_hDevice, on_process_no_signal_detected, ( PVOID ) ( ULONG ) 0 );
+
+        QCAP_REGISTER_SIGNAL_REMOVED_CALLBACK( m_hDevice, on_process_signal_removed, ( PVOID ) ( ULONG ) 0 );
+
+        QCAP_REGISTER_FORMAT_CHANGED_CALLBACK( m_hDevice, on_process_format_changed, ( PVOID ) ( ULONG ) 0 );
+
+        QCAP_REGISTER_VIDEO_PREVIEW_CALLBACK( m_hDevice, on_process_video_preview, ( PVOID ) ( ULONG ) 0 );
+
+        QCAP_REGISTER_AUDIO_PREVIEW_CALLBACK( m_hDevice, on_process_audio_preview, ( PVOID ) ( ULONG ) 0 );
+
+        QCAP_SET_VIDEO_DEFAULT_OUTPUT_FORMAT( m_hDevice, m_stParam_Device.st_nVideoColorSpaceType, 0, 0, 0, 0 );
+
+        QCAP_SET_DEVICE_CUSTOM_PROPERTY( m_hDevice, QCAP_DEVPROP_IO_METHOD, 1 );
+
+        for( INT iBufferCount = 0; iBufferCount < MAX_CUDA_BUFFER_NUM; iBufferCount++ ) {
+
+            QCAP_ALLOC_VIDEO_GPUDIRECT_PREVIEW_BUFFER( m_hDevice, &m_stFunc_Device.st_pCUDABuffer_S[ iBufferCount ], SOURCE_WIDTH * SOURCE_HEIGHT * 2 );
+
+            QCAP_BIND_VIDEO_GPUDIRECT_PREVIEW_BUFFER( m_hDevice, iBufferCount, m_stFunc_Device.st_pCUDABuffer_S[ iBufferCount ], SOURCE_WIDTH * SOURCE_HEIGHT * 2 );
+
+            printf( "[QCAP DEBUG] CUDA buffer id:%d, pointer:%p \n", iBufferCount, m_stFunc_Device.st_pCUDABuffer_S[ iBufferCount ] );
+
+        }
+
+        QCAP_RUN( m_hDevice );
+
+        m_bDeviceRunning = TRUE;
+
+    }
+
+}
+
+
+QString MainWindow::detectUsbPath()
+{
+    ////// Newest writable mount below /media/$USER or /run/media/$USER, kept by the monitor
+
+    const std::vector< UsbMount > &oMount_S = m_pUsbMonitor->GetMounts();
+
+    if (oMount_S.empty()) {
+        return "";
+    }
+
+    return oMount_S.back().st_qszMountPath;
+}
+
+bool MainWindow::copyRecursively(const QString &srcPath, const QString &dstPath)
+{
+    //    printf("copy image\n");
+
+    QDir srcDir(srcPath);
+    QStringList files = srcDir.entryList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+
+    if (files.isEmpty()) {
+        return false; // nothing to move
+    }
+
+    ////// The export thread moves the files, progress comes back through Func_Export_Progress
+
+    ////// The stick's file system UUID keys the resume journal
+
+    QString qszDeviceId;
+
+    for( const UsbMount &mount : m_pUsbMonitor->GetMounts() ) if( mount.st_qszMountPath == dstPath ) qszDeviceId = mount.st_qszDeviceId;
+
+    if( m_pUsbExporter->Start( srcPath, dstPath, qszDeviceId, ( USB_EXPORT_ARCHIVE_ENABLE == 1 ) ? USB_EXPORT_MODE_ARCHIVE : USB_EXPORT_MODE_FILES ) == FALSE ) {
+        return false;
+    }
+
+    ui->labelStatus->setText("Copying files...");
+    ui->progressBar->setRange(0, 100);
+    ui->progressBar->setValue(0);
+
+    return true;
+}
+
+void MainWindow::Func_Export_Progress( const QString &fileName, int nFilePercent, qint64 nBytesDone, qint64 nBytesTotal )
+{
+
+    ui->labelStatus->setText( QString( "Copying %1 ( %2% )" ).arg( fileName ).arg( nFilePercent ) );
+
+    ui->progressBar->setValue( ( nBytesTotal > 0 ) ? ( int )( nBytesDone * 100 / nBytesTotal ) : 100 );
+
+}
+
+void MainWindow::Func_Export_Finished( bool bOk, int nFilesMoved, const QString &dstPath )
+{
+
+    if( bOk ) {
+
+        ui->labelStatus->setText( QString( "✅ %1 files moved to: %2" ).arg( nFilesMoved ).arg( dstPath ) );
+
+        ui->progressBar->setValue( 100 );
+
+    } else {
+
+        ui->labelStatus->setText( QString( "⚠️ Copy stopped after %1 files, resumes when the USB is back" ).arg( nFilesMoved ) );
+
+    }
+
+}
+
+void MainWindow::checkUsb()
+{
+    QString usbPath = detectUsbPath();
+
+    if (!usbPath.isEmpty()) {
+        // USB detected
+        if (usbPath != lastUsbPath) {
+            ui->labelStatus->setText("Detected USB: " + usbPath);
+            printf("Detected USB: %s\n", usbPath.toStdString().c_str());
+            if (!lastUsbPath.isEmpty()) {
+                m_pUsbExporter->Cancel();
+            }
+            lastUsbPath = usbPath;
+            timer->start(USB_MOVE_INTERVAL);
+        }
+
+        // Continuously move files while USB is plugged in, once the running export is done
+        if (m_pUsbExporter->IsRunning() == FALSE) {
+            bool ok = copyRecursively(sourceDir, usbPath);
+            if (!ok) {
+                ui->labelStatus->setText("⚠️ No new files to move or copy failed");
+            }
+        }
+    }
+    else if (usbPath.isEmpty() && !lastUsbPath.isEmpty()) {
+        // USB removed, the export journal keeps its place for the next plug-in
+        m_pUsbExporter->Cancel();
+        timer->stop();
+        ui->labelStatus->setText("USB Removed");
+        ui->progressBar->setValue(0);
+        lastUsbPath.clear();
+    }
+}
+
+void MainWindow::Func_Capture_Stop()
+{
+
+    ////// Returns once no video preview callback runs or will run
+
+    m_stFunc_Device.st_bSinkState = FALSE;
+
+    if( m_pSoftCapture != nullptr ) {
+
+        printf( "[QCAP DEBUG] Soft capture: %lu frames delivered, %lu ticks missed\n", ( ULONG )m_pSoftCapture->GetFramesDelivered(), ( ULONG )m_pSoftCapture->GetFramesLate() );
+
+        delete m_pSoftCapture;
+
+        m_pSoftCapture = nullptr;
+
+    }
+
+    if( m_hDevice != nullptr && m_bDeviceRunning == TRUE ) {
+
+        QCAP_STOP( m_hDevice );
+
+        m_bDeviceRunning = FALSE;
+
+    }
+
+}
+
+
+void MainWindow::HwUninitialize()
+{
+
+    //DESTROY CAPTURE DEVICE
+
+    Func_Capture_Stop();
+
+    ////// Scalers, fused converter and their event handlers; the device buffers they may
+    ////// still reference stay until QCAP_DESTROY below
+
+    m_stFunc_Device.st_oFreeStack.flush();
+
+    if( m_hDevice != nullptr ) {
+
+        QCAP_DESTROY( m_hDevice );
+
+        m_hDevice = nullptr;
+
+    }
 
 }
 
 
-void MainWindow::HwInitialize()
+MainWindow::~MainWindow()
 {
+    ////// No more frames into the inference scaler before it goes away
 
-    //CREATE CAPTURE DEVICE
-
-    char CapDevName[ ] = "SC0710 PCI";
+    if( m_pFrameBus != nullptr && m_nInferBusId > 0 ) {
 
-    QCAP_CREATE( CapDevName, 0, NULL, &m_hDevice, TRUE, FALSE );
+        m_pFrameBus->Unsubscribe( m_nInferBusId );
 
-    if( m_hDevice != nullptr ) {
+        m_nInferBusId = 0;
 
-        ULONG nVcheck = QCAP_INPUT_TYPE_HDMI;
+    }
 
-        ULONG nVcurrent = 0;
+    if (m_infer) {
+        delete m_infer;
+        m_infer = nullptr;
+    }
 
-        QCAP_GET_VIDEO_INPUT( m_hDevice, &( nVcurrent ) );
+    ////// A running export stops at its next chunk, the journal resumes it on the next start
 
-        if( nVcurrent != nVcheck ) QCAP_SET_VIDEO_INPUT( m_hDevice, nVcheck );
+    if( m_pUsbExporter != nullptr ) {
 
-        ULONG nAcheck = QCAP_INPUT_TYPE_EMBEDDED_AUDIO;
+        UsbExporter * pUsbExporter = m_pUsbExporter;
 
-        ULONG nAcurrent = 0;
+        m_pUsbExporter = nullptr;
 
-        QCAP_GET_AUDIO_INPUT( m_hDevice, &( nAcurrent ) );
+        delete pUsbExporter;
 
-        if( nAcurrent != nAcheck ) QCAP_SET_AUDIO_INPUT( m_hDevice, nAcheck );
+    }
 
-        QCAP_REGISTER_NO_SIGNAL_DETECTED_CALLBACK( m_hDevice, on_process_no_signal_detected, ( PVOID ) ( ULONG ) 0 );
+    ////// Producers before consumers: the capture callback publishes into the bus, the bus
+    ////// threads push into the scalers and the scaler handlers push into the ring and the
+    ////// writer, so each stage is stopped before the one it feeds is deleted
 
-        QCAP_REGISTER_SIGNAL_REMOVED_CALLBACK( m_hDevice, on_process_signal_removed, ( PVOID ) ( ULONG ) 0 );
+    Func_Capture_Stop();
 
-        QCAP_REGISTER_FORMAT_CHANGED_CALLBACK( m_hDevice, on_process_format_changed, ( PVOID ) ( ULONG ) 0 );
+    if( m_pFrameBus != nullptr ) {
 
-        QCAP_REGISTER_VIDEO_PREVIEW_CALLBACK( m_hDevice, on_process_video_preview, ( PVOID ) ( ULONG ) 0 );
+        FrameBus * pFrameBus = m_pFrameBus;
 
-        QCAP_REGISTER_AUDIO_PREVIEW_CALLBACK( m_hDevice, on_process_audio_preview, ( PVOID ) ( ULONG ) 0 );
+        m_pFrameBus = nullptr;
 
-        QCAP_SET_VIDEO_DEFAULT_OUTPUT_FORMAT( m_hDevice, m_stParam_Device.st_nVideoColorSpaceType, 0, 0, 0, 0 );
+        delete pFrameBus;
 
-        QCAP_SET_DEVICE_CUSTOM_PROPERTY( m_hDevice, QCAP_DEVPROP_IO_METHOD, 1 );
+    }
 
-        for( INT iBufferCount = 0; iBufferCount < MAX_CUDA_BUFFER_NUM; iBufferCount++ ) {
+    HwUninitialize();
 
-            QCAP_ALLOC_VIDEO_GPUDIRECT_PREVIEW_BUFFER( m_hDevice, &m_stFunc_Device.st_pCUDABuffer_S[ iBufferCount ], SOURCE_WIDTH * SOURCE_HEIGHT * 2 );
+    ////// The scaler frames the ring and the writer still hold went back to the FramePool
+    ////// idle, they stay allocated while both drain
 
-            QCAP_BIND_VIDEO_GPUDIRECT_PREVIEW_BUFFER( m_hDevice, iBufferCount, m_stFunc_Device.st_pCUDABuffer_S[ iBufferCount ], SOURCE_WIDTH * SOURCE_HEIGHT * 2 );
+    if( m_pCropRing != nullptr ) {
 
-            printf( "[QCAP DEBUG] CUDA buffer id:%d, pointer:%p \n", iBufferCount, m_stFunc_Device.st_pCUDABuffer_S[ iBufferCount ] );
+        CropRing * pCropRing = m_pCropRing;
 
-        }
+        m_pCropRing = nullptr;
 
-        QCAP_RUN( m_hDevice );
+        delete pCropRing;
 
     }
 
-}
+    if( m_pCropWriter != nullptr ) {
 
+        CropWriter * pCropWriter = m_pCropWriter;
 
-QString MainWindow::detectUsbPath()
-{
-    QStringList mountRoots = {"/media", "/run/media"};
-    QString user = qgetenv("USER");
+        m_pCropWriter = nullptr;
 
-    for (const QString &root : mountRoots) {
-        QDir base(root + "/" + user);
-        if (!base.exists())
-            continue;
+        delete pCropWriter;
 
-        QStringList disks = base.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-        for (const QString &d : disks) {
-            QString full = base.absoluteFilePath(d);
-            QFileInfo fi(full);
-            if (fi.isDir() && fi.isWritable()) {
-                return full;
-            }
-        }
     }
-    return "";
-}
 
-bool MainWindow::copyRecursively(const QString &srcPath, const QString &dstPath)
-{
-    //    printf("copy image\n");
+    ////// Both writers are gone, closing trims the open segment
 
-    QDir srcDir(srcPath);
-    QStringList files = srcDir.entryList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    if( m_pSegmentStore != nullptr ) {
 
-    if (files.isEmpty()) {
-        return false; // nothing to move
-    }
+        SegmentStore * pSegmentStore = m_pSegmentStore;
 
-    ui->labelStatus->setText("Copying files...");
-    ui->progressBar->setRange(0, 0);
+        m_pSegmentStore = nullptr;
 
-    QProcess process;
-    QString cmd = QString("bash -c \"mv '%1'/* '%2'/\"").arg(srcPath, dstPath);
-    int ret = process.execute(cmd);
+        delete pSegmentStore;
 
-    ui->progressBar->setRange(0, 100);
-    ui->progressBar->setValue(100);
+    }
 
-    return (ret == 0);
-}
+    if( m_pDiskAccountant != nullptr ) {
 
-void MainWindow::checkUsb()
-{
-    QString usbPath = detectUsbPath();
+        DiskAccountant * pDiskAccountant = m_pDiskAccountant;
 
-    if (!usbPath.isEmpty()) {
-        // USB detected
-        if (usbPath != lastUsbPath) {
-            ui->labelStatus->setText("Detected USB: " + usbPath);
-            printf("Detected USB: %s\n", usbPath.toStdString().c_str());
-            lastUsbPath = usbPath;
-        }
+        m_pDiskAccountant = nullptr;
 
-        // Continuously move files while USB is plugged in
-        bool ok = copyRecursively(sourceDir, usbPath);
-        if (ok) {
-            ui->labelStatus->setText("✅ Files moved to: " + usbPath);
-        } else {
-            ui->labelStatus->setText("⚠️ No new files to move or copy failed");
-        }
-    }
-    else if (usbPath.isEmpty() && !lastUsbPath.isEmpty()) {
-        // USB removed
-        ui->labelStatus->setText("USB Removed");
-        ui->progressBar->setValue(0);
-        lastUsbPath.clear();
-    }
-}
+        delete pDiskAccountant;
 
-void MainWindow::HwUninitialize()
-{
+    }
 
-    //DESTROY CAPTURE DEVICE
+    if( m_pRetention != nullptr ) {
 
-    m_stFunc_Device.st_bSinkState = FALSE;
+        RetentionIndex * pRetention = m_pRetention;
 
-    m_stFunc_Device.st_oFreeStack.flush();
+        m_pRetention = nullptr;
 
-    if( m_hDevice != nullptr ) {
+        delete pRetention;
 
-        QCAP_STOP( m_hDevice );
+    }
 
-        QCAP_DESTROY( m_hDevice );
+    ////// Last, the exporter and both writers are gone
 
-        m_hDevice = nullptr;
+    if( m_pIoScheduler != nullptr ) {
 
-    }
+        IoScheduler * pIoScheduler = m_pIoScheduler;
 
-}
+        m_pIoScheduler = nullptr;
 
+        delete pIoScheduler;
 
-MainWindow::~MainWindow()
-{
-    if (m_infer) {
-        delete m_infer;
-        m_infer = nullptr;
     }
 
-    HwUninitialize();
-
     m_stParam_Device.st_nVideoWidth              = 0;
 
     m_stParam_Device.st_nVideoHeight             = 0;
@@ -746,15 +1292,13 @@ void MainWindow::on_btn_changepassword_clicked()
 void MainWindow::Func_DiskUsage_Update()
 {
 
-    double dTriggerPercentage = 90.0;
+    ////// Display only, the accountant samples the disk on every write and switches overwrite
 
-    m_qtStorage.refresh();
+    DiskAccountStats stats = m_pDiskAccountant->GetStats();
 
-    qint64 total = m_qtStorage.bytesTotal();
+    qint64 total = ( qint64 )stats.st_nBytesTotal;
 
-    qint64 free  = m_qtStorage.bytesAvailable();
-
-    qint64 used  = total - free;
+    qint64 used  = total - ( qint64 )stats.st_nBytesFree;
 
     double dUsedPercent = ( total > 0 ) ? ( double )used / total * 100.0 : 0.0;
 
@@ -762,44 +1306,227 @@ void MainWindow::Func_DiskUsage_Update()
             .arg( total / 1024.0 / 1024.0 / 1024.0, 0, 'f', 2 )
             .arg( used / 1024.0 / 1024.0 / 1024.0, 0, 'f', 2 );
 
+    if( stats.st_dSecondsToFull >= 0.0 ) qszDiskInfoLabel += QString( ", full in %1 min" ).arg( stats.st_dSecondsToFull / 60.0, 0, 'f', 1 );
+
     ui->Label_DiskUsage->setText( qszDiskInfoLabel );
 
     ui->ProgressBar_DiskUsage->setValue( ( int )dUsedPercent );
 
-    if( dUsedPercent >= dTriggerPercentage ) {
+    if( stats.st_bOverwrite == TRUE ) {
 
         ui->ProgressBar_DiskUsage->setStyleSheet( "QProgressBar::chunk {background-color: red;} QProgressBar{text-align: center;}" );
 
         ui->Label_DiskInfo->setText( "Local storage saving shall continue, overwriting oldest data using FIFO buffer" );
 
-        if( m_stFunc_Device.st_bDiskOverwrite == FALSE ) {
+    } else {
+
+        ui->ProgressBar_DiskUsage->setStyleSheet( "" );
+
+    }
+
+}
+
 
-            printf( "[QCAP DEBUG] Disk usage exceeds %d%. Local storage saving shall continue, Overwriting oldest data using FIFO Mode\n", ( UINT )dTriggerPercentage );
+void MainWindow::Func_PipelineStats_Dump()
+{
+
+    LatencyStats::Instance().Dump();
+
+    if( m_pFrameBus != nullptr ) {
+
+        for( const FrameBusStats &stats : m_pFrameBus->GetStats() ) {
+
+            printf( "[QCAP DEBUG] Frame bus %-10s depth %lu, delivered %lu, dropped %lu, skipped %lu\n"
+                    , stats.st_strName.c_str(), stats.st_nDepth
+                    , ( ULONG )stats.st_nDelivered, ( ULONG )stats.st_nDropped, ( ULONG )stats.st_nSkipped );
 
         }
 
-        m_stFunc_Device.st_bDiskOverwrite = TRUE;
+    }
 
-    } else {
+    if( m_infer != nullptr ) {
 
-        ui->ProgressBar_DiskUsage->setStyleSheet( "" );
+        InferStats stats = m_infer->GetStats();
+
+        printf( "[QCAP DEBUG] Inference pushed %lu, completed %lu, skipped busy %lu, failed %lu\n"
+                , ( ULONG )stats.st_nPushed, ( ULONG )stats.st_nCompleted, ( ULONG )stats.st_nSkippedBusy, ( ULONG )stats.st_nFailed );
+
+        printf( "[QCAP DEBUG] Inference %s wait avg %.2f ms, max %.2f ms\n", ( INFER_FENCE_ENABLE == 1 ) ? "fence" : "device sync"
+                , ( stats.st_nSyncWaits > 0 ) ? stats.st_nSyncWaitNs / 1e6 / stats.st_nSyncWaits : 0.0, stats.st_nSyncWaitMaxNs / 1e6 );
+
+        std::vector< __testkit__::handler_shard_stats_t > stShard_S = m_infer->GetHandlerStats();
+
+        for( size_t i = 0; i < stShard_S.size(); i++ ) {
+
+            printf( "[QCAP DEBUG] Inference handler thread %lu: sources %d, handled %lu, busy %.1f ms\n"
+                    , ( ULONG )i, stShard_S[ i ].sources, ( ULONG )stShard_S[ i ].handled, stShard_S[ i ].busy_us / 1e3 );
+
+        }
+
+        TensorBatcherStats stTensor = m_infer->GetTensorStats();
+
+        printf( "[QCAP DEBUG] Inference tensors: %lu frames in %lu batches ( %lu at the deadline ), dropped %lu\n"
+                , ( ULONG )stTensor.st_nFrames, ( ULONG )stTensor.st_nBatches, ( ULONG )stTensor.st_nPartial, ( ULONG )stTensor.st_nDropped );
+
+        SnapshotStats stSnapshot = m_infer->GetSnapshotStats();
+
+        printf( "[QCAP DEBUG] Snapshots depth %lu, queued %lu, encoded %lu, dropped %lu, failed %lu, encode avg %.2f ms, max %.2f ms\n"
+                , stSnapshot.st_nDepth, ( ULONG )stSnapshot.st_nQueued, ( ULONG )stSnapshot.st_nEncoded, ( ULONG )stSnapshot.st_nDropped
+                , ( ULONG )stSnapshot.st_nFailed, stSnapshot.st_dEncodeAvgMs, stSnapshot.st_dEncodeMaxMs );
+
+    }
+
+    if( m_stFunc_Device.st_pFusedConverter != nullptr ) {
+
+        printf( "[QCAP DEBUG] Fused converter crops dropped, every slot held by the writer: %lu\n"
+                , ( ULONG )m_stFunc_Device.st_pFusedConverter->GetCropBusyDrops() );
+
+    }
+
+    FramePoolStats stPool = FramePool::Instance().GetStats();
+
+    printf( "[QCAP DEBUG] Frame pool pinned %.1f MB ( high water %.1f MB, cap %.1f MB ), system %.1f MB, trimmed %.1f MB, refused %lu, bad releases %lu\n"
+            , stPool.st_nPinnedBytes / 1048576.0, stPool.st_nPinnedHighWater / 1048576.0, stPool.st_nPinnedCap / 1048576.0
+            , stPool.st_nSystemBytes / 1048576.0, stPool.st_nTrimmedBytes / 1048576.0, ( ULONG )stPool.st_nRefused, ( ULONG )stPool.st_nBadReleases );
+
+    for( const FramePoolClassStats &stClass : stPool.st_stClass_S ) {
+
+        printf( "[QCAP DEBUG] Frame pool %s %lux%lu cs %lu: in use %lu ( high water %lu ), allocated %lu, acquired %lu, recycled %lu\n"
+                , ( stClass.st_stKey.st_eMemory == FRAME_POOL_MEMORY_CUDA_HOST ) ? "cudahost" : "system"
+                , stClass.st_stKey.st_nWidth, stClass.st_stKey.st_nHeight, stClass.st_stKey.st_nColorSpaceType
+                , stClass.st_nInUse, stClass.st_nHighWater, stClass.st_nAllocated, ( ULONG )stClass.st_nAcquired, ( ULONG )stClass.st_nRecycled );
+
+    }
+
+    if( m_pCropWriter != nullptr ) {
+
+        CropWriterStats stats = m_pCropWriter->GetStats();
+
+        printf( "[QCAP DEBUG] Crop writer depth %lu, in flight %lu bytes, written %lu, rejected %lu, failed %lu\n"
+                , stats.st_nDepth, ( ULONG )stats.st_nBytesInFlight
+                , ( ULONG )stats.st_nFramesWritten, ( ULONG )stats.st_nFramesRejected, ( ULONG )stats.st_nFramesFailed );
+
+    }
+
+    if( m_pCropRing != nullptr ) {
+
+        CropRingStats stats = m_pCropRing->GetStats();
+
+        printf( "[QCAP DEBUG] Crop ring slots %lu, pinned %lu, stored %lu, dropped %lu, written %lu, triggers %lu\n"
+                , stats.st_nSlots, stats.st_nPinned, ( ULONG )stats.st_nFramesStored
+                , ( ULONG )stats.st_nFramesDropped, ( ULONG )stats.st_nFramesWritten, ( ULONG )stats.st_nTriggers );
+
+    }
+
+    if( m_pSegmentStore != nullptr ) {
+
+        SegmentStoreStats stats = m_pSegmentStore->GetStats();
+
+        printf( "[QCAP DEBUG] Segment store segment %lu, frames %lu, %lu MB, errors %lu\n"
+                , ( ULONG )stats.st_nSequence, ( ULONG )stats.st_nFramesWritten, ( ULONG )( stats.st_nBytesWritten >> 20 )
+                , ( ULONG )stats.st_nWriteErrors );
+
+    }
+
+    if( m_pDiskAccountant != nullptr ) {
+
+        DiskAccountStats stats = m_pDiskAccountant->GetStats();
+
+        printf( "[QCAP DEBUG] Disk accountant free %lu MB, reserved %lu MB, %.1f MB/s, full in %.0f s, overwrite %d, rejected %lu, evict requested %lu MB\n"
+                , ( ULONG )( stats.st_nBytesFree >> 20 ), ( ULONG )( stats.st_nBytesReserved >> 20 ), stats.st_dWriteRate / 1e6
+                , stats.st_dSecondsToFull, stats.st_bOverwrite, ( ULONG )stats.st_nReserveRejected, ( ULONG )( stats.st_nBytesEvictRequested >> 20 ) );
+
+    }
+
+    if( m_pRetention != nullptr ) {
+
+        RetentionStats stats = m_pRetention->GetStats();
+
+        printf( "[QCAP DEBUG] Retention %s files %lu, %lu MB, pending %lu MB, evicted %lu files / %lu MB\n"
+                , ( stats.st_bSeeded == TRUE ) ? "seeded" : "seeding", stats.st_nFiles, ( ULONG )( stats.st_nBytes >> 20 )
+                , ( ULONG )( stats.st_nBytesPending >> 20 ), ( ULONG )stats.st_nFilesEvicted, ( ULONG )( stats.st_nBytesEvicted >> 20 ) );
+
+    }
 
-        m_stFunc_Device.st_bDiskOverwrite = FALSE;
+    if( m_pIoScheduler != nullptr ) {
+
+        IoSchedStats stats = m_pIoScheduler->GetStats();
+
+        const char * pszClass[ IO_CLASS_COUNT ] = { "capture", "export" };
+
+        for( int i = 0; i < IO_CLASS_COUNT; i++ ) {
+
+            const IoClassStats &stClass = stats.st_stClass[ i ];
+
+            printf( "[QCAP DEBUG] I/O %-7s %.1f MB/s, %lu MB in %lu writes, wait avg %.1f ms, max %.1f ms\n"
+                    , pszClass[ i ], stClass.st_dRate / ( 1 << 20 ), ( ULONG )( stClass.st_nBytes >> 20 ), ( ULONG )stClass.st_nOps
+                    , stClass.st_dWaitAvgMs, stClass.st_dWaitMaxMs );
+
+        }
+
+        printf( "[QCAP DEBUG] I/O export limit %.0f MB/s, backoffs %lu\n", stats.st_dExportLimit / ( 1 << 20 ), ( ULONG )stats.st_nBackoffs );
+
+    }
+
+    if( m_pUsbExporter != nullptr ) {
+
+        UsbExportStats stats = m_pUsbExporter->GetStats();
+
+        printf( "[QCAP DEBUG] USB export jobs %lu, moved %lu files / %lu MB, syncs %lu, resumed %lu, verify failed %lu, errors %lu\n"
+                , ( ULONG )stats.st_nJobs, ( ULONG )stats.st_nFilesMoved, ( ULONG )( stats.st_nBytesCopied >> 20 ), ( ULONG )stats.st_nSyncs
+                , ( ULONG )stats.st_nFilesResumed, ( ULONG )stats.st_nVerifyFailed, ( ULONG )stats.st_nErrors );
+
+        if( stats.st_nArchives > 0 ) {
+
+            printf( "[QCAP DEBUG] USB archives %lu, %lu MB tar -> %lu MB written\n"
+                    , ( ULONG )stats.st_nArchives, ( ULONG )( stats.st_nArchiveBytesIn >> 20 ), ( ULONG )( stats.st_nBytesCopied >> 20 ) );
+
+        }
+
+    }
+
+    if( m_pThumbnailLoader != nullptr ) {
+
+        ThumbnailStats stats = m_pThumbnailLoader->GetStats();
+
+        printf( "[QCAP DEBUG] Thumbnails requested %lu, coalesced %lu, cache hits %lu, decoded %lu, failed %lu, cached %lu\n"
+                , ( ULONG )stats.st_nRequests, ( ULONG )stats.st_nCoalesced, ( ULONG )stats.st_nCacheHits
+                , ( ULONG )stats.st_nDecoded, ( ULONG )stats.st_nDecodeFailed, stats.st_nCached );
 
     }
 
 }
 
 
+void MainWindow::Func_Latency_Update()
+{
+
+    m_pLabel_Latency->setText( LatencyStats::Instance().Func_Summary_Text() );
+
+}
+
+
 void MainWindow::Func_OutputBmp_Update( const QString &path )
 {
 
     printf( "[QCAP DEBUG] New bmp file found: %s\n", path.toUtf8().data() );
 
+    m_pThumbnailLoader->Slot_Thumbnail_Request( path );
+
+}
+
+
+void MainWindow::Func_Thumbnail_Show( const QString &path, const QImage &image )
+{
+
+    m_pLabel_Thumbnail->setPixmap( QPixmap::fromImage( image ) );
+
+    m_pLabel_Thumbnail->setToolTip( path );
+
 }
 
 
-QRESULT MainWindow::Func_Live_Scaler_Init( free_stack_t& _FreeStack_, ULONG nCropX, ULONG nCropY, ULONG nCropW, ULONG nCropH, qcap2_video_scaler_t** ppVsca )
+QRESULT MainWindow::Func_Live_Scaler_Init( free_stack_t& _FreeStack_, ULONG nCropX, ULONG nCropY, ULONG nCropW, ULONG nCropH, qcap2_event_t* pEvent, qcap2_video_scaler_t** ppVsca )
 {
 
     QRESULT qres = QCAP_RS_SUCCESSFUL;
@@ -815,24 +1542,23 @@ QRESULT MainWindow::Func_Live_Scaler_Init( free_stack_t& _FreeStack_, ULONG nCro
         _FreeStack_ += [pRCBuffers]() {
             delete[] pRCBuffers;
         };
-        for(int i = 0;i < nBuffers;i++) {
-            qcap2_rcbuffer_t* pRCBuffer;
-            qres = new_video_cudahostbuf(_FreeStack_,
-                                         nColorSpaceType, nCropW, nCropH, cudaHostAllocMapped, &pRCBuffer);
-            if(qres != QCAP_RS_SUCCESSFUL) {
-                printf("[QCAP DEBUG] %s(%d): __testkit__::new_video_cudahostbuf() failed, qres=%d", __FUNCTION__, __LINE__, qres);
-                break;
-            }
-            pRCBuffers[i] = pRCBuffer;
+        qres = FramePool::Instance().Acquire(nColorSpaceType, nCropW, nCropH, FRAME_POOL_MEMORY_CUDA_HOST, nBuffers, pRCBuffers);
+        if(qres != QCAP_RS_SUCCESSFUL) {
+            printf("[QCAP DEBUG] %s(%d): FramePool::Acquire() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+            break;
         }
+        _FreeStack_ += [pRCBuffers, nBuffers]() {
+            FramePool::Instance().Release(pRCBuffers, nBuffers);
+        };
 
         qcap2_video_scaler_set_backend_type(pVsca, QCAP2_VIDEO_SCALER_BACKEND_TYPE_NPP);
-        qcap2_video_scaler_set_multithread(pVsca, false);
+        qcap2_video_scaler_set_multithread(pVsca, true);
         qcap2_video_scaler_set_frame_count(pVsca, nBuffers);
         qcap2_video_scaler_set_buffers(pVsca, &pRCBuffers[0]);
         qcap2_video_scaler_set_src_buffer_hint(pVsca, QCAP2_BUFFER_HINT_CUDAHOST);
         qcap2_video_scaler_set_dst_buffer_hint(pVsca, QCAP2_BUFFER_HINT_CUDAHOST);
         qcap2_video_scaler_set_crop(pVsca, nCropX, nCropY, nCropW, nCropH);
+        qcap2_video_scaler_set_event(pVsca, pEvent);
 
     {
         std::shared_ptr<qcap2_video_format_t> pVideoFormat(
@@ -919,7 +1645,7 @@ QRESULT MainWindow::Func_Live_Sink_Init( free_stack_t& _FreeStack_, ULONG nColor
 }
 
 
-QRESULT MainWindow::Func_Crop_Scaler_Init( free_stack_t& _FreeStack_, ULONG nCropX, ULONG nCropY, ULONG nCropW, ULONG nCropH, qcap2_video_scaler_t** ppVsca )
+QRESULT MainWindow::Func_Crop_Scaler_Init( free_stack_t& _FreeStack_, ULONG nCropX, ULONG nCropY, ULONG nCropW, ULONG nCropH, qcap2_event_t* pEvent, qcap2_video_scaler_t** ppVsca )
 {
 
     QRESULT qres = QCAP_RS_SUCCESSFUL;
@@ -935,24 +1661,23 @@ QRESULT MainWindow::Func_Crop_Scaler_Init( free_stack_t& _FreeStack_, ULONG nCro
         _FreeStack_ += [pRCBuffers]() {
             delete[] pRCBuffers;
         };
-        for(int i = 0;i < nBuffers;i++) {
-            qcap2_rcbuffer_t* pRCBuffer;
-            qres = new_video_cudahostbuf(_FreeStack_,
-                                         nColorSpaceType, nCropW, nCropH, cudaHostAllocMapped, &pRCBuffer);
-            if(qres != QCAP_RS_SUCCESSFUL) {
-                printf("[QCAP DEBUG] %s(%d): __testkit__::new_video_cudahostbuf() failed, qres=%d", __FUNCTION__, __LINE__, qres);
-                break;
-            }
-            pRCBuffers[i] = pRCBuffer;
+        qres = FramePool::Instance().Acquire(nColorSpaceType, nCropW, nCropH, FRAME_POOL_MEMORY_CUDA_HOST, nBuffers, pRCBuffers);
+        if(qres != QCAP_RS_SUCCESSFUL) {
+            printf("[QCAP DEBUG] %s(%d): FramePool::Acquire() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+            break;
         }
+        _FreeStack_ += [pRCBuffers, nBuffers]() {
+            FramePool::Instance().Release(pRCBuffers, nBuffers);
+        };
 
         qcap2_video_scaler_set_backend_type(pVsca, QCAP2_VIDEO_SCALER_BACKEND_TYPE_NPP);
-        qcap2_video_scaler_set_multithread(pVsca, false);
+        qcap2_video_scaler_set_multithread(pVsca, true);
         qcap2_video_scaler_set_frame_count(pVsca, nBuffers);
         qcap2_video_scaler_set_buffers(pVsca, &pRCBuffers[0]);
         qcap2_video_scaler_set_src_buffer_hint(pVsca, QCAP2_BUFFER_HINT_CUDAHOST);
         qcap2_video_scaler_set_dst_buffer_hint(pVsca, QCAP2_BUFFER_HINT_CUDAHOST);
         qcap2_video_scaler_set_crop(pVsca, nCropX, nCropY, nCropW, nCropH);
+        qcap2_video_scaler_set_event(pVsca, pEvent);
 
     {
 
@@ -988,9 +1713,95 @@ QRESULT MainWindow::Func_Crop_Scaler_Init( free_stack_t& _FreeStack_, ULONG nCro
 }
 
 
+QRESULT MainWindow::Func_Fused_Converter_Init( free_stack_t& _FreeStack_, ULONG nCropX, ULONG nCropY, ULONG nCropW, ULONG nCropH, FusedConverter** ppConverter )
+{
+
+    QRESULT qres = QCAP_RS_SUCCESSFUL;
+    switch(1) { case 1:
+        const int nBuffers = 4;
+
+        qcap2_rcbuffer_t** pLiveRCBuffers = new qcap2_rcbuffer_t*[nBuffers];
+        _FreeStack_ += [pLiveRCBuffers]() {
+            delete[] pLiveRCBuffers;
+        };
+        qcap2_rcbuffer_t** pCropRCBuffers = new qcap2_rcbuffer_t*[nBuffers];
+        _FreeStack_ += [pCropRCBuffers]() {
+            delete[] pCropRCBuffers;
+        };
+        ////// The CPU backend writes plain system memory, no CUDA device needed
+
+        const FramePoolMemory eMemory = (FusedConverter::Func_Cuda_Available() == TRUE) ? FRAME_POOL_MEMORY_CUDA_HOST : FRAME_POOL_MEMORY_SYSTEM;
+
+        qres = FramePool::Instance().Acquire(QCAP_COLORSPACE_TYPE_I420, SOURCE_WIDTH, SOURCE_HEIGHT, eMemory, nBuffers, pLiveRCBuffers);
+        if(qres != QCAP_RS_SUCCESSFUL) {
+            printf("[QCAP DEBUG] %s(%d): FramePool::Acquire() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+            break;
+        }
+        _FreeStack_ += [pLiveRCBuffers, nBuffers]() {
+            FramePool::Instance().Release(pLiveRCBuffers, nBuffers);
+        };
+
+        qres = FramePool::Instance().Acquire(QCAP_COLORSPACE_TYPE_GBRP, nCropW, nCropH, eMemory, nBuffers, pCropRCBuffers);
+        if(qres != QCAP_RS_SUCCESSFUL) {
+            printf("[QCAP DEBUG] %s(%d): FramePool::Acquire() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+            break;
+        }
+        _FreeStack_ += [pCropRCBuffers, nBuffers]() {
+            FramePool::Instance().Release(pCropRCBuffers, nBuffers);
+        };
+
+        FusedConverter* pConverter = new FusedConverter(SOURCE_WIDTH, SOURCE_HEIGHT, nCropX, nCropY, nCropW, nCropH);
+        _FreeStack_ += [pConverter]() {
+            delete pConverter;
+        };
+
+        qres = pConverter->Start(pLiveRCBuffers, pCropRCBuffers, nBuffers);
+        if(qres != QCAP_RS_SUCCESSFUL) {
+            printf("[QCAP DEBUG] %s(%d): FusedConverter::Start() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+            break;
+        }
+
+        ////// Crop slots still queued in the writer are not overwritten
+        pConverter->SetCropBusyCheck([this](qcap2_rcbuffer_t* pRCBuffer) {
+            CropWriter* pCropWriter = m_pCropWriter;
+            return (pCropWriter != nullptr) ? pCropWriter->Holds(pRCBuffer) : FALSE;
+        });
+
+        *ppConverter = pConverter;
+
+    }
+
+    return qres;
+
+}
+
+
+void MainWindow::on_BTN_StorgeCropData_pressed()
+{
+
+    ////// The window is centred on the press, not on the release that makes the click. Still
+    ////// stamped when the event loop gets to the press, so a busy loop shifts it by that much
+
+    m_nCropPressNs = Func_Latency_Now();
+
+}
+
+
 void MainWindow::on_BTN_StorgeCropData_clicked()
 {
 
+    ////// The ring picks frames by capture time, from the press stamp however late the click runs
+
+    if( m_pCropRing != nullptr ) {
+
+        m_pCropRing->Trigger( ( m_nCropPressNs > 0 ) ? m_nCropPressNs : Func_Latency_Now() );
+
+        m_nCropPressNs = 0;
+
+        return;
+
+    }
+
     m_stFunc_Device.st_bStorageCropRaw = TRUE;
 
 }
@@ -7,9 +7,11 @@
 #include <QProcess>
 #include <QtGui>
 #include <QFrame>
+#include <QLabel>
 
 #include <cstdlib>
 #include <stack>
+#include <atomic>
 
 #include <qcap.h>
 #include <qcap.linux.h>
@@ -23,12 +25,28 @@
 #include <processinference.h>
 #include <aspectratioframe.h>
 #include <bmpfinder.h>
+#include <thumbnailloader.h>
+#include <usbexporter.h>
+#include <usbmonitor.h>
+#include <cropwriter.h>
+#include <cropring.h>
+#include <retentionindex.h>
+#include <diskaccountant.h>
+#include <softcapture.h>
+#include <latencystats.h>
+#include <framebus.h>
+#include <fusedconverter.h>
+#include <framepool.h>
 
 ////// TIME INTERVAL
 
-#define DISKCHECK_INTERVAL 2000 //ms
+#define DISKCHECK_INTERVAL 2000 //ms, display only
 
-#define BMP_SCAN_INTERVAL 500 //ms
+#define BMP_SCAN_INTERVAL 500 //ms, only when inotify is not available
+
+#define USB_MOVE_INTERVAL 2000 //ms, new backup files while a stick is mounted
+
+#define LATENCY_OVERLAY_INTERVAL 1000 //ms
 
 ////// SOURCE
 
@@ -38,6 +56,29 @@
 
 #define MAX_CUDA_BUFFER_NUM 10
 
+////// 1 : single CUDA pass NV12 -> live I420 + GBRP crop, 0 : separate live / crop NPP scalers
+
+#define FUSED_CONVERT_ENABLE 1
+
+////// 1 : "Store Crop" saves the CROP_RING_PRE_MS / CROP_RING_POST_MS window around the press,
+////// 0 : it saves the next frame converted after the click is handled
+
+#define CROP_RING_ENABLE 1
+
+////// 1 : crops are stored lossless compressed ( .bscf, decode with --decode ), 0 : raw GBRP
+
+#define CROP_COMPRESS_ENABLE 1
+
+////// 1 : crops are appended to segment files under the output folder ( --segment-extract
+////// pulls one back out ), 0 : one file per frame
+
+#define SEGMENT_STORE_ENABLE 1
+
+////// 1 : USB export writes one split .tar.zst with a manifest ( --archive-extract pulls one
+////// file back out ), 0 : the folder tree is moved file by file
+
+#define USB_EXPORT_ARCHIVE_ENABLE 1
+
 ////// FRAME ASPECT RATIO
 
 #define LIVE_FRAME_WIDTH 1324
@@ -48,6 +89,14 @@
 
 #define INFER_FRAME_HEIGHT 508
 
+#define INFER_FRAME_RATE 30.0 //fps, captured frames handed to inference
+
+////// LATEST CAPTURE PREVIEW
+
+#define THUMBNAIL_WIDTH 320
+
+#define THUMBNAIL_HEIGHT 240
+
 ////// CROP SIZE
 
 #define CROP_WIDTH 556
@@ -151,6 +200,14 @@ struct FunctionParam {
 
     BYTE *                  st_pCUDABuffer_S[ MAX_CUDA_BUFFER_NUM ];
 
+    qcap2_event_handlers_t *    st_pEventHandlers_Live  = nullptr;
+
+    qcap2_event_handlers_t *    st_pEventHandlers_Crop  = nullptr;
+
+    qcap2_event_t *         st_pEvent_Live          = nullptr;
+
+    qcap2_event_t *         st_pEvent_Crop          = nullptr;
+
     qcap2_video_scaler_t *  st_pScaler_Live         = nullptr;
 
     qcap2_video_sink_t *    st_pSink_Live           = nullptr;
@@ -159,9 +216,15 @@ struct FunctionParam {
 
     qcap2_video_scaler_t *  st_pScaler_Crop         = nullptr;
 
-    BOOL                    st_bStorageCropRaw      = FALSE;
+    FusedConverter *        st_pFusedConverter      = nullptr;
+
+    std::atomic< BOOL >     st_bStorageCropRaw      { FALSE };      // set by the GUI, taken by one bus consumer
+
+    std::atomic< qint64 >   st_nCropCaptureTimeMs   { 0 };
 
-    BOOL                    st_bDiskOverwrite       = FALSE;
+    LatencyStampQueue       st_oStamp_Live;
+
+    LatencyStampQueue       st_oStamp_Crop;
 
 };
 
@@ -181,27 +244,49 @@ public:
     QString detectUsbPath();
     bool copyRecursively(const QString &srcPath, const QString &dstPath);
 
+    void Func_Export_Progress( const QString &fileName, int nFilePercent, qint64 nBytesDone, qint64 nBytesTotal );
+
+    void Func_Export_Finished( bool bOk, int nFilesMoved, const QString &dstPath );
+
     QTimer *timer;
     QString lastUsbPath;
     QString sourceDir;
 
+    UsbMonitor *            m_pUsbMonitor           = nullptr;
+
+    UsbExporter *           m_pUsbExporter          = nullptr;
+
     void HwInitialize();
 
     void HwUninitialize();
 
+    void Func_Capture_Stop();
+
     void Func_DiskUsage_Update();
 
     void Func_OutputBmp_Update( const QString &path );
 
-    QRESULT Func_Live_Scaler_Init( free_stack_t& _FreeStack_, ULONG nCropX, ULONG nCropY, ULONG nCropW, ULONG nCropH, qcap2_video_scaler_t** ppVsca );
+    void Func_Thumbnail_Show( const QString &path, const QImage &image );
+
+    void Func_Latency_Update();
+
+    void Func_PipelineStats_Dump();
+
+    QRESULT Func_Live_Scaler_Init( free_stack_t& _FreeStack_, ULONG nCropX, ULONG nCropY, ULONG nCropW, ULONG nCropH, qcap2_event_t* pEvent, qcap2_video_scaler_t** ppVsca );
 
     QRESULT Func_Live_Sink_Init( free_stack_t& _FreeStack_, ULONG nColorSpaceType, ULONG nVideoFrameWidth, ULONG nVideoFrameHeight, QFrame *pFrame, qcap2_video_sink_t** ppVsink );
 
-    QRESULT Func_Crop_Scaler_Init( free_stack_t& _FreeStack_, ULONG nCropX, ULONG nCropY, ULONG nCropW, ULONG nCropH, qcap2_video_scaler_t** ppVsca );
+    QRESULT Func_Fused_Converter_Init( free_stack_t& _FreeStack_, ULONG nCropX, ULONG nCropY, ULONG nCropW, ULONG nCropH, FusedConverter** ppConverter );
+
+    QRESULT Func_Crop_Scaler_Init( free_stack_t& _FreeStack_, ULONG nCropX, ULONG nCropY, ULONG nCropW, ULONG nCropH, qcap2_event_t* pEvent, qcap2_video_scaler_t** ppVsca );
 
     //// DEVICE HANDLE
 
-    PVOID                   m_hDevice;
+    PVOID                   m_hDevice               = nullptr;
+
+    BOOL                    m_bDeviceRunning        = FALSE;
+
+    SoftCapture *           m_pSoftCapture          = nullptr;
 
 
     //// SOURCE PARAM
@@ -214,14 +299,50 @@ public:
     FunctionParam           m_stFunc_Device;
 
 
+    //// FRAME BUS
+
+    FrameBus *              m_pFrameBus             = nullptr;
+
+
+    //// CROP WRITER
+
+    RetentionIndex *        m_pRetention            = nullptr;
+
+    IoScheduler *           m_pIoScheduler          = nullptr;
+
+    DiskAccountant *        m_pDiskAccountant       = nullptr;
+
+    SegmentStore *          m_pSegmentStore         = nullptr;
+
+    CropStoreParam          m_stCropStore;
+
+    CropWriter *            m_pCropWriter = nullptr;
+
+    CropRing *              m_pCropRing             = nullptr;
+
+    int64_t                 m_nCropPressNs          = 0;        // Func_Latency_Now() at the last "Store Crop" press
+
+
+    //// LATENCY OVERLAY
+
+    QLabel *                m_pLabel_Latency        = nullptr;
+
+    QTimer *                m_pLatencyTimer         = nullptr;
+
+
+    //// LATEST CAPTURE PREVIEW
+
+    QLabel *                m_pLabel_Thumbnail      = nullptr;
+
+    ThumbnailLoader *       m_pThumbnailLoader      = nullptr;
+
+
     //// OTHER
 
     QString                 m_qszAppPath;
 
     QString                 m_qszOutputPath;
 
-    QStorageInfo            m_qtStorage;
-
     QMap< QString, ULONG >  m_qMapVideoInput;
 
     QMap< QString, ULONG >  m_qMapAudioInput;
@@ -233,6 +354,8 @@ private slots:
 
     void on_btn_changepassword_clicked();
 
+    void on_BTN_StorgeCropData_pressed();
+
     void on_BTN_StorgeCropData_clicked();
 
 private:
@@ -240,6 +363,8 @@ private:
     Ui::MainWindow *ui;
     processinference* m_infer = nullptr;   // 加這一行成員
 
+    int m_nInferBusId = 0;
+
 };
 
 #endif // MAINWINDOW_H
@@ -12,63 +12,57 @@ static QRETURN OnEvent_infer_sca(qcap2_video_scaler_t* pVsca, qcap2_video_sink_t
     qres = qcap2_video_scaler_pop(pVsca, &pRCBuffer_);
     if (qres != QCAP_RS_SUCCESSFUL || !pRCBuffer_) {
         LOGE("%s(%d): qcap2_video_scaler_pop() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+        m_pProcessinference->OnInferDone(FALSE);
         return QCAP_RT_FAIL;
     }
 
+    int64_t nOriginNs = m_pProcessinference->m_oStamp_Infer.Pop();
+
+    LatencyStats::Instance().Record(LATENCY_STAGE_INFER_SCALE, nOriginNs);
+
     std::shared_ptr<qcap2_av_frame_t> pAVFrame_i420(
         (qcap2_av_frame_t*)qcap2_rcbuffer_lock_data(pRCBuffer_),
         [pRCBuffer_](qcap2_av_frame_t*) {
             qcap2_rcbuffer_unlock_data(pRCBuffer_);
         });
 
+    int64_t nSyncNs = Func_Latency_Now();
+
+#if INFER_FENCE_ENABLE
+    ////// Recorded on the legacy default stream after the pop, which waits on every blocking
+    ////// stream: the live and crop NPP scalers share it ( FUSED_CONVERT_ENABLE 0 ), so this
+    ////// covers all GPU work queued so far except that on non-blocking streams
+    FrameFence* pFence = m_pProcessinference->m_pFence;
+
+    qres = (pFence != nullptr && pFence->Record() == TRUE && pFence->Wait() == TRUE) ? QCAP_RS_SUCCESSFUL : QCAP_RS_ERROR_GENERAL;
+    if(qres != QCAP_RS_SUCCESSFUL) {
+        LOGE("%s(%d): FrameFence::Wait() failed", __FUNCTION__, __LINE__);
+#else
     qres = qcap2_cuda_device_synchronize();
     if(qres != QCAP_RS_SUCCESSFUL) {
         LOGE("%s(%d): qcap2_cuda_device_synchronize() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+#endif
+        qcap2_rcbuffer_release(pRCBuffer_);
+        m_pProcessinference->OnInferDone(FALSE);
         return QCAP_RT_FAIL;
     }
 
-/*
-#if SNAPSHOT_ENABLE
-    switch(1) { case 1:
-        static int nIndex = 0;
-        const char* strBase = "/home/nvidia/images";
-        // const char* strBase = "images";
-        char fn[PATH_MAX];
+    m_pProcessinference->OnSyncWait(Func_Latency_Now() - nSyncNs);
 
-        if(nIndex > 30) break;
+#if INFER_TENSOR_ENABLE
+    if(m_pProcessinference->m_pTensorBatcher != nullptr) {
+        uint8_t* pBuffer[4];
+        int nStride[4];
+        qcap2_av_frame_get_buffer1(pAVFrame_i420.get(), pBuffer, nStride);
 
-        sprintf(fn, "%s/snapshot-%02d.jpg", strBase, nIndex);
-        if(nIndex++ >= 100) nIndex = 0;
-
-        qres = qcap2_av_frame_store_picture(pAVFrame_i420.get(), fn);
-        if(qres != QCAP_RS_SUCCESSFUL) {
-            LOGE("%s(%d): qcap2_av_frame_store_picture() failed, qres=%d", __FUNCTION__, __LINE__, qres);
-            break;
-        }
+        ColorPlanes planes = { { pBuffer[0], pBuffer[1], pBuffer[2] }, { nStride[0], nStride[1], nStride[2] } };
+        m_pProcessinference->m_pTensorBatcher->Push(planes, nOriginNs);
     }
 #endif
-    */
 
 #if SNAPSHOT_ENABLE
-    switch(1) { case 1:
-        static int nIndex = 0;
-
-        char fn[PATH_MAX];
-
-        if(nIndex > 30) break;
-
-        sprintf(fn, "%s/snapshot-%02d.jpg", m_pProcessinference->l_qszOutputPath.toUtf8().data(), nIndex);
-
-        printf("[QCAP DEBUG] %s\n", fn);
-
-        if(nIndex++ >= 100) nIndex = 0;
-
-        qres = qcap2_av_frame_store_picture(pAVFrame_i420.get(), fn);
-        if(qres != QCAP_RS_SUCCESSFUL) {
-            LOGE("%s(%d): qcap2_av_frame_store_picture() failed, qres=%d", __FUNCTION__, __LINE__, qres);
-            break;
-        }
-    }
+    ////// Queued by reference only, the encoding runs on the snapshot pool
+    if(m_pProcessinference->m_pSnapshot != nullptr) m_pProcessinference->m_pSnapshot->Offer(pRCBuffer_, nOriginNs);
 #endif
 
     qres = qcap2_video_sink_push(pVsink, pRCBuffer_);
@@ -77,10 +71,12 @@ static QRETURN OnEvent_infer_sca(qcap2_video_scaler_t* pVsca, qcap2_video_sink_t
     }
     qcap2_rcbuffer_release(pRCBuffer_);
 
+    m_pProcessinference->OnInferDone(TRUE);
+
     return qret;
 }
 
-static QRETURN OnEvent_Timer(qcap2_timer_t* pTimer, __testkit__::tick_ctrl_t* pTickCtrl, qcap2_video_scaler_t* pVsca, qcap2_rcbuffer_t* pVsrc) {
+static QRETURN OnEvent_Timer(qcap2_timer_t* pTimer, __testkit__::tick_ctrl_t* pTickCtrl, qcap2_video_scaler_t* pVsca, qcap2_rcbuffer_t* pVsrc, LatencyStampQueue* pStampQueue) {
     QRESULT qres;
 
     int64_t now = _clk();
@@ -99,7 +95,12 @@ static QRETURN OnEvent_Timer(qcap2_timer_t* pTimer, __testkit__::tick_ctrl_t* pT
 
     if(pVsca) {
 //        qcap2_print_video_frame_info(pVsrc, "vvv");
+        int64_t nOriginNs = Func_Latency_Now();
+
         qres = qcap2_video_scaler_push(pVsca, pVsrc);
+        if(qres == QCAP_RS_SUCCESSFUL) {
+            pStampQueue->Push(nOriginNs);
+        }
     }
 
     return QCAP_RT_OK;
@@ -110,11 +111,16 @@ QRESULT processinference::OnStartTimer(__testkit__::free_stack_t& _FreeStack_, q
 
     __testkit__::tick_ctrl_t* pTickCtrl = new __testkit__::tick_ctrl_t();
     _FreeStack_ += [pTickCtrl]() {
+        const __testkit__::tick_stats_t& stats = pTickCtrl->stats;
+        printf("[QCAP DEBUG] Test pattern ticks %ld, missed %ld, jitter avg %.1f us, max %ld us\n", (long)stats.ticks, (long)stats.missed,
+               (stats.ticks > 0) ? (double)stats.jitter_sum / stats.ticks : 0.0, (long)stats.jitter_max);
         delete pTickCtrl;
     };
 
+    ////// A late timer skips the frames it missed, a test pattern has nothing to catch up on
     pTickCtrl->num = 30 * 1000LL;
     pTickCtrl->den = 1000LL;
+    pTickCtrl->policy = __testkit__::TICK_POLICY_SKIP;
 
     qcap2_timer_t* pTimer = qcap2_timer_new();
     _FreeStack_ += [pTimer]() {
@@ -142,19 +148,99 @@ QRESULT processinference::OnStartTimer(__testkit__::free_stack_t& _FreeStack_, q
         return QCAP_RS_ERROR_GENERAL;
     }
 
-    __testkit__::AddTimerHandler(_FreeStack_, pEventHandlers, pTimer, std::bind(&OnEvent_Timer, pTimer, pTickCtrl, pVsca, pVsrc));
+    AddTimerHandler(_FreeStack_, pTimer, std::bind(&OnEvent_Timer, pTimer, pTickCtrl, pVsca, pVsrc, &m_oStamp_Infer));
 
     return qres;
 }
 
+void processinference::Push(const FrameBusPacket &packet) {
+    if(pVsca_infer_i420 == nullptr) return;
+
+    ////// Latest frame wins: the bus keeps only the newest one queued, and while the
+    ////// previous one is still being scaled and shown this one is skipped
+    int nInFlight = m_nInFlight.load();
+    do {
+        if(nInFlight >= INFER_IN_FLIGHT_MAX) {
+            m_nSkippedBusy++;
+            return;
+        }
+    } while(m_nInFlight.compare_exchange_weak(nInFlight, nInFlight + 1) == false);
+
+    QRESULT qres = qcap2_video_scaler_push(pVsca_infer_i420, packet.pRCBuffer);
+    if(qres != QCAP_RS_SUCCESSFUL) {
+        LOGE("%s(%d): qcap2_video_scaler_push() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+        m_nInFlight--;
+        m_nFailed++;
+        return;
+    }
+
+    m_oStamp_Infer.Push(packet.nOriginNs);
+    m_nPushed++;
+}
+
+void processinference::OnInferDone(BOOL bOk) {
+    if(bOk == TRUE) m_nCompleted++;
+    else m_nFailed++;
+
+    if(m_nInFlight.load() > 0) m_nInFlight--;
+}
+
+void processinference::OnSyncWait(int64_t nWaitNs) {
+    std::lock_guard<std::mutex> lock(m_mtxSync);
+
+    m_nSyncWaits++;
+    m_nSyncWaitNs += nWaitNs;
+    m_nSyncWaitMaxNs = std::max(m_nSyncWaitMaxNs, nWaitNs);
+}
+
+void processinference::TriggerSnapshot() {
+    if(m_pSnapshot != nullptr) m_pSnapshot->Trigger();
+}
+
+SnapshotStats processinference::GetSnapshotStats() const {
+    if(m_pSnapshot == nullptr) return SnapshotStats();
+
+    return m_pSnapshot->GetStats();
+}
+
+TensorBatcherStats processinference::GetTensorStats() const {
+    if(m_pTensorBatcher == nullptr) return TensorBatcherStats();
+
+    return m_pTensorBatcher->GetStats();
+}
+
+std::vector<__testkit__::handler_shard_stats_t> processinference::GetHandlerStats() const {
+    return GetShardStats();
+}
+
+InferStats processinference::GetStats() const {
+    InferStats stats;
+
+    stats.st_nPushed = m_nPushed.load();
+    stats.st_nCompleted = m_nCompleted.load();
+    stats.st_nSkippedBusy = m_nSkippedBusy.load();
+    stats.st_nFailed = m_nFailed.load();
+
+    std::lock_guard<std::mutex> lock(m_mtxSync);
+
+    stats.st_nSyncWaits = m_nSyncWaits;
+    stats.st_nSyncWaitNs = m_nSyncWaitNs;
+    stats.st_nSyncWaitMaxNs = m_nSyncWaitMaxNs;
+
+    return stats;
+}
+
 void processinference::sourceRGB(__testkit__::free_stack_t& _FreeStack_, qcap2_rcbuffer_t** ppRCBuffer) {
     QRESULT qres;
     qcap2_rcbuffer_t* pRCBuffer;
-    qres = new_video_cudahostbuf(_FreeStack_, QCAP_COLORSPACE_TYPE_GBRP, l_nInferFrameWidth, l_nInferFrameHeight, cudaHostAllocMapped, &pRCBuffer);
+    qres = FramePool::Instance().Acquire(QCAP_COLORSPACE_TYPE_GBRP, l_nInferFrameWidth, l_nInferFrameHeight, FRAME_POOL_MEMORY_CUDA_HOST, 1, &pRCBuffer);
     if(qres != QCAP_RS_SUCCESSFUL) {
-        LOGE("%s(%d): new_video_cudahostbuf() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+        LOGE("%s(%d): FramePool::Acquire() failed, qres=%d", __FUNCTION__, __LINE__, qres);
         return;
     }
+    _FreeStack_ += [pRCBuffer]() {
+        FramePool::Instance().Release(&pRCBuffer, 1);
+    };
 
     qres = qcap2_fill_video_test_pattern(pRCBuffer, QCAP2_TEST_PATTERN_0);
     if(qres != QCAP_RS_SUCCESSFUL) {
@@ -168,7 +254,12 @@ QRESULT processinference::StartVscaInferI420(__testkit__::free_stack_t& _FreeSta
     QRESULT qres = QCAP_RS_SUCCESSFUL;
 
     switch(1) { case 1:
+#if SNAPSHOT_ENABLE
+        ////// Queued and encoding snapshots each keep a buffer out of the scaler's rotation
+        const int nBuffers = 2 + SNAPSHOT_QUEUE_DEPTH + SNAPSHOT_THREADS;
+#else
         const int nBuffers = 2;
+#endif
         const ULONG nColorSpaceType = QCAP_COLORSPACE_TYPE_I420;
         const ULONG nVideoFrameWidth = l_nInferFrameWidth;
         const ULONG nVideoFrameHeight = l_nInferFrameHeight;
@@ -182,17 +273,14 @@ QRESULT processinference::StartVscaInferI420(__testkit__::free_stack_t& _FreeSta
         _FreeStack_ += [pRCBuffers]() {
             delete[] pRCBuffers;
         };
-        for(int i = 0;i < nBuffers;i++) {
-            qcap2_rcbuffer_t* pRCBuffer;
-            qres = new_video_cudahostbuf(_FreeStack_,
-                nColorSpaceType, nVideoFrameWidth, nVideoFrameHeight, cudaHostAllocMapped, &pRCBuffer);
-            if(qres != QCAP_RS_SUCCESSFUL) {
-                LOGE("%s(%d): new_video_cudahostbuf() failed, qres=%d", __FUNCTION__, __LINE__, qres);
-                break;
-            }
-
-            pRCBuffers[i] = pRCBuffer;
+        qres = FramePool::Instance().Acquire(nColorSpaceType, nVideoFrameWidth, nVideoFrameHeight, FRAME_POOL_MEMORY_CUDA_HOST, nBuffers, pRCBuffers);
+        if(qres != QCAP_RS_SUCCESSFUL) {
+            LOGE("%s(%d): FramePool::Acquire() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+            break;
         }
+        _FreeStack_ += [pRCBuffers, nBuffers]() {
+            FramePool::Instance().Release(pRCBuffers, nBuffers);
+        };
 
         qcap2_video_scaler_set_backend_type(pVsca, QCAP2_VIDEO_SCALER_BACKEND_TYPE_NPP);
         qcap2_video_scaler_set_multithread(pVsca, false);
@@ -200,6 +288,7 @@ QRESULT processinference::StartVscaInferI420(__testkit__::free_stack_t& _FreeSta
         qcap2_video_scaler_set_buffers(pVsca, &pRCBuffers[0]);
         qcap2_video_scaler_set_src_buffer_hint(pVsca, QCAP2_BUFFER_HINT_CUDAHOST);
         qcap2_video_scaler_set_dst_buffer_hint(pVsca, QCAP2_BUFFER_HINT_CUDAHOST);
+        if(l_nCropW > 0 && l_nCropH > 0) qcap2_video_scaler_set_crop(pVsca, l_nCropX, l_nCropY, l_nCropW, l_nCropH);
 
         {
             std::shared_ptr<qcap2_video_format_t> pVideoFormat(
@@ -285,11 +374,13 @@ QRETURN processinference::OnStart(__testkit__::free_stack_t& _FreeStack_, QRESUL
     }
     printf("pVsca_infer_i420 :%p \n", pVsca_infer_i420);
     StartVscaInferVsink(_FreeStack_, QCAP_COLORSPACE_TYPE_I420, l_nInferFrameWidth, l_nInferFrameHeight, &pVsink_infer);
-    qres = __testkit__::AddEventHandler(mFreeStack, pEventHandlers, pEvent_infer_sca, std::bind(&OnEvent_infer_sca, pVsca_infer_i420, pVsink_infer, this));
+    ////// Shard 0, the destructor's thread: the snapshot service is deleted there between frames
+    qres = AddEventHandler(mFreeStack, pEvent_infer_sca, std::bind(&OnEvent_infer_sca, pVsca_infer_i420, pVsink_infer, this), 0);
     if(qres != QCAP_RS_SUCCESSFUL) {
         LOGE("%s[%d]AddEventHandler Failed", __FUNCTION__, __LINE__);
         return QCAP_RT_FAIL;
     }
+#if INFER_TEST_PATTERN_ENABLE
     qcap2_rcbuffer_t* pRCBuffer_src;
     sourceRGB(_FreeStack_, &pRCBuffer_src);
     qres = OnStartTimer(_FreeStack_, pEventHandlers, pVsca_infer_i420, pRCBuffer_src);
@@ -297,16 +388,49 @@ QRETURN processinference::OnStart(__testkit__::free_stack_t& _FreeStack_, QRESUL
         LOGE("%s[%d]OnStartTimer Failed", __FUNCTION__, __LINE__);
         return QCAP_RT_FAIL;
     }
+#endif
 
     return QCAP_RT_OK;
 }
 
-processinference::processinference(QFrame *frame, const QString &outputPath, ULONG nInferWidth, ULONG nInferHeight )
-    : m_frame(frame),
-      l_qszOutputPath(outputPath),
+processinference::processinference(QFrame *frame, const QString &outputPath, ULONG nInferWidth, ULONG nInferHeight
+                                   , ULONG nCropX, ULONG nCropY, ULONG nCropW, ULONG nCropH, IoScheduler *pIoScheduler )
+    : l_qszOutputPath(outputPath),
       l_nInferFrameWidth(nInferWidth),
-      l_nInferFrameHeight(nInferHeight) {
-    QRESULT qres = StartEventHandlers();
+      l_nInferFrameHeight(nInferHeight),
+      l_nCropX(nCropX),
+      l_nCropY(nCropY),
+      l_nCropW(nCropW),
+      l_nCropH(nCropH),
+      m_frame(frame) {
+#if INFER_TENSOR_ENABLE
+    ////// No model behind it yet: a batch only closes the latency of its frames
+    TensorBatcherParam stTensorParam;
+    stTensorParam.st_nWidth = nInferWidth;
+    stTensorParam.st_nHeight = nInferHeight;
+
+    m_pTensorBatcher = new TensorBatcher(stTensorParam, [](const TensorBatch &batch) {
+        for(int64_t nOriginNs : batch.nOriginNs_S) LatencyStats::Instance().Record(LATENCY_STAGE_INFER_TENSOR, nOriginNs);
+    });
+#endif
+
+#if INFER_FENCE_ENABLE
+    m_pFence = new CudaFence();
+#endif
+
+#if SNAPSHOT_ENABLE
+    SnapshotParam stSnapshotParam;
+    stSnapshotParam.st_qszOutputPath = QDir(outputPath).filePath(SNAPSHOT_FOLDER);
+    stSnapshotParam.st_nWidth = nInferWidth;
+    stSnapshotParam.st_nHeight = nInferHeight;
+    stSnapshotParam.st_pIoScheduler = pIoScheduler;
+
+    m_pSnapshot = new SnapshotService(stSnapshotParam);
+#else
+    Q_UNUSED(pIoScheduler);
+#endif
+
+    QRESULT qres = StartEventHandlers(INFER_HANDLER_THREADS);
 
     if (qres != QCAP_RS_SUCCESSFUL) {
         LOGE("%s(%d): StartEventHandlers() failed, qres=%d", __FUNCTION__, __LINE__, qres);
@@ -323,11 +447,25 @@ processinference::processinference(QFrame *frame, const QString &outputPath, ULO
 
 processinference::~processinference() {
     if (!pEventHandlers) {
+        delete m_pSnapshot;
+        m_pSnapshot = nullptr;
         mFreeStack.flush();
+        StopEventHandlers();
+        delete m_pTensorBatcher;
+        m_pTensorBatcher = nullptr;
+        delete m_pFence;
+        m_pFence = nullptr;
         return;
     }
 
     QRESULT qres = ExecInEventHandlers([this]() -> QRETURN {
+        ////// Queued snapshots hold scaler buffers, they go back before the scaler does; this
+        ////// is the scaler handler's shard, so no Offer() is running
+        if(m_pSnapshot != nullptr) {
+            SnapshotService* pSnapshot = m_pSnapshot;
+            m_pSnapshot = nullptr;
+            delete pSnapshot;
+        }
         mFreeStack.flush();
         return QCAP_RT_OK;
     });
@@ -336,12 +474,18 @@ processinference::~processinference() {
         LOGE("%s(%d): ExecInEventHandlers(flush) failed, qres=%d",  __FUNCTION__, __LINE__, qres);
     }
 
-    QRESULT qres2 = qcap2_event_handlers_stop(pEventHandlers);
-        if (qres2 != QCAP_RS_SUCCESSFUL) {
-            LOGE("%s(%d): qcap2_event_handlers_stop() failed, qres=%d",
-                 __FUNCTION__, __LINE__, qres2);
-        }
+    StopEventHandlers();
 
-        qcap2_event_handlers_delete(pEventHandlers);
-        pEventHandlers  = nullptr;
+    ////// Event handlers are gone, nothing pushes any more
+    if(m_pTensorBatcher != nullptr) {
+        TensorBatcher* pTensorBatcher = m_pTensorBatcher;
+        m_pTensorBatcher = nullptr;
+        delete pTensorBatcher;
+    }
+
+    if(m_pFence != nullptr) {
+        FrameFence* pFence = m_pFence;
+        m_pFence = nullptr;
+        delete pFence;
+    }
 }
@@ -8,6 +8,12 @@
 #include <qcap2.user.h>
 #include <qcap2.gst.h>
 #include <testkit.h>
+#include <latencystats.h>
+#include <framebus.h>
+#include <tensorbatcher.h>
+#include <framefence.h>
+#include <snapshotservice.h>
+#include <framepool.h>
 
 #include <stdlib.h>
 #include <fcntl.h>
@@ -18,6 +24,8 @@
 #include <fstream>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <algorithm>
 #include <vector>
 #include <stack>
 #include <string>
@@ -36,18 +44,86 @@
 #include <stdint.h>
 #include <QFrame>
 
+////// 1 : inference frames are stored as pictures by a SnapshotService ( policy, pool, file
+////// names in snapshotservice.h ), off the event handler thread
+
 #define SNAPSHOT_ENABLE 1
 
-class processinference : public __testkit__::TestCase
+////// 1 : the scaler is fed a static test pattern from a 30 fps timer ( no capture needed ),
+////// 0 : it is fed the captured frames that Push() gets from the frame bus
+
+#define INFER_TEST_PATTERN_ENABLE 0
+
+////// Frames handed to the scaler and not yet through OnEvent_infer_sca; a captured frame
+////// that finds this many is skipped rather than queued behind them
+
+#define INFER_IN_FLIGHT_MAX 1
+
+////// 1 : scaled frames are also batched into NCHW tensors for a model ( TensorBatcher )
+
+#define INFER_TENSOR_ENABLE 1
+
+////// 1 : a popped frame waits on a fence on the legacy default stream NPP runs on, which
+////// still orders after every blocking stream ( live and crop scalers included ) and only
+////// skips non-blocking ones, 0 : on qcap2_cuda_device_synchronize(). Compare the two with
+////// the F11 "Inference fence / device sync wait" line
+
+#define INFER_FENCE_ENABLE 1
+
+////// Event handler threads: the scaler completion and the test pattern timer are separate
+////// sources, so with 2 a fence wait no longer holds up the next tick
+
+#define INFER_HANDLER_THREADS 2
+
+struct InferStats {
+
+    uint64_t    st_nPushed              = 0;
+
+    uint64_t    st_nCompleted           = 0;
+
+    uint64_t    st_nSkippedBusy         = 0;
+
+    uint64_t    st_nFailed              = 0;
+
+    uint64_t    st_nSyncWaits           = 0;
+
+    int64_t     st_nSyncWaitNs          = 0;            // fence or device synchronize, total
+
+    int64_t     st_nSyncWaitMaxNs       = 0;
+
+};
+
+class processinference : public __testkit__::PoolTestCase
 {
     public:
 //    qszBMPOutputPath
-        processinference(QFrame *frame, const QString &outputPath, ULONG nInferFrameWidth, ULONG nInferFrameHeight);
+        ////// nCropW / nCropH of 0 scale the whole captured frame
+
+        processinference(QFrame *frame, const QString &outputPath, ULONG nInferFrameWidth, ULONG nInferFrameHeight
+                         , ULONG nCropX = 0, ULONG nCropY = 0, ULONG nCropW = 0, ULONG nCropH = 0, IoScheduler *pIoScheduler = nullptr);
         ~processinference();
         QRETURN OnStart(__testkit__::free_stack_t& _FreeStack_, QRESULT& qres);
         QRESULT OnStartTimer(__testkit__::free_stack_t& _FreeStack_, qcap2_event_handlers_t* pEventHandlers, qcap2_video_scaler_t* pVsca, qcap2_rcbuffer_t* pVsrc);
         void sourceRGB(__testkit__::free_stack_t& _FreeStack_, qcap2_rcbuffer_t** ppRCBuffer);
         QRESULT StartVscaInferI420(__testkit__::free_stack_t& _FreeStack_, qcap2_video_scaler_t** ppVsca, qcap2_event_t* pEvent);
+        ////// Frame bus consumer: the captured buffer goes to the scaler by reference, no copy
+
+        void Push(const FrameBusPacket &packet);
+
+        void OnInferDone(BOOL bOk);
+
+        InferStats GetStats() const;
+
+        TensorBatcherStats GetTensorStats() const;
+
+        std::vector<__testkit__::handler_shard_stats_t> GetHandlerStats() const;
+
+        ////// The next inference frame is stored whatever the snapshot policy
+
+        void TriggerSnapshot();
+
+        SnapshotStats GetSnapshotStats() const;
+
         QRESULT StartVscaInferVsink(__testkit__::free_stack_t& _FreeStack_, ULONG nColorSpaceType, ULONG nVideoFrameWidth, ULONG nVideoFrameHeight, qcap2_video_sink_t** ppVsink);
 
         __testkit__::free_stack_t mFreeStack;
@@ -57,13 +133,39 @@ class processinference : public __testkit__::TestCase
         qcap2_video_scaler_t* pVsca_infer_i420 = nullptr;
         qcap2_video_sink_t* pVsink_infer = nullptr;
 
+        TensorBatcher* m_pTensorBatcher = nullptr;
+
+        FrameFence* m_pFence = nullptr;
+
+        SnapshotService* m_pSnapshot = nullptr;
+
+        void OnSyncWait(int64_t nWaitNs);
+
+        LatencyStampQueue m_oStamp_Infer;
+
         bool bInferSink = false;
         QString     l_qszOutputPath;
         ULONG       l_nInferFrameWidth;
         ULONG       l_nInferFrameHeight;
+        ULONG       l_nCropX;
+        ULONG       l_nCropY;
+        ULONG       l_nCropW;
+        ULONG       l_nCropH;
 
     private:
         QFrame *m_frame = nullptr;
+
+        std::atomic<int> m_nInFlight { 0 };
+
+        std::atomic<uint64_t> m_nPushed { 0 };
+        std::atomic<uint64_t> m_nCompleted { 0 };
+        std::atomic<uint64_t> m_nSkippedBusy { 0 };
+        std::atomic<uint64_t> m_nFailed { 0 };
+
+        mutable std::mutex m_mtxSync;
+        uint64_t m_nSyncWaits = 0;
+        int64_t m_nSyncWaitNs = 0;
+        int64_t m_nSyncWaitMaxNs = 0;
 };
 
 #endif // PROCESSINFERENCE_H
@@ -0,0 +1,279 @@
+#include "retentionindex.h"
+#include "segmentstore.h"
+
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QDateTime>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+RetentionIndex::RetentionIndex( const QString &qszPath, uint64_t nBatchBytes )
+    : m_qszPath( qszPath ), m_nBatchBytes( nBatchBytes )
+{
+
+    m_thEvict = std::thread( &RetentionIndex::Func_Evict_Loop, this );
+
+}
+
+RetentionIndex::~RetentionIndex()
+{
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_bExit = TRUE;
+    }
+
+    m_cvEvict.notify_all();
+
+    if( m_thEvict.joinable() == TRUE ) m_thEvict.join();
+
+}
+
+void RetentionIndex::Add( const QString &qszFile, qint64 nCaptureTimeMs, uint64_t nBytes )
+{
+
+    std::string strFile = qszFile.toStdString();
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    m_strPinned_S.erase( strFile );
+
+    Func_Entry_Erase( strFile );
+
+    m_oEntry_S[ strFile ] = { nCaptureTimeMs, nBytes };
+
+    m_oOrder_S.insert( { nCaptureTimeMs, strFile } );
+
+    m_nBytes += nBytes;
+
+}
+
+void RetentionIndex::Pin( const QString &qszFile )
+{
+
+    std::string strFile = qszFile.toStdString();
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    m_strPinned_S.insert( strFile );
+
+    Func_Entry_Erase( strFile );
+
+}
+
+void RetentionIndex::Remove( const QString &qszFile )
+{
+
+    std::string strFile = qszFile.toStdString();
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    Func_Entry_Erase( strFile );
+
+}
+
+void RetentionIndex::Func_Entry_Erase( const std::string &strFile )
+{
+
+    auto it = m_oEntry_S.find( strFile );
+
+    if( it == m_oEntry_S.end() ) return;
+
+    m_oOrder_S.erase( { it->second.nCaptureTimeMs, strFile } );
+
+    m_nBytes -= it->second.nBytes;
+
+    m_oEntry_S.erase( it );
+
+}
+
+void RetentionIndex::Request( uint64_t nBytes )
+{
+
+    BOOL bWake = FALSE;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_nPending += ( int64_t )nBytes;
+
+        bWake = ( m_nPending >= ( int64_t )m_nBatchBytes ) ? TRUE : FALSE;
+    }
+
+    if( bWake == TRUE ) m_cvEvict.notify_one();
+
+}
+
+RetentionStats RetentionIndex::GetStats() const
+{
+
+    RetentionStats stats;
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    stats.st_nFiles = ( ULONG )m_oEntry_S.size();
+
+    stats.st_nBytes = m_nBytes;
+
+    stats.st_nBytesPending = ( m_nPending > 0 ) ? ( uint64_t )m_nPending : 0;
+
+    stats.st_nFilesEvicted = m_nFilesEvicted;
+
+    stats.st_nBytesEvicted = m_nBytesEvicted;
+
+    stats.st_bSeeded = m_bSeeded;
+
+    return stats;
+
+}
+
+void RetentionIndex::Func_Seed()
+{
+
+    ////// The one directory walk. Modification time stands in for the capture time of files
+    ////// written before this run, it is when the last frame of a segment went in.
+
+    ULONG nFiles = 0;
+
+    QDirIterator DirIt( m_qszPath, QDir::Files );
+
+    while( DirIt.hasNext() == TRUE ) {
+
+        DirIt.next();
+
+        QFileInfo FileTemp = DirIt.fileInfo();
+
+        if( FileTemp.fileName().endsWith( SEGMENT_STORE_INDEX_EXTENSION ) == TRUE ) continue;
+
+        std::string strFile = FileTemp.absoluteFilePath().toStdString();
+
+        qint64 nTimeMs = FileTemp.lastModified().toMSecsSinceEpoch();
+
+        uint64_t nBytes = ( uint64_t )FileTemp.size();
+
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        ////// A writer may have added it already, with the better time
+
+        if( m_oEntry_S.count( strFile ) > 0 || m_strPinned_S.count( strFile ) > 0 ) continue;
+
+        m_oEntry_S[ strFile ] = { nTimeMs, nBytes };
+
+        m_oOrder_S.insert( { nTimeMs, strFile } );
+
+        m_nBytes += nBytes;
+
+        nFiles++;
+
+    }
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_bSeeded = TRUE;
+    }
+
+    printf( "[QCAP DEBUG] Retention index: %s seeded, %lu files\n", m_qszPath.toUtf8().data(), nFiles );
+
+}
+
+BOOL RetentionIndex::Func_File_Delete( const std::string &strFile )
+{
+
+    if( unlink( strFile.c_str() ) != 0 ) return FALSE;
+
+    ////// A segment's index goes with it
+
+    size_t nExt = strlen( SEGMENT_STORE_EXTENSION );
+
+    if( strFile.size() > nExt && strFile.compare( strFile.size() - nExt, nExt, SEGMENT_STORE_EXTENSION ) == 0 ) {
+
+        unlink( ( strFile.substr( 0, strFile.size() - nExt ) + SEGMENT_STORE_INDEX_EXTENSION ).c_str() );
+
+    }
+
+    return TRUE;
+
+}
+
+void RetentionIndex::Func_Evict_Loop()
+{
+
+    Func_Seed();
+
+    while( TRUE ) {
+
+        std::vector< std::pair< std::string, uint64_t > > oVictim_S;
+
+        {
+            std::unique_lock< std::mutex > lock( m_mtx );
+
+            m_cvEvict.wait( lock, [ this ]() { return m_bExit == TRUE || m_nPending >= ( int64_t )m_nBatchBytes; } );
+
+            if( m_bExit == TRUE ) break;
+
+            ////// Take the oldest until the batch covers what was asked for
+
+            int64_t nTaken = 0;
+
+            while( nTaken < m_nPending && m_oOrder_S.empty() == FALSE ) {
+
+                std::string strFile = m_oOrder_S.begin()->second;
+
+                uint64_t nBytes = m_oEntry_S[ strFile ].nBytes;
+
+                m_oOrder_S.erase( m_oOrder_S.begin() );
+
+                m_oEntry_S.erase( strFile );
+
+                m_nBytes -= nBytes;
+
+                nTaken += ( int64_t )nBytes;
+
+                oVictim_S.push_back( { strFile, nBytes } );
+
+            }
+
+            ////// Nothing left to delete, the request can not be met
+
+            if( oVictim_S.empty() == TRUE ) {
+
+                m_nPending = 0;
+
+                continue;
+
+            }
+        }
+
+        uint64_t nFiles = 0;
+
+        uint64_t nFreed = 0;
+
+        for( const auto &victim : oVictim_S ) {
+
+            if( Func_File_Delete( victim.first ) == FALSE ) continue;
+
+            nFiles++;
+
+            nFreed += victim.second;
+
+        }
+
+        printf( "[QCAP DEBUG] Retention index: evicted %lu files, %lu MB\n", ( ULONG )nFiles, ( ULONG )( nFreed >> 20 ) );
+
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_nPending -= ( int64_t )nFreed;
+
+        m_nFilesEvicted += nFiles;
+
+        m_nBytesEvicted += nFreed;
+
+    }
+
+}
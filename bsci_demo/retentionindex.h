@@ -0,0 +1,126 @@
+#ifndef RETENTIONINDEX_H
+#define RETENTIONINDEX_H
+
+#include <QString>
+
+#include <stdint.h>
+
+#include <string>
+#include <set>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <qcap.windef.h>
+
+////// FIFO overwrite deletes once this much has been requested, so files go in batches and
+////// the writers never wait for an unlink
+
+#define RETENTION_EVICT_BATCH_MB 64
+
+struct RetentionStats {
+
+    ULONG       st_nFiles               = 0;
+
+    uint64_t    st_nBytes               = 0;
+
+    uint64_t    st_nBytesPending        = 0;
+
+    uint64_t    st_nFilesEvicted        = 0;
+
+    uint64_t    st_nBytesEvicted        = 0;
+
+    BOOL        st_bSeeded              = FALSE;
+
+};
+
+////// Every artifact in the output folder ( crops of any format, segments ), ordered by
+////// capture time. Seeded by one scan on the eviction thread at startup, then kept current
+////// by the writers through Add() / Remove(), so a frame costs O( log n ) however many
+////// files the folder holds. Subfolders are not walked: snapshots live in SNAPSHOT_FOLDER
+////// and bound themselves by wrapping their names after SNAPSHOT_KEEP.
+//////
+////// Writers Request() the bytes they are about to write while the disk is over its limit;
+////// the eviction thread deletes the oldest artifacts until that many bytes are free.
+////// A segment's .bsidx goes together with its .bsseg and is not indexed on its own.
+
+class RetentionIndex
+{
+
+public:
+
+    explicit RetentionIndex( const QString &qszPath, uint64_t nBatchBytes = ( uint64_t )RETENTION_EVICT_BATCH_MB << 20 );
+
+    ~RetentionIndex();
+
+    ////// Full path; adding a known path updates its time and size
+
+    void Add( const QString &qszFile, qint64 nCaptureTimeMs, uint64_t nBytes );
+
+    ////// Keeps a file still being written ( the open segment ) out of the index until its
+    ////// Add()
+
+    void Pin( const QString &qszFile );
+
+    void Remove( const QString &qszFile );
+
+    void Request( uint64_t nBytes );
+
+    RetentionStats GetStats() const;
+
+private:
+
+    struct Entry {
+
+        qint64      nCaptureTimeMs;
+
+        uint64_t    nBytes;
+
+    };
+
+    ////// Caller holds m_mtx
+
+    void Func_Entry_Erase( const std::string &strFile );
+
+    void Func_Seed();
+
+    void Func_Evict_Loop();
+
+    BOOL Func_File_Delete( const std::string &strFile );
+
+private:
+
+    QString                                         m_qszPath;
+
+    uint64_t                                        m_nBatchBytes;
+
+    mutable std::mutex                              m_mtx;
+
+    std::condition_variable                         m_cvEvict;
+
+    std::thread                                     m_thEvict;
+
+    std::set< std::pair< qint64, std::string > >    m_oOrder_S;
+
+    std::unordered_map< std::string, Entry >        m_oEntry_S;
+
+    std::set< std::string >                         m_strPinned_S;
+
+    uint64_t                                        m_nBytes            = 0;
+
+    ////// Requested but not freed yet; negative when a deleted file freed more than asked
+
+    int64_t                                         m_nPending          = 0;
+
+    uint64_t                                        m_nFilesEvicted     = 0;
+
+    uint64_t                                        m_nBytesEvicted     = 0;
+
+    BOOL                                            m_bSeeded           = FALSE;
+
+    BOOL                                            m_bExit             = FALSE;
+
+};
+
+#endif // RETENTIONINDEX_H
@@ -0,0 +1,870 @@
+#include "segmentstore.h"
+#include "framecodec.h"
+#include "retentionindex.h"
+#include "diskaccountant.h"
+#include "ioscheduler.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+
+static inline uint64_t Func_Align_Up( uint64_t n ) { return ( n + SEGMENT_STORE_ALIGN - 1 ) & ~( uint64_t )( SEGMENT_STORE_ALIGN - 1 ); }
+
+////// Space a frame takes in its segment, the next frame starts at the following boundary
+
+static inline uint64_t Func_Frame_Span( uint64_t nPayloadBytes ) { return Func_Align_Up( sizeof( SegmentFrameHeader ) + nPayloadBytes ); }
+
+////// Segment bases ( full path without extension ) in sequence order
+
+static QStringList Func_Segment_List( const QString &qszPath )
+{
+
+    QDir dir( qszPath, QString( "segment_*" ) + SEGMENT_STORE_EXTENSION, QDir::Name, QDir::Files );
+
+    QStringList qszBase_S;
+
+    for( const QString &qszName : dir.entryList() ) qszBase_S.append( dir.absoluteFilePath( qszName.left( qszName.size() - ( int )strlen( SEGMENT_STORE_EXTENSION ) ) ) );
+
+    return qszBase_S;
+
+}
+
+static uint64_t Func_Sequence_Parse( const QString &qszBase )
+{
+
+    QString qszName = QFileInfo( qszBase ).fileName();
+
+    return qszName.mid( ( int )strlen( "segment_" ) ).toULongLong();
+
+}
+
+static std::string Func_Segment_Base( const QString &qszPath, uint64_t nSequence )
+{
+
+    return QDir( qszPath ).absoluteFilePath( QString::asprintf( "segment_%012llu", ( unsigned long long )nSequence ) ).toStdString();
+
+}
+
+static BOOL Func_Write_Full( int nFd, struct iovec * pIov, int nIov, uint64_t nOffset )
+{
+
+    ////// pwritev() may stop short, carry on from where it did
+
+    while( nIov > 0 ) {
+
+        ssize_t nWritten = pwritev( nFd, pIov, nIov, ( off_t )nOffset );
+
+        if( nWritten < 0 ) {
+
+            if( errno == EINTR ) continue;
+
+            return FALSE;
+
+        }
+
+        nOffset += ( uint64_t )nWritten;
+
+        while( nIov > 0 && ( size_t )nWritten >= pIov->iov_len ) {
+
+            nWritten -= ( ssize_t )pIov->iov_len;
+
+            pIov++;
+
+            nIov--;
+
+        }
+
+        if( nIov > 0 ) {
+
+            pIov->iov_base = ( uint8_t * )pIov->iov_base + nWritten;
+
+            pIov->iov_len -= ( size_t )nWritten;
+
+        }
+
+    }
+
+    return TRUE;
+
+}
+
+SegmentStore::SegmentStore( const QString &qszPath, RetentionIndex * pRetention, DiskAccountant * pAccountant, IoScheduler * pIoScheduler, uint64_t nSegmentBytes )
+    : m_qszPath( qszPath ), m_pRetention( pRetention ), m_pAccountant( pAccountant ), m_pIoScheduler( pIoScheduler ), m_nSegmentBytes( nSegmentBytes )
+{
+
+    QDir().mkpath( m_qszPath );
+
+    ////// Existing segments are closed, a new one is started on the first frame
+
+    QStringList qszBase_S = Func_Segment_List( m_qszPath );
+
+    for( const QString &qszBase : qszBase_S ) m_nSequence = std::max( m_nSequence, Func_Sequence_Parse( qszBase ) );
+
+    SegmentReader reader( m_qszPath );
+
+    uint64_t nFirst = 0;
+
+    uint64_t nLast = 0;
+
+    if( reader.GetFrameRange( &nFirst, &nLast ) == TRUE ) m_nNextFrame = nLast + 1;
+
+    printf( "[QCAP DEBUG] Segment store: %s, %lu segments, next frame %lu\n"
+            , m_qszPath.toUtf8().data(), ( ULONG )qszBase_S.size(), ( ULONG )m_nNextFrame );
+
+}
+
+SegmentStore::~SegmentStore()
+{
+
+    ClosedSegment closed;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        Func_Segment_Close( &closed );
+    }
+
+    Func_Segment_Finish( closed );
+
+}
+
+BOOL SegmentStore::Func_Segment_Open()
+{
+
+    ////// The whole segment is accounted for up front
+
+    if( m_pAccountant != nullptr && m_pAccountant->Reserve( m_nSegmentBytes ) == FALSE ) {
+
+        printf( "[QCAP DEBUG] %s(%d): no disk space for a new segment\n", __FUNCTION__, __LINE__ );
+
+        return FALSE;
+
+    }
+
+    m_nSequence++;
+
+    std::string strBase = Func_Segment_Base( m_qszPath, m_nSequence );
+
+    m_nFd = open( ( strBase + SEGMENT_STORE_EXTENSION ).c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+
+    ////// Allocated up front, appends then never extend the file. Where the file system can
+    ////// not, the file just grows and every frame reserves its own space.
+
+    BOOL bAllocated = FALSE;
+
+    if( m_nFd < 0 || DiskAccountant::Func_File_Preallocate( m_nFd, m_nSegmentBytes, &bAllocated ) == FALSE ) {
+
+        printf( "[QCAP DEBUG] %s(%d): open / fallocate( %s ) failed, errno=%d\n", __FUNCTION__, __LINE__, strBase.c_str(), errno );
+
+        if( m_nFd >= 0 ) {
+
+            close( m_nFd );
+
+            unlink( ( strBase + SEGMENT_STORE_EXTENSION ).c_str() );
+
+        }
+
+        m_nFd = -1;
+
+        if( m_pAccountant != nullptr ) m_pAccountant->Release( m_nSegmentBytes );
+
+        return FALSE;
+
+    }
+
+    if( m_pAccountant != nullptr ) m_pAccountant->Release( m_nSegmentBytes );
+
+    m_bPreallocated = bAllocated;
+
+    SegmentFileHeader header = {};
+
+    header.nMagic = SEGMENT_STORE_MAGIC;
+
+    header.nVersion = SEGMENT_STORE_VERSION;
+
+    header.nSequence = m_nSequence;
+
+    header.nCapacity = m_nSegmentBytes;
+
+    header.nCreatedMs = QDateTime::currentMSecsSinceEpoch();
+
+    struct iovec iov = { &header, sizeof( header ) };
+
+    m_pFp_Index = fopen( ( strBase + SEGMENT_STORE_INDEX_EXTENSION ).c_str(), "wb" );
+
+    if( Func_Write_Full( m_nFd, &iov, 1, 0 ) == FALSE || m_pFp_Index == nullptr ) {
+
+        printf( "[QCAP DEBUG] %s(%d): segment %s init failed, errno=%d\n", __FUNCTION__, __LINE__, strBase.c_str(), errno );
+
+        if( m_pFp_Index != nullptr ) fclose( m_pFp_Index );
+
+        m_pFp_Index = nullptr;
+
+        close( m_nFd );
+
+        m_nFd = -1;
+
+        unlink( ( strBase + SEGMENT_STORE_EXTENSION ).c_str() );
+
+        unlink( ( strBase + SEGMENT_STORE_INDEX_EXTENSION ).c_str() );
+
+        return FALSE;
+
+    }
+
+    m_nOffset = SEGMENT_STORE_ALIGN;
+
+    m_nLastCaptureMs = 0;
+
+    ////// Retention must not evict the segment being appended to
+
+    if( m_pRetention != nullptr ) m_pRetention->Pin( QString::fromStdString( strBase + SEGMENT_STORE_EXTENSION ) );
+
+    printf( "[QCAP DEBUG] Segment store: open %s%s\n", strBase.c_str(), SEGMENT_STORE_EXTENSION );
+
+    return TRUE;
+
+}
+
+void SegmentStore::Func_Segment_Close( ClosedSegment * pClosed )
+{
+
+    if( m_nFd < 0 ) return;
+
+    ////// Only detached here: the ftruncate() and fdatasync() of a full segment take long
+    ////// enough to stall the other writer if they ran under the lock
+
+    pClosed->nFd = m_nFd;
+
+    pClosed->pFp_Index = m_pFp_Index;
+
+    pClosed->nBytes = m_nOffset;
+
+    pClosed->nLastCaptureMs = m_nLastCaptureMs;
+
+    pClosed->strFile = Func_Segment_Base( m_qszPath, m_nSequence ) + SEGMENT_STORE_EXTENSION;
+
+    m_nFd = -1;
+
+    m_pFp_Index = nullptr;
+
+}
+
+void SegmentStore::Func_Segment_Finish( const ClosedSegment &closed )
+{
+
+    if( closed.nFd < 0 ) return;
+
+    ////// Give back the unused part of the reservation
+
+    if( ftruncate( closed.nFd, ( off_t )closed.nBytes ) != 0 ) printf( "[QCAP DEBUG] %s(%d): ftruncate() failed, errno=%d\n", __FUNCTION__, __LINE__, errno );
+
+    fdatasync( closed.nFd );
+
+    close( closed.nFd );
+
+    fclose( closed.pFp_Index );
+
+    ////// Evictable from now on, ordered by its newest frame
+
+    if( m_pRetention != nullptr ) m_pRetention->Add( QString::fromStdString( closed.strFile ), closed.nLastCaptureMs, closed.nBytes );
+
+}
+
+int64_t SegmentStore::Append( const ColorPlanes &planes, int nPlanes, ULONG nWidth, ULONG nHeight, ULONG nColorSpaceType, qint64 nCaptureTimeMs, BOOL bCompress, uint64_t * pnBytes )
+{
+
+    if( pnBytes != nullptr ) *pnBytes = 0;
+
+    ////// Payload is prepared before the lock, so the two writers only serialise on the disk
+
+    static thread_local std::vector< uint8_t > vPayload;
+
+    SegmentFrameHeader header = {};
+
+    struct iovec iov[ 4 ];
+
+    int nIov = 1;
+
+    uint64_t nPayloadBytes = 0;
+
+    if( bCompress == TRUE ) {
+
+        vPayload.clear();
+
+        FrameCodec_Encode( planes, nPlanes, nWidth, nHeight, &vPayload );
+
+        iov[ nIov++ ] = { vPayload.data(), vPayload.size() };
+
+        nPayloadBytes = vPayload.size();
+
+    } else {
+
+        BOOL bPacked = TRUE;
+
+        for( int i = 0; i < nPlanes; i++ ) if( ( ULONG )planes.nStride[ i ] != nWidth ) bPacked = FALSE;
+
+        size_t nPlaneBytes = ( size_t )nWidth * nHeight;
+
+        if( bPacked == TRUE ) {
+
+            for( int i = 0; i < nPlanes; i++ ) iov[ nIov++ ] = { planes.pData[ i ], nPlaneBytes };
+
+        } else {
+
+            vPayload.resize( nPlaneBytes * nPlanes );
+
+            for( int i = 0; i < nPlanes; i++ ) {
+
+                for( ULONG y = 0; y < nHeight; y++ ) memcpy( vPayload.data() + nPlaneBytes * i + ( size_t )y * nWidth, planes.pData[ i ] + ( size_t )y * planes.nStride[ i ], nWidth );
+
+            }
+
+            iov[ nIov++ ] = { vPayload.data(), vPayload.size() };
+
+        }
+
+        nPayloadBytes = nPlaneBytes * nPlanes;
+
+    }
+
+    header.nMagic = SEGMENT_FRAME_MAGIC;
+
+    header.nHeaderBytes = sizeof( header );
+
+    header.nCaptureTimeMs = nCaptureTimeMs;
+
+    header.nWidth = ( uint32_t )nWidth;
+
+    header.nHeight = ( uint32_t )nHeight;
+
+    header.nColorSpaceType = ( uint32_t )nColorSpaceType;
+
+    header.nPlanes = ( uint16_t )nPlanes;
+
+    header.nCodec = ( uint16_t )( ( bCompress == TRUE ) ? SEGMENT_CODEC_BSCF : SEGMENT_CODEC_RAW );
+
+    for( int i = 0; i < nPlanes && i < 3; i++ ) header.nStride[ i ] = ( uint32_t )nWidth;
+
+    header.nPayloadBytes = ( uint32_t )nPayloadBytes;
+
+    iov[ 0 ] = { &header, sizeof( header ) };
+
+    uint64_t nSpan = Func_Frame_Span( nPayloadBytes );
+
+    ClosedSegment closed;
+
+    int64_t nFrame = -1;
+
+    ////// Export is held off for the disk work only, the frame was coded above
+
+    if( m_pIoScheduler != nullptr ) m_pIoScheduler->Acquire( IO_CLASS_CAPTURE, nSpan );
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        nFrame = Func_Frame_Append( &header, iov, nIov, nSpan, nCaptureTimeMs, &closed );
+    }
+
+    ////// A segment this frame rolled over is synced without holding up the other writer
+
+    Func_Segment_Finish( closed );
+
+    if( m_pIoScheduler != nullptr ) m_pIoScheduler->Complete( IO_CLASS_CAPTURE, ( nFrame >= 0 ) ? nSpan : 0 );
+
+    if( nFrame >= 0 && pnBytes != nullptr ) *pnBytes = nSpan;
+
+    return nFrame;
+
+}
+
+int64_t SegmentStore::Func_Frame_Append( SegmentFrameHeader * pHeader, struct iovec * pIov, int nIov, uint64_t nSpan, qint64 nCaptureTimeMs, ClosedSegment * pClosed )
+{
+
+    ////// Roll over when the frame does not fit, an empty segment takes it regardless
+
+    if( m_nFd >= 0 && m_nOffset + nSpan > m_nSegmentBytes && m_nOffset > SEGMENT_STORE_ALIGN ) Func_Segment_Close( pClosed );
+
+    if( m_nFd < 0 && Func_Segment_Open() == FALSE ) {
+
+        m_nWriteErrors++;
+
+        return -1;
+
+    }
+
+    pHeader->nFrame = m_nNextFrame;
+
+    BOOL bReserved = FALSE;
+
+    if( m_bPreallocated == FALSE && m_pAccountant != nullptr ) {
+
+        if( m_pAccountant->Reserve( nSpan ) == FALSE ) {
+
+            m_nWriteErrors++;
+
+            return -1;
+
+        }
+
+        bReserved = TRUE;
+
+    }
+
+    BOOL bWritten = Func_Write_Full( m_nFd, pIov, nIov, m_nOffset );
+
+    if( bReserved == TRUE ) m_pAccountant->Release( nSpan );
+
+    if( bWritten == FALSE ) {
+
+        printf( "[QCAP DEBUG] %s(%d): pwritev() failed, errno=%d\n", __FUNCTION__, __LINE__, errno );
+
+        m_nWriteErrors++;
+
+        return -1;
+
+    }
+
+    if( m_pAccountant != nullptr ) m_pAccountant->Written( nSpan );
+
+    ////// Index entry only after the frame is in the file, so it never points at nothing
+
+    SegmentIndexEntry entry = {};
+
+    entry.nFrame = pHeader->nFrame;
+
+    entry.nCaptureTimeMs = nCaptureTimeMs;
+
+    entry.nOffset = m_nOffset;
+
+    entry.nPayloadBytes = pHeader->nPayloadBytes;
+
+    fwrite( &entry, sizeof( entry ), 1, m_pFp_Index );
+
+    fflush( m_pFp_Index );
+
+    m_nOffset += nSpan;
+
+    m_nNextFrame++;
+
+    m_nLastCaptureMs = std::max( m_nLastCaptureMs, ( qint64 )nCaptureTimeMs );
+
+    m_nFramesWritten++;
+
+    m_nBytesWritten += nSpan;
+
+    return ( int64_t )pHeader->nFrame;
+
+}
+
+SegmentStoreStats SegmentStore::GetStats() const
+{
+
+    SegmentStoreStats stats;
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    stats.st_nSequence = m_nSequence;
+
+    stats.st_nFramesWritten = m_nFramesWritten;
+
+    stats.st_nBytesWritten = m_nBytesWritten;
+
+    stats.st_nWriteErrors = m_nWriteErrors;
+
+    return stats;
+
+}
+
+SegmentReader::SegmentReader( const QString &qszPath )
+    : m_qszPath( qszPath )
+{
+
+    Refresh();
+
+}
+
+SegmentReader::~SegmentReader()
+{
+
+    for( Segment &segment : m_oSegment_S ) Func_Segment_Unmap( &segment );
+
+}
+
+void SegmentReader::Refresh()
+{
+
+    std::vector< Segment > oSegment_S;
+
+    for( const QString &qszBase : Func_Segment_List( m_qszPath ) ) {
+
+        Segment segment;
+
+        segment.strBase = qszBase.toStdString();
+
+        segment.nSequence = Func_Sequence_Parse( qszBase );
+
+        ////// Known segments keep their mapping, evicted ones are dropped below
+
+        auto it = std::find_if( m_oSegment_S.begin(), m_oSegment_S.end(), [ &segment ]( const Segment &s ) { return s.nSequence == segment.nSequence; } );
+
+        if( it != m_oSegment_S.end() ) {
+
+            std::swap( segment, *it );
+
+            it->nSequence = UINT64_MAX;
+
+        }
+
+        oSegment_S.push_back( std::move( segment ) );
+
+    }
+
+    for( Segment &segment : m_oSegment_S ) Func_Segment_Unmap( &segment );
+
+    m_oSegment_S.swap( oSegment_S );
+
+    ////// Only the newest segments can still be growing, older ones are loaded once
+
+    for( size_t i = 0; i < m_oSegment_S.size(); i++ ) {
+
+        if( m_oSegment_S[ i ].vIndex.empty() == FALSE && i + 1 < m_oSegment_S.size() && m_oSegment_S[ i + 1 ].vIndex.empty() == FALSE ) continue;
+
+        Func_Segment_Load( &m_oSegment_S[ i ] );
+
+    }
+
+}
+
+void SegmentReader::Func_Segment_Load( Segment * pSegment )
+{
+
+    pSegment->vIndex.clear();
+
+    FILE * pFp = fopen( ( pSegment->strBase + SEGMENT_STORE_INDEX_EXTENSION ).c_str(), "rb" );
+
+    if( pFp != nullptr ) {
+
+        SegmentIndexEntry entry;
+
+        while( fread( &entry, sizeof( entry ), 1, pFp ) == 1 ) {
+
+            if( pSegment->vIndex.empty() == FALSE && entry.nFrame <= pSegment->vIndex.back().nFrame ) break;
+
+            pSegment->vIndex.push_back( entry );
+
+        }
+
+        fclose( pFp );
+
+    }
+
+    ////// Frames past the last index entry are recovered from their headers. pread() rather
+    ////// than the mapping: the writer may truncate the segment under us.
+
+    int nFd = open( ( pSegment->strBase + SEGMENT_STORE_EXTENSION ).c_str(), O_RDONLY | O_CLOEXEC );
+
+    if( nFd < 0 ) return;
+
+    struct stat st = {};
+
+    fstat( nFd, &st );
+
+    uint64_t nOffset = SEGMENT_STORE_ALIGN;
+
+    if( pSegment->vIndex.empty() == FALSE ) nOffset = pSegment->vIndex.back().nOffset + Func_Frame_Span( pSegment->vIndex.back().nPayloadBytes );
+
+    while( nOffset + sizeof( SegmentFrameHeader ) <= ( uint64_t )st.st_size ) {
+
+        SegmentFrameHeader header;
+
+        if( pread( nFd, &header, sizeof( header ), ( off_t )nOffset ) != ( ssize_t )sizeof( header ) ) break;
+
+        if( header.nMagic != SEGMENT_FRAME_MAGIC || header.nHeaderBytes != sizeof( header ) ) break;
+
+        if( nOffset + sizeof( header ) + header.nPayloadBytes > ( uint64_t )st.st_size ) break;
+
+        if( pSegment->vIndex.empty() == FALSE && header.nFrame <= pSegment->vIndex.back().nFrame ) break;
+
+        SegmentIndexEntry entry = {};
+
+        entry.nFrame = header.nFrame;
+
+        entry.nCaptureTimeMs = header.nCaptureTimeMs;
+
+        entry.nOffset = nOffset;
+
+        entry.nPayloadBytes = header.nPayloadBytes;
+
+        pSegment->vIndex.push_back( entry );
+
+        nOffset += Func_Frame_Span( header.nPayloadBytes );
+
+    }
+
+    close( nFd );
+
+    pSegment->nMinTimeMs = INT64_MAX;
+
+    pSegment->nMaxTimeMs = INT64_MIN;
+
+    for( const SegmentIndexEntry &entry : pSegment->vIndex ) {
+
+        pSegment->nMinTimeMs = std::min( pSegment->nMinTimeMs, entry.nCaptureTimeMs );
+
+        pSegment->nMaxTimeMs = std::max( pSegment->nMaxTimeMs, entry.nCaptureTimeMs );
+
+    }
+
+}
+
+BOOL SegmentReader::Func_Segment_Map( Segment * pSegment )
+{
+
+    Func_Segment_Unmap( pSegment );
+
+    int nFd = open( ( pSegment->strBase + SEGMENT_STORE_EXTENSION ).c_str(), O_RDONLY | O_CLOEXEC );
+
+    if( nFd < 0 ) return FALSE;
+
+    struct stat st = {};
+
+    fstat( nFd, &st );
+
+    void * pMap = ( st.st_size > 0 ) ? mmap( nullptr, ( size_t )st.st_size, PROT_READ, MAP_SHARED, nFd, 0 ) : MAP_FAILED;
+
+    close( nFd );
+
+    if( pMap == MAP_FAILED ) return FALSE;
+
+    pSegment->pMap = ( const uint8_t * )pMap;
+
+    pSegment->nMapBytes = ( size_t )st.st_size;
+
+    return TRUE;
+
+}
+
+void SegmentReader::Func_Segment_Unmap( Segment * pSegment )
+{
+
+    if( pSegment->pMap != nullptr ) munmap( ( void * )pSegment->pMap, pSegment->nMapBytes );
+
+    pSegment->pMap = nullptr;
+
+    pSegment->nMapBytes = 0;
+
+}
+
+BOOL SegmentReader::Func_Entry_Get( Segment * pSegment, const SegmentIndexEntry &entry, SegmentFrame * pFrame )
+{
+
+    ////// Compared without adding to the offset, a corrupt index entry must not wrap around
+
+    uint64_t nNeed = sizeof( SegmentFrameHeader ) + ( uint64_t )entry.nPayloadBytes;
+
+    auto Func_Entry_Fits = [ & ]() { return entry.nOffset <= pSegment->nMapBytes && pSegment->nMapBytes - entry.nOffset >= nNeed; };
+
+    if( Func_Entry_Fits() == FALSE && ( Func_Segment_Map( pSegment ) == FALSE || Func_Entry_Fits() == FALSE ) ) return FALSE;
+
+    const SegmentFrameHeader * pHeader = ( const SegmentFrameHeader * )( pSegment->pMap + entry.nOffset );
+
+    if( pHeader->nMagic != SEGMENT_FRAME_MAGIC || pHeader->nFrame != entry.nFrame ) return FALSE;
+
+    ////// The payload is read by what the header says, which has to stay inside the mapping too
+
+    if( pHeader->nHeaderBytes != sizeof( SegmentFrameHeader ) || pHeader->nPayloadBytes != entry.nPayloadBytes ) {
+
+        printf( "[QCAP DEBUG] %s(%d): frame %lu header does not match its index entry\n", __FUNCTION__, __LINE__, ( ULONG )entry.nFrame );
+
+        return FALSE;
+
+    }
+
+    pFrame->pHeader = pHeader;
+
+    pFrame->pPayload = ( const uint8_t * )pHeader + pHeader->nHeaderBytes;
+
+    return TRUE;
+
+}
+
+uint64_t SegmentReader::GetFrameCount() const
+{
+
+    uint64_t nCount = 0;
+
+    for( const Segment &segment : m_oSegment_S ) nCount += segment.vIndex.size();
+
+    return nCount;
+
+}
+
+BOOL SegmentReader::GetFrameRange( uint64_t * pFirst, uint64_t * pLast ) const
+{
+
+    BOOL bFound = FALSE;
+
+    for( const Segment &segment : m_oSegment_S ) {
+
+        if( segment.vIndex.empty() == TRUE ) continue;
+
+        if( bFound == FALSE ) *pFirst = segment.vIndex.front().nFrame;
+
+        *pLast = segment.vIndex.back().nFrame;
+
+        bFound = TRUE;
+
+    }
+
+    return bFound;
+
+}
+
+BOOL SegmentReader::GetFrame( uint64_t nFrame, SegmentFrame * pFrame )
+{
+
+    ////// Segments hold ascending, disjoint frame ranges
+
+    auto itSegment = std::upper_bound( m_oSegment_S.begin(), m_oSegment_S.end(), nFrame, []( uint64_t n, const Segment &s ) {
+        return s.vIndex.empty() == FALSE && n < s.vIndex.front().nFrame;
+    } );
+
+    while( itSegment != m_oSegment_S.begin() ) {
+
+        --itSegment;
+
+        if( itSegment->vIndex.empty() == TRUE ) continue;
+
+        const std::vector< SegmentIndexEntry > &vIndex = itSegment->vIndex;
+
+        auto it = std::lower_bound( vIndex.begin(), vIndex.end(), nFrame, []( const SegmentIndexEntry &e, uint64_t n ) { return e.nFrame < n; } );
+
+        if( it == vIndex.end() || it->nFrame != nFrame ) return FALSE;
+
+        return Func_Entry_Get( &*itSegment, *it, pFrame );
+
+    }
+
+    return FALSE;
+
+}
+
+BOOL SegmentReader::FindFrame( qint64 nTimeMs, SegmentFrame * pFrame )
+{
+
+    ////// The crop writer and the ring interleave, so capture times are only roughly in
+    ////// frame order: look at every entry of the segments that can hold a match
+
+    Segment * pBestSegment = nullptr;
+
+    const SegmentIndexEntry * pBest = nullptr;
+
+    Segment * pFirstSegment = nullptr;
+
+    const SegmentIndexEntry * pFirst = nullptr;
+
+    for( Segment &segment : m_oSegment_S ) {
+
+        if( segment.vIndex.empty() == TRUE ) continue;
+
+        ////// Once a match is known, only a segment with entries in ( match, nTimeMs ] can beat it
+
+        if( pBest != nullptr && ( segment.nMinTimeMs > nTimeMs || segment.nMaxTimeMs < pBest->nCaptureTimeMs ) ) continue;
+
+        for( const SegmentIndexEntry &entry : segment.vIndex ) {
+
+            if( pFirst == nullptr || entry.nCaptureTimeMs < pFirst->nCaptureTimeMs ) { pFirst = &entry; pFirstSegment = &segment; }
+
+            if( entry.nCaptureTimeMs > nTimeMs ) continue;
+
+            if( pBest == nullptr || entry.nCaptureTimeMs >= pBest->nCaptureTimeMs ) { pBest = &entry; pBestSegment = &segment; }
+
+        }
+
+    }
+
+    if( pBest == nullptr ) { pBest = pFirst; pBestSegment = pFirstSegment; }
+
+    if( pBest == nullptr ) return FALSE;
+
+    return Func_Entry_Get( pBestSegment, *pBest, pFrame );
+
+}
+
+BOOL SegmentReader::Func_Frame_Unpack( const SegmentFrame &frame, std::vector< uint8_t > * pOut )
+{
+
+    const SegmentFrameHeader * pHeader = frame.pHeader;
+
+    pOut->clear();
+
+    if( pHeader->nCodec == SEGMENT_CODEC_RAW ) {
+
+        pOut->assign( frame.pPayload, frame.pPayload + pHeader->nPayloadBytes );
+
+        return TRUE;
+
+    }
+
+    FrameCodecImage image;
+
+    if( pHeader->nCodec != SEGMENT_CODEC_BSCF || FrameCodec_Decode( frame.pPayload, pHeader->nPayloadBytes, &image ) == FALSE ) return FALSE;
+
+    for( int i = 0; i < image.nPlanes; i++ ) pOut->insert( pOut->end(), image.vPlane[ i ].begin(), image.vPlane[ i ].end() );
+
+    return TRUE;
+
+}
+
+BOOL SegmentStore_Frame_Extract( const char * pszPath, uint64_t nFrame, const char * pszOutput )
+{
+
+    SegmentReader reader( QString::fromUtf8( pszPath ) );
+
+    SegmentFrame frame;
+
+    if( reader.GetFrame( nFrame, &frame ) == FALSE ) {
+
+        printf( "[QCAP DEBUG] Frame %lu not in %s ( %lu frames )\n", ( ULONG )nFrame, pszPath, ( ULONG )reader.GetFrameCount() );
+
+        return FALSE;
+
+    }
+
+    std::vector< uint8_t > vData;
+
+    if( SegmentReader::Func_Frame_Unpack( frame, &vData ) == FALSE ) {
+
+        printf( "[QCAP DEBUG] Frame %lu: payload decode failed\n", ( ULONG )nFrame );
+
+        return FALSE;
+
+    }
+
+    FILE * pFp = fopen( pszOutput, "wb" );
+
+    if( pFp == nullptr ) return FALSE;
+
+    BOOL bWritten = ( fwrite( vData.data(), 1, vData.size(), pFp ) == vData.size() ) ? TRUE : FALSE;
+
+    fclose( pFp );
+
+    printf( "[QCAP DEBUG] Frame %lu: %s, %ux%u, %u planes, colour space %u -> %s\n"
+            , ( ULONG )nFrame, QDateTime::fromMSecsSinceEpoch( frame.pHeader->nCaptureTimeMs ).toString( Qt::ISODateWithMs ).toUtf8().data()
+            , frame.pHeader->nWidth, frame.pHeader->nHeight, frame.pHeader->nPlanes, frame.pHeader->nColorSpaceType, pszOutput );
+
+    return bWritten;
+
+}
@@ -0,0 +1,306 @@
+#ifndef SEGMENTSTORE_H
+#define SEGMENTSTORE_H
+
+#include <QString>
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <mutex>
+#include <vector>
+#include <string>
+
+#include <qcap.windef.h>
+
+#include "colorconvert.h"
+
+struct iovec;
+
+class RetentionIndex;
+
+class DiskAccountant;
+
+class IoScheduler;
+
+////// Append-only frame store: frames go into large preallocated segment files instead of
+////// one file each, so the output folder holds a few hundred entries instead of a few
+////// hundred thousand and capture never pays for create / close per frame.
+//////
+////// <dir>/segment_<seq>.bsseg   SegmentFileHeader, then frames at SEGMENT_STORE_ALIGN
+//////                             boundaries, each a SegmentFrameHeader plus payload
+////// <dir>/segment_<seq>.bsidx   one SegmentIndexEntry per frame, appended after the frame
+//////
+////// Frame numbers run on across segments and restarts. Every frame header describes its
+////// own payload, so a reader rebuilds the tail of a segment whose index missed the last
+////// frames ( power loss ) by walking the headers.
+
+#define SEGMENT_STORE_SEGMENT_MB 256
+
+#define SEGMENT_STORE_ALIGN 4096
+
+#define SEGMENT_STORE_EXTENSION ".bsseg"
+
+#define SEGMENT_STORE_INDEX_EXTENSION ".bsidx"
+
+#define SEGMENT_STORE_MAGIC 0x47535342          // "BSSG"
+
+#define SEGMENT_FRAME_MAGIC 0x52465342          // "BSFR"
+
+#define SEGMENT_STORE_VERSION 1
+
+enum SegmentCodec {
+
+    SEGMENT_CODEC_RAW = 0,                      // planes back to back, stride == width
+
+    SEGMENT_CODEC_BSCF                          // FrameCodec_Encode() stream
+
+};
+
+////// On-disk records, little endian, naturally aligned so the reader can use them in place
+
+struct SegmentFileHeader {
+
+    uint32_t    nMagic;
+
+    uint32_t    nVersion;
+
+    uint64_t    nSequence;
+
+    uint64_t    nCapacity;
+
+    int64_t     nCreatedMs;
+
+    uint8_t     reserved[ 32 ];
+
+};
+
+struct SegmentFrameHeader {
+
+    uint32_t    nMagic;
+
+    uint32_t    nHeaderBytes;
+
+    uint64_t    nFrame;
+
+    int64_t     nCaptureTimeMs;
+
+    uint32_t    nWidth;
+
+    uint32_t    nHeight;
+
+    uint32_t    nColorSpaceType;                // QCAP_COLORSPACE_TYPE_*
+
+    uint16_t    nPlanes;
+
+    uint16_t    nCodec;                         // SegmentCodec
+
+    uint32_t    nStride[ 3 ];
+
+    uint32_t    nPayloadBytes;
+
+};
+
+struct SegmentIndexEntry {
+
+    uint64_t    nFrame;
+
+    int64_t     nCaptureTimeMs;
+
+    uint64_t    nOffset;                        // of the SegmentFrameHeader
+
+    uint32_t    nPayloadBytes;
+
+    uint32_t    reserved;
+
+};
+
+static_assert( sizeof( SegmentFileHeader ) == 64, "segment header layout" );
+
+static_assert( sizeof( SegmentFrameHeader ) == 56, "frame header layout" );
+
+static_assert( sizeof( SegmentIndexEntry ) == 32, "index entry layout" );
+
+struct SegmentStoreStats {
+
+    uint64_t    st_nSequence            = 0;               // of the newest segment
+
+    uint64_t    st_nFramesWritten       = 0;
+
+    uint64_t    st_nBytesWritten        = 0;
+
+    uint64_t    st_nWriteErrors         = 0;
+
+};
+
+////// Writer side, shared by the crop writer and the pre-trigger ring, Append() is thread safe.
+////// Closed segments are handed to the retention index, which evicts them as a whole.
+
+class SegmentStore
+{
+
+public:
+
+    ////// The write of every frame, and the sync of a segment it closes, run as capture I/O on
+    ////// pIoScheduler; coding and packing the frame do not
+
+    explicit SegmentStore( const QString &qszPath, RetentionIndex * pRetention = nullptr, DiskAccountant * pAccountant = nullptr, IoScheduler * pIoScheduler = nullptr
+                           , uint64_t nSegmentBytes = ( uint64_t )SEGMENT_STORE_SEGMENT_MB << 20 );
+
+    ~SegmentStore();
+
+    ////// Returns the frame number, or -1 when the write failed. nPlanes planes of
+    ////// nWidth x nHeight are packed; bCompress codes them with FrameCodec first.
+    ////// *pnBytes gets the bytes that went to disk.
+
+    int64_t Append( const ColorPlanes &planes, int nPlanes, ULONG nWidth, ULONG nHeight, ULONG nColorSpaceType, qint64 nCaptureTimeMs, BOOL bCompress, uint64_t * pnBytes = nullptr );
+
+    SegmentStoreStats GetStats() const;
+
+    const QString & GetPath() const { return m_qszPath; }
+
+private:
+
+    ////// A segment taken off the append path, synced and closed outside the lock
+
+    struct ClosedSegment {
+
+        int                 nFd             = -1;
+
+        FILE *              pFp_Index       = nullptr;
+
+        uint64_t            nBytes          = 0;
+
+        qint64              nLastCaptureMs  = 0;
+
+        std::string         strFile;
+
+    };
+
+    BOOL Func_Segment_Open();
+
+    void Func_Segment_Close( ClosedSegment * pClosed );
+
+    void Func_Segment_Finish( const ClosedSegment &closed );
+
+    int64_t Func_Frame_Append( SegmentFrameHeader * pHeader, struct iovec * pIov, int nIov, uint64_t nSpan, qint64 nCaptureTimeMs, ClosedSegment * pClosed );
+
+private:
+
+    QString                     m_qszPath;
+
+    RetentionIndex *            m_pRetention;
+
+    DiskAccountant *            m_pAccountant;
+
+    IoScheduler *               m_pIoScheduler;
+
+    uint64_t                    m_nSegmentBytes;
+
+    mutable std::mutex          m_mtx;
+
+    int                         m_nFd               = -1;
+
+    FILE *                      m_pFp_Index         = nullptr;
+
+    uint64_t                    m_nSequence         = 0;
+
+    uint64_t                    m_nOffset           = 0;
+
+    BOOL                        m_bPreallocated     = FALSE;    // else every frame reserves its own space
+
+    uint64_t                    m_nNextFrame        = 0;
+
+    qint64                      m_nLastCaptureMs    = 0;
+
+    uint64_t                    m_nFramesWritten    = 0;
+
+    uint64_t                    m_nBytesWritten     = 0;
+
+    uint64_t                    m_nWriteErrors      = 0;
+
+};
+
+////// One frame as seen through the reader's mapping, valid while the reader lives
+
+struct SegmentFrame {
+
+    const SegmentFrameHeader *  pHeader     = nullptr;
+
+    const uint8_t *             pPayload    = nullptr;
+
+};
+
+////// Reader side: maps segments read only on first use. Frames are found by number with a
+////// binary search over the per-segment indexes, by capture time through each segment's
+////// time range.
+
+class SegmentReader
+{
+
+public:
+
+    explicit SegmentReader( const QString &qszPath );
+
+    ~SegmentReader();
+
+    ////// Picks up segments and frames written since the last call
+
+    void Refresh();
+
+    uint64_t GetFrameCount() const;
+
+    ////// [ first, last ] frame number, FALSE when the store is empty
+
+    BOOL GetFrameRange( uint64_t * pFirst, uint64_t * pLast ) const;
+
+    BOOL GetFrame( uint64_t nFrame, SegmentFrame * pFrame );
+
+    ////// Last frame captured at or before nTimeMs ( the first one if all are later )
+
+    BOOL FindFrame( qint64 nTimeMs, SegmentFrame * pFrame );
+
+    ////// Payload unpacked to planes back to back ( decodes BSCF )
+
+    static BOOL Func_Frame_Unpack( const SegmentFrame &frame, std::vector< uint8_t > * pOut );
+
+private:
+
+    struct Segment {
+
+        std::string                         strBase;
+
+        uint64_t                            nSequence   = 0;
+
+        std::vector< SegmentIndexEntry >    vIndex;
+
+        int64_t                             nMinTimeMs  = 0;
+
+        int64_t                             nMaxTimeMs  = 0;
+
+        const uint8_t *                     pMap        = nullptr;
+
+        size_t                              nMapBytes   = 0;
+
+    };
+
+    void Func_Segment_Load( Segment * pSegment );
+
+    BOOL Func_Segment_Map( Segment * pSegment );
+
+    void Func_Segment_Unmap( Segment * pSegment );
+
+    BOOL Func_Entry_Get( Segment * pSegment, const SegmentIndexEntry &entry, SegmentFrame * pFrame );
+
+private:
+
+    QString                     m_qszPath;
+
+    std::vector< Segment >      m_oSegment_S;       // by sequence
+
+};
+
+////// Offline tooling: writes one frame of a store as .raw
+
+BOOL SegmentStore_Frame_Extract( const char * pszPath, uint64_t nFrame, const char * pszOutput );
+
+#endif // SEGMENTSTORE_H
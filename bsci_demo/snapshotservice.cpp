@@ -0,0 +1,312 @@
+#include "snapshotservice.h"
+#include "latencystats.h"
+#include "cpuconvert.h"
+
+#include <QDir>
+#include <QFile>
+#include <QBuffer>
+#include <QImage>
+#include <QImageWriter>
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <memory>
+
+SnapshotService::SnapshotService( const SnapshotParam &param )
+    : m_stParam( param ), m_bTrigger( FALSE )
+{
+
+    if( m_stParam.st_nThreads == 0 ) m_stParam.st_nThreads = 1;
+
+    if( m_stParam.st_nQueueDepth == 0 ) m_stParam.st_nQueueDepth = 1;
+
+    if( m_stParam.st_ePolicy == SNAPSHOT_POLICY_EVERY_NTH && m_stParam.st_nEveryNth == 0 ) {
+
+        printf( "[QCAP DEBUG] %s(%d): every 0th frame is not a snapshot policy, only F10 takes snapshots\n", __FUNCTION__, __LINE__ );
+
+        m_stParam.st_ePolicy = SNAPSHOT_POLICY_TRIGGER;
+
+    }
+
+    for( ULONG i = 0; i < m_stParam.st_nThreads; i++ ) m_thEncode_S.emplace_back( &SnapshotService::Func_Encode_Loop, this );
+
+}
+
+SnapshotService::~SnapshotService()
+{
+
+    std::deque< Item > queItem;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_bExit = TRUE;
+
+        queItem.swap( m_queItem );
+    }
+
+    m_cvQueue.notify_all();
+
+    for( std::thread &th : m_thEncode_S ) th.join();
+
+    for( const Item &item : queItem ) qcap2_rcbuffer_release( item.pRCBuffer );
+
+}
+
+void SnapshotService::Trigger()
+{
+
+    m_bTrigger = TRUE;
+
+}
+
+BOOL SnapshotService::Func_Policy_Accept()
+{
+
+    if( m_bTrigger.exchange( FALSE ) == TRUE ) return TRUE;
+
+    switch( m_stParam.st_ePolicy ) {
+
+    case SNAPSHOT_POLICY_EVERY_NTH:
+
+        if( m_stParam.st_nEveryNth == 0 ) return FALSE;
+
+        return ( ( m_nOffered - 1 ) % m_stParam.st_nEveryNth == 0 ) ? TRUE : FALSE;
+
+    case SNAPSHOT_POLICY_RATE: {
+
+        if( m_stParam.st_dMaxRate <= 0.0 ) return FALSE;
+
+        int64_t nNowNs = Func_Latency_Now();
+
+        if( nNowNs < m_nNextNs ) return FALSE;
+
+        m_nNextNs = nNowNs + ( int64_t )( 1e9 / m_stParam.st_dMaxRate );
+
+        return TRUE;
+
+    }
+
+    default:
+
+        return FALSE;
+
+    }
+
+}
+
+BOOL SnapshotService::Offer( qcap2_rcbuffer_t * pRCBuffer, int64_t nOriginNs )
+{
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_nOffered++;
+
+        m_stStats.st_nOffered++;
+
+        if( m_bExit == TRUE || Func_Policy_Accept() == FALSE ) return FALSE;
+
+        if( m_queItem.size() >= m_stParam.st_nQueueDepth ) {
+
+            m_stStats.st_nDropped++;
+
+            return FALSE;
+
+        }
+
+        ////// A reference only, the frame stays in its scaler buffer until it is encoded
+
+        qcap2_rcbuffer_add_ref( pRCBuffer );
+
+        m_queItem.push_back( { pRCBuffer, nOriginNs, m_nIndex++ } );
+
+        m_stStats.st_nQueued++;
+    }
+
+    m_cvQueue.notify_one();
+
+    return TRUE;
+
+}
+
+void SnapshotService::Func_Encode_Loop()
+{
+
+    while( TRUE ) {
+
+        Item item;
+
+        {
+            std::unique_lock< std::mutex > lock( m_mtx );
+
+            m_cvQueue.wait( lock, [ this ]() { return m_bExit == TRUE || m_queItem.empty() == FALSE; } );
+
+            if( m_bExit == TRUE ) return;
+
+            item = m_queItem.front();
+
+            m_queItem.pop_front();
+        }
+
+        int64_t nStartNs = Func_Latency_Now();
+
+        BOOL bOk = Func_Encode( item );
+
+        int64_t nEncodeNs = Func_Latency_Now() - nStartNs;
+
+        qcap2_rcbuffer_release( item.pRCBuffer );
+
+        if( bOk == TRUE ) LatencyStats::Instance().Record( LATENCY_STAGE_SNAPSHOT, item.nOriginNs );
+
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        if( bOk == TRUE ) {
+
+            m_stStats.st_nEncoded++;
+
+            m_nEncodeNs += nEncodeNs;
+
+            m_stStats.st_dEncodeMaxMs = std::max( m_stStats.st_dEncodeMaxMs, nEncodeNs / 1e6 );
+
+        } else {
+
+            m_stStats.st_nFailed++;
+
+        }
+
+    }
+
+}
+
+BOOL SnapshotService::Func_Encode( const Item &item )
+{
+
+    int nWidth = ( int )m_stParam.st_nWidth, nHeight = ( int )m_stParam.st_nHeight;
+
+    std::shared_ptr< qcap2_av_frame_t > pAVFrame(
+                ( qcap2_av_frame_t * )qcap2_rcbuffer_lock_data( item.pRCBuffer ),
+                [ &item ]( qcap2_av_frame_t * ) {
+                    qcap2_rcbuffer_unlock_data( item.pRCBuffer );
+                });
+
+    uint8_t * pBuffer[ 4 ];
+
+    int nStride[ 4 ];
+
+    qcap2_av_frame_get_buffer1( pAVFrame.get(), pBuffer, nStride );
+
+    if( pBuffer[ 0 ] == nullptr || pBuffer[ 1 ] == nullptr || pBuffer[ 2 ] == nullptr ) return FALSE;
+
+    ////// I420 -> planar RGB on the vector path, then interleaved for the encoder. This
+    ////// thread is the parallelism, the conversion stays on it
+
+    static thread_local std::vector< uint8_t > vPlanar;
+
+    vPlanar.resize( ( size_t )nWidth * nHeight * 3 );
+
+    uint8_t * pG = vPlanar.data(), * pB = pG + ( size_t )nWidth * nHeight, * pR = pB + ( size_t )nWidth * nHeight;
+
+    ColorPlanes src = { { pBuffer[ 0 ], pBuffer[ 1 ], pBuffer[ 2 ] }, { nStride[ 0 ], nStride[ 1 ], nStride[ 2 ] } };
+
+    ColorPlanes dst = { { pG, pB, pR }, { nWidth, nWidth, nWidth } };
+
+    CpuConvert_Run( CPU_CONVERT_I420_TO_GBRP, src, dst, nWidth, nHeight, CpuConvert_Isa_Best(), 1 );
+
+    pAVFrame.reset();
+
+    QImage image( nWidth, nHeight, QImage::Format_RGB888 );
+
+    for( int y = 0; y < nHeight; y++ ) {
+
+        uchar * pLine = image.scanLine( y );
+
+        size_t nRow = ( size_t )y * nWidth;
+
+        for( int x = 0; x < nWidth; x++ ) {
+
+            pLine[ 3 * x + 0 ] = pR[ nRow + x ];
+
+            pLine[ 3 * x + 1 ] = pG[ nRow + x ];
+
+            pLine[ 3 * x + 2 ] = pB[ nRow + x ];
+
+        }
+
+    }
+
+    const char * pszFormat = ( m_stParam.st_eFormat == SNAPSHOT_FORMAT_PNG ) ? "png" : "jpg";
+
+    QString qszName = ( m_stParam.st_nKeep > 0 )
+            ? QString( "%1-%2.%3" ).arg( m_stParam.st_qszPrefix ).arg( item.nIndex % m_stParam.st_nKeep, 2, 10, QChar( '0' ) ).arg( pszFormat )
+            : QString( "%1-%2.%3" ).arg( m_stParam.st_qszPrefix ).arg( item.nIndex, 6, 10, QChar( '0' ) ).arg( pszFormat );
+
+    QString qszPath = m_stParam.st_qszOutputPath + "/" + qszName;
+
+    ////// Hidden while it is written, the USB export and the folder watchers skip it
+
+    QString qszTemp = m_stParam.st_qszOutputPath + "/." + qszName + ".tmp";
+
+    ////// Made again on every write, a clean-up that removed the folder does not end the snapshots
+
+    QDir().mkpath( m_stParam.st_qszOutputPath );
+
+    QByteArray qbaCoded;
+
+    QBuffer buffer( &qbaCoded );
+
+    buffer.open( QIODevice::WriteOnly );
+
+    QImageWriter writer( &buffer, pszFormat );
+
+    writer.setQuality( ( m_stParam.st_eFormat == SNAPSHOT_FORMAT_PNG ) ? -1 : m_stParam.st_nQuality );
+
+    if( writer.write( image ) == false ) {
+
+        printf( "[QCAP DEBUG] %s(%d): snapshot %s failed: %s\n", __FUNCTION__, __LINE__, qszName.toUtf8().data(), writer.errorString().toUtf8().data() );
+
+        return FALSE;
+
+    }
+
+    IoScheduler * pIoScheduler = m_stParam.st_pIoScheduler;
+
+    if( pIoScheduler != nullptr ) pIoScheduler->Acquire( IO_CLASS_CAPTURE, ( uint64_t )qbaCoded.size() );
+
+    QFile file( qszTemp );
+
+    BOOL bWritten = ( file.open( QIODevice::WriteOnly | QIODevice::Truncate ) == true && file.write( qbaCoded ) == qbaCoded.size() && file.flush() == true ) ? TRUE : FALSE;
+
+    file.close();
+
+    if( pIoScheduler != nullptr ) pIoScheduler->Complete( IO_CLASS_CAPTURE, ( bWritten == TRUE ) ? ( uint64_t )qbaCoded.size() : 0 );
+
+    if( bWritten == FALSE ) {
+
+        printf( "[QCAP DEBUG] %s(%d): snapshot %s failed: %s\n", __FUNCTION__, __LINE__, qszName.toUtf8().data(), file.errorString().toUtf8().data() );
+
+        remove( qszTemp.toUtf8().data() );
+
+        return FALSE;
+
+    }
+
+    return ( rename( qszTemp.toUtf8().data(), qszPath.toUtf8().data() ) == 0 ) ? TRUE : FALSE;
+
+}
+
+SnapshotStats SnapshotService::GetStats() const
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    SnapshotStats stats = m_stStats;
+
+    stats.st_nDepth = ( ULONG )m_queItem.size();
+
+    stats.st_dEncodeAvgMs = ( stats.st_nEncoded > 0 ) ? m_nEncodeNs / 1e6 / stats.st_nEncoded : 0.0;
+
+    return stats;
+
+}
@@ -0,0 +1,179 @@
+#ifndef SNAPSHOTSERVICE_H
+#define SNAPSHOTSERVICE_H
+
+#include <QString>
+
+#include <stdint.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <atomic>
+
+#include <qcap.windef.h>
+#include <qcap2.h>
+
+#include "ioscheduler.h"
+
+////// Encoder threads, and frames waiting for them; every queued or encoding frame holds a
+////// scaler buffer, so the scaler needs that many on top of its own
+
+#define SNAPSHOT_THREADS 2
+
+#define SNAPSHOT_QUEUE_DEPTH 4
+
+////// File names wrap after this many, so snapshots never fill the disk
+
+#define SNAPSHOT_KEEP 30
+
+////// Own folder under the frame output, so the crop retention and the frame finder never
+////// count a snapshot as a stored crop
+
+#define SNAPSHOT_FOLDER "snapshots"
+
+enum SnapshotFormat {
+
+    SNAPSHOT_FORMAT_JPEG = 0,
+
+    SNAPSHOT_FORMAT_PNG
+
+};
+
+enum SnapshotPolicy {
+
+    SNAPSHOT_POLICY_EVERY_NTH = 0,      // one of every st_nEveryNth offered frames
+
+    SNAPSHOT_POLICY_RATE,               // at most st_dMaxRate per second
+
+    SNAPSHOT_POLICY_TRIGGER             // only after Trigger()
+
+};
+
+struct SnapshotParam {
+
+    QString         st_qszOutputPath;
+
+    QString         st_qszPrefix        = "snapshot";
+
+    ULONG           st_nWidth           = 0;            // I420 frames of this size
+
+    ULONG           st_nHeight          = 0;
+
+    SnapshotFormat  st_eFormat          = SNAPSHOT_FORMAT_JPEG;
+
+    int             st_nQuality         = 90;
+
+    SnapshotPolicy  st_ePolicy          = SNAPSHOT_POLICY_EVERY_NTH;
+
+    ULONG           st_nEveryNth        = 30;           // 0 is rejected, the policy falls back to trigger only
+
+    double          st_dMaxRate         = 1.0;
+
+    ULONG           st_nKeep            = SNAPSHOT_KEEP;
+
+    ULONG           st_nThreads         = SNAPSHOT_THREADS;
+
+    ULONG           st_nQueueDepth      = SNAPSHOT_QUEUE_DEPTH;
+
+    IoScheduler *   st_pIoScheduler     = nullptr;      // every file write runs as capture I/O
+
+};
+
+struct SnapshotStats {
+
+    ULONG       st_nDepth               = 0;
+
+    uint64_t    st_nOffered             = 0;
+
+    uint64_t    st_nQueued              = 0;
+
+    uint64_t    st_nEncoded             = 0;
+
+    uint64_t    st_nDropped             = 0;            // queue full
+
+    uint64_t    st_nFailed              = 0;
+
+    double      st_dEncodeAvgMs         = 0.0;
+
+    double      st_dEncodeMaxMs         = 0.0;
+
+};
+
+////// Stores inference frames as JPEG / PNG off the event handler thread. Offer() picks frames
+////// by the policy and only takes a reference, the colour conversion ( CpuConvert ) and the
+////// encoding run on a bounded pool; a frame that finds the queue full is dropped.
+////// Files are written under a temporary name and renamed, so nobody reads half of one; the
+////// image is encoded in memory first, so only the write itself holds the export off.
+
+class SnapshotService
+{
+
+public:
+
+    explicit SnapshotService( const SnapshotParam &param );
+
+    ////// Frames still queued are dropped, the ones being encoded are finished
+
+    ~SnapshotService();
+
+    ////// Never blocks; TRUE when the frame was queued
+
+    BOOL Offer( qcap2_rcbuffer_t * pRCBuffer, int64_t nOriginNs );
+
+    ////// The next offered frame is taken whatever the policy
+
+    void Trigger();
+
+    SnapshotStats GetStats() const;
+
+private:
+
+    struct Item {
+
+        qcap2_rcbuffer_t *  pRCBuffer;
+
+        int64_t             nOriginNs;
+
+        uint64_t            nIndex;
+
+    };
+
+    BOOL Func_Policy_Accept();
+
+    void Func_Encode_Loop();
+
+    BOOL Func_Encode( const Item &item );
+
+private:
+
+    SnapshotParam                   m_stParam;
+
+    std::vector< std::thread >      m_thEncode_S;
+
+    mutable std::mutex              m_mtx;
+
+    std::condition_variable         m_cvQueue;
+
+    std::deque< Item >              m_queItem;
+
+    BOOL                            m_bExit             = FALSE;
+
+    std::atomic< BOOL >             m_bTrigger;
+
+    ////// Policy state, only touched by Offer()
+
+    uint64_t                        m_nOffered          = 0;
+
+    int64_t                         m_nNextNs           = 0;
+
+    uint64_t                        m_nIndex            = 0;
+
+    SnapshotStats                   m_stStats;
+
+    int64_t                         m_nEncodeNs         = 0;
+
+};
+
+#endif // SNAPSHOTSERVICE_H
@@ -0,0 +1,445 @@
+#include "softcapture.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QStringList>
+
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+#include <cuda_runtime_api.h>
+
+SoftCapture::SoftCapture( const SoftCaptureParam &param )
+    : m_stParam( param )
+{
+
+    m_nFrameBytes = m_stParam.st_nVideoWidth * m_stParam.st_nVideoHeight * 3 / 2;
+
+}
+
+SoftCapture::~SoftCapture()
+{
+
+    Stop();
+
+    for( size_t i = 0; i < m_pFrameBuffer_S.size(); i++ ) {
+
+        if( m_bPinned_S[ i ] == TRUE ) cudaFreeHost( m_pFrameBuffer_S[ i ] );
+
+        else free( m_pFrameBuffer_S[ i ] );
+
+    }
+
+    m_pFrameBuffer_S.clear();
+
+    m_bPinned_S.clear();
+
+}
+
+BOOL SoftCapture::Func_Param_FromEnv( ULONG nDefaultWidth, ULONG nDefaultHeight, SoftCaptureParam * pParam )
+{
+
+    QString qszSource = QString::fromLocal8Bit( qgetenv( "BSCI_SOFT_CAPTURE" ) );
+
+    if( qszSource.isEmpty() == TRUE ) return FALSE;
+
+    pParam->st_qszSource = qszSource;
+
+    pParam->st_nVideoWidth = nDefaultWidth;
+
+    pParam->st_nVideoHeight = nDefaultHeight;
+
+    pParam->st_nPipelineWidth = nDefaultWidth;
+
+    pParam->st_nPipelineHeight = nDefaultHeight;
+
+    QString qszSize = QString::fromLocal8Bit( qgetenv( "BSCI_SOFT_CAPTURE_SIZE" ) );
+
+    if( qszSize.isEmpty() == FALSE ) {
+
+        QStringList qszWH = qszSize.split( 'x' );
+
+        ////// Kept even when wrong, Run() then refuses to start rather than silently using the default
+
+        pParam->st_nVideoWidth = ( qszWH.size() == 2 ) ? qszWH[ 0 ].toULong() : 0;
+
+        pParam->st_nVideoHeight = ( qszWH.size() == 2 ) ? qszWH[ 1 ].toULong() : 0;
+
+    }
+
+    QString qszFps = QString::fromLocal8Bit( qgetenv( "BSCI_SOFT_CAPTURE_FPS" ) );
+
+    if( qszFps.isEmpty() == FALSE && qszFps.toDouble() > 0.0 ) {
+
+        pParam->st_dVideoFrameRate = qszFps.toDouble();
+
+        pParam->st_bFrameRateSet = TRUE;
+
+    }
+
+    return TRUE;
+
+}
+
+void SoftCapture::RegisterFormatChangedCallback( format_changed_cb_t pfnCallback, PVOID pUserData )
+{
+
+    m_pfnFormatChanged = pfnCallback;
+
+    m_pFormatUserData = pUserData;
+
+}
+
+void SoftCapture::RegisterVideoPreviewCallback( video_preview_cb_t pfnCallback, PVOID pUserData )
+{
+
+    m_pfnVideoPreview = pfnCallback;
+
+    m_pPreviewUserData = pUserData;
+
+}
+
+BOOL SoftCapture::Func_Size_Check( const char * pszWhat ) const
+{
+
+    if( m_stParam.st_nVideoWidth == m_stParam.st_nPipelineWidth && m_stParam.st_nVideoHeight == m_stParam.st_nPipelineHeight ) return TRUE;
+
+    printf( "[QCAP DEBUG] Soft capture: %s is %lux%lu, the pipeline only takes %lux%lu 8-bit 4:2:0\n"
+            , pszWhat, m_stParam.st_nVideoWidth, m_stParam.st_nVideoHeight, m_stParam.st_nPipelineWidth, m_stParam.st_nPipelineHeight );
+
+    return FALSE;
+
+}
+
+BOOL SoftCapture::Func_Clip_LoadRaw()
+{
+
+    if( Func_Size_Check( "BSCI_SOFT_CAPTURE_SIZE" ) == FALSE ) return FALSE;
+
+    QFile qFile( m_stParam.st_qszSource );
+
+    if( qFile.open( QIODevice::ReadOnly ) == FALSE ) {
+
+        printf( "[QCAP DEBUG] Soft capture: open %s failed\n", m_stParam.st_qszSource.toUtf8().data() );
+
+        return FALSE;
+
+    }
+
+    qint64 nBytes = qMin< qint64 >( qFile.size(), SOFT_CAPTURE_MAX_CLIP_BYTES );
+
+    m_nClipFrames = nBytes / m_nFrameBytes;
+
+    if( m_nClipFrames == 0 ) {
+
+        printf( "[QCAP DEBUG] Soft capture: %s is smaller than one %lux%lu NV12 frame\n", m_stParam.st_qszSource.toUtf8().data(), m_stParam.st_nVideoWidth, m_stParam.st_nVideoHeight );
+
+        return FALSE;
+
+    }
+
+    m_qbaClip = qFile.read( ( qint64 )m_nClipFrames * m_nFrameBytes );
+
+    return TRUE;
+
+}
+
+BOOL SoftCapture::Func_Clip_LoadY4M()
+{
+
+    QFile qFile( m_stParam.st_qszSource );
+
+    if( qFile.open( QIODevice::ReadOnly ) == FALSE ) {
+
+        printf( "[QCAP DEBUG] Soft capture: open %s failed\n", m_stParam.st_qszSource.toUtf8().data() );
+
+        return FALSE;
+
+    }
+
+    ////// Stream header: "YUV4MPEG2 W1920 H1080 F60000:1001 Ip C420jpeg ..."
+
+    QByteArray qbaHeader = qFile.readLine().trimmed();
+
+    QList< QByteArray > qbaTokens = qbaHeader.split( ' ' );
+
+    if( qbaTokens.isEmpty() == TRUE || qbaTokens[ 0 ] != "YUV4MPEG2" ) {
+
+        printf( "[QCAP DEBUG] Soft capture: %s is not a Y4M stream\n", m_stParam.st_qszSource.toUtf8().data() );
+
+        return FALSE;
+
+    }
+
+    for( const QByteArray &qbaToken : qbaTokens ) {
+
+        if( qbaToken.startsWith( 'W' ) ) m_stParam.st_nVideoWidth = qbaToken.mid( 1 ).toULong();
+
+        else if( qbaToken.startsWith( 'H' ) ) m_stParam.st_nVideoHeight = qbaToken.mid( 1 ).toULong();
+
+        else if( qbaToken.startsWith( 'F' ) && m_stParam.st_bFrameRateSet == FALSE ) {
+
+            QList< QByteArray > qbaRate = qbaToken.mid( 1 ).split( ':' );
+
+            if( qbaRate.size() == 2 && qbaRate[ 1 ].toDouble() > 0.0 ) m_stParam.st_dVideoFrameRate = qbaRate[ 0 ].toDouble() / qbaRate[ 1 ].toDouble();
+
+        } else if( qbaToken.startsWith( 'C' ) ) {
+
+            ////// 8-bit 4:2:0 only, the chroma siting variants all share the layout; C420p10,
+            ////// C422, C444, mono and the like would be read as garbage
+
+            if( qbaToken != "C420" && qbaToken != "C420jpeg" && qbaToken != "C420paldv" && qbaToken != "C420mpeg2" ) {
+
+                printf( "[QCAP DEBUG] Soft capture: %s is %s, only 8-bit 4:2:0 ( C420, C420jpeg, C420paldv, C420mpeg2 ) is supported\n"
+                        , m_stParam.st_qszSource.toUtf8().data(), qbaToken.data() );
+
+                return FALSE;
+
+            }
+
+        }
+
+    }
+
+    if( Func_Size_Check( "the Y4M stream" ) == FALSE ) return FALSE;
+
+    m_nFrameBytes = m_stParam.st_nVideoWidth * m_stParam.st_nVideoHeight * 3 / 2;
+
+    ULONG nLumaBytes = m_stParam.st_nVideoWidth * m_stParam.st_nVideoHeight;
+
+    ULONG nChromaBytes = nLumaBytes / 4;
+
+    QByteArray qbaPlanar( m_nFrameBytes, 0 );
+
+    m_qbaClip.clear();
+
+    m_nClipFrames = 0;
+
+    while( ( uint64_t )m_qbaClip.size() + m_nFrameBytes <= SOFT_CAPTURE_MAX_CLIP_BYTES ) {
+
+        QByteArray qbaFrameHeader = qFile.readLine();
+
+        if( qbaFrameHeader.startsWith( "FRAME" ) == FALSE ) break;
+
+        if( qFile.read( qbaPlanar.data(), m_nFrameBytes ) != ( qint64 )m_nFrameBytes ) break;
+
+        ////// I420 -> NV12, interleave U and V into one chroma plane
+
+        qint64 nOffset = m_qbaClip.size();
+
+        m_qbaClip.resize( nOffset + m_nFrameBytes );
+
+        BYTE * pDst = ( BYTE * )m_qbaClip.data() + nOffset;
+
+        const BYTE * pSrc = ( const BYTE * )qbaPlanar.constData();
+
+        memcpy( pDst, pSrc, nLumaBytes );
+
+        const BYTE * pU = pSrc + nLumaBytes;
+
+        const BYTE * pV = pU + nChromaBytes;
+
+        BYTE * pUV = pDst + nLumaBytes;
+
+        for( ULONG i = 0; i < nChromaBytes; i++ ) {
+
+            pUV[ i * 2 + 0 ] = pU[ i ];
+
+            pUV[ i * 2 + 1 ] = pV[ i ];
+
+        }
+
+        m_nClipFrames++;
+
+    }
+
+    if( m_nClipFrames == 0 ) {
+
+        printf( "[QCAP DEBUG] Soft capture: %s has no frames\n", m_stParam.st_qszSource.toUtf8().data() );
+
+        return FALSE;
+
+    }
+
+    return TRUE;
+
+}
+
+void SoftCapture::Func_Synthetic_Fill( BYTE * pFrame, uint64_t nFrameIndex )
+{
+
+    ////// Horizontal luma ramp with a bar moving 8 px per frame, so every frame differs
+
+    const ULONG nWidth = m_stParam.st_nVideoWidth;
+
+    const ULONG nHeight = m_stParam.st_nVideoHeight;
+
+    const ULONG nBarX = ( nFrameIndex * 8 ) % nWidth;
+
+    const ULONG nBarW = nWidth / 32 + 1;
+
+    for( ULONG y = 0; y < nHeight; y++ ) {
+
+        BYTE * pRow = pFrame + y * nWidth;
+
+        for( ULONG x = 0; x < nWidth; x++ ) pRow[ x ] = ( BYTE )( 16 + x * 219 / nWidth );
+
+        for( ULONG x = nBarX; x < nBarX + nBarW && x < nWidth; x++ ) pRow[ x ] = 235;
+
+    }
+
+    BYTE * pUV = pFrame + nWidth * nHeight;
+
+    for( ULONG y = 0; y < nHeight / 2; y++ ) {
+
+        BYTE * pRow = pUV + y * nWidth;
+
+        for( ULONG x = 0; x < nWidth; x += 2 ) {
+
+            pRow[ x + 0 ] = ( BYTE )( 16 + y * 224 / ( nHeight / 2 ) );
+
+            pRow[ x + 1 ] = ( BYTE )( 240 - x * 224 / nWidth );
+
+        }
+
+    }
+
+}
+
+QRESULT SoftCapture::Run()
+{
+
+    if( m_bRunning == TRUE ) return QCAP_RS_SUCCESSFUL;
+
+    QString qszSource = m_stParam.st_qszSource;
+
+    BOOL bLoaded = TRUE;
+
+    if( qszSource == "synthetic" ) {
+
+        m_nClipFrames = 0;
+
+        bLoaded = Func_Size_Check( "BSCI_SOFT_CAPTURE_SIZE" );
+
+    } else if( qszSource.endsWith( ".y4m", Qt::CaseInsensitive ) == TRUE ) {
+
+        bLoaded = Func_Clip_LoadY4M();
+
+    } else {
+
+        bLoaded = Func_Clip_LoadRaw();
+
+    }
+
+    if( bLoaded == FALSE ) return QCAP_RS_ERROR_GENERAL;
+
+    printf( "[QCAP DEBUG] Soft capture: %s, %lu x %lu @ %2.3f FPS, %lu clip frames\n"
+            , qszSource.toUtf8().data(), m_stParam.st_nVideoWidth, m_stParam.st_nVideoHeight
+            , m_stParam.st_dVideoFrameRate, m_nClipFrames );
+
+    ////// Pinned like the GPUDirect preview buffers, plain heap when there is no CUDA device
+
+    for( INT iBufferCount = 0; iBufferCount < SOFT_CAPTURE_BUFFER_NUM; iBufferCount++ ) {
+
+        BYTE * pBuffer = nullptr;
+
+        BOOL bPinned = TRUE;
+
+        if( cudaHostAlloc( ( void ** )&pBuffer, m_nFrameBytes, cudaHostAllocMapped ) != cudaSuccess ) {
+
+            pBuffer = ( BYTE * )malloc( m_nFrameBytes );
+
+            bPinned = FALSE;
+
+        }
+
+        if( pBuffer == nullptr ) return QCAP_RS_ERROR_OUT_OF_MEMORY;
+
+        m_pFrameBuffer_S.push_back( pBuffer );
+
+        m_bPinned_S.push_back( bPinned );
+
+    }
+
+    if( m_pfnFormatChanged != nullptr ) {
+
+        m_pfnFormatChanged( this, QCAP_INPUT_TYPE_HDMI, QCAP_INPUT_TYPE_EMBEDDED_AUDIO
+                            , m_stParam.st_nVideoWidth, m_stParam.st_nVideoHeight, FALSE, m_stParam.st_dVideoFrameRate
+                            , 0, 0, 0, m_pFormatUserData );
+
+    }
+
+    m_bRunning = TRUE;
+
+    m_thCapture = std::thread( &SoftCapture::Func_Capture_Loop, this );
+
+    return QCAP_RS_SUCCESSFUL;
+
+}
+
+void SoftCapture::Stop()
+{
+
+    m_bRunning = FALSE;
+
+    if( m_thCapture.joinable() == TRUE ) m_thCapture.join();
+
+}
+
+void SoftCapture::Func_Capture_Loop()
+{
+
+    typedef std::chrono::steady_clock clock_t;
+
+    const clock_t::duration nPeriod = std::chrono::duration_cast< clock_t::duration >( std::chrono::duration< double >( 1.0 / m_stParam.st_dVideoFrameRate ) );
+
+    const clock_t::time_point tStart = clock_t::now();
+
+    uint64_t nTick = 0;
+
+    uint64_t nFrameIndex = 0;
+
+    while( m_bRunning == TRUE ) {
+
+        ////// Deadlines are anchored to the start time, so pacing does not drift.
+        ////// Like the card, a late source drops the ticks it missed instead of bursting.
+
+        clock_t::time_point tDeadline = tStart + nPeriod * nTick;
+
+        clock_t::time_point tNow = clock_t::now();
+
+        if( tNow < tDeadline ) {
+
+            std::this_thread::sleep_until( tDeadline );
+
+        } else if( tNow - tDeadline >= nPeriod ) {
+
+            uint64_t nMissed = ( tNow - tDeadline ) / nPeriod;
+
+            m_nFramesLate += nMissed;
+
+            nTick += nMissed;
+
+        }
+
+        BYTE * pFrame = m_pFrameBuffer_S[ nFrameIndex % m_pFrameBuffer_S.size() ];
+
+        if( m_nClipFrames == 0 ) Func_Synthetic_Fill( pFrame, nFrameIndex );
+
+        else memcpy( pFrame, m_qbaClip.constData() + ( size_t )( nFrameIndex % m_nClipFrames ) * m_nFrameBytes, m_nFrameBytes );
+
+        double dSampleTime = std::chrono::duration< double >( clock_t::now() - tStart ).count();
+
+        if( m_pfnVideoPreview != nullptr ) m_pfnVideoPreview( this, dSampleTime, pFrame, m_nFrameBytes, m_pPreviewUserData );
+
+        m_nFramesDelivered++;
+
+        nFrameIndex++;
+
+        nTick++;
+
+    }
+
+}
@@ -0,0 +1,121 @@
+#ifndef SOFTCAPTURE_H
+#define SOFTCAPTURE_H
+
+#include <QString>
+#include <QByteArray>
+
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include <qcap.h>
+#include <qcap.windef.h>
+
+////// Software capture source, stands in for the SC0710 when BSCI_SOFT_CAPTURE is set:
+//////
+//////   BSCI_SOFT_CAPTURE=synthetic            moving test pattern
+//////   BSCI_SOFT_CAPTURE=/path/clip.nv12      raw NV12, needs BSCI_SOFT_CAPTURE_SIZE
+//////   BSCI_SOFT_CAPTURE=/path/clip.y4m       YUV4MPEG2 4:2:0, interleaved to NV12 on load
+//////
+//////   BSCI_SOFT_CAPTURE_SIZE=1920x1080       ( must be SOURCE_WIDTH x SOURCE_HEIGHT, the default )
+//////   BSCI_SOFT_CAPTURE_FPS=60               ( default 60, Y4M clips use their own rate if unset )
+//////
+////// Frames are handed to the registered preview callback as one contiguous pinned
+////// NV12 buffer, the same way the GPUDirect preview buffers arrive from the card.
+////// The scalers and crops are built for SOURCE_WIDTH x SOURCE_HEIGHT, so any other size,
+////// and anything but 8-bit 4:2:0, is refused by Run() instead of being fed through.
+
+#define SOFT_CAPTURE_BUFFER_NUM 10
+
+#define SOFT_CAPTURE_MAX_CLIP_BYTES ( 512ULL * 1024 * 1024 )
+
+struct SoftCaptureParam {
+
+    QString     st_qszSource;
+
+    ULONG       st_nVideoWidth      = 1920;
+
+    ULONG       st_nVideoHeight     = 1080;
+
+    double      st_dVideoFrameRate  = 60.0;
+
+    BOOL        st_bFrameRateSet    = FALSE;
+
+    ULONG       st_nPipelineWidth   = 1920;             // the only size the source may deliver
+
+    ULONG       st_nPipelineHeight  = 1080;
+
+};
+
+class SoftCapture
+{
+
+public:
+
+    typedef QRETURN ( *format_changed_cb_t )( PVOID, ULONG, ULONG, ULONG, ULONG, BOOL, double, ULONG, ULONG, ULONG, PVOID );
+
+    typedef QRETURN ( *video_preview_cb_t )( PVOID, double, BYTE *, ULONG, PVOID );
+
+    explicit SoftCapture( const SoftCaptureParam &param );
+
+    ~SoftCapture();
+
+    static BOOL Func_Param_FromEnv( ULONG nDefaultWidth, ULONG nDefaultHeight, SoftCaptureParam * pParam );
+
+    void RegisterFormatChangedCallback( format_changed_cb_t pfnCallback, PVOID pUserData );
+
+    void RegisterVideoPreviewCallback( video_preview_cb_t pfnCallback, PVOID pUserData );
+
+    QRESULT Run();
+
+    void Stop();
+
+    uint64_t GetFramesDelivered() const { return m_nFramesDelivered; }
+
+    uint64_t GetFramesLate() const { return m_nFramesLate; }
+
+private:
+
+    BOOL Func_Clip_LoadRaw();
+
+    BOOL Func_Clip_LoadY4M();
+
+    BOOL Func_Size_Check( const char * pszWhat ) const;
+
+    void Func_Synthetic_Fill( BYTE * pFrame, uint64_t nFrameIndex );
+
+    void Func_Capture_Loop();
+
+private:
+
+    SoftCaptureParam            m_stParam;
+
+    ULONG                       m_nFrameBytes       = 0;
+
+    QByteArray                  m_qbaClip;
+
+    ULONG                       m_nClipFrames       = 0;
+
+    std::vector< BYTE * >       m_pFrameBuffer_S;
+
+    std::vector< BOOL >         m_bPinned_S;
+
+    format_changed_cb_t         m_pfnFormatChanged  = nullptr;
+
+    PVOID                       m_pFormatUserData   = nullptr;
+
+    video_preview_cb_t          m_pfnVideoPreview   = nullptr;
+
+    PVOID                       m_pPreviewUserData  = nullptr;
+
+    std::thread                 m_thCapture;
+
+    std::atomic< BOOL >         m_bRunning          { FALSE };
+
+    std::atomic< uint64_t >     m_nFramesDelivered  { 0 };
+
+    std::atomic< uint64_t >     m_nFramesLate       { 0 };
+
+};
+
+#endif // SOFTCAPTURE_H
@@ -0,0 +1,661 @@
+#include "tensorbatcher.h"
+#include "latencystats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+////// Rows per band below which a frame is not split across the pool
+
+#define TENSOR_BAND_MIN_ROWS 32
+
+uint16_t TensorBatcher_Half_From_Float( float f )
+{
+
+    uint32_t x;
+
+    memcpy( &x, &f, sizeof( x ) );
+
+    uint16_t nSign = ( uint16_t )( ( x >> 16 ) & 0x8000 );
+
+    uint32_t nAbs = x & 0x7fffffff;
+
+    if( nAbs >= 0x7f800000 ) return nSign | 0x7c00 | ( ( nAbs > 0x7f800000 ) ? 0x200 : 0 );
+
+    ////// 65520 and up round past the largest half
+
+    if( nAbs >= 0x477ff000 ) return nSign | 0x7c00;
+
+    if( nAbs < 0x38800000 ) {
+
+        ////// Below 2^-14: subnormal, in units of 2^-24
+
+        int nShift = 126 - ( int )( nAbs >> 23 );
+
+        if( nShift > 24 ) return nSign;
+
+        uint32_t nMant = ( nAbs & 0x7fffff ) | 0x800000;
+
+        uint32_t nHalf = nMant >> nShift;
+
+        uint32_t nRem = nMant & ( ( 1u << nShift ) - 1 ), nTie = 1u << ( nShift - 1 );
+
+        if( nRem > nTie || ( nRem == nTie && ( nHalf & 1 ) != 0 ) ) nHalf++;
+
+        return nSign | ( uint16_t )nHalf;
+
+    }
+
+    uint32_t nHalf = ( nAbs - 0x38000000 ) >> 13;
+
+    uint32_t nRem = nAbs & 0x1fff;
+
+    if( nRem > 0x1000 || ( nRem == 0x1000 && ( nHalf & 1 ) != 0 ) ) nHalf++;
+
+    return nSign | ( uint16_t )nHalf;
+
+}
+
+float TensorBatcher_Half_To_Float( uint16_t h )
+{
+
+    uint32_t nSign = ( uint32_t )( h & 0x8000 ) << 16;
+
+    uint32_t nExp = ( h >> 10 ) & 0x1f, nMant = h & 0x3ff;
+
+    uint32_t x;
+
+    if( nExp == 0x1f ) {
+
+        x = nSign | 0x7f800000 | ( nMant << 13 );
+
+    } else if( nExp != 0 ) {
+
+        x = nSign | ( ( nExp + 112 ) << 23 ) | ( nMant << 13 );
+
+    } else {
+
+        float f = ( float )nMant * ( 1.0f / 16777216.0f );
+
+        return ( nSign != 0 ) ? -f : f;
+
+    }
+
+    float f;
+
+    memcpy( &f, &x, sizeof( f ) );
+
+    return f;
+
+}
+
+template< typename T >
+static void Func_Rows_Convert( const ColorPlanes &src, int nWidth, int nHeight, int nRowStart, int nRowEnd, const T ( *pLut )[ 256 ], T * pImage )
+{
+
+    size_t nPlane = ( size_t )nWidth * nHeight;
+
+    for( int y = nRowStart; y < nRowEnd; y++ ) {
+
+        const uint8_t * pY = src.pData[ 0 ] + ( size_t )y * src.nStride[ 0 ];
+
+        const uint8_t * pU = src.pData[ 1 ] + ( size_t )( y >> 1 ) * src.nStride[ 1 ];
+
+        const uint8_t * pV = src.pData[ 2 ] + ( size_t )( y >> 1 ) * src.nStride[ 2 ];
+
+        T * pR = pImage + ( size_t )y * nWidth;
+
+        T * pG = pR + nPlane;
+
+        T * pB = pG + nPlane;
+
+        for( int x = 0; x < nWidth; x++ ) {
+
+            uint8_t r, g, b;
+
+            ColorConvert_YUV_To_RGB( pY[ x ], pU[ x >> 1 ], pV[ x >> 1 ], &r, &g, &b );
+
+            pR[ x ] = pLut[ 0 ][ r ];
+
+            pG[ x ] = pLut[ 1 ][ g ];
+
+            pB[ x ] = pLut[ 2 ][ b ];
+
+        }
+
+    }
+
+}
+
+static float Func_Normalize( const TensorBatcherParam &param, int nChannel, uint8_t nValue )
+{
+
+    return ( ( float )nValue / 255.0f - param.st_fMean[ nChannel ] ) / param.st_fStd[ nChannel ];
+
+}
+
+TensorBatcher::TensorBatcher( const TensorBatcherParam &param, const consumer_func_t &pfnConsumer )
+    : m_stParam( param ), m_pfnConsumer( pfnConsumer ), m_oPool( std::max( 1, param.st_nThreads ) )
+{
+
+    if( m_stParam.st_nBatch == 0 ) m_stParam.st_nBatch = 1;
+
+    if( m_stParam.st_nArenas < 2 ) m_stParam.st_nArenas = 2;
+
+    size_t nElement = ( m_stParam.st_eType == TENSOR_TYPE_FLOAT16 ) ? sizeof( uint16_t ) : sizeof( float );
+
+    m_nImageBytes = 3 * ( size_t )m_stParam.st_nWidth * m_stParam.st_nHeight * nElement;
+
+    for( int c = 0; c < 3; c++ ) {
+
+        for( int i = 0; i < 256; i++ ) {
+
+            m_fLut[ c ][ i ] = Func_Normalize( m_stParam, c, ( uint8_t )i );
+
+            m_nLutHalf[ c ][ i ] = TensorBatcher_Half_From_Float( m_fLut[ c ][ i ] );
+
+        }
+
+    }
+
+    for( ULONG i = 0; i < m_stParam.st_nArenas; i++ ) {
+
+        m_pArena_S.emplace_back( new Arena() );
+
+        m_pArena_S.back()->vData.resize( m_nImageBytes * m_stParam.st_nBatch );
+
+        m_pArena_S.back()->nOriginNs_S.reserve( m_stParam.st_nBatch );
+
+        m_queFree.push_back( m_pArena_S.back().get() );
+
+    }
+
+    m_thConsume = std::thread( &TensorBatcher::Func_Consume_Loop, this );
+
+}
+
+TensorBatcher::~TensorBatcher()
+{
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_bExit = TRUE;
+    }
+
+    m_cvReady.notify_all();
+
+    if( m_thConsume.joinable() == TRUE ) m_thConsume.join();
+
+}
+
+BOOL TensorBatcher::Push( const ColorPlanes &src, int64_t nOriginNs )
+{
+
+    Arena * pArena;
+
+    size_t nSlot;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        if( m_pFill == nullptr ) {
+
+            if( m_queFree.empty() == TRUE ) {
+
+                m_stStats.st_nDropped++;
+
+                return FALSE;
+
+            }
+
+            m_pFill = m_queFree.front();
+
+            m_queFree.pop_front();
+
+            m_pFill->nOriginNs_S.clear();
+
+        }
+
+        pArena = m_pFill;
+
+        nSlot = pArena->nOriginNs_S.size();
+
+        m_bConverting = TRUE;
+    }
+
+    ////// Straight into the slot, the arena is not touched by anyone else while it fills
+
+    int nWidth = ( int )m_stParam.st_nWidth, nHeight = ( int )m_stParam.st_nHeight;
+
+    uint8_t * pImage = pArena->vData.data() + nSlot * m_nImageBytes;
+
+    int nBands = std::min( m_oPool.GetThreadCount(), std::max( 1, nHeight / TENSOR_BAND_MIN_ROWS ) );
+
+    int nBandRows = ( nHeight + nBands - 1 ) / nBands;
+
+    m_oPool.Run( nBands, [ & ]( int i ) {
+
+        int nRowStart = i * nBandRows, nRowEnd = std::min( nHeight, nRowStart + nBandRows );
+
+        if( m_stParam.st_eType == TENSOR_TYPE_FLOAT16 ) Func_Rows_Convert< uint16_t >( src, nWidth, nHeight, nRowStart, nRowEnd, m_nLutHalf, ( uint16_t * )pImage );
+
+        else Func_Rows_Convert< float >( src, nWidth, nHeight, nRowStart, nRowEnd, m_fLut, ( float * )pImage );
+
+    } );
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_bConverting = FALSE;
+
+        if( pArena->nOriginNs_S.empty() == TRUE ) pArena->nFirstNs = Func_Latency_Now();
+
+        pArena->nOriginNs_S.push_back( nOriginNs );
+
+        m_stStats.st_nFrames++;
+
+        if( pArena->nOriginNs_S.size() >= m_stParam.st_nBatch ) {
+
+            Func_Arena_Ready( pArena, FALSE );
+
+            m_pFill = nullptr;
+
+        }
+    }
+
+    ////// Also wakes the consumer for the deadline of a partial batch
+
+    m_cvReady.notify_one();
+
+    return TRUE;
+
+}
+
+void TensorBatcher::Flush()
+{
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        if( m_pFill == nullptr || m_bConverting == TRUE || m_pFill->nOriginNs_S.empty() == TRUE ) return;
+
+        Func_Arena_Ready( m_pFill, TRUE );
+
+        m_pFill = nullptr;
+    }
+
+    m_cvReady.notify_one();
+
+}
+
+void TensorBatcher::Func_Arena_Ready( Arena * pArena, BOOL bPartial )
+{
+
+    pArena->bPartial = bPartial;
+
+    m_queReady.push_back( pArena );
+
+    m_stStats.st_nBatches++;
+
+    if( bPartial == TRUE ) m_stStats.st_nPartial++;
+
+}
+
+void TensorBatcher::Func_Consume_Loop()
+{
+
+    int64_t nDeadlineNs = ( int64_t )m_stParam.st_nDeadlineMs * 1000000;
+
+    while( TRUE ) {
+
+        Arena * pArena = nullptr;
+
+        {
+            std::unique_lock< std::mutex > lock( m_mtx );
+
+            while( pArena == nullptr ) {
+
+                ////// Batches already complete still go out on exit
+
+                if( m_queReady.empty() == FALSE ) {
+
+                    pArena = m_queReady.front();
+
+                    m_queReady.pop_front();
+
+                    break;
+
+                }
+
+                if( m_bExit == TRUE ) return;
+
+                if( m_pFill != nullptr && m_bConverting == FALSE && m_pFill->nOriginNs_S.empty() == FALSE ) {
+
+                    int64_t nWaitNs = m_pFill->nFirstNs + nDeadlineNs - Func_Latency_Now();
+
+                    if( nWaitNs <= 0 ) {
+
+                        Func_Arena_Ready( m_pFill, TRUE );
+
+                        m_pFill = nullptr;
+
+                        continue;
+
+                    }
+
+                    m_cvReady.wait_for( lock, std::chrono::nanoseconds( nWaitNs ) );
+
+                } else {
+
+                    m_cvReady.wait( lock );
+
+                }
+
+            }
+        }
+
+        TensorBatch batch;
+
+        batch.pData = pArena->vData.data();
+
+        batch.eType = m_stParam.st_eType;
+
+        batch.nBatch = ( ULONG )pArena->nOriginNs_S.size();
+
+        batch.nHeight = m_stParam.st_nHeight;
+
+        batch.nWidth = m_stParam.st_nWidth;
+
+        batch.nBytes = m_nImageBytes * batch.nBatch;
+
+        batch.bPartial = pArena->bPartial;
+
+        batch.nOriginNs_S = pArena->nOriginNs_S;
+
+        if( m_pfnConsumer ) m_pfnConsumer( batch );
+
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_queFree.push_back( pArena );
+
+    }
+
+}
+
+TensorBatcherStats TensorBatcher::GetStats() const
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    return m_stStats;
+
+}
+
+struct TensorTestFrame {
+
+    std::vector< uint8_t >  vPlane[ 3 ];
+
+    ColorPlanes             planes;
+
+};
+
+static void Func_Test_Frame_Alloc( TensorTestFrame * pFrame, int nWidth, int nHeight, int nPad )
+{
+
+    int nChromaW = ( nWidth + 1 ) / 2, nChromaH = ( nHeight + 1 ) / 2;
+
+    int nStride[ 3 ] = { nWidth + nPad, nChromaW + nPad, nChromaW + nPad };
+
+    int nRows[ 3 ] = { nHeight, nChromaH, nChromaH };
+
+    for( int i = 0; i < 3; i++ ) {
+
+        pFrame->vPlane[ i ].resize( ( size_t )nStride[ i ] * nRows[ i ] );
+
+        for( auto &c : pFrame->vPlane[ i ] ) c = ( uint8_t )rand();
+
+        pFrame->planes.pData[ i ] = pFrame->vPlane[ i ].data();
+
+        pFrame->planes.nStride[ i ] = nStride[ i ];
+
+    }
+
+}
+
+////// Per pixel, without tables or bands
+
+static BOOL Func_Test_Image_Check( const TensorTestFrame &frame, const TensorBatcherParam &param, const uint8_t * pImage )
+{
+
+    int nWidth = ( int )param.st_nWidth, nHeight = ( int )param.st_nHeight;
+
+    size_t nPlane = ( size_t )nWidth * nHeight;
+
+    for( int y = 0; y < nHeight; y++ ) {
+
+        for( int x = 0; x < nWidth; x++ ) {
+
+            const ColorPlanes &p = frame.planes;
+
+            uint8_t rgb[ 3 ];
+
+            ColorConvert_YUV_To_RGB( p.pData[ 0 ][ y * p.nStride[ 0 ] + x ], p.pData[ 1 ][ ( y / 2 ) * p.nStride[ 1 ] + x / 2 ]
+                                     , p.pData[ 2 ][ ( y / 2 ) * p.nStride[ 2 ] + x / 2 ], &rgb[ 0 ], &rgb[ 1 ], &rgb[ 2 ] );
+
+            for( int c = 0; c < 3; c++ ) {
+
+                float fRef = Func_Normalize( param, c, rgb[ c ] );
+
+                size_t nIndex = c * nPlane + ( size_t )y * nWidth + x;
+
+                BOOL bSame = ( param.st_eType == TENSOR_TYPE_FLOAT16 )
+                        ? ( ( ( const uint16_t * )pImage )[ nIndex ] == TensorBatcher_Half_From_Float( fRef ) )
+                        : ( ( ( const float * )pImage )[ nIndex ] == fRef );
+
+                if( bSame == FALSE ) {
+
+                    printf( "TensorBatcher self-test: type %d, %dx%d differs at channel %d ( %d, %d )\n", ( int )param.st_eType, nWidth, nHeight, c, x, y );
+
+                    return FALSE;
+
+                }
+
+            }
+
+        }
+
+    }
+
+    return TRUE;
+
+}
+
+BOOL TensorBatcher_SelfTest()
+{
+
+    BOOL bPass = TRUE;
+
+    ////// Every finite half survives the round trip, and a few known encodings
+
+    for( uint32_t h = 0; h < 0x10000; h++ ) {
+
+        if( ( h & 0x7c00 ) == 0x7c00 && ( h & 0x3ff ) != 0 ) continue;
+
+        if( TensorBatcher_Half_From_Float( TensorBatcher_Half_To_Float( ( uint16_t )h ) ) != h ) {
+
+            printf( "TensorBatcher self-test: half 0x%04x does not round trip\n", h );
+
+            bPass = FALSE;
+
+            break;
+
+        }
+
+    }
+
+    struct { float f; uint16_t h; } known_S[] = {
+        { 1.0f, 0x3c00 }, { -2.0f, 0xc000 }, { 65504.0f, 0x7bff }, { 65520.0f, 0x7c00 }, { 1.0f + 1.0f / 2048, 0x3c00 },
+        { 5.9604645e-8f, 0x0001 }, { 2.9802322e-8f, 0x0000 }, { 6.1035156e-5f, 0x0400 }, { 0.1f, 0x2e66 }
+    };
+
+    for( const auto &known : known_S ) {
+
+        if( TensorBatcher_Half_From_Float( known.f ) != known.h ) {
+
+            printf( "TensorBatcher self-test: half of %g is 0x%04x, expected 0x%04x\n", known.f, TensorBatcher_Half_From_Float( known.f ), known.h );
+
+            bPass = FALSE;
+
+        }
+
+    }
+
+    ////// 7 frames in batches of 3: two full ones, the last one goes at the deadline ( small
+    ////// frames, so converting never takes that long ) or on Flush()
+
+    int nSize_S[][ 2 ] = { { 556, 508 }, { 37, 21 }, { 2, 1 } };
+
+    for( int t = 0; t < 2; t++ ) {
+
+        for( const auto &size : nSize_S ) {
+
+            TensorBatcherParam param;
+
+            param.st_nWidth = size[ 0 ];
+
+            param.st_nHeight = size[ 1 ];
+
+            param.st_nBatch = 3;
+
+            BOOL bLarge = ( size[ 0 ] * size[ 1 ] > 4096 ) ? TRUE : FALSE;
+
+            param.st_nDeadlineMs = ( bLarge == TRUE ) ? 60000 : 100;
+
+            param.st_nArenas = 4;
+
+            param.st_eType = ( TensorType )t;
+
+            std::vector< TensorTestFrame > frame_S( 7 );
+
+            for( TensorTestFrame &frame : frame_S ) Func_Test_Frame_Alloc( &frame, size[ 0 ], size[ 1 ], 3 );
+
+            std::vector< ULONG > nBatch_S;
+
+            std::vector< BOOL > bPartial_S;
+
+            std::atomic< BOOL > bSame( TRUE );
+
+            {
+                TensorBatcher batcher( param, [ & ]( const TensorBatch &batch ) {
+
+                    nBatch_S.push_back( batch.nBatch );
+
+                    bPartial_S.push_back( batch.bPartial );
+
+                    for( ULONG n = 0; n < batch.nBatch; n++ ) {
+
+                        const TensorTestFrame &frame = frame_S[ ( size_t )batch.nOriginNs_S[ n ] ];
+
+                        if( Func_Test_Image_Check( frame, param, ( const uint8_t * )batch.pData + n * batch.nBytes / batch.nBatch ) == FALSE ) bSame = FALSE;
+
+                    }
+
+                } );
+
+                for( size_t i = 0; i < frame_S.size(); i++ ) {
+
+                    if( batcher.Push( frame_S[ i ].planes, ( int64_t )i ) == FALSE ) bSame = FALSE;
+
+                }
+
+                if( bLarge == TRUE ) batcher.Flush();
+
+                for( int nWaitMs = 0; nWaitMs < 3000 && batcher.GetStats().st_nBatches < 3; nWaitMs += 10 ) {
+
+                    std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+
+                }
+            }
+
+            if( bSame == FALSE || nBatch_S.size() != 3 || nBatch_S[ 0 ] != 3 || nBatch_S[ 1 ] != 3 || nBatch_S[ 2 ] != 1
+                    || bPartial_S[ 0 ] == TRUE || bPartial_S[ 2 ] == FALSE ) {
+
+                printf( "TensorBatcher self-test: type %d, %dx%d failed\n", t, size[ 0 ], size[ 1 ] );
+
+                bPass = FALSE;
+
+            }
+
+        }
+
+    }
+
+    printf( "TensorBatcher self-test %s\n", ( bPass == TRUE ) ? "passed" : "FAILED" );
+
+    return bPass;
+
+}
+
+static double Func_Throughput_Measure( int nWidth, int nHeight, TensorType eType, ULONG nBatch, const TensorTestFrame &frame, double dSeconds )
+{
+
+    TensorBatcherParam param;
+
+    param.st_nWidth = nWidth;
+
+    param.st_nHeight = nHeight;
+
+    param.st_nBatch = nBatch;
+
+    param.st_nDeadlineMs = 1000;
+
+    param.st_eType = eType;
+
+    std::atomic< uint64_t > nFrames( 0 );
+
+    auto tStart = std::chrono::steady_clock::now();
+
+    {
+        TensorBatcher batcher( param, [ & ]( const TensorBatch &batch ) { nFrames += batch.nBatch; } );
+
+        while( std::chrono::duration< double >( std::chrono::steady_clock::now() - tStart ).count() < dSeconds ) {
+
+            batcher.Push( frame.planes, 0 );
+
+        }
+
+        batcher.Flush();
+    }
+
+    return nFrames.load() / std::chrono::duration< double >( std::chrono::steady_clock::now() - tStart ).count();
+
+}
+
+void TensorBatcher_Benchmark( int nWidth, int nHeight, double dSecondsPerCase )
+{
+
+    TensorTestFrame frame;
+
+    Func_Test_Frame_Alloc( &frame, nWidth, nHeight, 0 );
+
+    printf( "TensorBatcher benchmark %dx%d I420 -> NCHW, frames/s ( %d threads )\n", nWidth, nHeight, TENSOR_BATCH_THREADS );
+
+    printf( "%-8s %10s %10s\n", "batch", "float32", "float16" );
+
+    for( ULONG nBatch = 1; nBatch <= 16; nBatch *= 2 ) {
+
+        double dFloat = Func_Throughput_Measure( nWidth, nHeight, TENSOR_TYPE_FLOAT32, nBatch, frame, dSecondsPerCase );
+
+        double dHalf = Func_Throughput_Measure( nWidth, nHeight, TENSOR_TYPE_FLOAT16, nBatch, frame, dSecondsPerCase );
+
+        printf( "%-8lu %10.1f %10.1f\n", nBatch, dFloat, dHalf );
+
+    }
+
+}
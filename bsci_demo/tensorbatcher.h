@@ -0,0 +1,202 @@
+#ifndef TENSORBATCHER_H
+#define TENSORBATCHER_H
+
+#include <stdint.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include <qcap.windef.h>
+
+#include "colorconvert.h"
+#include "workerpool.h"
+
+////// Frames per tensor, and how long a partial batch may wait for the rest
+
+#define TENSOR_BATCH_SIZE 4
+
+#define TENSOR_BATCH_DEADLINE_MS 100
+
+////// Arenas in rotation: one filling, the others queued for or held by the consumer. A
+////// frame that finds none free is dropped, the scaler is never held up
+
+#define TENSOR_BATCH_ARENAS 3
+
+#define TENSOR_BATCH_THREADS 2
+
+enum TensorType {
+
+    TENSOR_TYPE_FLOAT32 = 0,
+
+    TENSOR_TYPE_FLOAT16                 // IEEE half, round to nearest even
+
+};
+
+struct TensorBatcherParam {
+
+    ULONG       st_nWidth               = 0;
+
+    ULONG       st_nHeight              = 0;
+
+    ULONG       st_nBatch               = TENSOR_BATCH_SIZE;
+
+    ULONG       st_nDeadlineMs          = TENSOR_BATCH_DEADLINE_MS;
+
+    ULONG       st_nArenas              = TENSOR_BATCH_ARENAS;
+
+    int         st_nThreads             = TENSOR_BATCH_THREADS;
+
+    TensorType  st_eType                = TENSOR_TYPE_FLOAT32;
+
+    ////// ( x / 255 - mean ) / std per R, G, B channel, ImageNet statistics by default
+
+    float       st_fMean[ 3 ]           = { 0.485f, 0.456f, 0.406f };
+
+    float       st_fStd[ 3 ]            = { 0.229f, 0.224f, 0.225f };
+
+};
+
+////// One contiguous N x 3 x H x W tensor, R G B planes per image. Only valid during the
+////// consumer call, the arena is reused afterwards.
+
+struct TensorBatch {
+
+    const void *            pData           = nullptr;
+
+    TensorType              eType           = TENSOR_TYPE_FLOAT32;
+
+    ULONG                   nBatch          = 0;            // images filled, at most st_nBatch
+
+    ULONG                   nChannels       = 3;
+
+    ULONG                   nHeight         = 0;
+
+    ULONG                   nWidth          = 0;
+
+    size_t                  nBytes          = 0;            // of the nBatch images
+
+    BOOL                    bPartial        = FALSE;        // handed over at the deadline
+
+    std::vector< int64_t >  nOriginNs_S;
+
+};
+
+struct TensorBatcherStats {
+
+    uint64_t    st_nFrames              = 0;
+
+    uint64_t    st_nBatches             = 0;
+
+    uint64_t    st_nPartial             = 0;
+
+    uint64_t    st_nDropped             = 0;
+
+};
+
+////// Collects inference frames into batched NCHW tensors for a model. Push() converts an
+////// I420 frame straight into its slot of the filling arena ( BT.709 as ColorConvert,
+////// normalised through per channel lookup tables ), a full arena or one whose first
+////// frame is older than the deadline goes to the consumer thread.
+
+class TensorBatcher
+{
+
+public:
+
+    typedef std::function< void ( const TensorBatch& ) > consumer_func_t;
+
+    TensorBatcher( const TensorBatcherParam &param, const consumer_func_t &pfnConsumer );
+
+    ////// A partial batch still filling is dropped
+
+    ~TensorBatcher();
+
+    ////// FALSE when the frame was dropped because every arena is busy
+
+    BOOL Push( const ColorPlanes &src, int64_t nOriginNs );
+
+    ////// Hands the partial batch over now
+
+    void Flush();
+
+    TensorBatcherStats GetStats() const;
+
+    size_t GetImageBytes() const { return m_nImageBytes; }
+
+private:
+
+    struct Arena {
+
+        std::vector< uint8_t >  vData;
+
+        std::vector< int64_t >  nOriginNs_S;
+
+        int64_t                 nFirstNs        = 0;
+
+        BOOL                    bPartial        = FALSE;
+
+    };
+
+    void Func_Consume_Loop();
+
+    ////// Caller holds m_mtx
+
+    void Func_Arena_Ready( Arena * pArena, BOOL bPartial );
+
+private:
+
+    TensorBatcherParam                  m_stParam;
+
+    consumer_func_t                     m_pfnConsumer;
+
+    size_t                              m_nImageBytes;
+
+    float                               m_fLut[ 3 ][ 256 ];
+
+    uint16_t                            m_nLutHalf[ 3 ][ 256 ];
+
+    WorkerPool                          m_oPool;
+
+    std::vector< std::unique_ptr< Arena > > m_pArena_S;
+
+    std::thread                         m_thConsume;
+
+    mutable std::mutex                  m_mtx;
+
+    std::condition_variable             m_cvReady;
+
+    std::deque< Arena * >               m_queFree;
+
+    std::deque< Arena * >               m_queReady;
+
+    Arena *                             m_pFill             = nullptr;
+
+    BOOL                                m_bConverting       = FALSE;
+
+    BOOL                                m_bExit             = FALSE;
+
+    TensorBatcherStats                  m_stStats;
+
+};
+
+////// IEEE half from float, round to nearest even, overflow to infinity
+
+uint16_t TensorBatcher_Half_From_Float( float f );
+
+float TensorBatcher_Half_To_Float( uint16_t h );
+
+////// Checks the converted tensors against a per pixel reference, both types, odd sizes
+////// and deadline batches included. Returns FALSE on any difference.
+
+BOOL TensorBatcher_SelfTest();
+
+////// Prints frames/s through the batcher for batch sizes 1 to 16, float and half
+
+void TensorBatcher_Benchmark( int nWidth, int nHeight, double dSecondsPerCase );
+
+#endif // TENSORBATCHER_H
@@ -18,6 +18,7 @@
 #include "qcap2.gst.h"
 
 #include <sys/time.h>
+#include <time.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -31,18 +32,23 @@
 #include <thread>
 #include <atomic>
 #include <vector>
+#include <algorithm>
+#include <chrono>
 #include <stack>
 #include <string>
 
 #include <string.h>
 #include <pthread.h>
 
+////// us on CLOCK_MONOTONIC: NTP steps and clock changes do not move it, so tick pacing
+////// does not jump; not a time of day
+
 static inline uint64_t _clk(void)
 {
-   struct timeval tv;
-   gettimeofday(&tv, NULL);
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
 
-   return (uint64_t)tv.tv_sec * 1000000ULL + (uint64_t)tv.tv_usec;
+   return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
 }
 
 static inline void LOGE(const char* fmt, ...)
@@ -119,32 +125,104 @@ namespace __testkit__ {
 		lock.clear(std::memory_order_release);
 	}
 
+	enum tick_policy_t {
+		TICK_POLICY_SKIP = 0,		// after a stall, go on from the next deadline still ahead
+		TICK_POLICY_CATCH_UP,		// fire the missed ticks back to back, up to catchup_max
+	};
+
+	struct tick_stats_t {
+		int64_t ticks;
+		int64_t missed;				// deadlines never fired
+		int64_t caught_up;			// fired back to back after a stall
+		int64_t jitter_sum;			// | fired - deadline |, us
+		int64_t jitter_max;
+		int64_t locks;
+		int64_t lock_error;			// last phase error seen by lock(), us
+	};
+
+	////// Paces a timer at num / den ticks per second, 30000 / 1001 being exact, on _clk() us.
+	////// Deadline k is start + k * den / num worked out from k itself, so rounding never
+	////// accumulates; advance() returns the us until the next deadline.
+
 	struct tick_ctrl_t {
 		typedef tick_ctrl_t self_t;
 
-		int num;
-		int den;
+		int64_t num;
+		int64_t den;
+		tick_policy_t policy;
+		int64_t catchup_max;
+		int64_t lock_gain;			// lock() moves the phase by error / lock_gain
+
+		tick_stats_t stats;
 
-		explicit tick_ctrl_t() {
+		explicit tick_ctrl_t() : num(30), den(1), policy(TICK_POLICY_SKIP), catchup_max(4), lock_gain(8) {
+			reset_stats();
 		}
 
 		void start(int64_t t) {
 			nDenSecs = den * 1000000LL;
 			nTimer = t;
+			nTick = 0;
 		}
 
 		int64_t advance(int64_t t) {
-			int64_t nDiff = t - nTimer;
-			int64_t nTicks = nDiff * num / nDenSecs;
-			int64_t nNextTimer = nTimer + (nTicks + 1) * nDenSecs / num;
+			int64_t nDue = ticks_at(t);
+			int64_t nLate = t - deadline(nTick);
+
+			stats.ticks++;
+			stats.jitter_sum += (nLate < 0) ? -nLate : nLate;
+			stats.jitter_max = std::max(stats.jitter_max, (nLate < 0) ? -nLate : nLate);
+
+			if(nDue > nTick && (policy == TICK_POLICY_SKIP || nDue - nTick > catchup_max)) {
+				stats.missed += nDue - nTick;
+				nTick = nDue + 1;
+			} else {
+				if(nDue > nTick) stats.caught_up++;
+				nTick++;
+			}
+
+			////// At least 1 us: a timer armed with 0 would be disarmed
+			return std::max(deadline(nTick) - t, (int64_t)1);
+		}
+
+		////// Pulls the phase towards a reference, e.g. capture timestamps mapped onto _clk(),
+		////// so the ticks follow the source instead of this clock; call it once per reference
+
+		void lock(int64_t tRef) {
+			int64_t k = ticks_at(tRef);
+			int64_t nError = tRef - deadline(k);
+			int64_t nErrorNext = tRef - deadline(k + 1);
+
+			if(-nErrorNext < nError) nError = nErrorNext;
+
+			nTimer += nError / lock_gain;
+
+			stats.locks++;
+			stats.lock_error = nError;
+		}
+
+		void reset_stats() {
+			memset(&stats, 0, sizeof(stats));
+		}
+
+		////// Deadline of tick k, rounded up so that ticks_at(deadline(k)) == k
 
-			nTimer += nTicks * nDenSecs / num;
+		int64_t deadline(int64_t k) const {
+			return nTimer + (k / num) * nDenSecs + ((k % num) * nDenSecs + num - 1) / num;
+		}
+
+		////// Index of the last deadline at or before t, -1 before the start
 
-			return nNextTimer - t;
+		int64_t ticks_at(int64_t t) const {
+			int64_t nDiff = t - nTimer;
+			if(nDiff < 0) return -1;
+
+			return (nDiff / nDenSecs) * num + (nDiff % nDenSecs) * num / nDenSecs;
 		}
 
 		int64_t nDenSecs;
 		int64_t nTimer;
+		int64_t nTick;
 	};
 
 	struct callback_t {
@@ -540,6 +618,291 @@ inline QRESULT new_video_cudahostbuf(free_stack_t& _FreeStack_, ULONG nColorSpac
             });
         }
     };
+
+    struct handler_shard_stats_t {
+        int sources;
+        int64_t handled;
+        int64_t busy_us;
+    };
+
+    ////// TestCase over several event handler threads ( shards ). A source stays on the shard it
+    ////// was added to, so its handler never overlaps itself and sees its events in order, while
+    ////// different sources run in parallel; a new source goes to the shard with the fewest
+    ////// sources, then the least busy one. Shard 0 is pEventHandlers, ExecInEventHandlers()
+    ////// and OnExitEventHandlers() run there. Handlers are added and removed on their own
+    ////// shard's thread, whichever thread asks.
+
+    struct PoolTestCase : TestCase {
+        typedef PoolTestCase self_t;
+
+        struct shard_t {
+            qcap2_event_handlers_t* pEventHandlers = nullptr;
+            std::thread::id nThreadId;
+            std::atomic<int> nSources { 0 };
+            std::atomic<int64_t> nHandled { 0 };
+            std::atomic<int64_t> nBusyUs { 0 };
+        };
+
+        std::vector<std::shared_ptr<shard_t> > shards;
+
+        ////// nCpus, if not empty, pins shard i to CPU nCpus[ i % size ]
+
+        QRESULT StartEventHandlers(int nThreads, const std::vector<int>& nCpus = std::vector<int>()) {
+            QRESULT qres = QCAP_RS_SUCCESSFUL;
+
+            for(int i = 0;i < std::max(nThreads, 1);i++) {
+                std::shared_ptr<shard_t> pShard(new shard_t());
+
+                qres = __testkit__::StartEventHandlers(_FreeStack_main_, &pShard->pEventHandlers);
+                if(qres != QCAP_RS_SUCCESSFUL) {
+                    LOGE("%s(%d): StartEventHandlers() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+                    break;
+                }
+
+                int nCpu = nCpus.empty() ? -1 : nCpus[i % nCpus.size()];
+                qres = __testkit__::ExecInEventHandlers(pShard->pEventHandlers, [pShard, nCpu]() -> QRETURN {
+                    pShard->nThreadId = std::this_thread::get_id();
+
+                    if(nCpu >= 0) {
+                        cpu_set_t oCpuSet;
+                        CPU_ZERO(&oCpuSet);
+                        CPU_SET(nCpu, &oCpuSet);
+
+                        int err = pthread_setaffinity_np(pthread_self(), sizeof(oCpuSet), &oCpuSet);
+                        if(err != 0) {
+                            LOGE("%s(%d): pthread_setaffinity_np() failed, err=%d", __FUNCTION__, __LINE__, err);
+                        }
+                    }
+
+                    return QCAP_RT_OK;
+                });
+                if(qres != QCAP_RS_SUCCESSFUL) break;
+
+                shards.push_back(pShard);
+            }
+
+            pEventHandlers = shards.empty() ? nullptr : shards[0]->pEventHandlers;
+
+            return qres;
+        }
+
+        ////// Stops and deletes every shard; the handlers must have been removed first
+
+        void StopEventHandlers() {
+            _FreeStack_main_.flush();
+            shards.clear();
+            pEventHandlers = nullptr;
+        }
+
+        ////// nShard >= 0 places the source on that shard instead of the least loaded one
+
+        template<class FUNC>
+        QRESULT AddEventHandler(free_stack_t& _FreeStack_, qcap2_event_t* pEvent, FUNC func, int nShard = -1) {
+            uintptr_t nHandle;
+            QRESULT qres = qcap2_event_get_native_handle(pEvent, &nHandle);
+            if(qres != QCAP_RS_SUCCESSFUL) {
+                LOGE("%s(%d): qcap2_event_get_native_handle() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+                return qres;
+            }
+
+            return AddHandler(_FreeStack_, PickShard(nShard), nHandle, func);
+        }
+
+        template<class FUNC>
+        QRESULT AddTimerHandler(free_stack_t& _FreeStack_, qcap2_timer_t* pTimer, FUNC func, int nShard = -1) {
+            uintptr_t nHandle;
+            QRESULT qres = qcap2_timer_get_native_handle(pTimer, &nHandle);
+            if(qres != QCAP_RS_SUCCESSFUL) {
+                LOGE("%s(%d): qcap2_timer_get_native_handle() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+                return qres;
+            }
+
+            return AddHandler(_FreeStack_, PickShard(nShard), nHandle, func);
+        }
+
+        std::vector<handler_shard_stats_t> GetShardStats() const {
+            std::vector<handler_shard_stats_t> stats;
+
+            for(const std::shared_ptr<shard_t>& pShard : shards) {
+                stats.push_back({ pShard->nSources.load(), pShard->nHandled.load(), pShard->nBusyUs.load() });
+            }
+
+            return stats;
+        }
+
+        shard_t* PickShard(int nShard) {
+            if(shards.empty()) return nullptr;
+
+            if(nShard >= 0) return shards[nShard % shards.size()].get();
+
+            shard_t* pBest = shards[0].get();
+            for(const std::shared_ptr<shard_t>& pShard : shards) {
+                if(pShard->nSources < pBest->nSources ||
+                    (pShard->nSources == pBest->nSources && pShard->nBusyUs < pBest->nBusyUs)) pBest = pShard.get();
+            }
+
+            return pBest;
+        }
+
+        ////// Runs func on the shard's thread and waits for it; directly when already there
+
+        template<class FUNC>
+        static QRESULT ExecInShard(shard_t* pShard, FUNC func) {
+            if(std::this_thread::get_id() == pShard->nThreadId) {
+                func();
+                return QCAP_RS_SUCCESSFUL;
+            }
+
+            return __testkit__::ExecInEventHandlers(pShard->pEventHandlers, func);
+        }
+
+        template<class FUNC>
+        QRESULT AddHandler(free_stack_t& _FreeStack_, shard_t* pShard, uintptr_t nHandle, FUNC func) {
+            if(pShard == nullptr) return QCAP_RS_ERROR_GENERAL;
+
+            callback_t* pCallback = new callback_t([pShard, func]() -> QRETURN {
+                int64_t nStart = (int64_t)_clk();
+                QRETURN qret = func();
+
+                pShard->nBusyUs += (int64_t)_clk() - nStart;
+                pShard->nHandled++;
+
+                return qret;
+            });
+            _FreeStack_ += [pCallback]() {
+                delete pCallback;
+            };
+
+            QRESULT qres = QCAP_RS_SUCCESSFUL;
+            QRESULT qres_exec = ExecInShard(pShard, [&]() -> QRETURN {
+                qres = qcap2_event_handlers_add_handler(pShard->pEventHandlers, nHandle,
+                    callback_t::_func, pCallback);
+
+                return QCAP_RT_OK;
+            });
+            if(qres_exec != QCAP_RS_SUCCESSFUL) qres = qres_exec;
+            if(qres != QCAP_RS_SUCCESSFUL) {
+                LOGE("%s(%d): qcap2_event_handlers_add_handler() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+                return qres;
+            }
+            pShard->nSources++;
+            _FreeStack_ += [pShard, nHandle]() {
+                ExecInShard(pShard, [pShard, nHandle]() -> QRETURN {
+                    QRESULT qres;
+
+                    qres = qcap2_event_handlers_remove_handler(pShard->pEventHandlers, nHandle);
+                    if(qres != QCAP_RS_SUCCESSFUL) {
+                        LOGE("%s(%d): qcap2_event_handlers_remove_handler() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+                    }
+
+                    return QCAP_RT_OK;
+                });
+                pShard->nSources--;
+            };
+
+            return qres;
+        }
+    };
+
+    ////// Timer sources whose handlers block for a fixed time per event, as on a fence wait, on
+    ////// 1, 2, 4 .. nMaxThreads shards:
+    ////// events handled per second, ticks missed, and how late a handler starts after its
+    ////// deadline ( dispatch latency ). Also counts a handler overlapping itself, which
+    ////// must never happen.
+
+    inline void PoolTestCase_Benchmark(int nMaxThreads, bool bAffinity, double dSecondsPerCase) {
+        const int nSources = 8;
+        const int nRate = 500;
+        const int64_t nWaitUs = 400;
+
+        struct source_t {
+            qcap2_timer_t* pTimer = nullptr;
+            tick_ctrl_t oTick;
+            std::atomic<int> nInside { 0 };
+            std::atomic<int64_t> nOverlaps { 0 };
+        };
+
+        printf("PoolTestCase benchmark: %d timers at %d Hz, handlers blocked %ld us each, affinity %s\n",
+            nSources, nRate, (long)nWaitUs, bAffinity ? "on" : "off");
+        printf("%-8s %10s %10s %10s %10s %10s\n", "threads", "events/s", "missed", "avg us", "max us", "overlaps");
+
+        for(int nThreads = 1;nThreads <= std::max(nMaxThreads, 1);nThreads *= 2) {
+            PoolTestCase oCase;
+
+            std::vector<int> nCpus;
+            for(int i = 0;bAffinity && i < nThreads;i++) nCpus.push_back(i % std::max((int)std::thread::hardware_concurrency(), 1));
+
+            if(oCase.StartEventHandlers(nThreads, nCpus) != QCAP_RS_SUCCESSFUL) {
+                oCase.StopEventHandlers();
+                return;
+            }
+
+            free_stack_t _FreeStack_;
+            std::vector<std::shared_ptr<source_t> > pSources;
+
+            for(int i = 0;i < nSources;i++) {
+                std::shared_ptr<source_t> pSource(new source_t());
+                pSources.push_back(pSource);
+
+                qcap2_timer_t* pTimer = qcap2_timer_new();
+                _FreeStack_ += [pTimer]() {
+                    qcap2_timer_delete(pTimer);
+                };
+
+                QRESULT qres = qcap2_timer_start(pTimer);
+                if(qres != QCAP_RS_SUCCESSFUL) {
+                    LOGE("%s(%d): qcap2_timer_start() failed, qres=%d", __FUNCTION__, __LINE__, qres);
+                    break;
+                }
+                _FreeStack_ += [pTimer]() {
+                    qcap2_timer_stop(pTimer);
+                };
+
+                pSource->pTimer = pTimer;
+                pSource->oTick.num = nRate;
+                pSource->oTick.den = 1;
+                pSource->oTick.policy = TICK_POLICY_SKIP;
+
+                int64_t t = (int64_t)_clk();
+                pSource->oTick.start(t);
+                qcap2_timer_next(pTimer, pSource->oTick.advance(t));
+                pSource->oTick.reset_stats();
+
+                source_t* p = pSource.get();
+                oCase.AddTimerHandler(_FreeStack_, pTimer, [p, nWaitUs]() -> QRETURN {
+                    int64_t now = (int64_t)_clk();
+                    uint64_t nExpirations;
+
+                    qcap2_timer_wait(p->pTimer, &nExpirations);
+                    if(p->nInside++ != 0) p->nOverlaps++;
+
+                    qcap2_timer_next(p->pTimer, p->oTick.advance(now));
+                    std::this_thread::sleep_for(std::chrono::microseconds(nWaitUs));
+
+                    p->nInside--;
+
+                    return QCAP_RT_OK;
+                });
+            }
+
+            std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(dSecondsPerCase * 1000000)));
+
+            _FreeStack_.flush();
+            oCase.StopEventHandlers();
+
+            int64_t nTicks = 0, nMissed = 0, nJitterSum = 0, nJitterMax = 0, nOverlaps = 0;
+            for(const std::shared_ptr<source_t>& pSource : pSources) {
+                nTicks += pSource->oTick.stats.ticks;
+                nMissed += pSource->oTick.stats.missed;
+                nJitterSum += pSource->oTick.stats.jitter_sum;
+                nJitterMax = std::max(nJitterMax, pSource->oTick.stats.jitter_max);
+                nOverlaps += pSource->nOverlaps;
+            }
+
+            printf("%-8d %10.0f %10ld %10.1f %10ld %10ld\n", nThreads, nTicks / dSecondsPerCase, (long)nMissed,
+                (nTicks > 0) ? (double)nJitterSum / nTicks : 0.0, (long)nJitterMax, (long)nOverlaps);
+        }
+    }
 };
 
 #endif // __TESTKIT_H__
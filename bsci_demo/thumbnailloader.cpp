@@ -0,0 +1,182 @@
+#include "thumbnailloader.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QImageReader>
+#include <QMetaObject>
+#include <QtConcurrent>
+
+#include <stdio.h>
+
+ThumbnailLoader::ThumbnailLoader( const QSize &sizeTarget, int nThreads, QObject *parent )
+    : QObject( parent ), m_sizeTarget( sizeTarget ), m_nThreads( qMax( nThreads, 1 ) ), m_oCache( THUMBNAIL_CACHE_KB )
+{
+
+    m_oPool.setMaxThreadCount( m_nThreads );
+
+}
+
+ThumbnailLoader::~ThumbnailLoader()
+{
+
+    ////// Results still queued to this object are dropped with it
+
+    m_oPool.waitForDone();
+
+}
+
+void ThumbnailLoader::SetTargetSize( const QSize &sizeTarget )
+{
+
+    m_sizeTarget = sizeTarget;
+
+}
+
+ThumbnailStats ThumbnailLoader::GetStats() const
+{
+
+    ThumbnailStats stats = m_stStats;
+
+    stats.st_nCached = ( ULONG )m_oCache.count();
+
+    return stats;
+
+}
+
+void ThumbnailLoader::Slot_Thumbnail_Request( const QString &fullPath )
+{
+
+    m_stStats.st_nRequests++;
+
+    Func_Request_Process( fullPath, ++m_nSeq );
+
+}
+
+void ThumbnailLoader::Func_Request_Process( const QString &fullPath, uint64_t nSeq )
+{
+
+    QFileInfo fileInfo( fullPath );
+
+    QString qszKey = QString( "%1|%2|%3x%4" ).arg( fullPath ).arg( fileInfo.lastModified().toMSecsSinceEpoch() )
+                                             .arg( m_sizeTarget.width() ).arg( m_sizeTarget.height() );
+
+    QImage * pCached = m_oCache.object( qszKey );
+
+    if( pCached != nullptr ) {
+
+        m_stStats.st_nCacheHits++;
+
+        Func_Image_Show( fullPath, nSeq, *pCached );
+
+        return;
+
+    }
+
+    ////// All decode threads busy: wait, replacing whatever was waiting already
+
+    if( m_nInFlight >= m_nThreads ) {
+
+        if( m_bPending == TRUE ) m_stStats.st_nCoalesced++;
+
+        m_bPending = TRUE;
+
+        m_qszPendingPath = fullPath;
+
+        m_nPendingSeq = nSeq;
+
+        return;
+
+    }
+
+    m_nInFlight++;
+
+    QSize sizeTarget = m_sizeTarget;
+
+    QtConcurrent::run( &m_oPool, [ this, fullPath, qszKey, nSeq, sizeTarget ]() {
+
+        QImage image = Func_Image_Decode( fullPath, sizeTarget );
+
+        QMetaObject::invokeMethod( this, [ this, fullPath, qszKey, nSeq, image ]() {
+
+            Func_Decode_Done( fullPath, qszKey, nSeq, image );
+
+        }, Qt::QueuedConnection );
+
+    } );
+
+}
+
+void ThumbnailLoader::Func_Decode_Done( const QString &fullPath, const QString &qszKey, uint64_t nSeq, const QImage &image )
+{
+
+    m_nInFlight--;
+
+    if( image.isNull() == TRUE ) {
+
+        m_stStats.st_nDecodeFailed++;
+
+        printf( "[QCAP DEBUG] %s(%d): decode failed: %s\n", __FUNCTION__, __LINE__, fullPath.toUtf8().data() );
+
+    } else {
+
+        m_stStats.st_nDecoded++;
+
+        m_oCache.insert( qszKey, new QImage( image ), qMax( ( int )( image.sizeInBytes() >> 10 ), 1 ) );
+
+        Func_Image_Show( fullPath, nSeq, image );
+
+    }
+
+    if( m_bPending == TRUE ) {
+
+        m_bPending = FALSE;
+
+        Func_Request_Process( m_qszPendingPath, m_nPendingSeq );
+
+    }
+
+}
+
+void ThumbnailLoader::Func_Image_Show( const QString &fullPath, uint64_t nSeq, const QImage &image )
+{
+
+    ////// A slow decode finishing after a newer image is shown must not replace it
+
+    if( nSeq <= m_nShownSeq ) return;
+
+    m_nShownSeq = nSeq;
+
+    ////// Anything still waiting is older than what is on screen now
+
+    if( m_bPending == TRUE && m_nPendingSeq < nSeq ) m_bPending = FALSE;
+
+    emit Signal_Thumbnail_Ready( fullPath, image );
+
+}
+
+QImage ThumbnailLoader::Func_Image_Decode( const QString &fullPath, const QSize &sizeTarget )
+{
+
+    QImageReader reader( fullPath );
+
+    QSize sizeSource = reader.size();
+
+    ////// Readers that support it ( JPEG ) decode straight at the reduced size
+
+    if( sizeSource.isValid() == TRUE && sizeTarget.isValid() == TRUE ) {
+
+        reader.setScaledSize( sizeSource.scaled( sizeTarget, Qt::KeepAspectRatio ) );
+
+    }
+
+    QImage image = reader.read();
+
+    if( image.isNull() == FALSE && sizeTarget.isValid() == TRUE && ( image.width() > sizeTarget.width() || image.height() > sizeTarget.height() ) ) {
+
+        image = image.scaled( sizeTarget, Qt::KeepAspectRatio, Qt::SmoothTransformation );
+
+    }
+
+    return image;
+
+}
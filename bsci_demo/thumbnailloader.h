@@ -0,0 +1,104 @@
+#ifndef THUMBNAILLOADER_H
+#define THUMBNAILLOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QSize>
+#include <QImage>
+#include <QCache>
+#include <QThreadPool>
+
+#include <stdint.h>
+
+#include <qcap.windef.h>
+
+////// Decoded thumbnails kept for redisplay, cost counted in KB
+
+#define THUMBNAIL_CACHE_KB ( 32 * 1024 )
+
+#define THUMBNAIL_DECODE_THREADS 2
+
+struct ThumbnailStats {
+
+    uint64_t    st_nRequests            = 0;
+
+    uint64_t    st_nCoalesced           = 0;            // replaced by a newer request before decoding
+
+    uint64_t    st_nCacheHits           = 0;
+
+    uint64_t    st_nDecoded             = 0;
+
+    uint64_t    st_nDecodeFailed        = 0;
+
+    ULONG       st_nCached              = 0;
+
+};
+
+////// Decodes images and scales them to the target size off the GUI thread. At most
+////// THUMBNAIL_DECODE_THREADS decodes run; a request arriving while they are busy replaces
+////// the one still waiting, so a burst only decodes its newest image. Results older than
+////// what is already shown are cached but not emitted. Lives on the GUI thread, the cache is
+////// keyed by path, mtime and target size and only touched there.
+
+class ThumbnailLoader : public QObject
+{
+
+    Q_OBJECT
+
+public:
+
+    explicit ThumbnailLoader( const QSize &sizeTarget, int nThreads = THUMBNAIL_DECODE_THREADS, QObject *parent = nullptr );
+
+    ~ThumbnailLoader();
+
+    void SetTargetSize( const QSize &sizeTarget );
+
+    ThumbnailStats GetStats() const;
+
+signals:
+
+    void Signal_Thumbnail_Ready( const QString &fullPath, const QImage &image );
+
+public slots:
+
+    void Slot_Thumbnail_Request( const QString &fullPath );
+
+private:
+
+    void Func_Request_Process( const QString &fullPath, uint64_t nSeq );
+
+    void Func_Decode_Done( const QString &fullPath, const QString &qszKey, uint64_t nSeq, const QImage &image );
+
+    void Func_Image_Show( const QString &fullPath, uint64_t nSeq, const QImage &image );
+
+    static QImage Func_Image_Decode( const QString &fullPath, const QSize &sizeTarget );
+
+private:
+
+    QSize                       m_sizeTarget;
+
+    QThreadPool                 m_oPool;
+
+    int                         m_nThreads;
+
+    int                         m_nInFlight         = 0;
+
+    QCache< QString, QImage >   m_oCache;
+
+    ////// The newest request waiting for a free decode thread
+
+    BOOL                        m_bPending          = FALSE;
+
+    QString                     m_qszPendingPath;
+
+    uint64_t                    m_nPendingSeq       = 0;
+
+    uint64_t                    m_nSeq              = 0;
+
+    uint64_t                    m_nShownSeq         = 0;
+
+    ThumbnailStats              m_stStats;
+
+};
+
+#endif // THUMBNAILLOADER_H
@@ -0,0 +1,759 @@
+#include "usbexporter.h"
+#include "latencystats.h"
+#include "archivewriter.h"
+
+#include <QDir>
+#include <QDateTime>
+#include <QDirIterator>
+#include <QFileInfo>
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/sendfile.h>
+
+#include <algorithm>
+#include <map>
+
+UsbExporter::UsbExporter( IoScheduler * pIoScheduler, QObject *parent )
+    : QObject( parent ), m_pIoScheduler( pIoScheduler ), m_bRunning( FALSE ), m_bAbort( FALSE ), m_nBytesDone( 0 ), m_nProgressNs( 0 ), m_nCopyMode( 0 )
+{
+
+}
+
+UsbExporter::~UsbExporter()
+{
+
+    m_bAbort = TRUE;
+
+    if( m_thJob.joinable() == TRUE ) m_thJob.join();
+
+}
+
+BOOL UsbExporter::Start( const QString &qszSrcPath, const QString &qszDstPath, const QString &qszDeviceId, UsbExportMode eMode )
+{
+
+    if( m_bRunning.load() == TRUE ) return FALSE;
+
+    if( m_thJob.joinable() == TRUE ) m_thJob.join();
+
+    struct statvfs st = {};
+
+    if( statvfs( qszDstPath.toUtf8().data(), &st ) != 0 ) return FALSE;
+
+    m_eMode = eMode;
+
+    m_strSrc = QDir( qszSrcPath ).absolutePath().toStdString();
+
+    m_strDst = QDir( qszDstPath ).absolutePath().toStdString();
+
+    m_strJournal = m_strSrc + "/" + USB_EXPORT_JOURNAL;
+
+    ////// The file system UUID stays with the stick, the fsid can change from one mount to the next
+
+    std::string strDeviceId = ( qszDeviceId.isEmpty() == FALSE ) ? qszDeviceId.toStdString()
+                                                                 : QString::asprintf( "fsid %llx", ( unsigned long long )st.f_fsid ).toStdString();
+
+    if( strDeviceId != m_strDeviceId ) m_oSkipped_S.clear();
+
+    m_strDeviceId = strDeviceId;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_oFile_S.clear();
+
+        m_nNext = 0;
+
+        m_nBytesSinceSync = 0;
+
+        m_bSyncing = FALSE;
+
+        m_bFailed = FALSE;
+
+        m_nMoved = 0;
+
+        m_stStats.st_nJobs++;
+    }
+
+    m_nBytesTotal = 0;
+
+    m_nBytesDone = 0;
+
+    m_nProgressNs = 0;
+
+    m_bAbort = FALSE;
+
+    m_bRunning = TRUE;
+
+    m_thJob = std::thread( &UsbExporter::Func_Job_Run, this );
+
+    return TRUE;
+
+}
+
+void UsbExporter::Cancel()
+{
+
+    m_bAbort = TRUE;
+
+}
+
+UsbExportStats UsbExporter::GetStats() const
+{
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    return m_stStats;
+
+}
+
+void UsbExporter::Func_Job_Run()
+{
+
+    Func_Files_Collect();
+
+    BOOL bOk = ( m_eMode == USB_EXPORT_MODE_ARCHIVE ) ? Func_Archive_Run() : Func_Files_Run();
+
+    int nMoved;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        if( bOk == FALSE ) m_stStats.st_nErrors++;
+
+        nMoved = m_nMoved;
+    }
+
+    if( bOk == TRUE ) {
+
+        unlink( m_strJournal.c_str() );
+
+        Func_Dirs_Prune();
+
+    }
+
+    printf( "[QCAP DEBUG] USB export %s: %d files moved to %s\n", ( bOk == TRUE ) ? "done" : "stopped", nMoved, m_strDst.c_str() );
+
+    m_bRunning = FALSE;
+
+    emit Signal_Export_Finished( bOk == TRUE, nMoved, QString::fromStdString( m_strDst ) );
+
+}
+
+BOOL UsbExporter::Func_Files_Run()
+{
+
+    Func_Journal_Load();
+
+    printf( "[QCAP DEBUG] USB export: %lu files, %lu MB to %s\n"
+            , ( ULONG )m_oFile_S.size(), ( ULONG )( ( m_nBytesTotal - m_nBytesDone.load() ) >> 20 ), m_strDst.c_str() );
+
+    int nThreads = std::min< int >( USB_EXPORT_FILES, ( int )m_oFile_S.size() );
+
+    std::vector< std::thread > thCopy_S;
+
+    for( int i = 0; i < nThreads; i++ ) thCopy_S.emplace_back( &UsbExporter::Func_Copy_Loop, this );
+
+    for( std::thread &th : thCopy_S ) th.join();
+
+    ////// Whatever is copied gets synced and verified, even when the job stopped early
+
+    if( m_bAbort.load() == FALSE ) Func_Sync( TRUE );
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    BOOL bOk = ( m_bFailed == FALSE && m_bAbort.load() == FALSE ) ? TRUE : FALSE;
+
+    for( const ExportFile &file : m_oFile_S ) if( file.bVerified == FALSE ) bOk = FALSE;
+
+    return bOk;
+
+}
+
+BOOL UsbExporter::Func_Archive_Run()
+{
+
+    if( m_oFile_S.empty() == TRUE ) return TRUE;
+
+    ////// Named by the time; the writer reserves the name, so a job restarted within the same
+    ////// millisecond gets a suffix instead of truncating the archive before it
+
+    std::string strName = "bsci_" + QDateTime::currentDateTime().toString( "yyyyMMdd_hhmmss_zzz" ).toStdString();
+
+    ArchiveWriter writer( m_strDst, strName, m_pIoScheduler );
+
+    printf( "[QCAP DEBUG] USB export: %lu files, %lu MB into %s/%s%s\n"
+            , ( ULONG )m_oFile_S.size(), ( ULONG )( m_nBytesTotal >> 20 ), m_strDst.c_str(), writer.GetName().c_str(), ARCHIVE_EXTENSION );
+
+    writer.SetCancelCheck( [ this ]() { return m_bAbort.load(); } );
+
+    BOOL bOk = TRUE;
+
+    int nArchived = 0;
+
+    for( ExportFile &file : m_oFile_S ) {
+
+        if( m_bAbort.load() == TRUE ) { bOk = FALSE; break; }
+
+        Func_Progress_Emit( file, 0, FALSE );
+
+        if( writer.Add( m_strSrc + "/" + file.strRel, file.strRel ) == TRUE ) {
+
+            file.bCopied = TRUE;
+
+            nArchived++;
+
+        } else if( writer.IsFailed() == TRUE ) {
+
+            printf( "[QCAP DEBUG] %s(%d): archive failed at %s\n", __FUNCTION__, __LINE__, file.strRel.c_str() );
+
+            bOk = FALSE;
+
+            break;
+
+        } else {
+
+            ////// Vanished or unreadable, the manifest says so; the rest still goes out
+
+            printf( "[QCAP DEBUG] %s(%d): %s can not be read, skipped\n", __FUNCTION__, __LINE__, file.strRel.c_str() );
+
+            m_oSkipped_S.insert( file.strRel );
+
+        }
+
+        m_nBytesDone += file.nSize;
+
+        Func_Progress_Emit( file, file.nSize, TRUE );
+
+    }
+
+    ////// Nothing readable: no archive at all rather than an empty one on every retry
+
+    if( bOk == TRUE && nArchived == 0 ) {
+
+        writer.Remove();
+
+        return TRUE;
+
+    }
+
+    if( bOk == TRUE ) bOk = writer.Finish();
+
+    ArchiveStats stArchive = writer.GetStats();
+
+    ////// Same rule as file by file: nothing leaves the source before it reads back from the stick
+
+    BOOL bVerified = FALSE;
+
+    if( bOk == TRUE && m_bAbort.load() == FALSE ) {
+
+        int nFdDir = open( m_strDst.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+        if( nFdDir >= 0 && syncfs( nFdDir ) == 0 ) bVerified = writer.Verify();
+
+        if( nFdDir >= 0 ) close( nFdDir );
+
+    }
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_stStats.st_nBytesCopied += stArchive.st_nBytesOut;
+
+        if( bOk == TRUE ) m_stStats.st_nSyncs++;
+
+        if( bOk == TRUE && bVerified == FALSE ) m_stStats.st_nVerifyFailed++;
+    }
+
+    if( bVerified == FALSE ) {
+
+        writer.Remove();
+
+        return FALSE;
+
+    }
+
+    for( const ExportFile &file : m_oFile_S ) if( file.bCopied == TRUE ) unlink( ( m_strSrc + "/" + file.strRel ).c_str() );
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    m_nMoved = nArchived;
+
+    m_stStats.st_nFilesMoved += nArchived;
+
+    m_stStats.st_nArchives++;
+
+    m_stStats.st_nArchiveBytesIn += stArchive.st_nBytesIn;
+
+    return TRUE;
+
+}
+
+void UsbExporter::Func_Files_Collect()
+{
+
+    QDirIterator it( QString::fromStdString( m_strSrc ), QDir::Files | QDir::NoSymLinks, QDirIterator::Subdirectories );
+
+    size_t nPrefix = m_strSrc.size() + 1;
+
+    while( it.hasNext() == TRUE ) {
+
+        it.next();
+
+        QFileInfo fileInfo = it.fileInfo();
+
+        ExportFile file;
+
+        file.strRel = fileInfo.absoluteFilePath().toStdString().substr( nPrefix );
+
+        if( m_eMode == USB_EXPORT_MODE_ARCHIVE && m_oSkipped_S.count( file.strRel ) > 0 ) continue;
+
+        file.nSize = ( uint64_t )fileInfo.size();
+
+        m_nBytesTotal += file.nSize;
+
+        m_oFile_S.push_back( file );
+
+    }
+
+    ////// Oldest names first; hidden files ( the journal among them ) stay, like with the shell glob
+
+    std::sort( m_oFile_S.begin(), m_oFile_S.end(), []( const ExportFile &a, const ExportFile &b ) { return a.strRel < b.strRel; } );
+
+}
+
+void UsbExporter::Func_Journal_Load()
+{
+
+    FILE * pFile = fopen( m_strJournal.c_str(), "r" );
+
+    if( pFile == nullptr ) return;
+
+    std::map< std::string, uint64_t > oOffset_S;
+
+    char szLine[ 4096 ];
+
+    ////// Offsets only mean something on the stick they were written to
+
+    std::string strDevice = "device " + m_strDeviceId + "\n";
+
+    if( fgets( szLine, sizeof( szLine ), pFile ) != nullptr && strDevice == szLine ) {
+
+        while( fgets( szLine, sizeof( szLine ), pFile ) != nullptr ) {
+
+            char * pSpace = strchr( szLine, ' ' );
+
+            if( pSpace == nullptr ) continue;
+
+            szLine[ strcspn( szLine, "\n" ) ] = 0;
+
+            oOffset_S[ std::string( pSpace + 1 ) ] = strtoull( szLine, nullptr, 10 );
+
+        }
+
+    }
+
+    fclose( pFile );
+
+    for( ExportFile &file : m_oFile_S ) {
+
+        auto it = oOffset_S.find( file.strRel );
+
+        if( it == oOffset_S.end() || it->second > file.nSize ) continue;
+
+        struct stat st = {};
+
+        if( stat( ( m_strDst + "/" + file.strRel ).c_str(), &st ) != 0 || ( uint64_t )st.st_size < it->second ) continue;
+
+        file.nStart = file.nCopied = file.nDurable = it->second;
+
+        m_nBytesDone += it->second;
+
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_stStats.st_nFilesResumed++;
+
+    }
+
+}
+
+void UsbExporter::Func_Journal_Save()
+{
+
+    std::string strTemp = m_strJournal + ".tmp";
+
+    FILE * pFile = fopen( strTemp.c_str(), "w" );
+
+    if( pFile == nullptr ) return;
+
+    fprintf( pFile, "device %s\n", m_strDeviceId.c_str() );
+
+    for( const ExportFile &file : m_oFile_S ) {
+
+        if( file.bVerified == TRUE || file.nDurable == 0 ) continue;
+
+        fprintf( pFile, "%llu %s\n", ( unsigned long long )file.nDurable, file.strRel.c_str() );
+
+    }
+
+    fflush( pFile );
+
+    fdatasync( fileno( pFile ) );
+
+    fclose( pFile );
+
+    rename( strTemp.c_str(), m_strJournal.c_str() );
+
+}
+
+void UsbExporter::Func_Copy_Loop()
+{
+
+    while( m_bAbort.load() == FALSE ) {
+
+        ExportFile * pFile;
+
+        {
+            std::lock_guard< std::mutex > lock( m_mtx );
+
+            if( m_nNext >= m_oFile_S.size() ) return;
+
+            pFile = &m_oFile_S[ m_nNext++ ];
+        }
+
+        if( Func_File_Copy( *pFile ) == FALSE ) {
+
+            printf( "[QCAP DEBUG] %s(%d): copy of %s failed, errno=%d\n", __FUNCTION__, __LINE__, pFile->strRel.c_str(), errno );
+
+            std::lock_guard< std::mutex > lock( m_mtx );
+
+            m_bFailed = TRUE;
+
+            ////// Mostly the stick going away, the other files would fail the same way
+
+            m_bAbort = TRUE;
+
+        }
+
+    }
+
+}
+
+BOOL UsbExporter::Func_File_Copy( ExportFile &file )
+{
+
+    std::string strSrc = m_strSrc + "/" + file.strRel;
+
+    std::string strDst = m_strDst + "/" + file.strRel;
+
+    QDir().mkpath( QFileInfo( QString::fromStdString( strDst ) ).absolutePath() );
+
+    int nFdIn = open( strSrc.c_str(), O_RDONLY | O_CLOEXEC );
+
+    if( nFdIn < 0 ) return FALSE;
+
+    int nFdOut = open( strDst.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | ( ( file.nStart == 0 ) ? O_TRUNC : 0 ), 0644 );
+
+    if( nFdOut < 0 ) { close( nFdIn ); return FALSE; }
+
+    BOOL bOk = TRUE;
+
+    ////// Anything past the synced offset may not have made it to the stick
+
+    if( file.nStart > 0 && ftruncate( nFdOut, ( off_t )file.nStart ) != 0 ) bOk = FALSE;
+
+    uint64_t nOffset = file.nStart;
+
+    uint64_t nChunk = ( uint64_t )USB_EXPORT_CHUNK_MB << 20;
+
+    while( bOk == TRUE && nOffset < file.nSize ) {
+
+        if( m_bAbort.load() == TRUE ) { bOk = FALSE; break; }
+
+        uint64_t nBytes = std::min( nChunk, file.nSize - nOffset );
+
+        if( m_pIoScheduler != nullptr ) m_pIoScheduler->Acquire( IO_CLASS_EXPORT, nBytes );
+
+        ssize_t nCopied = Func_Range_Copy( nFdIn, nFdOut, nOffset, nBytes );
+
+        if( m_pIoScheduler != nullptr ) m_pIoScheduler->Complete( IO_CLASS_EXPORT, ( nCopied > 0 ) ? ( uint64_t )nCopied : 0 );
+
+        if( nCopied <= 0 ) { bOk = FALSE; break; }
+
+        nOffset += ( uint64_t )nCopied;
+
+        {
+            std::lock_guard< std::mutex > lock( m_mtx );
+
+            file.nCopied = nOffset;
+
+            m_nBytesSinceSync += ( uint64_t )nCopied;
+
+            m_stStats.st_nBytesCopied += ( uint64_t )nCopied;
+        }
+
+        m_nBytesDone += ( uint64_t )nCopied;
+
+        Func_Progress_Emit( file, nOffset, ( nOffset == file.nSize ) ? TRUE : FALSE );
+
+        Func_Sync( FALSE );
+
+    }
+
+    int nErrno = errno;
+
+    if( bOk == TRUE ) {
+
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        file.bCopied = TRUE;
+
+    }
+
+    close( nFdOut );
+
+    close( nFdIn );
+
+    errno = nErrno;
+
+    return bOk;
+
+}
+
+ssize_t UsbExporter::Func_Range_Copy( int nFdIn, int nFdOut, uint64_t nOffset, uint64_t nBytes )
+{
+
+    if( m_nCopyMode.load() == 0 ) {
+
+        loff_t nOffIn = ( loff_t )nOffset, nOffOut = ( loff_t )nOffset;
+
+        ssize_t nCopied = copy_file_range( nFdIn, &nOffIn, nFdOut, &nOffOut, nBytes, 0 );
+
+        if( nCopied >= 0 ) return nCopied;
+
+        ////// Older kernels, and newer ones across file system types, refuse
+
+        if( errno != EXDEV && errno != EINVAL && errno != ENOSYS && errno != EOPNOTSUPP ) return -1;
+
+        m_nCopyMode = std::max( m_nCopyMode.load(), 1 );
+
+    }
+
+    if( m_nCopyMode.load() == 1 ) {
+
+        off_t nOffIn = ( off_t )nOffset;
+
+        if( lseek( nFdOut, ( off_t )nOffset, SEEK_SET ) < 0 ) return -1;
+
+        ssize_t nCopied = sendfile( nFdOut, nFdIn, &nOffIn, nBytes );
+
+        if( nCopied >= 0 ) return nCopied;
+
+        if( errno != EINVAL && errno != ENOSYS ) return -1;
+
+        m_nCopyMode = 2;
+
+    }
+
+    static thread_local std::vector< char > vBuffer;
+
+    vBuffer.resize( nBytes );
+
+    ssize_t nRead = pread( nFdIn, vBuffer.data(), nBytes, ( off_t )nOffset );
+
+    if( nRead <= 0 ) return nRead;
+
+    for( ssize_t nDone = 0; nDone < nRead; ) {
+
+        ssize_t nWritten = pwrite( nFdOut, vBuffer.data() + nDone, nRead - nDone, ( off_t )( nOffset + nDone ) );
+
+        if( nWritten <= 0 ) return -1;
+
+        nDone += nWritten;
+
+    }
+
+    return nRead;
+
+}
+
+void UsbExporter::Func_Sync( BOOL bForce )
+{
+
+    std::vector< uint64_t > nCopied_S;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        if( m_bSyncing == TRUE ) return;
+
+        if( bForce == FALSE && m_nBytesSinceSync < ( ( uint64_t )USB_EXPORT_SYNC_MB << 20 ) ) return;
+
+        m_bSyncing = TRUE;
+
+        m_nBytesSinceSync = 0;
+
+        ////// Everything in here was written before the sync starts, so it is durable after it
+
+        for( const ExportFile &file : m_oFile_S ) nCopied_S.push_back( file.nCopied );
+    }
+
+    int nFdDir = open( m_strDst.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+    BOOL bSynced = ( nFdDir >= 0 && syncfs( nFdDir ) == 0 ) ? TRUE : FALSE;
+
+    if( nFdDir >= 0 ) close( nFdDir );
+
+    std::vector< size_t > nVerify_S;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        if( bSynced == FALSE ) {
+
+            m_bFailed = TRUE;
+
+            m_bAbort = TRUE;
+
+            m_bSyncing = FALSE;
+
+            return;
+
+        }
+
+        m_stStats.st_nSyncs++;
+
+        for( size_t i = 0; i < nCopied_S.size(); i++ ) {
+
+            ExportFile &file = m_oFile_S[ i ];
+
+            file.nDurable = std::max( file.nDurable, nCopied_S[ i ] );
+
+            if( file.bVerified == FALSE && file.bCopied == TRUE && file.nDurable == file.nSize ) nVerify_S.push_back( i );
+
+        }
+
+        Func_Journal_Save();
+    }
+
+    ////// Verify and delete outside the lock, the copy threads carry on meanwhile
+
+    for( size_t i : nVerify_S ) {
+
+        ExportFile &file = m_oFile_S[ i ];
+
+        BOOL bVerified = Func_File_Verify( file );
+
+        if( bVerified == TRUE ) unlink( ( m_strSrc + "/" + file.strRel ).c_str() );
+
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        if( bVerified == TRUE ) {
+
+            file.bVerified = TRUE;
+
+            m_nMoved++;
+
+            m_stStats.st_nFilesMoved++;
+
+        } else {
+
+            printf( "[QCAP DEBUG] %s(%d): %s differs on the stick, kept in the source\n", __FUNCTION__, __LINE__, file.strRel.c_str() );
+
+            ////// Copied again from the start next time
+
+            file.nDurable = 0;
+
+            m_bFailed = TRUE;
+
+            m_stStats.st_nVerifyFailed++;
+
+            Func_Journal_Save();
+
+        }
+
+    }
+
+    std::lock_guard< std::mutex > lock( m_mtx );
+
+    m_bSyncing = FALSE;
+
+}
+
+BOOL UsbExporter::Func_File_Verify( const ExportFile &file )
+{
+
+    int nFdSrc = open( ( m_strSrc + "/" + file.strRel ).c_str(), O_RDONLY | O_CLOEXEC );
+
+    int nFdDst = open( ( m_strDst + "/" + file.strRel ).c_str(), O_RDONLY | O_CLOEXEC );
+
+    BOOL bOk = ( nFdSrc >= 0 && nFdDst >= 0 ) ? TRUE : FALSE;
+
+    struct stat st = {};
+
+    if( bOk == TRUE && ( fstat( nFdDst, &st ) != 0 || ( uint64_t )st.st_size != file.nSize ) ) bOk = FALSE;
+
+    ////// The pages are clean after the sync; dropping them makes the compare read the stick
+
+    if( bOk == TRUE ) posix_fadvise( nFdDst, 0, 0, POSIX_FADV_DONTNEED );
+
+    std::vector< char > vSrc( 1 << 20 ), vDst( 1 << 20 );
+
+    for( uint64_t nOffset = 0; bOk == TRUE && nOffset < file.nSize; ) {
+
+        size_t nBytes = ( size_t )std::min< uint64_t >( vSrc.size(), file.nSize - nOffset );
+
+        if( pread( nFdSrc, vSrc.data(), nBytes, ( off_t )nOffset ) != ( ssize_t )nBytes
+            || pread( nFdDst, vDst.data(), nBytes, ( off_t )nOffset ) != ( ssize_t )nBytes
+            || memcmp( vSrc.data(), vDst.data(), nBytes ) != 0 ) bOk = FALSE;
+
+        nOffset += nBytes;
+
+    }
+
+    if( nFdSrc >= 0 ) close( nFdSrc );
+
+    if( nFdDst >= 0 ) close( nFdDst );
+
+    return bOk;
+
+}
+
+void UsbExporter::Func_Progress_Emit( const ExportFile &file, uint64_t nCopied, BOOL bForce )
+{
+
+    int64_t nNowNs = Func_Latency_Now();
+
+    int64_t nLastNs = m_nProgressNs.load();
+
+    if( bForce == FALSE && nNowNs - nLastNs < ( int64_t )USB_EXPORT_PROGRESS_MS * 1000000 ) return;
+
+    if( m_nProgressNs.compare_exchange_strong( nLastNs, nNowNs ) == FALSE && bForce == FALSE ) return;
+
+    int nFilePercent = ( file.nSize > 0 ) ? ( int )( nCopied * 100 / file.nSize ) : 100;
+
+    emit Signal_Export_Progress( QString::fromStdString( file.strRel ), nFilePercent, ( qint64 )m_nBytesDone.load(), ( qint64 )m_nBytesTotal );
+
+}
+
+void UsbExporter::Func_Dirs_Prune()
+{
+
+    ////// mv took the folders along; empty ones go, deepest first
+
+    QStringList qszDir_S;
+
+    QDirIterator it( QString::fromStdString( m_strSrc ), QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories );
+
+    while( it.hasNext() == TRUE ) qszDir_S.append( it.next() );
+
+    std::sort( qszDir_S.begin(), qszDir_S.end(), []( const QString &a, const QString &b ) { return a.size() > b.size(); } );
+
+    for( const QString &qszDir : qszDir_S ) rmdir( qszDir.toUtf8().data() );
+
+}
@@ -0,0 +1,216 @@
+#ifndef USBEXPORTER_H
+#define USBEXPORTER_H
+
+#include <QObject>
+#include <QString>
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <set>
+
+#include <qcap.windef.h>
+
+#include "ioscheduler.h"
+
+////// Files copied at the same time
+
+#define USB_EXPORT_FILES 2
+
+#define USB_EXPORT_CHUNK_MB 4
+
+////// One syncfs() per this much copied, then the journal is saved and the finished files are
+////// verified and removed from the source
+
+#define USB_EXPORT_SYNC_MB 64
+
+////// In the source folder: stick identity ( UsbMount::st_qszDeviceId ) and the synced offset of
+////// every unfinished file
+
+#define USB_EXPORT_JOURNAL ".bsci_export.journal"
+
+#define USB_EXPORT_PROGRESS_MS 100
+
+enum UsbExportMode {
+
+    USB_EXPORT_MODE_FILES = 0,          // the folder tree, file by file
+
+    USB_EXPORT_MODE_ARCHIVE             // one split .tar.zst with a manifest, see ArchiveWriter
+
+};
+
+struct UsbExportStats {
+
+    uint64_t    st_nJobs                = 0;
+
+    uint64_t    st_nFilesMoved          = 0;
+
+    uint64_t    st_nBytesCopied         = 0;
+
+    uint64_t    st_nSyncs               = 0;
+
+    uint64_t    st_nFilesResumed        = 0;
+
+    uint64_t    st_nVerifyFailed        = 0;
+
+    uint64_t    st_nErrors              = 0;
+
+    uint64_t    st_nArchives            = 0;
+
+    uint64_t    st_nArchiveBytesIn      = 0;            // tar stream
+
+};
+
+////// Moves everything below a source folder onto a USB stick on its own thread, so the GUI
+////// only sees progress signals. Up to USB_EXPORT_FILES files are copied in chunks with
+////// copy_file_range() ( sendfile() or read / write where the kernel refuses ), durability is
+////// batched into one syncfs() per USB_EXPORT_SYNC_MB, and a source file is only deleted once
+////// its copy reads back identical from the stick. The journal makes a pulled stick resume
+////// where the last sync left off when it is plugged in again.
+//////
+////// In archive mode the files go into one compressed archive instead, the sources are
+////// removed once the whole archive reads back from the stick; a pulled stick restarts it.
+////// A file that can not be read is listed in the manifest and left in the source, and is
+////// not tried again until another stick is plugged in.
+
+class UsbExporter : public QObject
+{
+
+    Q_OBJECT
+
+public:
+
+    ////// Every chunk is export class I/O on pIoScheduler, when there is one
+
+    explicit UsbExporter( IoScheduler * pIoScheduler = nullptr, QObject *parent = nullptr );
+
+    ~UsbExporter();
+
+    ////// FALSE while a job is still running. qszDeviceId names the stick for the resume journal,
+    ////// empty falls back to the file system id of qszDstPath
+
+    BOOL Start( const QString &qszSrcPath, const QString &qszDstPath, const QString &qszDeviceId, UsbExportMode eMode = USB_EXPORT_MODE_FILES );
+
+    ////// Stick removed: the running job stops at the next chunk, the journal keeps its place
+
+    void Cancel();
+
+    BOOL IsRunning() const { return m_bRunning.load(); }
+
+    UsbExportStats GetStats() const;
+
+signals:
+
+    void Signal_Export_Progress( const QString &fileName, int nFilePercent, qint64 nBytesDone, qint64 nBytesTotal );
+
+    void Signal_Export_Finished( bool bOk, int nFilesMoved, const QString &dstPath );
+
+private:
+
+    struct ExportFile {
+
+        std::string     strRel;
+
+        uint64_t        nSize       = 0;
+
+        uint64_t        nStart      = 0;            // resumed from the journal
+
+        uint64_t        nCopied     = 0;
+
+        uint64_t        nDurable    = 0;            // covered by a finished syncfs()
+
+        BOOL            bCopied     = FALSE;
+
+        BOOL            bVerified   = FALSE;
+
+    };
+
+    void Func_Job_Run();
+
+    void Func_Files_Collect();
+
+    BOOL Func_Files_Run();
+
+    BOOL Func_Archive_Run();
+
+    void Func_Journal_Load();
+
+    ////// Caller holds m_mtx
+
+    void Func_Journal_Save();
+
+    void Func_Copy_Loop();
+
+    BOOL Func_File_Copy( ExportFile &file );
+
+    ssize_t Func_Range_Copy( int nFdIn, int nFdOut, uint64_t nOffset, uint64_t nBytes );
+
+    void Func_Sync( BOOL bForce );
+
+    BOOL Func_File_Verify( const ExportFile &file );
+
+    void Func_Progress_Emit( const ExportFile &file, uint64_t nCopied, BOOL bForce );
+
+    void Func_Dirs_Prune();
+
+private:
+
+    IoScheduler *               m_pIoScheduler;
+
+    std::thread                 m_thJob;
+
+    std::atomic< BOOL >         m_bRunning;
+
+    std::atomic< BOOL >         m_bAbort;
+
+    ////// Job state, set before the job thread starts
+
+    UsbExportMode               m_eMode             = USB_EXPORT_MODE_FILES;
+
+    std::string                 m_strSrc;
+
+    std::string                 m_strDst;
+
+    std::string                 m_strJournal;
+
+    std::string                 m_strDeviceId;
+
+    ////// Archive mode: files that could not be read on this stick, left out of later jobs
+
+    std::set< std::string >     m_oSkipped_S;
+
+    std::vector< ExportFile >   m_oFile_S;
+
+    uint64_t                    m_nBytesTotal       = 0;
+
+    ////// Guards the file states, the sync bookkeeping and the stats
+
+    mutable std::mutex          m_mtx;
+
+    size_t                      m_nNext             = 0;
+
+    uint64_t                    m_nBytesSinceSync   = 0;
+
+    BOOL                        m_bSyncing          = FALSE;
+
+    BOOL                        m_bFailed           = FALSE;
+
+    int                         m_nMoved            = 0;
+
+    UsbExportStats              m_stStats;
+
+    std::atomic< uint64_t >     m_nBytesDone;
+
+    std::atomic< int64_t >      m_nProgressNs;
+
+    ////// 0 copy_file_range(), 1 sendfile(), 2 read / write; only ever goes up
+
+    std::atomic< int >          m_nCopyMode;
+
+};
+
+#endif // USBEXPORTER_H
@@ -0,0 +1,245 @@
+#include "usbmonitor.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QByteArray>
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+UsbMonitor::UsbMonitor( QObject *parent )
+    : QObject( parent )
+{
+
+    QString qszRoots = qgetenv( USB_MONITOR_ROOTS_ENV );
+
+    if( qszRoots.isEmpty() == FALSE ) {
+
+        for( const QString &qszRoot : qszRoots.split( ':' ) ) if( qszRoot.isEmpty() == FALSE ) m_qszRoot_S << qszRoot;
+
+        printf( "[QCAP DEBUG] USB monitor test roots: %s\n", qszRoots.toUtf8().data() );
+
+    } else {
+
+        QString user = qgetenv( "USER" );
+
+        m_qszRoot_S << "/media/" + user << "/run/media/" + user;
+
+    }
+
+    for( QString &qszRoot : m_qszRoot_S ) qszRoot = QDir::cleanPath( qszRoot );
+
+    m_nFd = open( "/proc/self/mountinfo", O_RDONLY | O_CLOEXEC );
+
+    if( m_nFd < 0 ) {
+
+        printf( "[QCAP DEBUG] %s(%d): open( /proc/self/mountinfo ) failed, errno=%d\n", __FUNCTION__, __LINE__, errno );
+
+        return;
+
+    }
+
+    ////// The mount table is a "priority" event on the descriptor, not a readable one
+
+    m_pNotifier = new QSocketNotifier( m_nFd, QSocketNotifier::Exception, this );
+
+    connect( m_pNotifier, &QSocketNotifier::activated, this, &UsbMonitor::Slot_MountInfo_Changed );
+
+    ////// Already mounted sticks are there from the start, without signals
+
+    m_oMount_S = Func_MountInfo_Parse();
+
+}
+
+UsbMonitor::~UsbMonitor()
+{
+
+    if( m_nFd >= 0 ) close( m_nFd );
+
+}
+
+void UsbMonitor::Slot_MountInfo_Changed()
+{
+
+    std::vector< UsbMount > oMount_S = Func_MountInfo_Parse();
+
+    std::vector< UsbMount > oOld_S;
+
+    oOld_S.swap( m_oMount_S );
+
+    m_oMount_S = oMount_S;
+
+    auto pfnFind = []( const std::vector< UsbMount > &oMount_S, const UsbMount &mount ) {
+
+        for( const UsbMount &other : oMount_S ) {
+
+            if( other.st_qszMountPath == mount.st_qszMountPath && other.st_qszDeviceId == mount.st_qszDeviceId ) return TRUE;
+
+        }
+
+        return FALSE;
+
+    };
+
+    for( const UsbMount &mount : oOld_S ) {
+
+        if( pfnFind( oMount_S, mount ) == TRUE ) continue;
+
+        printf( "[QCAP DEBUG] USB removed: %s ( %s )\n", mount.st_qszMountPath.toUtf8().data(), mount.st_qszDeviceId.toUtf8().data() );
+
+        emit Signal_Usb_Removed( mount.st_qszMountPath, mount.st_qszDeviceId );
+
+    }
+
+    for( const UsbMount &mount : oMount_S ) {
+
+        if( pfnFind( oOld_S, mount ) == TRUE ) continue;
+
+        printf( "[QCAP DEBUG] USB mounted: %s ( %s, %s )\n", mount.st_qszMountPath.toUtf8().data(), mount.st_qszDeviceId.toUtf8().data(), mount.st_qszFsType.toUtf8().data() );
+
+        emit Signal_Usb_Mounted( mount.st_qszMountPath, mount.st_qszDeviceId );
+
+    }
+
+}
+
+std::vector< UsbMount > UsbMonitor::Func_MountInfo_Parse()
+{
+
+    std::vector< UsbMount > oMount_S;
+
+    if( m_nFd < 0 ) return oMount_S;
+
+    ////// Reading from the start again is also what clears the change flag
+
+    QByteArray content;
+
+    char szBuffer[ 16384 ];
+
+    for( off_t nOffset = 0; ; ) {
+
+        ssize_t nRead = pread( m_nFd, szBuffer, sizeof( szBuffer ), nOffset );
+
+        if( nRead <= 0 ) break;
+
+        content.append( szBuffer, ( int )nRead );
+
+        nOffset += nRead;
+
+    }
+
+    ////// 36 35 98:0 /mnt1 /mnt/parent rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+
+    for( const QByteArray &line : content.split( '\n' ) ) {
+
+        QList< QByteArray > field_S = line.split( ' ' );
+
+        int nSeparator = field_S.indexOf( "-" );
+
+        if( nSeparator < 6 || nSeparator + 2 >= field_S.size() ) continue;
+
+        QString qszMountPath = Func_Field_Unescape( field_S[ 4 ] );
+
+        BOOL bUnderRoot = FALSE;
+
+        for( const QString &qszRoot : m_qszRoot_S ) {
+
+            if( qszMountPath.startsWith( qszRoot + "/" ) == TRUE ) bUnderRoot = TRUE;
+
+        }
+
+        if( bUnderRoot == FALSE ) continue;
+
+        if( field_S[ 5 ].startsWith( "rw" ) == FALSE || QFileInfo( qszMountPath ).isWritable() == FALSE ) continue;
+
+        UsbMount mount;
+
+        mount.st_qszMountPath = qszMountPath;
+
+        mount.st_qszFsType = QString::fromUtf8( field_S[ nSeparator + 1 ] );
+
+        mount.st_qszDeviceId = Func_Device_Id( QString::fromUtf8( field_S[ 2 ] ), Func_Field_Unescape( field_S[ 3 ] ), Func_Field_Unescape( field_S[ nSeparator + 2 ] ) );
+
+        ////// Mounted over again: the newer mount hides the older one
+
+        for( auto it = oMount_S.begin(); it != oMount_S.end(); ) {
+
+            if( it->st_qszMountPath == qszMountPath ) it = oMount_S.erase( it ); else ++it;
+
+        }
+
+        oMount_S.push_back( mount );
+
+    }
+
+    return oMount_S;
+
+}
+
+QString UsbMonitor::Func_Device_Id( const QString &qszDevice, const QString &qszRoot, const QString &qszSource )
+{
+
+    QString qszId = qszDevice;
+
+    unsigned int nMajor = 0, nMinor = 0;
+
+    if( sscanf( qszDevice.toUtf8().data(), "%u:%u", &nMajor, &nMinor ) == 2 ) {
+
+        dev_t nDev = makedev( nMajor, nMinor );
+
+        QDir dir( "/dev/disk/by-uuid" );
+
+        for( const QString &qszUuid : dir.entryList( QDir::System | QDir::NoDotAndDotDot ) ) {
+
+            struct stat st = {};
+
+            if( stat( dir.absoluteFilePath( qszUuid ).toUtf8().data(), &st ) == 0 && S_ISBLK( st.st_mode ) && st.st_rdev == nDev ) {
+
+                qszId = "UUID=" + qszUuid;
+
+                break;
+
+            }
+
+        }
+
+    }
+
+    if( qszId == qszDevice && qszSource.startsWith( "/dev/" ) == TRUE ) qszId += " " + qszSource;
+
+    if( qszRoot != "/" ) qszId += ":" + qszRoot;
+
+    return qszId;
+
+}
+
+QString UsbMonitor::Func_Field_Unescape( const QByteArray &field )
+{
+
+    ////// Space, tab, newline and backslash come as \040, \011, \012 and \134
+
+    QByteArray result;
+
+    for( int i = 0; i < field.size(); i++ ) {
+
+        if( field[ i ] == '\\' && i + 3 < field.size() ) {
+
+            bool bOk = false;
+
+            int nChar = field.mid( i + 1, 3 ).toInt( &bOk, 8 );
+
+            if( bOk == true ) { result.append( ( char )nChar ); i += 3; continue; }
+
+        }
+
+        result.append( field[ i ] );
+
+    }
+
+    return QString::fromUtf8( result );
+
+}
@@ -0,0 +1,80 @@
+#ifndef USBMONITOR_H
+#define USBMONITOR_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QSocketNotifier>
+
+#include <vector>
+
+#include <qcap.windef.h>
+
+////// Colon separated mount roots replacing /media/$USER and /run/media/$USER, for testing
+////// without a stick: mount --bind /tmp/stick $BSCI_USB_ROOTS/stick appears as a plug-in
+
+#define USB_MONITOR_ROOTS_ENV "BSCI_USB_ROOTS"
+
+struct UsbMount {
+
+    QString     st_qszMountPath;
+
+    ////// File system UUID when udev knows one, else the device number; plus the bound
+    ////// subfolder for bind mounts. Same stick, same id, whatever it is mounted as.
+
+    QString     st_qszDeviceId;
+
+    QString     st_qszFsType;
+
+};
+
+////// Follows /proc/self/mountinfo, which the kernel flags ( POLLPRI ) whenever the mount
+////// table changes, so a stick shows up within milliseconds of being mounted and nothing is
+////// scanned in between. Only writable mounts below the mount roots count.
+
+class UsbMonitor : public QObject
+{
+
+    Q_OBJECT
+
+public:
+
+    explicit UsbMonitor( QObject *parent = nullptr );
+
+    ~UsbMonitor();
+
+    ////// In mount order, oldest first
+
+    const std::vector< UsbMount > & GetMounts() const { return m_oMount_S; }
+
+signals:
+
+    void Signal_Usb_Mounted( const QString &mountPath, const QString &deviceId );
+
+    void Signal_Usb_Removed( const QString &mountPath, const QString &deviceId );
+
+private slots:
+
+    void Slot_MountInfo_Changed();
+
+private:
+
+    std::vector< UsbMount > Func_MountInfo_Parse();
+
+    QString Func_Device_Id( const QString &qszDevice, const QString &qszRoot, const QString &qszSource );
+
+    static QString Func_Field_Unescape( const QByteArray &field );
+
+private:
+
+    int                         m_nFd               = -1;
+
+    QSocketNotifier *           m_pNotifier         = nullptr;
+
+    QStringList                 m_qszRoot_S;
+
+    std::vector< UsbMount >     m_oMount_S;
+
+};
+
+#endif // USBMONITOR_H
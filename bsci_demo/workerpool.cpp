@@ -0,0 +1,117 @@
+#include "workerpool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool( int nThreads )
+{
+
+    nThreads = std::min( nThreads, std::max( 1, ( int )std::thread::hardware_concurrency() ) );
+
+    for( int i = 1; i < nThreads; i++ ) m_thWorker_S.emplace_back( &WorkerPool::Func_Worker_Loop, this );
+
+}
+
+WorkerPool::~WorkerPool()
+{
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_bExit = TRUE;
+    }
+
+    m_cvWork.notify_all();
+
+    for( auto &th : m_thWorker_S ) th.join();
+
+}
+
+void WorkerPool::Run( int nTasks, const std::function< void( int ) > &pfnTask )
+{
+
+    if( nTasks <= 0 ) return;
+
+    std::lock_guard< std::mutex > lockRun( m_mtxRun );
+
+    uint64_t nGeneration = 0;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        m_pfnTask = &pfnTask;
+
+        m_nTasks = nTasks;
+
+        m_nNext = 0;
+
+        m_nDone = 0;
+
+        nGeneration = ++m_nGeneration;
+    }
+
+    m_cvWork.notify_all();
+
+    Func_Tasks_Drain( nGeneration );
+
+    std::unique_lock< std::mutex > lock( m_mtx );
+
+    m_cvDone.wait( lock, [ this ]() { return m_nDone == m_nTasks; } );
+
+    m_pfnTask = nullptr;
+
+}
+
+////// Tasks are claimed under the lock with the generation checked, so a worker that wakes
+////// late never runs a task of the next job with a stale function
+
+void WorkerPool::Func_Tasks_Drain( uint64_t nGeneration )
+{
+
+    while( TRUE ) {
+
+        int nTask = 0;
+
+        const std::function< void( int ) > * pfnTask = nullptr;
+
+        {
+            std::lock_guard< std::mutex > lock( m_mtx );
+
+            if( m_nGeneration != nGeneration || m_nNext >= m_nTasks ) break;
+
+            nTask = m_nNext++;
+
+            pfnTask = m_pfnTask;
+        }
+
+        ( *pfnTask )( nTask );
+
+        std::lock_guard< std::mutex > lock( m_mtx );
+
+        if( ++m_nDone == m_nTasks ) m_cvDone.notify_all();
+
+    }
+
+}
+
+void WorkerPool::Func_Worker_Loop()
+{
+
+    uint64_t nSeen = 0;
+
+    while( TRUE ) {
+
+        {
+            std::unique_lock< std::mutex > lock( m_mtx );
+
+            m_cvWork.wait( lock, [ this, nSeen ]() { return m_bExit == TRUE || m_nGeneration != nSeen; } );
+
+            if( m_bExit == TRUE ) break;
+
+            nSeen = m_nGeneration;
+        }
+
+        Func_Tasks_Drain( nSeen );
+
+    }
+
+}
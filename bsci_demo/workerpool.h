@@ -0,0 +1,63 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <functional>
+
+#include <qcap.windef.h>
+
+////// Fixed set of threads that run the tasks of one job in parallel. Run() is serialised
+////// and the calling thread takes tasks too, so at most nThreads threads work at once.
+////// Used for row bands ( CpuConvert ) and slices ( FrameCodec ).
+
+class WorkerPool
+{
+
+public:
+
+    explicit WorkerPool( int nThreads );
+
+    ~WorkerPool();
+
+    int GetThreadCount() const { return ( int )m_thWorker_S.size() + 1; }
+
+    ////// Calls pfnTask( 0 .. nTasks - 1 ) and returns when all of them have finished
+
+    void Run( int nTasks, const std::function< void( int ) > &pfnTask );
+
+private:
+
+    void Func_Tasks_Drain( uint64_t nGeneration );
+
+    void Func_Worker_Loop();
+
+private:
+
+    std::vector< std::thread >              m_thWorker_S;
+
+    std::mutex                              m_mtxRun;
+
+    std::mutex                              m_mtx;
+
+    std::condition_variable                 m_cvWork;
+
+    std::condition_variable                 m_cvDone;
+
+    const std::function< void( int ) > *    m_pfnTask       = nullptr;
+
+    int                                     m_nTasks        = 0;
+
+    int                                     m_nNext         = 0;
+
+    int                                     m_nDone         = 0;
+
+    uint64_t                                m_nGeneration   = 0;
+
+    BOOL                                    m_bExit         = FALSE;
+
+};
+
+#endif // WORKERPOOL_H